@@ -13,6 +13,26 @@
  * - Pin/unpin the main window (always on top)
  * - Save and restore user settings
  * - Threaded worker for background current monitoring
+ * - Per-instrument calibration of the monitored readings
+ * - Optional session capture with statistics computed on fixed-point columns, logged crash-safe
+ * - Optional OpenMetrics endpoint for the monitoring stack
+ * - Optional web dashboard streaming samples to browsers, with a compressed scroll-back history
+ * - Setpoint journal restoring the last commanded state on startup
+ * - Sequenced samples with quality flags and gap reporting
+ * - Optional predictive polling skipping reads of steady readings
+ * - Allocation probes on hot paths (PS_TRACK_ALLOCATIONS builds)
+ * - Automatic reconnect and a fault-injection resilience benchmark
+ * - Per-model timing profiles setting the command timeouts
+ * - Link-budget planning of the sample time
+ * - Multi-output supplies read with one channel-addressed query
+ * - Status-byte change detection of output switches, trips and errors
+ * - Named presets recalled from instrument memory slots
+ * - Optional engine process keeping sampling and protection alive without the window
+ * - Cancellable instrument exchanges, resynchronized after an abort
+ * - Power-cycle endurance runner capturing the current of every power-up
+ * - Battery emulation from an equivalent-circuit model
+ * - Telemetry bus with a backpressure policy per consumer
+ * - One pooled event per GUI frame instead of one queued signal per sample
  *
  * @author Aaron Escoboza
  * @note Github: https://github.com/aaron-ev
@@ -20,17 +40,38 @@
 
 #include "GUI_MAIN_POWER_SUPPLY.h"
 #include "./ui_UI_POWER_SUPPLY.h"
+#include "metrics_server.h"
+#include "web_dashboard.h"
+#include "alloc_tracker.h"
+#include "link_budget.h"
+#include "instrument_engine.h"
+#include "engine_transport.h"
+#include "frame_event.h"
+#include "sample_store.h"
 #include <QObject>
 #include <QDebug>
 #include <QMessageBox>
 #include <QSettings>
+#include <QStatusBar>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QMenu>
+#include <QInputDialog>
+#include <QSharedMemory>
+#include <QProcess>
+#include <QCoreApplication>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 
 /**
  * @class Worker
  * @brief Background worker for monitoring power supply current in a separate thread.
  *
- * The Worker class periodically queries the power supply for the current value and emits
- * a signal when the current changes. It is designed to run in a separate thread.
+ * The Worker class periodically queries the power supply for the current value and hands
+ * the samples to the window one frame at a time. It is designed to run in a separate thread.
  */
 class Worker : public QObject
 {
@@ -51,20 +92,321 @@ public:
         stopFlag = true;
     }
 
+    /**
+     * @brief Time between samples.
+     * @return Sample time in milliseconds.
+     */
+    int sampleTimeMs(void) const
+    {
+        return sampleTime;
+    }
+
+    /**
+     * @brief Sets the time between samples. Takes effect with the next sample.
+     * @param milliseconds Sample time in milliseconds.
+     */
+    void setSampleTimeMs(int milliseconds)
+    {
+        sampleTime = milliseconds;
+    }
+
+    /**
+     * @brief Tells whether every sample also reads the voltage.
+     * @return True when metrics, the telemetry bus or the capture need the voltage.
+     */
+    bool readsVoltage(void) const
+    {
+        return metrics || bus || engine || voltageWanted;
+    }
+
+    /**
+     * @brief Makes every sample also read the voltage. Must be called before the thread starts.
+     * @param enable True when the window keeps the voltage of the samples.
+     */
+    void setReadsVoltage(bool enable)
+    {
+        voltageWanted = enable;
+    }
+
+    /**
+     * @brief Sets the calibration applied to every reading.
+     * @param cal Calibration of the connected instrument.
+     */
+    void setCalibration(const Calibration& cal)
+    {
+        std::lock_guard<std::mutex> lock(calibrationMutex);
+        calibration = cal;
+    }
+
+    /**
+     * @brief Sets the metrics every sample is published to. Must be called before the thread starts.
+     * @param telemetry Metrics registry, nullptr to disable publishing.
+     */
+    void setMetrics(TelemetryMetrics *telemetry)
+    {
+        metrics = telemetry;
+    }
+
+    /**
+     * @brief Sets the tracker every sample is accounted in. Must be called before the thread starts.
+     * @param tracker Gap tracker, nullptr to disable tracking.
+     */
+    void setGapTracker(GapTracker *tracker)
+    {
+        gapTracker = tracker;
+    }
+
+    /**
+     * @brief Sets the predictor deciding which ticks read the instrument. Must be called before the thread starts.
+     * @param predictor Poll predictor, nullptr to read at every tick.
+     */
+    void setPollPredictor(PollPredictor *predictor)
+    {
+        pollPredictor = predictor;
+    }
+
+    /**
+     * @brief Sets the number of outputs sampled. Must be called before the thread starts.
+     * @param channels Outputs of the supply; more than one are read with one compound query.
+     */
+    void setChannelCount(int channels)
+    {
+        channelCount = std::max(1, channels);
+        readings.assign(channelCount, PsChannelReading());
+        lastGood.assign(channelCount, Sample());
+    }
+
+    /**
+     * @brief Tells whether every sample also checks the instrument status.
+     */
+    bool watchesStatus(void) const
+    {
+        return statusWatch;
+    }
+
+    /**
+     * @brief Enables the status check of every sample. Reports come with statusChanged.
+     * @param enable True to poll the status byte, or the full state on models without status reporting.
+     */
+    void setStatusWatch(bool enable)
+    {
+        statusWatch = enable;
+    }
+
+    /**
+     * @brief Thins out the status checks when the link budget cannot afford one per sample.
+     * @param samples Samples per status check, 1 for every sample.
+     */
+    void setStatusInterval(int samples)
+    {
+        statusEvery = std::max(1, samples);
+    }
+
+    /**
+     * @brief Sets the dispatcher handing the samples to the window. Must be called before the thread starts.
+     * @param dispatcher Frame dispatcher of the window, nullptr for none.
+     */
+    void setFrameDispatcher(FrameDispatcher *dispatcher)
+    {
+        frames = dispatcher;
+    }
+
+    /**
+     * @brief Sets the bus every sample is published to. Must be called before the thread starts.
+     * @param telemetry Telemetry bus read by the consumers of the samples, nullptr for none.
+     */
+    void setTelemetryBus(TelemetryBus *telemetry)
+    {
+        bus = telemetry;
+    }
+
+    /**
+     * @brief Takes the samples from an instrument engine instead of reading the instrument.
+     * Must be called before the thread starts.
+     * @param region Shared region of the engine, nullptr to sample in this process.
+     */
+    void setEngine(EngineRegion *region)
+    {
+        engine = region;
+    }
+
 private:
     PowerSupply *powerSupply;      ///< Pointer to the PowerSupply object.
     PowerSupply::PsError err;      ///< Last error code.
-    double oldCurrent = 0.0;       ///< Previous current value.
     double newCurrent = 0.0;       ///< Latest current value.
+    double newVoltage = 0.0;       ///< Latest voltage value (read only when publishing samples).
+    bool voltageWanted = false;    ///< The window needs the voltage of every sample.
     bool stopFlag = false;         ///< Flag to stop the worker loop.
-    int sampleTime = 1;            ///< Time between samples in seconds.
+    std::atomic<int> sampleTime{1000};  ///< Time between samples in milliseconds.
+    Calibration calibration;       ///< Calibration of the connected instrument.
+    std::mutex calibrationMutex;   ///< Protects the calibration.
+    TelemetryMetrics *metrics = nullptr; ///< Metrics registry, optional.
+    TelemetryBus *bus = nullptr;   ///< Fan-out of every sample to its consumers, optional.
+    FrameDispatcher *frames = nullptr; ///< Per-frame delivery of the samples to the window, optional.
+    GapTracker *gapTracker = nullptr; ///< Gap and latency accounting, optional.
+    PollPredictor *pollPredictor = nullptr; ///< Skips reads the model can predict, optional.
+    uint64_t nextSequence = 1;     ///< Sequence number of the next sample.
+    int channelCount = 1;          ///< Outputs sampled.
+    std::vector<PsChannelReading> readings = std::vector<PsChannelReading>(1); ///< Readings of the last sample, per output.
+    std::vector<Sample> lastGood = std::vector<Sample>(1); ///< Last sample with a fresh reading, per output.
+    std::atomic<bool> statusWatch{false}; ///< Check the instrument status every statusEvery samples.
+    std::atomic<int> statusEvery{1};      ///< Samples per status check, from the link budget.
+    PsStatus status;               ///< Instrument status of the last check.
+    EngineRegion *engine = nullptr; ///< Region of the instrument engine, optional.
+    static constexpr int engineReadMs = 10; ///< Time between reads of the engine's telemetry ring.
+
+    /**
+     * @brief Calibrates a sample of one output and hands it to the trackers, the metrics and the signals.
+     * @param channel Channel number.
+     * @param sample Sample with the raw reading when good, replaced by the last good reading when not.
+     * A predicted sample keeps its current and takes the voltage of the last good reading.
+     */
+    void deliver(int channel, Sample& sample)
+    {
+        GapRecord gap;
+
+        if (sample.good())
+        {
+            /* Correct the raw reading with the instrument calibration */
+            {
+                std::lock_guard<std::mutex> lock(calibrationMutex);
+                calibration.apply(channel, readsVoltage() ? &sample.voltage : nullptr, &sample.current, 1);
+            }
+            lastGood[channel] = sample;
+            if (pollPredictor && channelCount == 1)
+                pollPredictor->update(0, sample.timestampMs, sample.current);
+        }
+        else if (sample.quality == SAMPLE_PREDICTED)
+        {
+            sample.voltage = lastGood[channel].voltage;
+        }
+        else
+        {
+            /* Stale sample: the last good reading, flagged */
+            sample.voltage = lastGood[channel].voltage;
+            sample.current = lastGood[channel].current;
+        }
+
+        if (gapTracker && gapTracker->record(channel, sample, &gap))
+            emit gapClosed(channel, gap.durationMs(), gap.lastSequence - gap.firstSequence + 1);
+        if (metrics)
+            metrics->publish(channel, sample);
+
+        if (bus)
+            bus->publish(channel, sample);
+
+        /* The window gets the samples with the next frame, not one event each */
+        if (frames)
+            frames->push(channel, sample);
+    }
+
+    /**
+     * @brief Worker loop of engine mode: forwards the engine's samples and state changes.
+     * Samples are renumbered across engine restarts so the gap tracker sees
+     * one stream; samples lost by reading too late show up as gaps. While the
+     * engine's link is up the window is asked, at most once a second, to
+     * reopen a local link closed after a failure; the driver is only touched
+     * on the GUI thread.
+     */
+    void engineWork()
+    {
+        EngineSample entries[64];
+        EngineState state;
+        uint64_t session = 0;
+        uint64_t cursor = 0;
+        uint64_t statusChanges = 0;
+        uint64_t protectionTrips = 0;
+        uint64_t sequenceBase = 0;
+        uint64_t lastSequence = 0;
+        std::chrono::steady_clock::time_point lastLinkCheck;
+
+        while (stopFlag == false)
+        {
+            uint64_t lost = 0;
+            size_t count;
+
+            /* A new engine starts a new stream and new counters */
+            if (engine->session.load(std::memory_order_relaxed) != session && engine->state.load(state))
+            {
+                session = engine->session.load(std::memory_order_relaxed);
+                cursor = engine->telemetryHead.load(std::memory_order_acquire);
+                statusChanges = state.statusChanges;
+                protectionTrips = state.protectionTrips;
+                sequenceBase = lastSequence;
+            }
+            if (session == 0)
+            {
+                QThread::msleep(engineReadMs);
+                continue;
+            }
+
+            count = engine->readTelemetry(cursor, entries, sizeof(entries) / sizeof(entries[0]), lost);
+            for (size_t i = 0; i < count; i++)
+            {
+                Sample& sample = entries[i].sample;
+
+                if (entries[i].channel < 0 || entries[i].channel >= channelCount)
+                    continue;
+                sample.sequence += sequenceBase;
+                lastSequence = std::max(lastSequence, sample.sequence);
+                deliver(entries[i].channel, sample);
+            }
+            if (frames)
+                frames->flush();
+
+            if (engine->state.load(state))
+            {
+                if (state.statusChanges != statusChanges)
+                {
+                    statusChanges = state.statusChanges;
+                    emit statusChanged(state.output, state.questionable, state.error);
+                }
+                if (state.protectionTrips != protectionTrips)
+                {
+                    protectionTrips = state.protectionTrips;
+                    emit protectionTripped(state.protectionChannel, state.protectionCurrent);
+                }
+                if (state.linkUp && std::chrono::steady_clock::now() - lastLinkCheck >= std::chrono::seconds(1))
+                {
+                    lastLinkCheck = std::chrono::steady_clock::now();
+                    emit engineLinkUp();
+                }
+            }
+
+            if (count < sizeof(entries) / sizeof(entries[0]))
+                QThread::msleep(engineReadMs);
+        }
+    }
 
 signals:
     /**
-     * @brief Signal emitted when the current value changes.
-     * @param current The new current value.
+     * @brief Signal emitted when a good sample ends a run of missing or flagged samples.
+     * @param channel Channel number.
+     * @param durationMs Time between the good samples around the gap.
+     * @param samples Number of samples without a fresh reading.
      */
-    void currentChanged(double current);
+    void gapClosed(int channel, qint64 durationMs, quint64 samples);
+
+    /**
+     * @brief Signal emitted when a status check finds the output switched, a protection tripped or an error.
+     * @param output Output state.
+     * @param questionable Questionable events latched since the previous report.
+     * @param error Oldest instrument error, 0 for none.
+     */
+    void statusChanged(bool output, quint16 questionable, int error);
+
+    /**
+     * @brief Signal emitted when the engine switched an output off over its current limit.
+     * @param channel Channel number.
+     * @param current Raw current reading that tripped the protection.
+     */
+    void protectionTripped(int channel, double current);
+
+    /**
+     * @brief Signal emitted in engine mode, at most once a second, while the engine's link is up.
+     * The window reopens its own link to the engine when a failure closed it.
+     */
+    void engineLinkUp(void);
 
 public slots:
     /**
@@ -72,30 +414,97 @@ public slots:
      */
     void mainWork()
     {
+        if (engine)
+        {
+            engineWork();
+            return;
+        }
+
         while (stopFlag == false)
         {
+            Sample sample;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            PS_ALLOCATION_PROBE("worker.sample");
+
+            /* Every iteration produces a sample, with or without a fresh reading */
+            sample.sequence = nextSequence++;
+            sample.timestampMs = QDateTime::currentMSecsSinceEpoch();
+
+            /* Ticks the model predicts well enough cost no round trip; their sample is flagged predicted */
+            if (pollPredictor && channelCount == 1 && powerSupply->isOpen() == PowerSupply::PsError::ERR_SUCCESS &&
+                !pollPredictor->shouldPoll(0, sample.timestampMs))
+            {
+                sample.current = pollPredictor->predict(0, sample.timestampMs);
+                sample.quality = SAMPLE_PREDICTED;
+                deliver(0, sample);
+                if (frames)
+                    frames->flush();
+                QThread::msleep(sampleTime);
+                continue;
+            }
+
             if (powerSupply->isOpen() != PowerSupply::PsError::ERR_SUCCESS)
             {
                 qDebug() << "Port not open";
-                goto wait_till_nex_sample;
+                err = PowerSupply::PsError::ERR_DEVICE_NOT_CONNECTED;
+
+                /* A link lost mid-session is reopened unless the user closed it; the sample stays flagged as reconnecting */
+                if (powerSupply->reconnect() == PowerSupply::PsError::ERR_SUCCESS)
+                    qDebug() << "Reconnected";
+            }
+            else if (channelCount > 1)
+            {
+                /* One compound query reads every output */
+                err = powerSupply->readChannels(readings, readsVoltage());
+                if (err != PowerSupply::PsError::ERR_SUCCESS)
+                    qDebug() << "Failed to read channels";
+            }
+            else
+            {
+                err = powerSupply->readCurrent(newCurrent);
+                if (err != PowerSupply::PsError::ERR_SUCCESS)
+                    qDebug() << "Failed to get current";
+
+                /* Voltage is only needed by the metrics, the dashboard and the capture */
+                if (err == PowerSupply::PsError::ERR_SUCCESS && readsVoltage())
+                {
+                    err = powerSupply->readVoltage(newVoltage);
+                    if (err != PowerSupply::PsError::ERR_SUCCESS)
+                        qDebug() << "Failed to get voltage";
+                }
+                readings[0].voltage = newVoltage;
+                readings[0].current = newCurrent;
             }
+            sample.quality = InstrumentEngine::qualityFor(err);
+            sample.latencyUs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                         std::chrono::steady_clock::now() - start).count());
 
-            err = powerSupply->readCurrent(newCurrent);
-            if (err != PowerSupply::PsError::ERR_SUCCESS)
+            /* The outputs of one read share sequence, timestamp, quality and latency */
+            for (int channel = 0; channel < channelCount; channel++)
             {
-                qDebug() << "Failed to get current";
-                goto wait_till_nex_sample;
+                Sample output = sample;
+
+                output.voltage = readings[channel].voltage;
+                output.current = readings[channel].current;
+                deliver(channel, output);
             }
+            if (frames)
+                frames->flush();
 
-            /* Only signal is emitted when there is a current change */
-            if (newCurrent != oldCurrent)
+            /* One status byte every statusEvery samples; the full state only when it reports a change */
+            if (statusWatch && err == PowerSupply::PsError::ERR_SUCCESS &&
+                sample.sequence % static_cast<uint64_t>(statusEvery.load()) == 0)
             {
-                oldCurrent = newCurrent;
-                emit currentChanged(newCurrent);
+                bool changed = false;
+
+                if (powerSupply->pollStatus(status, changed) != PowerSupply::PsError::ERR_SUCCESS)
+                    qDebug() << "Failed to poll status";
+                else if (changed)
+                    emit statusChanged(status.output, status.questionable, status.error);
             }
 
-            wait_till_nex_sample:
-                QThread::sleep(sampleTime); /* Wait until next sample */
+            QThread::msleep(sampleTime); /* Wait until next sample */
         }
     }
 };
@@ -110,6 +519,7 @@ public slots:
 /**
  * @brief MainWindow constructor.
  * Initializes the UI, restores user settings, and starts the worker thread.
+ * In engine mode the session starts once the engine is attached.
  * @param parent Parent widget.
  */
 MainWindow::MainWindow(QWidget *parent)
@@ -117,14 +527,18 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
 {
     QString userPort;
-    bool powerState = false;
     bool userPinState = false;
-    PowerSupply::PsError err = PowerSupply::PsError::ERR_SUCCESS;
 
     ui->setupUi(this);
     setFixedSize(size());
     this->setWindowTitle(this->windowTitle() + " v" + swVersion);
 
+    /* Steps of the voltage box settle before they are journaled and written */
+    voltageTimer = new QTimer(this);
+    voltageTimer->setSingleShot(true);
+    voltageTimer->setInterval(voltageSettleMs);
+    connect(voltageTimer, &QTimer::timeout, this, &MainWindow::commit_voltage);
+
     /* User settings: Port */
     settings = new QSettings("powerSupply", "settings");
 
@@ -143,8 +557,52 @@ MainWindow::MainWindow(QWidget *parent)
         ui->pinButton->setChecked(userPinState);
     }
 
+    /* User settings: engine mode, the instrument is driven by a separate engine process */
+    if (settings->value("engineMode", false).toBool())
+        attach_engine(userPort);
+    else
+        start_session(nullptr);
+}
+
+/**
+ * @brief Creates the power supply and the worker, and starts sampling.
+ * @param engineRegion Region of the attached engine, nullptr when the window samples the instrument itself.
+ */
+void MainWindow::start_session(EngineRegion *engineRegion)
+{
+    QString userPort = settings->value("port", "").toString();
+    QString journalDir;
+    int metricsPort = 0;
+    int dashboardPort = 0;
+    int dashboardHistoryMiB = 0;
+    int channels = 1;
+    PowerSupply::PsError err = PowerSupply::PsError::ERR_SUCCESS;
+
     /* Power supply object */
-    powerSupply = new PowerSupply(userPort.toStdString());
+    if (engineRegion)
+    {
+        engineTransport = new EngineTransport(engineRegion);
+        powerSupply = new PowerSupply(userPort.toStdString(), std::unique_ptr<Transport>(engineTransport));
+        engineTransport->configure(EngineOp::PROTECTION, settings->value("protectionCurrentA", 0.0).toDouble());
+    }
+    else
+    {
+        powerSupply = new PowerSupply(userPort.toStdString());
+    }
+    powerSupply->setCancelToken(&cancelToken);
+
+    /* User settings: presets, applied from the window's context menu */
+    if (!presetStore.deserialize(settings->value("presets", "").toString().toStdString()))
+        statusBar()->showMessage("Invalid presets", statusbarMessageTimeout);
+    setContextMenuPolicy(Qt::CustomContextMenu);
+    connect(this, &QWidget::customContextMenuRequested, this, &MainWindow::show_context_menu);
+
+    /* User settings: outputs of the supply, each sampled as one channel */
+    channels = std::max(1, settings->value("channels", 1).toInt());
+    if (powerSupply->setChannels(channels) != PowerSupply::PsError::ERR_SUCCESS)
+        statusBar()->showMessage(QString("%1 outputs do not fit in one query, sampling output 1").arg(channels),
+                                 statusbarMessageTimeout);
+    channels = powerSupply->channels;
 
     /* Create worker thread, connect signals and start it */
     workerThread = new QThread(this);
@@ -152,27 +610,106 @@ MainWindow::MainWindow(QWidget *parent)
     worker->moveToThread(workerThread);
     connect(workerThread, &QThread::started, worker, &Worker::mainWork);
     connect(workerThread, &QThread::finished, worker, &Worker::deleteLater);
-    connect(worker, &Worker::currentChanged, this, &MainWindow::on_current_valueChanged);
+    connect(worker, &Worker::statusChanged, this, &MainWindow::report_status);
+    connect(worker, &Worker::protectionTripped, this, &MainWindow::report_protection);
+    connect(worker, &Worker::engineLinkUp, this, &MainWindow::reopen_engine_link);
+    worker->setChannelCount(channels);
+    worker->setEngine(engineRegion);
+    frameDispatcher = new FrameDispatcher(this);
+    worker->setFrameDispatcher(frameDispatcher);
 
-    /* Check if power supply port is opened */
-    if (powerSupply->isOpen() != PowerSupply::PsError::ERR_SUCCESS)
-        QString errorMessage = "Failed to turn on power supply";
+    /* User settings: session capture for the statistics of the context menu, disabled when 0.
+       With captureLog the session's samples are also written to a crash-safe log,
+       durable within captureDurabilityMs */
+    captureLimit = static_cast<size_t>(std::max(0LL, settings->value("captureSamples", 0).toLongLong()));
+    if (captureLimit > 0)
+    {
+        capture = new SampleStore(channels);
+        worker->setReadsVoltage(true);
+        if (settings->value("captureLog", true).toBool())
+        {
+            QString captureDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/capture/" +
+                                 QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss");
+            uint32_t durabilityMs = static_cast<uint32_t>(std::max(1, settings->value("captureDurabilityMs", 50).toInt()));
 
-    /* Update power button state */
-    powerSupply->isOn(powerState);
-    if (powerState)
-        load_power_icon(ui->buttonPower, true);
-    else
-        load_power_icon(ui->buttonPower, false);
+            if (captureLog.open(captureDir.toStdString(), durabilityMs) != CaptureLog::CaptureError::ERR_SUCCESS)
+                statusBar()->showMessage("Capture log unavailable", statusbarMessageTimeout);
+        }
+    }
+    load_calibration();
+    load_timing_profile();
 
-    /* User settings: default voltage */
-    lastSavedVoltage = settings->value("lastSavedVoltage", "0.0").toDouble();
-    if (powerSupply->writeVoltage(lastSavedVoltage) == PowerSupply::PsError::ERR_SUCCESS)
+    /* Every sample is accounted for gaps and read latency */
+    gapTracker = new GapTracker(channels);
+    worker->setGapTracker(gapTracker);
+    connect(worker, &Worker::gapClosed, this, &MainWindow::report_gap);
+
+    /* User settings: predictive polling, reads only when the current model is uncertain.
+       Outputs of a multi-channel supply are read together, so it applies to single-output ones.
+       An engine samples at its own pace, so it does not apply in engine mode either */
+    if (channels == 1 && !engineRegion && settings->value("predictivePolling", false).toBool())
     {
-        ui->voltage->blockSignals(true);
-        ui->voltage->setValue(lastSavedVoltage);
-        ui->voltage->blockSignals(false);
+        PollPolicy policy;
+        policy.maxUncertainty = settings->value("predictionBound", policy.maxUncertainty).toDouble();
+        policy.maxStalenessMs = settings->value("maxStalenessMs", static_cast<qlonglong>(policy.maxStalenessMs)).toLongLong();
+        pollPredictor = new PollPredictor(1, policy);
+        worker->setPollPredictor(pollPredictor);
     }
+
+    /* User settings: OpenMetrics endpoint on localhost, disabled when the port is 0 */
+    metrics = new TelemetryMetrics(channels);
+    metrics->addDevice("ps0", &powerSupply->health);
+    metrics->setGapTracker(gapTracker);
+    metrics->setPollPredictor(pollPredictor);
+    metricsPort = settings->value("metricsPort", 0).toInt();
+    if (metricsPort > 0)
+    {
+        worker->setMetrics(metrics);
+        metricsServer = new MetricsServer(metrics, this);
+        if (!metricsServer->start(static_cast<quint16>(metricsPort)))
+            statusBar()->showMessage(QString("Metrics port %1 unavailable").arg(metricsPort), statusbarMessageTimeout);
+    }
+
+    /* User settings: web dashboard, disabled when the port is 0. It listens on localhost
+       unless dashboardLan exposes it to the network.
+       It reads the samples from the telemetry bus with the dashboardBackpressure policy
+       and keeps dashboardHistoryMiB of them for the scroll-back chart (0 disables it) */
+    dashboardPort = settings->value("dashboardPort", 0).toInt();
+    if (dashboardPort > 0)
+    {
+        BusConsumerOptions consumer;
+
+        dashboard = new WebDashboard(channels, this);
+        dashboardHistoryMiB = settings->value("dashboardHistoryMiB", 16).toInt();
+        if (dashboardHistoryMiB > 0)
+            dashboard->enableHistory(static_cast<size_t>(dashboardHistoryMiB) * 1024 * 1024);
+        telemetryBus = new TelemetryBus();
+        consumer.name = "dashboard";
+        if (!TelemetryBus::parsePolicy(settings->value("dashboardBackpressure", "drop-oldest").toString().toStdString(),
+                                       consumer.policy))
+            statusBar()->showMessage("Invalid dashboardBackpressure", statusbarMessageTimeout);
+        dashboardConsumer = telemetryBus->subscribe(consumer);
+        worker->setTelemetryBus(telemetryBus);
+        metrics->setTelemetryBus(telemetryBus);
+        telemetryTimer = new QTimer(this);
+        connect(telemetryTimer, &QTimer::timeout, this, &MainWindow::drain_telemetry);
+        telemetryTimer->start(telemetryDrainMs);
+        if (!dashboard->start(settings->value("dashboardLan", false).toBool() ? QHostAddress::Any : QHostAddress::LocalHost,
+                              static_cast<quint16>(dashboardPort)))
+            statusBar()->showMessage(QString("Dashboard port %1 unavailable").arg(dashboardPort), statusbarMessageTimeout);
+    }
+
+    /* Check if power supply port is opened */
+    if (powerSupply->isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+        QString errorMessage = "Failed to turn on power supply";
+
+    /* Setpoint journal: rebuild the last commanded state and reconcile the instrument with it */
+    journalDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal";
+    if (journal.open(journalDir.toStdString()) != SetpointJournal::JournalError::ERR_SUCCESS)
+        statusBar()->showMessage("Setpoint journal unavailable", statusbarMessageTimeout);
+    restore_setpoints();
+    enable_status_watch();
+    plan_link_budget();
     workerThread->start();
 }
 
@@ -183,6 +720,24 @@ MainWindow::MainWindow(QWidget *parent)
  */
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+    /* An engine still coming up is left to run on its own */
+    if (engineTimer)
+        engineTimer->stop();
+
+    /* A voltage still settling is applied, not dropped */
+    if (voltageTimer->isActive())
+    {
+        voltageTimer->stop();
+        commit_voltage();
+    }
+
+    /* A sample blocked on a stalled link must not hold the window open */
+    cancelToken.cancel();
+    if (telemetryBus)
+        telemetryBus->close();
+    if (workerThread)
+        worker->stop();
+
     /* Close the power supply */
     if (powerSupply)
     {
@@ -192,7 +747,6 @@ void MainWindow::closeEvent(QCloseEvent *event)
     /* Stop the worker thread */
     if (workerThread)
     {
-        worker->stop();
         workerThread->quit();
         workerThread->wait();
         delete workerThread;
@@ -207,6 +761,13 @@ void MainWindow::closeEvent(QCloseEvent *event)
  */
 MainWindow::~MainWindow()
 {
+    if (AllocationTracker::enabled())
+    {
+        std::string report;
+        AllocationTracker::render(report);
+        qDebug().noquote() << QString::fromStdString(report);
+    }
+
     if (powerSupply)
     {
         powerSupply->close();
@@ -219,6 +780,14 @@ MainWindow::~MainWindow()
         workerThread->wait();          // Wait for the thread to finish
         delete workerThread;           // Delete the thread
     }
+    delete metricsServer;
+    delete dashboard;
+    delete metrics;
+    delete telemetryBus;
+    delete frameDispatcher;
+    delete capture;
+    delete gapTracker;
+    delete pollPredictor;
     delete ui;  // Clean up the UI
 }
 
@@ -228,22 +797,402 @@ MainWindow::~MainWindow()
  */
 void MainWindow::on_current_valueChanged(double current)
 {
+    PS_ALLOCATION_PROBE("gui.currentFrame");
     ui->current->setValue(current);
 }
 
+/**
+ * @brief Handles the frames of the worker: shows the latest current of the first output,
+ * adds the good samples to the capture and every sample to the capture log.
+ * One event arrives per frame with the samples since the previous one, so
+ * the widget is updated at most once per frame however fast the sampling.
+ * @param event Posted event.
+ */
+void MainWindow::customEvent(QEvent *event)
+{
+    const FrameEvent *frame;
+    const Sample *latest = nullptr;
+
+    if (event->type() != FrameEvent::frameType())
+    {
+        QMainWindow::customEvent(event);
+        return;
+    }
+
+    frame = static_cast<const FrameEvent*>(event);
+    for (uint64_t index = frame->begin; index < frame->end; index++)
+    {
+        const FrameSample& entry = frameDispatcher->at(index);
+
+        /* The log keeps the flagged samples too, they mark the gaps */
+        if (captureLog.isOpen())
+            captureLog.append(entry.channel, entry.sample);
+        if (!entry.sample.good())
+            continue;
+        if (entry.channel == 0)
+            latest = &entry.sample;
+        if (capture)
+            capture_sample(entry.channel, entry.sample);
+    }
+    if (latest)
+        on_current_valueChanged(latest->current);
+    frameDispatcher->finish(*frame);
+}
+
+/**
+ * @brief Timer slot handing the samples of the telemetry bus to the dashboard.
+ * The dashboard is a consumer of its own: when the window falls behind, its
+ * backpressure policy decides what it misses, and the sampler is not held up.
+ */
+void MainWindow::drain_telemetry(void)
+{
+    BusEntry entries[256];
+    size_t count;
+
+    do
+    {
+        count = telemetryBus->read(dashboardConsumer, entries, sizeof(entries) / sizeof(entries[0]));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (entries[i].sample.good())
+                dashboard->publish(entries[i].channel, entries[i].sample.timestampMs,
+                                   entries[i].sample.voltage, entries[i].sample.current);
+        }
+    } while (count == sizeof(entries) / sizeof(entries[0]));
+}
+
+/**
+ * @brief Adds a good sample to the capture, up to the captureSamples user setting per output.
+ * @param channel Channel number.
+ * @param sample Calibrated sample.
+ */
+void MainWindow::capture_sample(int channel, const Sample& sample)
+{
+    if (capture->size(channel) >= captureLimit)
+    {
+        if (!captureFull)
+            statusBar()->showMessage("Capture full, clear it to continue", statusbarMessageTimeout);
+        captureFull = true;
+        return;
+    }
+    capture->append(channel, sample.timestampMs, sample.voltage, sample.current);
+}
+
+/**
+ * @brief Shows the statistics of the capture, computed on its integer columns.
+ * Intervals over three sample times are counted as gaps and left out of the energy.
+ */
+void MainWindow::show_capture_stats(void)
+{
+    QString text;
+
+    capture->setGapThresholdMs(3 * worker->sampleTimeMs());
+    for (size_t channel = 0; channel < capture->channels(); channel++)
+    {
+        size_t count = capture->size(channel);
+        ColumnStats stats = capture->stats(channel, 0, count);
+
+        text += QString("Output %1: %2 samples").arg(channel + 1).arg(count);
+        if (count == 0)
+        {
+            text += "\n\n";
+            continue;
+        }
+        text += QString(" over %1 s\n").arg(capture->timestampColumn(channel)[count - 1] / 1000.0, 0, 'f', 1);
+        text += QString("Voltage %1 / %2 / %3 V (min / mean / max)\n")
+                    .arg(stats.minVoltage, 0, 'f', 4).arg(stats.meanVoltage, 0, 'f', 4).arg(stats.maxVoltage, 0, 'f', 4);
+        text += QString("Current %1 / %2 / %3 A (min / mean / max)\n")
+                    .arg(stats.minCurrent, 0, 'f', 4).arg(stats.meanCurrent, 0, 'f', 4).arg(stats.maxCurrent, 0, 'f', 4);
+        text += QString("Energy %1 J (%2 Wh), %3 gaps over %4 s\n\n")
+                    .arg(stats.energyJoules, 0, 'f', 3).arg(stats.energyJoules / 3600.0, 0, 'f', 4)
+                    .arg(stats.gaps).arg(stats.gapSeconds, 0, 'f', 1);
+    }
+    QMessageBox::information(this, "Capture", text.trimmed());
+}
+
+/**
+ * @brief Slot called when the worker recovers from missing or flagged samples.
+ * @param channel Channel number.
+ * @param durationMs Duration of the gap.
+ * @param samples Samples without a fresh reading.
+ */
+void MainWindow::report_gap(int channel, qint64 durationMs, quint64 samples)
+{
+    std::string report;
+
+    statusBar()->showMessage(QString("Channel %1: %2 samples missing over %3 s")
+                                 .arg(channel).arg(samples).arg(durationMs / 1000.0, 0, 'f', 1),
+                             statusbarMessageTimeout);
+    gapTracker->render(report);
+    if (pollPredictor)
+        pollPredictor->render(report);
+    qDebug().noquote() << QString::fromStdString(report);
+}
+
+/**
+ * @brief Slot called when a status check reports a change on the instrument.
+ * An output switched at the front panel or by a protection is mirrored in
+ * the widgets; trips and instrument errors are shown in the status bar.
+ * @param output Output state.
+ * @param questionable Questionable events latched since the previous report.
+ * @param error Oldest instrument error, 0 for none.
+ */
+void MainWindow::report_status(bool output, quint16 questionable, int error)
+{
+    if (output)
+        load_power_icon(ui->buttonPower, true);
+    else
+        reset_power_supply_widgets();
+    if (pollPredictor)
+        pollPredictor->setpointChanged(0);
+
+    if (questionable & powerSupply->questionableMask)
+        statusBar()->showMessage(QString("Protection tripped (questionable status %1)").arg(questionable),
+                                 statusbarMessageTimeout);
+    else if (error != 0)
+        statusBar()->showMessage(QString("Instrument error %1").arg(error), statusbarMessageTimeout);
+}
+
+/**
+ * @brief Slot called while the engine's link is up. Reopens the window's link
+ * to the engine when a failed exchange closed it. Runs on the GUI thread,
+ * which owns the driver's open and close.
+ */
+void MainWindow::reopen_engine_link(void)
+{
+    if (powerSupply->isOpen() != PowerSupply::PsError::ERR_SUCCESS &&
+        powerSupply->reconnect() == PowerSupply::PsError::ERR_SUCCESS)
+        qDebug() << "Engine link reopened";
+}
+
+/**
+ * @brief Slot called when the engine switched an output off over the protectionCurrentA user setting.
+ * @param channel Channel number.
+ * @param current Raw current reading that tripped the protection.
+ */
+void MainWindow::report_protection(int channel, double current)
+{
+    if (channel == 0)
+    {
+        reset_power_supply_widgets();
+        journal.recordOutput(false, QDateTime::currentMSecsSinceEpoch());
+    }
+    statusBar()->showMessage(QString("Output %1 switched off at %2 A").arg(channel + 1).arg(current, 0, 'f', 3),
+                             statusbarMessageTimeout);
+}
+
+/**
+ * @brief Shows the context menu: apply, save the instrument settings as a preset,
+ * delete presets, and the statistics of the capture when one is kept.
+ * @param position Click position in window coordinates.
+ */
+void MainWindow::show_context_menu(const QPoint& position)
+{
+    QMenu menu(this);
+    QMenu *removeMenu = nullptr;
+    std::vector<std::string> names = presetStore.names();
+
+    for (const std::string& name : names)
+    {
+        QString presetName = QString::fromStdString(name);
+        menu.addAction("Apply " + presetName, this, [this, presetName] { apply_preset(presetName); });
+    }
+    if (!names.empty())
+        menu.addSeparator();
+    menu.addAction("Save settings as preset...", this, [this] {
+        bool accepted = false;
+        QString name = QInputDialog::getText(this, "Save preset", "Preset name:", QLineEdit::Normal, "", &accepted).trimmed();
+        if (accepted && !name.isEmpty())
+            save_preset(name);
+    });
+    if (!names.empty())
+    {
+        removeMenu = menu.addMenu("Delete preset");
+        for (const std::string& name : names)
+        {
+            removeMenu->addAction(QString::fromStdString(name), this, [this, name] {
+                presetStore.remove(name);
+                store_presets();
+            });
+        }
+    }
+    if (capture)
+    {
+        menu.addSeparator();
+        menu.addAction("Capture statistics...", this, &MainWindow::show_capture_stats);
+        menu.addAction("Clear capture", this, [this] {
+            for (size_t channel = 0; channel < capture->channels(); channel++)
+                capture->clear(channel);
+            captureFull = false;
+        });
+    }
+    menu.exec(mapToGlobal(position));
+}
+
+/**
+ * @brief Switches the instrument to a preset.
+ * A preset already saved in an instrument slot is recalled with one *RCL
+ * message that reads the settings back. Otherwise, or when the slot turns
+ * out to hold other settings, the preset is written in one message and then
+ * saved to a slot, when the presetSlots user setting allows any, so that
+ * the next switch is a recall.
+ * @param name Preset name.
+ */
+void MainWindow::apply_preset(const QString& name)
+{
+    const Preset *preset = presetStore.find(name.toStdString());
+    PsSetpoints setpoints;
+    SetpointState previous = journal.state();
+    SetpointState wanted;
+    int slots = presetSlotsSupported && !instrumentSerial.empty() ? settings->value("presetSlots", 0).toInt() : 0;
+    int slot = 0;
+    bool recalled = false;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    if (preset == nullptr)
+        return;
+    setpoints.voltage = preset->voltage;
+    setpoints.currentLimit = preset->currentLimit;
+    setpoints.output = preset->output;
+
+    /* Journaled before the instrument is touched; undone if it refuses */
+    wanted.voltage = setpoints.voltage;
+    wanted.currentLimit = setpoints.currentLimit;
+    wanted.currentLimitKnown = true;
+    wanted.output = setpoints.output;
+    wanted.timestampMs = now;
+    if (journal.record(wanted) != SetpointJournal::JournalError::ERR_SUCCESS)
+        statusBar()->showMessage("Setpoint journal write failed", statusbarMessageTimeout);
+
+    if (slots > 0)
+        slot = presetStore.slotFor(instrumentSerial, name.toStdString());
+    if (slot > 0)
+    {
+        if (powerSupply->recallState(slot, setpoints, voltageTolerance, recalled) != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            statusBar()->showMessage("Failed to recall preset " + name, statusbarMessageTimeout);
+            journal.record(previous);
+            return;
+        }
+        if (recalled)
+            presetStore.recordUsed(instrumentSerial, slot);
+        else
+            presetStore.forgetSlot(instrumentSerial, slot);  /* Overwritten behind our back */
+    }
+
+    if (!recalled)
+    {
+        if (powerSupply->writeSetpoints(setpoints) != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            statusBar()->showMessage("Failed to apply preset " + name, statusbarMessageTimeout);
+            journal.record(previous);
+            return;
+        }
+
+        /* Keep it in the instrument for the next switch */
+        slot = presetStore.assignSlot(instrumentSerial, name.toStdString(), slots);
+        if (slot > 0 && powerSupply->saveState(slot) == PowerSupply::PsError::ERR_SUCCESS)
+            presetStore.recordSaved(instrumentSerial, slot, name.toStdString());
+        else if (slot > 0)
+            presetSlotsSupported = false;
+    }
+    store_presets();
+
+    if (pollPredictor)
+        pollPredictor->setpointChanged(0);
+    lastSavedVoltage = setpoints.voltage;
+    settings->setValue("lastSavedVoltage", lastSavedVoltage);
+    if (setpoints.output)
+    {
+        load_power_icon(ui->buttonPower, true);
+        ui->voltage->blockSignals(true);
+        ui->voltage->setValue(setpoints.voltage);
+        ui->voltage->blockSignals(false);
+    }
+    else
+    {
+        reset_power_supply_widgets();
+    }
+    statusBar()->showMessage(recalled ? QString("Preset %1 recalled from slot %2").arg(name).arg(slot)
+                                      : QString("Preset %1 applied").arg(name), statusbarMessageTimeout);
+}
+
+/**
+ * @brief Saves the settings of the instrument as a preset, and to a slot when allowed.
+ * @param name Preset name; an existing preset is replaced.
+ */
+void MainWindow::save_preset(const QString& name)
+{
+    PsSetpoints actual;
+    Preset preset;
+    int slots = presetSlotsSupported && !instrumentSerial.empty() ? settings->value("presetSlots", 0).toInt() : 0;
+    int slot = 0;
+
+    if (powerSupply->readSetpoints(actual) != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        statusBar()->showMessage("Failed to read the settings of preset " + name, statusbarMessageTimeout);
+        return;
+    }
+    preset.voltage = actual.voltage;
+    preset.currentLimit = actual.currentLimit;
+    preset.output = actual.output;
+    presetStore.setPreset(name.toStdString(), preset);
+
+    slot = presetStore.assignSlot(instrumentSerial, name.toStdString(), slots);
+    if (slot > 0 && powerSupply->saveState(slot) == PowerSupply::PsError::ERR_SUCCESS)
+        presetStore.recordSaved(instrumentSerial, slot, name.toStdString());
+    else if (slot > 0)
+        presetSlotsSupported = false;
+    store_presets();
+    statusBar()->showMessage("Preset " + name + " saved", statusbarMessageTimeout);
+}
+
+/**
+ * @brief Writes presets and slot assignments to the user settings.
+ */
+void MainWindow::store_presets(void)
+{
+    settings->setValue("presets", QString::fromStdString(presetStore.serialize()));
+}
+
 /**
  * @brief Slot called when the voltage value changes.
  * @param voltage The new voltage value.
  */
 void MainWindow::on_voltage_valueChanged(double voltage)
 {
+   Q_UNUSED(voltage);
+   voltageTimer->start();
+}
+
+/**
+ * @brief Journals the voltage of the voltage box and writes it to the instrument.
+ * Runs once the box has been still for voltageSettleMs, or when editing
+ * finishes, so the steps of a held arrow key cost one durable record instead
+ * of one each. The instrument is left alone when the record is not durable.
+ */
+void MainWindow::commit_voltage(void)
+{
+   double voltage = ui->voltage->value();
+   SetpointState previous = journal.state();
+
+   if (journal.isOpen() &&
+       journal.recordVoltage(voltage, QDateTime::currentMSecsSinceEpoch()) != SetpointJournal::JournalError::ERR_SUCCESS)
+   {
+       journal.record(previous);
+       statusBar()->showMessage("Setpoint journal write failed, voltage not applied", statusbarMessageTimeout);
+       return;
+   }
    if (powerSupply->writeVoltage(voltage) != PowerSupply::PsError:: ERR_SUCCESS)
    {
+       journal.record(previous);
        ui->voltage->setValue(0.0);
        return;
    }
    lastSavedVoltage = voltage;
    settings->setValue("lastSavedVoltage", lastSavedVoltage);
+   if (pollPredictor)
+       pollPredictor->setpointChanged(0);
 }
 
 /**
@@ -259,6 +1208,373 @@ void MainWindow::reset_power_supply_widgets(void)
     ui->current->setValue(0.0);
 }
 
+/**
+ * @brief Loads the calibration of the connected instrument and hands it to the worker.
+ * Tables are stored in the user settings under the serial number reported by *IDN?.
+ * Instruments without a stored table are monitored uncorrected.
+ */
+void MainWindow::load_calibration(void)
+{
+    PsIdentity identity;
+    QString key;
+    QString tableText;
+
+    /* The serial number also keys the preset slots of the instrument */
+    instrumentSerial.clear();
+    if (powerSupply->readIdentity(identity) != PowerSupply::PsError::ERR_SUCCESS || identity.serialNumber.empty())
+    {
+        worker->setCalibration(Calibration());
+        return;
+    }
+    instrumentSerial = identity.serialNumber;
+
+    key = "calibration/" + QString::fromStdString(identity.serialNumber).replace('/', '_');
+    tableText = settings->value(key, "").toString();
+    Calibration& stored = calibrationStore.forSerial(identity.serialNumber);
+    if (!tableText.isEmpty() && !stored.deserialize(tableText.toStdString()))
+        statusBar()->showMessage("Invalid calibration for S/N " + QString::fromStdString(identity.serialNumber),
+                                 statusbarMessageTimeout);
+
+    worker->setCalibration(stored);
+}
+
+/**
+ * @brief Applies the timing profile of the connected model to the driver.
+ * Profiles are built with --profile-instrument and stored in the user settings
+ * under the model reported by *IDN?. Models without a profile keep the
+ * default timeout.
+ */
+void MainWindow::load_timing_profile(void)
+{
+    PsIdentity identity;
+    TimingProfile profile;
+    QString profileText;
+
+    timingProfile = TimingProfile();
+    if (powerSupply->readIdentity(identity) != PowerSupply::PsError::ERR_SUCCESS || identity.model.empty())
+    {
+        powerSupply->applyTimingProfile(timingProfile);
+        return;
+    }
+
+    profileText = settings->value("timing/" + QString::fromStdString(identity.model).replace('/', '_'), "").toString();
+    if (!profileText.isEmpty() && !profile.deserialize(profileText.toStdString()))
+        statusBar()->showMessage("Invalid timing profile for " + QString::fromStdString(identity.model),
+                                 statusbarMessageTimeout);
+    powerSupply->applyTimingProfile(profile);
+    timingProfile = profile;
+}
+
+/**
+ * @brief Fits the sample time of the sampleTimeMs user setting into the link budget.
+ * Every sample costs the wire time of its commands and replies at the port
+ * baud rate plus the instrument time from the timing profile, and part of
+ * the link stays free so voltage writes do not queue behind telemetry. A
+ * sample time over budget is lengthened to the shortest safe one, or
+ * replaced by the default when linkRejectOverBudget is set. The default is
+ * planned too, and lengthened in turn when even it does not fit.
+ */
+void MainWindow::plan_link_budget(void)
+{
+    const int defaultSampleTimeMs = 1000;
+    const int maxSampleTimeMs = 60000;  /* Longest sample time the budget may stretch to */
+    LinkFraming framing;
+    LinkBudgetPolicy policy;
+    LinkPlan plan;
+    std::string report;
+    int requestedMs = std::max(1, settings->value("sampleTimeMs", defaultSampleTimeMs).toInt());
+    int plannedMs = requestedMs;
+    int statusEvery = 1;
+
+    auto command = [this](const std::string& name, LinkTraffic traffic, size_t parameterBytes, double rate) {
+        const CommandTiming *timing = timingProfile.find(name);
+        ScheduledCommand scheduled;
+
+        scheduled.name = name;
+        scheduled.traffic = traffic;
+        scheduled.commandBytes = powerSupply->commandBytes(name) + parameterBytes;
+        scheduled.replyBytes = (timing && timing->replyBytes) ? timing->replyBytes : (traffic == LinkTraffic::CONTROL ? 0 : 12);
+        scheduled.ratePerSecond = rate;
+        return scheduled;
+    };
+
+    auto planAt = [&](int sampleTimeMs, bool scaleBack) {
+        std::vector<ScheduledCommand> schedule;
+        double sampleRate = 1000.0 / sampleTimeMs;
+        LinkBudgetPolicy samplePolicy = policy;
+
+        /* Every sample reads the current of each output, and the voltage when it is exported */
+        if (powerSupply->channels > 1)
+        {
+            /* One readChannels() query per sample: the outputs after the selected one are
+               each selected, then read; the replies come back joined by ';' */
+            ScheduledCommand query = command("readCurrent", LinkTraffic::TELEMETRY, 0, sampleRate);
+
+            query.name = "readChannels";
+            query.commandBytes = powerSupply->channelQueryBytes(powerSupply->channels, worker->readsVoltage());
+            query.replyBytes *= powerSupply->channels;
+            query.parts.assign(powerSupply->channels - 1, "selectChannel");
+            query.parts.insert(query.parts.end(), powerSupply->channels, "readCurrent");
+            if (worker->readsVoltage())
+            {
+                query.replyBytes += powerSupply->channels * command("readVoltage", LinkTraffic::TELEMETRY, 0, 0.0).replyBytes;
+                query.parts.insert(query.parts.end(), powerSupply->channels, "readVoltage");
+            }
+            schedule.push_back(query);
+        }
+        else
+        {
+            schedule.push_back(command("readCurrent", LinkTraffic::TELEMETRY, 0, sampleRate));
+            if (worker->readsVoltage())
+                schedule.push_back(command("readVoltage", LinkTraffic::TELEMETRY, 0, sampleRate));
+        }
+        schedule.push_back(command("writeVoltage", LinkTraffic::CONTROL, 10, 0.0));  /* " 12.000000" */
+
+        /* Change detection: the status byte, or the full state on models without status reporting */
+        if (worker->watchesStatus())
+            schedule.push_back(command(powerSupply->statusReportingEnabled() ? "statusByte" : "readStatus",
+                                       LinkTraffic::STATUS, 0, 1000.0 / sampleTimeMs));
+
+        samplePolicy.scaleBack = scaleBack;
+        return LinkBudgetPlanner(framing, timingProfile, samplePolicy).plan(schedule);
+    };
+
+    /* Sample time at a scaled-back rate, at most maxSampleTimeMs */
+    auto lengthened = [maxSampleTimeMs](int sampleTimeMs, double scale) {
+        if (scale * maxSampleTimeMs <= sampleTimeMs)
+            return maxSampleTimeMs;
+        return static_cast<int>(std::ceil(sampleTimeMs / scale));
+    };
+
+    framing.baudrate = powerSupply->baudrate;
+    policy.scaleBack = !settings->value("linkRejectOverBudget", false).toBool();
+
+    plan = planAt(requestedMs, policy.scaleBack);
+    plan.render(report);
+    qDebug().noquote() << QString::fromStdString(report);
+
+    if (plan.telemetryBudget <= 0.0)
+    {
+        /* The reserve and the status polls take the whole link: no sample time fits */
+        statusBar()->showMessage("The link budget leaves no time for sampling, sample time not planned",
+                                 statusbarMessageTimeout);
+    }
+    else if (!plan.accepted)
+    {
+        /* The default has to fit as well; if it does not, it is lengthened like any other */
+        plan = planAt(defaultSampleTimeMs, true);
+        plannedMs = plan.telemetryBudget > 0.0 ? lengthened(defaultSampleTimeMs, std::min(1.0, plan.telemetryScale))
+                                               : defaultSampleTimeMs;
+        statusBar()->showMessage(QString("Sample time %1 ms exceeds the link budget, using %2 ms")
+                                     .arg(requestedMs).arg(plannedMs), statusbarMessageTimeout);
+    }
+    else if (plan.telemetryScale < 1.0)
+    {
+        plannedMs = lengthened(requestedMs, plan.telemetryScale);
+        statusBar()->showMessage(QString("Sample time raised from %1 ms to %2 ms to fit the link budget")
+                                     .arg(requestedMs).arg(plannedMs), statusbarMessageTimeout);
+    }
+
+    /* Status polls over their share are thinned out: one every statusEvery samples */
+    if (worker->watchesStatus())
+    {
+        LinkPlan planned = planAt(plannedMs, true);
+
+        /* With no share left at all the status is still checked once every maxSampleTimeMs */
+        int slowest = std::max(1, maxSampleTimeMs / plannedMs);
+
+        if (planned.statusScale <= 1.0 / slowest)
+            statusEvery = slowest;
+        else if (planned.statusScale < 1.0)
+            statusEvery = static_cast<int>(std::ceil(1.0 / planned.statusScale));
+        if (statusEvery > 1)
+            qDebug() << "Link budget: Status checked every" << statusEvery << "samples";
+    }
+    worker->setSampleTimeMs(plannedMs);
+    worker->setStatusInterval(statusEvery);
+    if (engineTransport)
+    {
+        engineTransport->configure(EngineOp::SAMPLE_TIME, plannedMs);
+        if (worker->watchesStatus())
+            engineTransport->configure(EngineOp::STATUS_WATCH, statusEvery);
+    }
+}
+
+/**
+ * @brief Attaches to the instrument engine, starting one when none is running.
+ * The engine is this executable run with --engine. It keeps the port,
+ * sampling, protection and logging while the window hangs or is closed,
+ * and a window started later attaches to it at once. Nothing here locks
+ * the shared memory, so the window can never stall the engine.
+ *
+ * A started engine takes a while to come up. The window stays responsive
+ * and shows that it is connecting while poll_engine() looks for the region.
+ * @param port Port the engine opens when it has to be started.
+ */
+void MainWindow::attach_engine(const QString& port)
+{
+    engineMemory = new QSharedMemory(QSharedMemory::platformSafeKey(EngineRegion::sharedMemoryKey), this);
+    enginePort = port;
+    engineAttempts = 50;
+    engineTimer = new QTimer(this);
+    engineTimer->setInterval(100);
+    connect(engineTimer, &QTimer::timeout, this, &MainWindow::poll_engine);
+
+    /* Nothing can be commanded before the session starts */
+    ui->centralwidget->setEnabled(false);
+    statusBar()->showMessage("Connecting to the instrument engine...");
+    poll_engine();
+}
+
+/**
+ * @brief Looks for the engine's region, every 100 ms for 5 s at most.
+ * Starts the session with the engine once it is alive, or without it,
+ * sampling the instrument in the window, when none comes up.
+ */
+void MainWindow::poll_engine(void)
+{
+    if (engineMemory->isAttached() || engineMemory->attach())
+    {
+        EngineRegion *region = static_cast<EngineRegion*>(engineMemory->data());
+        if (static_cast<size_t>(engineMemory->size()) >= sizeof(EngineRegion) &&
+            region->engineAlive(QDateTime::currentMSecsSinceEpoch()))
+        {
+            engineTimer->stop();
+            ui->centralwidget->setEnabled(true);
+            statusBar()->clearMessage();
+            start_session(region);
+            return;
+        }
+    }
+    if (!engineStarted)
+        engineStarted = QProcess::startDetached(QCoreApplication::applicationFilePath(), {"--engine", enginePort});
+    if (engineStarted && --engineAttempts > 0)
+    {
+        if (!engineTimer->isActive())
+            engineTimer->start();
+        return;
+    }
+
+    engineTimer->stop();
+    qDebug() << "Instrument engine unavailable";
+    delete engineMemory;
+    engineMemory = nullptr;
+    ui->centralwidget->setEnabled(true);
+    statusBar()->showMessage("Instrument engine unavailable, sampling in the window", statusbarMessageTimeout);
+    start_session(nullptr);
+}
+
+/**
+ * @brief Sets up the status check of every sample, from the statusWatch user setting (default on).
+ * The status enables are programmed so the check costs one *STB? per sample;
+ * models that reject them are checked by reading their full state.
+ */
+void MainWindow::enable_status_watch(void)
+{
+    bool watch = settings->value("statusWatch", true).toBool();
+
+    /* In engine mode the engine checks the status and the worker relays its reports */
+    if (engineTransport)
+    {
+        engineTransport->configure(EngineOp::STATUS_WATCH, watch ? 1.0 : 0.0);
+        worker->setStatusWatch(watch);
+        return;
+    }
+    if (watch && powerSupply->isOpen() == PowerSupply::PsError::ERR_SUCCESS &&
+        powerSupply->enableStatusReporting() != PowerSupply::PsError::ERR_SUCCESS)
+        qDebug() << "Status reporting unavailable, polling the full state";
+    worker->setStatusWatch(watch);
+}
+
+/**
+ * @brief Brings the instrument back to the last state recorded in the setpoint journal.
+ * The programmed state is read back with one compound query and only the
+ * settings that differ are written; voltage and current limit go in one
+ * message. The output is switched only when the
+ * restoreOutput user setting allows it; otherwise the button reflects the
+ * instrument. Without a journal entry the saved default voltage is used.
+ */
+void MainWindow::restore_setpoints(void)
+{
+    SetpointState wanted;
+    PsSetpoints actual;
+    bool powerState = false;
+    bool restoreOutput = settings->value("restoreOutput", false).toBool();
+    bool restored = true;  /* No write to the instrument failed */
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    if (journal.hasState())
+    {
+        wanted = journal.state();
+        qDebug() << "Setpoint journal: Recovered in" << journal.recoveryMicroseconds() << "us";
+    }
+    else
+    {
+        wanted.voltage = settings->value("lastSavedVoltage", "0.0").toDouble();
+        restoreOutput = false;
+    }
+    lastSavedVoltage = wanted.voltage;
+
+    if (powerSupply->readSetpoints(actual) == PowerSupply::PsError::ERR_SUCCESS)
+    {
+        PsSetpoints program = actual;
+
+        program.voltage = wanted.voltage;
+        if (wanted.currentLimitKnown)
+            program.currentLimit = wanted.currentLimit;
+        if (std::fabs(actual.voltage - program.voltage) > voltageTolerance ||
+            std::fabs(actual.currentLimit - program.currentLimit) > voltageTolerance)
+        {
+            if (powerSupply->writeSetpoints(program) == PowerSupply::PsError::ERR_SUCCESS)
+            {
+                actual.voltage = program.voltage;
+                actual.currentLimit = program.currentLimit;
+            }
+            else
+                restored = false;
+        }
+        if (restoreOutput && actual.output != wanted.output)
+        {
+            if ((wanted.output ? powerSupply->turnOn() : powerSupply->turnOff()) == PowerSupply::PsError::ERR_SUCCESS)
+                actual.output = wanted.output;
+            else
+                restored = false;
+        }
+        powerState = actual.output;
+    }
+    else
+    {
+        /* Instruments without compound queries get the previous blind restore */
+        powerSupply->isOn(powerState);
+        if (powerSupply->writeVoltage(wanted.voltage) != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            load_power_icon(ui->buttonPower, powerState);
+            return;
+        }
+        actual.voltage = wanted.voltage;
+    }
+
+    load_power_icon(ui->buttonPower, powerState);
+    ui->voltage->blockSignals(true);
+    ui->voltage->setValue(actual.voltage);
+    ui->voltage->blockSignals(false);
+
+    /* The journal follows what the instrument was left at: seeded on first
+       run, and an output left as found becomes the new state. After a failed
+       write the journal keeps the state still to be restored */
+    if (!journal.hasState() ||
+        (restored && (std::fabs(journal.state().voltage - actual.voltage) > voltageTolerance ||
+                      journal.state().output != powerState)))
+    {
+        SetpointState found = journal.state();
+
+        found.voltage = actual.voltage;
+        found.output = powerState;
+        found.timestampMs = now;
+        journal.record(found);
+    }
+}
+
 /**
  * @brief Slot called when the power button is clicked.
  * Turns the power supply on or off.
@@ -290,26 +1606,42 @@ void MainWindow::on_buttonPower_clicked()
 
     if (powerState == true) /* Power state ON, next state OFF */
     {
+        journal.recordOutput(false, QDateTime::currentMSecsSinceEpoch());
         err = powerSupply->turnOff();
         if (err != PowerSupply::PsError::ERR_SUCCESS)
         {
+            journal.recordOutput(true, QDateTime::currentMSecsSinceEpoch());
             errorMessage = "Failed to turn off device";
             goto err_buttonPower_clicked;
         }
+        if (pollPredictor)
+            pollPredictor->setpointChanged(0);
         reset_power_supply_widgets();
     }
     else /* Power state OFF, next state ON */
     {
+        SetpointState previous = journal.state();
+
+        journal.recordOutput(true, QDateTime::currentMSecsSinceEpoch());
         err = powerSupply->turnOn();
         if (err != PowerSupply::PsError::ERR_SUCCESS)
         {
+            journal.record(previous);
             errorMessage = "Failed to turn on device";
             goto err_buttonPower_clicked;
         }
 
         /* Power supply is on, voltage updated to user default values */
+        if (pollPredictor)
+            pollPredictor->setpointChanged(0);
         load_power_icon(ui->buttonPower, true);
-        if (powerSupply->writeVoltage(lastSavedVoltage) == PowerSupply::PsError::ERR_SUCCESS)
+        previous = journal.state();
+        journal.recordVoltage(lastSavedVoltage, QDateTime::currentMSecsSinceEpoch());
+        if (powerSupply->writeVoltage(lastSavedVoltage) != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            journal.record(previous);
+        }
+        else
         {
             ui->current->setValue(0.0);
             ui->voltage->blockSignals(true);
@@ -379,6 +1711,11 @@ void MainWindow::on_voltage_editingFinished()
         QMessageBox::warning(this, "Invalid Voltage", "Voltage must be greater than 0.0V");
         return;
     }
+    if (voltageTimer->isActive())
+    {
+        voltageTimer->stop();
+        commit_voltage();
+    }
     /* Save to user settings */
     lastSavedVoltage = voltage;
     settings->setValue("lastSavedVoltage", lastSavedVoltage);
@@ -414,6 +1751,10 @@ void MainWindow::on_port_editingFinished()
 
     /* Save opened port to user settings */
     settings->setValue("port", port);
+    load_calibration();
+    load_timing_profile();
+    enable_status_watch();
+    plan_link_budget();
 
     /* Check the current power state */
     err = powerSupply->isOn(powerState);
@@ -3,6 +3,14 @@
 
 #include <QMainWindow>
 #include "drv_power_supply.h"
+#include "calibration.h"
+#include "metrics.h"
+#include "gap_tracker.h"
+#include "poll_predictor.h"
+#include "setpoint_journal.h"
+#include "capture_log.h"
+#include "preset_store.h"
+#include "telemetry_bus.h"
 #include <QPushButton>
 #include <QThread>
 #include <QCloseEvent>
@@ -10,6 +18,14 @@
 #include <QSettings>
 
 class Worker;
+class MetricsServer;
+class WebDashboard;
+class EngineTransport;
+class QSharedMemory;
+class QTimer;
+class FrameDispatcher;
+class SampleStore;
+struct EngineRegion;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -29,32 +45,83 @@ private slots:
     void on_buttonPower_clicked();
     void on_pinButton_clicked(bool checked);
     void on_voltage_valueChanged(double voltage);
+    void commit_voltage(void);
     void on_current_valueChanged(double current);
     void on_voltage_editingFinished();
     void on_port_editingFinished();
+    void report_gap(int channel, qint64 durationMs, quint64 samples);
+    void report_status(bool output, quint16 questionable, int error);
+    void report_protection(int channel, double current);
+    void reopen_engine_link(void);
+    void show_context_menu(const QPoint& position);
+    void drain_telemetry(void);
+    void poll_engine(void);
 
 signals:
     void powerSupplyStateChanged(bool state);
 
 protected:
     void closeEvent(QCloseEvent *event) override;
+    void customEvent(QEvent *event) override;
 
 private:
-    Worker *worker;  /* Pointer to the worker object */
+    Worker *worker = nullptr;  /* Pointer to the worker object */
     QSettings *settings;  /* Pointer to the QSettings object */
     int powerSwitchSize = 65; /* Default power switch icon size (w, h) */
     Ui::MainWindow *ui;  /* Declare the `ui` member */
-    QThread *workerThread;  /* Pointer to the worker thread */
-    PowerSupply *powerSupply;  /* Pointer to the PowerSupply object */
+    QThread *workerThread = nullptr;  /* Pointer to the worker thread */
+    PowerSupply *powerSupply = nullptr;  /* Pointer to the PowerSupply object */
     double lastSavedVoltage = 0.0;
     int statusbarMessageTimeout = 5000; /* Default timeout for status bar messages */
     std::string powerSwitchOnStatePath = ":/img/on.png";
     std::string powerSwitchOffStatePath = ":/img/off.png";
     QString swVersion = "1.0"; /* Software version */
+    CalibrationStore calibrationStore; /* Correction tables per instrument serial number */
+    TelemetryMetrics *metrics = nullptr;  /* Live telemetry and driver health for monitoring */
+    MetricsServer *metricsServer = nullptr;  /* Optional OpenMetrics endpoint */
+    WebDashboard *dashboard = nullptr;  /* Optional browser dashboard */
+    GapTracker *gapTracker = nullptr;  /* Gap and latency report of the sampled channels */
+    PollPredictor *pollPredictor = nullptr;  /* Optional model-based polling */
+    SetpointJournal journal;  /* Write-ahead log of accepted setpoints */
+    double voltageTolerance = 0.0005;  /* Setpoints closer than this are not rewritten */
+    QTimer *voltageTimer = nullptr;  /* Coalesces the steps of the voltage box into one journaled write */
+    int voltageSettleMs = 150;  /* Stillness of the voltage box before it is applied */
+    TimingProfile timingProfile;  /* Timing of the connected model, empty when not profiled */
+    std::string instrumentSerial;  /* Serial number of the connected instrument, empty when unknown */
+    PresetStore presetStore;  /* Named configurations and the instrument slots holding them */
+    bool presetSlotsSupported = true;  /* Cleared for the session when the model rejects *SAV */
+    QSharedMemory *engineMemory = nullptr;  /* Mapping of the instrument engine's region, engine mode only */
+    EngineTransport *engineTransport = nullptr;  /* Command link to the engine, owned by powerSupply */
+    QTimer *engineTimer = nullptr;  /* Polls for the engine's region while attaching, engine mode only */
+    QString enginePort;  /* Port the engine opens when the window starts it */
+    int engineAttempts = 0;  /* Polls left before the window samples the instrument itself */
+    bool engineStarted = false;  /* An engine process was started by this window */
+    CancelToken cancelToken;  /* Cuts off the instrument exchange in progress when the window closes */
+    TelemetryBus *telemetryBus = nullptr;  /* Fan-out of the samples to the dashboard, dashboard only */
+    int dashboardConsumer = -1;  /* Cursor of the dashboard on the telemetry bus */
+    QTimer *telemetryTimer = nullptr;  /* Hands the bus's samples to the dashboard */
+    int telemetryDrainMs = 50;  /* One dashboard tick */
+    FrameDispatcher *frameDispatcher = nullptr;  /* Samples of the worker, one event per frame */
+    SampleStore *capture = nullptr;  /* Samples of the session for the capture statistics, optional */
+    size_t captureLimit = 0;  /* Samples kept per output */
+    bool captureFull = false;  /* The limit was reached and reported */
+    CaptureLog captureLog;  /* Crash-safe copy of the captured samples, optional */
 
     /* Private functions */
     void load_power_icon(QPushButton *button, bool state);
     void reset_power_supply_widgets(void);
+    void load_calibration(void);
+    void load_timing_profile(void);
+    void plan_link_budget(void);
+    void enable_status_watch(void);
+    void attach_engine(const QString& port);
+    void start_session(EngineRegion *engineRegion);
+    void apply_preset(const QString& name);
+    void save_preset(const QString& name);
+    void store_presets(void);
+    void capture_sample(int channel, const Sample& sample);
+    void show_capture_stats(void);
+    void restore_setpoints(void);
     void close(void);
 };
 #endif /* GUI_MAIN_POWER_SUPPLY_H */
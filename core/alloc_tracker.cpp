@@ -0,0 +1,277 @@
+/**
+ * @file alloc_tracker.cpp
+ * @brief Counting global allocator and per-site allocation probes.
+ *
+ * With PS_TRACK_ALLOCATIONS the replaceable global operator new/delete
+ * forms are defined here on top of malloc/free. Each allocation bumps a
+ * thread-local counter (read by probes) and process-wide atomics (for
+ * the totals). Nothing in this file allocates through operator new while
+ * counting, so the allocator cannot recurse.
+ */
+
+#include "alloc_tracker.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    constexpr size_t maxSites = 256;
+
+    thread_local AllocationCounters threadTotals;
+    std::atomic<uint64_t> processAllocations{0};
+    std::atomic<uint64_t> processBytes{0};
+    std::atomic<uint64_t> processFrees{0};
+    std::atomic<uint64_t> violations{0};
+    std::atomic<AllocationSite*> sites[maxSites];
+    std::atomic<size_t> siteCount{0};
+
+    bool strictMode(void)
+    {
+        static const bool strict = [] {
+            const char *value = std::getenv("PS_ALLOC_STRICT");
+            return value != nullptr && value[0] == '1';
+        }();
+        return strict;
+    }
+
+#if defined(PS_TRACK_ALLOCATIONS)
+    void countAllocation(size_t size)
+    {
+        threadTotals.allocations++;
+        threadTotals.bytes += size;
+        processAllocations.fetch_add(1, std::memory_order_relaxed);
+        processBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void countFree(void)
+    {
+        threadTotals.frees++;
+        processFrees.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* allocate(size_t size)
+    {
+        void *pointer = std::malloc(size ? size : 1);
+        if (pointer)
+            countAllocation(size);
+        return pointer;
+    }
+
+    void* allocateAligned(size_t size, size_t alignment)
+    {
+        void *pointer = nullptr;
+#if defined(_WIN32)
+        pointer = _aligned_malloc(size ? size : 1, alignment);
+#else
+        if (posix_memalign(&pointer, alignment < sizeof(void*) ? sizeof(void*) : alignment, size ? size : 1) != 0)
+            pointer = nullptr;
+#endif
+        if (pointer)
+            countAllocation(size);
+        return pointer;
+    }
+
+    void release(void *pointer)
+    {
+        if (pointer == nullptr)
+            return;
+        countFree();
+        std::free(pointer);
+    }
+
+    void releaseAligned(void *pointer)
+    {
+        if (pointer == nullptr)
+            return;
+        countFree();
+#if defined(_WIN32)
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+#endif
+}
+
+/**
+ * @brief Constructor. Registers the site for the report.
+ * @param name Name printed in the report.
+ * @param zeroAllocation True if any allocation on this path is a regression.
+ */
+AllocationSite::AllocationSite(const char *name, bool zeroAllocation)
+    : name(name), zeroAllocation(zeroAllocation)
+{
+    size_t index = siteCount.fetch_add(1);
+    if (index < maxSites)
+        sites[index].store(this, std::memory_order_release);
+}
+
+AllocationProbe::AllocationProbe(AllocationSite& site)
+    : site(site), start(threadTotals)
+{
+}
+
+/**
+ * @brief Credits the allocations made since construction to the site.
+ */
+AllocationProbe::~AllocationProbe()
+{
+    uint64_t allocations = threadTotals.allocations - start.allocations;
+    uint64_t bytes = threadTotals.bytes - start.bytes;
+    uint64_t maxBytes = site.maxBytesPerCall.load(std::memory_order_relaxed);
+
+    site.calls.fetch_add(1, std::memory_order_relaxed);
+    if (allocations == 0)
+        return;
+
+    site.allocatingCalls.fetch_add(1, std::memory_order_relaxed);
+    site.allocations.fetch_add(allocations, std::memory_order_relaxed);
+    site.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    while (bytes > maxBytes && !site.maxBytesPerCall.compare_exchange_weak(maxBytes, bytes, std::memory_order_relaxed))
+        ;
+
+    if (site.zeroAllocation)
+    {
+        violations.fetch_add(1, std::memory_order_relaxed);
+        std::fprintf(stderr, "Allocation tracker: zero-allocation path %s allocated %llu times (%llu bytes)\n",
+                     site.name, static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(bytes));
+        if (strictMode())
+            std::abort();
+    }
+}
+
+/**
+ * @brief True if the build counts allocations.
+ */
+bool AllocationTracker::enabled(void)
+{
+#if defined(PS_TRACK_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationCounters AllocationTracker::threadCounters(void)
+{
+    return threadTotals;
+}
+
+AllocationCounters AllocationTracker::processCounters(void)
+{
+    AllocationCounters counters;
+
+    counters.allocations = processAllocations.load(std::memory_order_relaxed);
+    counters.bytes = processBytes.load(std::memory_order_relaxed);
+    counters.frees = processFrees.load(std::memory_order_relaxed);
+    return counters;
+}
+
+uint64_t AllocationTracker::zeroAllocationViolations(void)
+{
+    return violations.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Renders the per-site report, one line per probed path.
+ * @param out The report is appended here.
+ */
+void AllocationTracker::render(std::string& out)
+{
+    AllocationCounters totals = processCounters();
+    size_t count = siteCount.load() < maxSites ? siteCount.load() : maxSites;
+    char line[320];
+
+    snprintf(line, sizeof(line), "process: allocations %llu bytes %llu frees %llu, zero-allocation violations %llu\n",
+             static_cast<unsigned long long>(totals.allocations), static_cast<unsigned long long>(totals.bytes),
+             static_cast<unsigned long long>(totals.frees), static_cast<unsigned long long>(zeroAllocationViolations()));
+    out += line;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const AllocationSite *site = sites[i].load(std::memory_order_acquire);
+        uint64_t calls;
+
+        if (site == nullptr)
+            continue;
+        calls = site->calls.load(std::memory_order_relaxed);
+        snprintf(line, sizeof(line), "%s: calls %llu allocating %llu | allocations %.2f/call bytes %.1f/call max %llu bytes%s\n",
+                 site->name, static_cast<unsigned long long>(calls),
+                 static_cast<unsigned long long>(site->allocatingCalls.load(std::memory_order_relaxed)),
+                 calls ? static_cast<double>(site->allocations.load(std::memory_order_relaxed)) / calls : 0.0,
+                 calls ? static_cast<double>(site->bytes.load(std::memory_order_relaxed)) / calls : 0.0,
+                 static_cast<unsigned long long>(site->maxBytesPerCall.load(std::memory_order_relaxed)),
+                 site->zeroAllocation ? (site->allocatingCalls.load(std::memory_order_relaxed) ? " [zero-allocation VIOLATED]"
+                                                                                               : " [zero-allocation]")
+                                      : "");
+        out += line;
+    }
+}
+
+#if defined(PS_TRACK_ALLOCATIONS)
+void* operator new(std::size_t size)
+{
+    void *pointer = allocate(size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    void *pointer = allocate(size);
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void *pointer = allocateAligned(size, static_cast<size_t>(alignment));
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    void *pointer = allocateAligned(size, static_cast<size_t>(alignment));
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *pointer) noexcept { release(pointer); }
+void operator delete[](void *pointer) noexcept { release(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { release(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { release(pointer); }
+void operator delete(void *pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept { releaseAligned(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t&) noexcept { releaseAligned(pointer); }
+#endif
@@ -0,0 +1,82 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* Heap allocation accounting for hot paths.
+   Builds configured with PS_TRACK_ALLOCATIONS replace the global operator
+   new/delete with counting versions and turn the probe macros below into
+   scoped probes. A probe reads the calling thread's counters when it is
+   entered and credits the difference to its site when it leaves, so nested
+   and concurrent probes stay exact. Other builds compile the macros away.
+
+   PS_ALLOCATION_PROBE(name)       accounts allocations of the enclosing scope
+   PS_ZERO_ALLOCATION_PROBE(name)  same, and reports every call that allocates;
+                                   with PS_ALLOC_STRICT=1 in the environment
+                                   the process aborts on the first one */
+
+/* Allocations made by the calling thread since it started */
+struct AllocationCounters
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+};
+
+/* Totals of one probed code path. Sites are static objects, registered on
+   first use in a fixed table so registering never allocates */
+class AllocationSite
+{
+    public:
+        AllocationSite(const char *name, bool zeroAllocation);
+
+        const char *name;
+        bool zeroAllocation;
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> allocatingCalls{0};  /* Calls that allocated at least once */
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> maxBytesPerCall{0};
+};
+
+class AllocationProbe
+{
+    public:
+        explicit AllocationProbe(AllocationSite& site);
+        ~AllocationProbe();
+
+        AllocationProbe(const AllocationProbe&) = delete;
+        AllocationProbe& operator=(const AllocationProbe&) = delete;
+
+    private:
+        AllocationSite& site;
+        AllocationCounters start;
+};
+
+namespace AllocationTracker
+{
+    bool enabled(void);
+    AllocationCounters threadCounters(void);
+    AllocationCounters processCounters(void);
+    uint64_t zeroAllocationViolations(void);
+    void render(std::string& out);
+}
+
+#if defined(PS_TRACK_ALLOCATIONS)
+#define PS_ALLOC_CONCAT_(a, b) a##b
+#define PS_ALLOC_CONCAT(a, b) PS_ALLOC_CONCAT_(a, b)
+#define PS_ALLOCATION_PROBE(name) \
+    static AllocationSite PS_ALLOC_CONCAT(psAllocSite, __LINE__)(name, false); \
+    AllocationProbe PS_ALLOC_CONCAT(psAllocProbe, __LINE__)(PS_ALLOC_CONCAT(psAllocSite, __LINE__))
+#define PS_ZERO_ALLOCATION_PROBE(name) \
+    static AllocationSite PS_ALLOC_CONCAT(psAllocSite, __LINE__)(name, true); \
+    AllocationProbe PS_ALLOC_CONCAT(psAllocProbe, __LINE__)(PS_ALLOC_CONCAT(psAllocSite, __LINE__))
+#else
+#define PS_ALLOCATION_PROBE(name) do { } while (0)
+#define PS_ZERO_ALLOCATION_PROBE(name) do { } while (0)
+#endif
+
+#endif /* ALLOC_TRACKER_H */
@@ -0,0 +1,223 @@
+/**
+ * @file allocation_check.cpp
+ * @brief Exercises the zero-allocation paths and counts the calls that allocated.
+ *
+ * Every object is built and warmed up before its path is counted, the way
+ * the sampler sets them up before the first sample. A violation is a call
+ * that allocated inside a PS_ZERO_ALLOCATION_PROBE scope; the tracker counts
+ * them process-wide, so the paths are checked one after another.
+ */
+
+#include "allocation_check.h"
+#include "alloc_tracker.h"
+#include "calibration.h"
+#include "frame_ring.h"
+#include "metrics.h"
+#include "poll_predictor.h"
+#include "telemetry_bus.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+namespace
+{
+    /* Deterministic pseudo-random readings */
+    class Noise
+    {
+        public:
+            double next(double scale)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                return ((state >> 33) / 2147483648.0 - 1.0) * scale;
+            }
+
+        private:
+            uint64_t state = 0x2545F4914F6CDD1DULL;
+    };
+
+    /**
+     * @brief Runs one path and records its calls and violations.
+     * @param body Called once per iteration; returns the calls of probed functions it made.
+     */
+    AllocationCheckResult check(const char *path, uint64_t iterations, const std::function<uint64_t(uint64_t)>& body)
+    {
+        AllocationCheckResult result;
+        uint64_t before = AllocationTracker::zeroAllocationViolations();
+
+        result.path = path;
+        for (uint64_t n = 0; n < iterations; n++)
+            result.calls += body(n);
+        result.violations = AllocationTracker::zeroAllocationViolations() - before;
+        return result;
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param iterations Iterations of every path.
+ */
+AllocationCheck::AllocationCheck(uint64_t iterations)
+    : iterations(std::max<uint64_t>(iterations, 1))
+{
+}
+
+/**
+ * @brief Drives every zero-allocation path.
+ * @return One result per path.
+ */
+std::vector<AllocationCheckResult> AllocationCheck::run(void)
+{
+    std::vector<AllocationCheckResult> results;
+    Noise noise;
+
+    /* calibration.apply: a polynomial and a lookup table, one sample and a block */
+    {
+        Calibration calibration;
+        ChannelCalibration polynomial;
+        ChannelCalibration table;
+        double voltages[64];
+        double currents[64];
+
+        polynomial.voltage.coefficients = {0.001, 1.0002, -1e-6};
+        polynomial.current.coefficients = {-0.0005, 0.999};
+        table.voltage.kind = CalibrationCurve::Kind::LOOKUP_TABLE;
+        table.voltage.lutValues = {0.0, 1.01, 2.02, 3.0, 4.05};
+        table.current = polynomial.current;
+        table.current.unitScale = 1e-3;
+        calibration.setChannel(0, polynomial);
+        calibration.setChannel(1, table);
+
+        results.push_back(check("calibration.apply", iterations, [&](uint64_t n) {
+            for (size_t i = 0; i < 64; i++)
+            {
+                voltages[i] = 2.0 + noise.next(2.5);
+                currents[i] = 0.5 + noise.next(0.5);
+            }
+            calibration.apply(0, voltages, currents, 1);
+            calibration.apply(static_cast<int>(n & 1), voltages, currents, 64);
+            calibration.apply(2, nullptr, currents, 64);  /* Uncalibrated channel */
+            return 3;
+        }));
+    }
+
+    /* metrics.publish: good, flagged and predicted samples, out of order sequences */
+    {
+        TelemetryMetrics metrics(4);
+
+        results.push_back(check("metrics.publish", iterations, [&](uint64_t n) {
+            Sample sample;
+
+            sample.sequence = (n % 97 == 0) ? n : n + 1;
+            sample.timestampMs = 1700000000000LL + static_cast<int64_t>(n) * 10;
+            sample.voltage = 12.0 + noise.next(0.01);
+            sample.current = 1.0 + noise.next(0.1);
+            sample.quality = (n % 13 == 0) ? SAMPLE_TIMEOUT | SAMPLE_STALE : (n % 3 == 0) ? SAMPLE_PREDICTED : SAMPLE_GOOD;
+            metrics.publish(static_cast<int>(n % 4), sample);
+            return 1;
+        }));
+    }
+
+    /* bus.publish: consumers that never read, read late and coalesce, over a small ring */
+    {
+        TelemetryBus bus(256);
+        BusConsumerOptions options;
+        BusEntry entries[64];
+        int lagging;
+        int decimated;
+        int coalesced;
+
+        options.name = "lagging";
+        lagging = bus.subscribe(options);
+        options.name = "decimated";
+        options.policy = BackpressurePolicy::DECIMATE;
+        decimated = bus.subscribe(options);
+        options.name = "coalesced";
+        options.policy = BackpressurePolicy::COALESCE;
+        coalesced = bus.subscribe(options);
+        (void)lagging;
+
+        results.push_back(check("bus.publish", iterations, [&](uint64_t n) {
+            Sample sample;
+
+            sample.sequence = n + 1;
+            sample.current = noise.next(1.0);
+            bus.publish(static_cast<int>(n % 4), sample);
+            if (n % 500 == 0)
+                bus.read(decimated, entries, sizeof(entries) / sizeof(entries[0]));
+            if (n % 50 == 0)
+                bus.read(coalesced, entries, sizeof(entries) / sizeof(entries[0]));
+            return 1;
+        }));
+    }
+
+    /* frames.push: a consumer that releases late, so the ring fills and drops */
+    {
+        FrameRing ring(64);
+
+        results.push_back(check("frames.push", iterations, [&](uint64_t n) {
+            Sample sample;
+
+            sample.sequence = n + 1;
+            ring.push(static_cast<int>(n % 2), sample);
+            if (n % 100 == 0)
+                ring.release(ring.written());
+            return 1;
+        }));
+    }
+
+    /* predictor.shouldPoll and predictor.update: steady load, load steps and setpoint changes */
+    {
+        PollPredictor predictor(2);
+        int64_t nowMs = 1700000000000LL;
+
+        results.push_back(check("predictor.*", iterations, [&](uint64_t n) {
+            size_t channel = n % 2;
+            double level = (n / 1000) % 2 ? 1.5 : 0.5;
+            uint64_t calls = 1;
+
+            nowMs += 5;
+            if (n % 5000 == 0)
+                predictor.setpointChanged(channel);
+            if (predictor.shouldPoll(channel, nowMs))
+            {
+                predictor.update(channel, nowMs, level + noise.next(0.001));
+                calls++;
+            }
+            return calls;
+        }));
+    }
+    return results;
+}
+
+/**
+ * @brief True if no path allocated.
+ */
+bool AllocationCheck::passed(const std::vector<AllocationCheckResult>& results)
+{
+    for (const AllocationCheckResult& result : results)
+    {
+        if (result.violations != 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Formats the results.
+ * @param results Results of run().
+ * @param out Text is appended here.
+ */
+void AllocationCheck::render(const std::vector<AllocationCheckResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-20s %12s %12s\n", "path", "calls", "allocating");
+    out += line;
+    for (const AllocationCheckResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-20s %12llu %12llu\n", result.path.c_str(),
+                 static_cast<unsigned long long>(result.calls), static_cast<unsigned long long>(result.violations));
+        out += line;
+    }
+    out += passed(results) ? "No zero-allocation path allocated\n" : "FAILED: zero-allocation paths allocated\n";
+}
@@ -0,0 +1,34 @@
+#ifndef ALLOCATION_CHECK_H
+#define ALLOCATION_CHECK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Calls of one zero-allocation path and the ones that allocated */
+struct AllocationCheckResult
+{
+    std::string path;
+    uint64_t calls = 0;
+    uint64_t violations = 0;  /* Calls reported by the zero-allocation probes */
+};
+
+/* Drives every path guarded by PS_ZERO_ALLOCATION_PROBE the way the sampler
+   does, including the edge cases: calibration curves of both kinds, flagged
+   and predicted samples, a bus whose consumers lag behind every policy that
+   does not wait, a full frame ring and load steps of the poll model. Only
+   meaningful in builds configured with PS_TRACK_ALLOCATIONS. */
+class AllocationCheck
+{
+    public:
+        explicit AllocationCheck(uint64_t iterations = 100000);
+
+        std::vector<AllocationCheckResult> run(void);
+        static bool passed(const std::vector<AllocationCheckResult>& results);
+        static void render(const std::vector<AllocationCheckResult>& results, std::string& out);
+
+    private:
+        uint64_t iterations;
+};
+
+#endif /* ALLOCATION_CHECK_H */
@@ -0,0 +1,187 @@
+/**
+ * @file battery_model.cpp
+ * @brief Equivalent-circuit battery model stepped at a fixed rate.
+ *
+ * Per cell, with discharge current I held over a step of dt:
+ *   SoC(k+1) = SoC(k) - I dt / (3600 capacity)
+ *   v_i(k+1) = v_i(k) exp(-dt / R_i C_i) + R_i (1 - exp(-dt / R_i C_i)) I
+ *   V = cells (OCV(SoC) - R0 I - sum v_i)
+ * The RC update is exact for a held current, so the step size only limits
+ * how finely the load current is followed, not the accuracy of the circuit.
+ */
+
+#include "battery_model.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+/**
+ * @brief Parameters of a 2.5 Ah NMC 18650 cell at room temperature.
+ * Two RC pairs: charge transfer (30 s) and diffusion (800 s).
+ */
+BatteryParameters BatteryParameters::lithiumIon(void)
+{
+    BatteryParameters parameters;
+
+    parameters.capacityAh = 2.5;
+    parameters.r0 = 0.030;
+    parameters.rcPairs = {{0.015, 2000.0}, {0.020, 40000.0}};
+    parameters.ocv = {3.00, 3.45, 3.55, 3.62, 3.67, 3.72, 3.79, 3.87, 3.95, 4.05, 4.18};
+    return parameters;
+}
+
+std::string BatteryParameters::serialize(void) const
+{
+    std::ostringstream out;
+    out.precision(17);
+
+    out << "capacity " << capacityAh << '\n';
+    out << "r0 " << r0 << '\n';
+    for (const RcPair& pair : rcPairs)
+        out << "rc " << pair.ohms << ' ' << pair.farads << '\n';
+    out << "ocv";
+    for (double voltage : ocv)
+        out << ' ' << voltage;
+    out << '\n';
+    out << "soc " << initialSoc << '\n';
+    out << "cells " << cells << '\n';
+    return out.str();
+}
+
+/**
+ * @brief Parses the text of serialize().
+ * @return False on a malformed or physically impossible set; nothing is changed then.
+ */
+bool BatteryParameters::deserialize(const std::string& text)
+{
+    BatteryParameters parsed;
+    std::istringstream in(text);
+    std::string line;
+    double value;
+
+    parsed.rcPairs.clear();
+    parsed.ocv.clear();
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        RcPair pair;
+
+        if (line.empty())
+            continue;
+        fields >> key;
+        if (key == "capacity")
+        {
+            if (!(fields >> parsed.capacityAh) || parsed.capacityAh <= 0.0)
+                return false;
+        }
+        else if (key == "r0")
+        {
+            if (!(fields >> parsed.r0) || parsed.r0 < 0.0)
+                return false;
+        }
+        else if (key == "rc")
+        {
+            if (!(fields >> pair.ohms >> pair.farads) || pair.ohms <= 0.0 || pair.farads <= 0.0)
+                return false;
+            parsed.rcPairs.push_back(pair);
+        }
+        else if (key == "ocv")
+        {
+            while (fields >> value)
+                parsed.ocv.push_back(value);
+        }
+        else if (key == "soc")
+        {
+            if (!(fields >> parsed.initialSoc) || parsed.initialSoc < 0.0 || parsed.initialSoc > 1.0)
+                return false;
+        }
+        else if (key == "cells")
+        {
+            if (!(fields >> parsed.cells) || parsed.cells < 1)
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (parsed.ocv.size() < 2 || parsed.rcPairs.size() > BatteryModel::maxRcPairs)
+        return false;
+    *this = parsed;
+    return true;
+}
+
+/**
+ * @brief Constructor.
+ * @param parameters Cell and pack parameters; pairs beyond maxRcPairs are ignored,
+ * and a table of fewer than two points is replaced by that of lithiumIon().
+ * @param stepSeconds Fixed time step of step().
+ */
+BatteryModel::BatteryModel(const BatteryParameters& parameters, double stepSeconds)
+    : parameters(parameters), dt(stepSeconds)
+{
+    if (this->parameters.ocv.size() < 2)
+        this->parameters.ocv = BatteryParameters::lithiumIon().ocv;
+    this->parameters.cells = std::max(1, this->parameters.cells);
+    socPerAmp = dt / (3600.0 * this->parameters.capacityAh);
+    pairs = std::min(this->parameters.rcPairs.size(), maxRcPairs);
+    for (size_t i = 0; i < pairs; i++)
+    {
+        const RcPair& pair = this->parameters.rcPairs[i];
+
+        decay[i] = std::exp(-dt / (pair.ohms * pair.farads));
+        gain[i] = pair.ohms * (1.0 - decay[i]);
+    }
+    reset();
+}
+
+/**
+ * @brief Back to the initial state of charge, fully relaxed.
+ */
+void BatteryModel::reset(void)
+{
+    soc = std::min(1.0, std::max(0.0, parameters.initialSoc));
+    for (size_t i = 0; i < maxRcPairs; i++)
+        polarization[i] = 0.0;
+}
+
+/**
+ * @brief Open-circuit voltage of the pack at the present state of charge.
+ */
+double BatteryModel::openCircuitVoltage(void) const
+{
+    const std::vector<double>& table = parameters.ocv;
+    double position = soc * (table.size() - 1);
+    size_t index = std::min(static_cast<size_t>(position), table.size() - 2);
+    double fraction = position - index;
+
+    return parameters.cells * (table[index] + fraction * (table[index + 1] - table[index]));
+}
+
+/**
+ * @brief Terminal voltage of the pack for a current, without advancing the state.
+ * @param current Discharge current in amperes, negative when charging.
+ */
+double BatteryModel::terminalVoltage(double current) const
+{
+    double drop = parameters.r0 * current;
+
+    for (size_t i = 0; i < pairs; i++)
+        drop += polarization[i];
+    return openCircuitVoltage() - parameters.cells * drop;
+}
+
+/**
+ * @brief Advances the model by one step with the current held over it.
+ * @param current Discharge current in amperes, negative when charging.
+ * @return Terminal voltage at the end of the step, for the same current.
+ */
+double BatteryModel::step(double current)
+{
+    soc = std::min(1.0, std::max(0.0, soc - current * socPerAmp));
+    for (size_t i = 0; i < pairs; i++)
+        polarization[i] = polarization[i] * decay[i] + gain[i] * current;
+    return terminalVoltage(current);
+}
@@ -0,0 +1,61 @@
+#ifndef BATTERY_MODEL_H
+#define BATTERY_MODEL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* Polarization branch of the equivalent circuit: a resistor in parallel with a capacitor */
+struct RcPair
+{
+    double ohms = 0.0;
+    double farads = 0.0;
+};
+
+/* Equivalent circuit of one cell: OCV(SoC) in series with R0 and the RC
+   pairs. A pack is cells identical cells in series */
+struct BatteryParameters
+{
+    double capacityAh = 2.5;
+    double r0 = 0.030;                 /* Ohmic resistance of a cell */
+    std::vector<RcPair> rcPairs;       /* At most BatteryModel::maxRcPairs */
+    std::vector<double> ocv;           /* Open-circuit voltage of a cell at evenly spaced SoC, 0 to 1 */
+    double initialSoc = 1.0;
+    int cells = 1;
+
+    static BatteryParameters lithiumIon(void);
+    std::string serialize(void) const;
+    bool deserialize(const std::string& text);
+};
+
+/* Discrete-time battery model with a fixed step. The RC pairs use the exact
+   solution for a current held over the step, with their decay factors
+   computed once, and the OCV table has evenly spaced points: a step is one
+   multiply-add per pair and one table lookup, without allocation. The same
+   current sequence always gives the same voltages. */
+class BatteryModel
+{
+    public:
+        static constexpr size_t maxRcPairs = 4;
+
+        BatteryModel(const BatteryParameters& parameters, double stepSeconds);
+
+        double step(double current);
+        double terminalVoltage(double current) const;
+        double openCircuitVoltage(void) const;
+        double stateOfCharge(void) const { return soc; }
+        double stepSeconds(void) const { return dt; }
+        void reset(void);
+
+    private:
+        BatteryParameters parameters;
+        double dt;
+        double socPerAmp;                  /* SoC drawn by 1 A over one step */
+        size_t pairs;
+        double decay[maxRcPairs];          /* exp(-dt / RC) */
+        double gain[maxRcPairs];           /* R (1 - decay) */
+        double polarization[maxRcPairs];   /* Voltage across each pair */
+        double soc;
+};
+
+#endif /* BATTERY_MODEL_H */
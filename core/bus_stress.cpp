@@ -0,0 +1,257 @@
+/**
+ * @file bus_stress.cpp
+ * @brief Slow-consumer stress run of the telemetry bus.
+ *
+ * A sampler thread publishes on an absolute schedule, as the worker does,
+ * while a fast consumer drains the bus as soon as it is woken and four slow
+ * consumers, one per backpressure policy, take a small batch and then sleep.
+ * The slow ones fall a full ring behind within seconds and stay there, which
+ * is the steady state the policies exist for.
+ */
+
+#include "bus_stress.h"
+#include "alloc_tracker.h"
+#include "sim_farm.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    int64_t wallClockMs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param options Sampler rate, ring size and the pace of the slow consumers.
+ */
+BusStress::BusStress(const BusStressOptions& options)
+    : options(options)
+{
+    this->options.channels = std::max(1, options.channels);
+    this->options.rateHz = std::max(1.0, options.rateHz);
+    this->options.slowBatch = std::max<size_t>(options.slowBatch, static_cast<size_t>(this->options.channels));
+}
+
+/**
+ * @brief Runs the sampler and the consumers for the configured time.
+ * @return Per-second figures and the totals of every consumer.
+ */
+BusStressReport BusStress::run(void)
+{
+    using Clock = std::chrono::steady_clock;
+    static const BackpressurePolicy slowPolicies[] = {BackpressurePolicy::DROP_OLDEST, BackpressurePolicy::DECIMATE,
+                                                      BackpressurePolicy::BLOCK, BackpressurePolicy::COALESCE};
+    BusStressReport report;
+    TelemetryBus bus(options.slots);
+    std::vector<int> ids;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> iterations{0};
+    std::atomic<uint32_t> maxPublishUs{0};
+    Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rateHz));
+    Clock::time_point start;
+    uint64_t lastIterations = 0;
+
+    report.options = options;
+    {
+        BusConsumerOptions fast;
+        fast.name = "fast";
+        ids.push_back(bus.subscribe(fast));
+    }
+    for (BackpressurePolicy policy : slowPolicies)
+    {
+        BusConsumerOptions slow;
+        slow.name = std::string("slow-") + TelemetryBus::policyName(policy);
+        slow.policy = policy;
+        slow.blockTimeoutMs = options.blockTimeoutMs;
+        ids.push_back(bus.subscribe(slow));
+    }
+
+    /* Consumers */
+    threads.emplace_back([&] {
+        std::vector<BusEntry> entries(256);
+
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (bus.waitForData(ids[0], 10))
+                bus.read(ids[0], entries.data(), entries.size());
+        }
+    });
+    for (size_t i = 1; i < ids.size(); i++)
+    {
+        threads.emplace_back([&, i] {
+            std::vector<BusEntry> entries(options.slowBatch);
+
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                bus.read(ids[i], entries.data(), entries.size());
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.slowReadMs));
+            }
+        });
+    }
+
+    /* Sampler */
+    start = Clock::now();
+    threads.emplace_back([&] {
+        AllocationCounters before = AllocationTracker::threadCounters();
+        Clock::time_point next = Clock::now();
+        uint64_t sequence = 1;
+
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            Clock::time_point publishStart = Clock::now();
+            Sample sample;
+            uint32_t us;
+
+            sample.sequence = sequence++;
+            sample.timestampMs = wallClockMs();
+            for (int channel = 0; channel < options.channels; channel++)
+            {
+                sample.voltage = 5.0 + channel;
+                sample.current = 0.001 * static_cast<double>(sample.sequence % 1000);
+                bus.publish(channel, sample);
+            }
+            us = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - publishStart).count());
+            if (us > maxPublishUs.load(std::memory_order_relaxed))
+                maxPublishUs.store(us, std::memory_order_relaxed);
+            iterations.fetch_add(1, std::memory_order_relaxed);
+
+            next += period;
+            if (next < Clock::now())
+                next = Clock::now();  /* Late: do not catch up in a burst */
+            std::this_thread::sleep_until(next);
+        }
+        report.publishAllocations = AllocationTracker::threadCounters().allocations - before.allocations;
+    });
+
+    /* One row per second */
+    for (int second = 1; second <= static_cast<int>(options.seconds + 0.5); second++)
+    {
+        BusStressSecond row;
+        uint64_t total;
+
+        std::this_thread::sleep_until(start + std::chrono::seconds(second));
+        total = iterations.load(std::memory_order_relaxed);
+        row.iterations = total - lastIterations;
+        lastIterations = total;
+        row.maxPublishUs = maxPublishUs.exchange(0, std::memory_order_relaxed);
+        row.residentBytes = FarmBenchmark::residentBytes();
+        for (const BusConsumerStats& consumer : bus.stats())
+            row.lag.push_back(consumer.lag);
+        report.seconds.push_back(row);
+    }
+
+    stop = true;
+    bus.close();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    report.consumers = bus.stats();
+    report.published = bus.published();
+    report.publishBlockedUs = bus.publishBlockedUs();
+    report.busBytes = bus.memoryBytes();
+    return report;
+}
+
+/**
+ * @brief True if the sampler kept its rate and memory stayed flat after the
+ * first second, whatever the slow consumers did.
+ */
+bool BusStress::passed(const BusStressReport& report)
+{
+    /* The first second includes thread start-up */
+    for (size_t i = 1; i < report.seconds.size(); i++)
+    {
+        if (report.seconds[i].iterations < minRateShare * report.options.rateHz)
+            return false;
+        if (report.seconds[i].residentBytes > report.seconds[1].residentBytes + maxResidentGrowth)
+            return false;
+    }
+    return report.seconds.size() >= 2;
+}
+
+/**
+ * @brief Formats the per-second rows, the consumer totals and the drift of rate and memory.
+ * @param report Report of run().
+ * @param out Text is appended here.
+ */
+void BusStress::render(const BusStressReport& report, std::string& out)
+{
+    char line[256];
+    uint64_t minIterations = UINT64_MAX;
+    uint64_t maxIterations = 0;
+    size_t firstResident = 0;
+    size_t lastResident = 0;
+
+    snprintf(line, sizeof(line), "Sampler %.0f Hz x %d channels, ring %zu samples (%zu bytes), slow consumers read %zu every %u ms\n\n",
+             report.options.rateHz, report.options.channels, report.options.slots, report.busBytes,
+             report.options.slowBatch, report.options.slowReadMs);
+    out += line;
+
+    snprintf(line, sizeof(line), "%4s %10s %14s %10s  lag per consumer\n", "s", "sampler Hz", "max publish ms", "RSS KiB");
+    out += line;
+    for (size_t i = 0; i < report.seconds.size(); i++)
+    {
+        const BusStressSecond& row = report.seconds[i];
+
+        snprintf(line, sizeof(line), "%4zu %10llu %14.3f %10zu ", i + 1, static_cast<unsigned long long>(row.iterations),
+                 row.maxPublishUs / 1000.0, row.residentBytes / 1024);
+        out += line;
+        for (uint64_t lag : row.lag)
+        {
+            snprintf(line, sizeof(line), " %6llu", static_cast<unsigned long long>(lag));
+            out += line;
+        }
+        out += "\n";
+
+        /* The first second includes thread start-up */
+        if (i == 0)
+            continue;
+        minIterations = std::min(minIterations, row.iterations);
+        maxIterations = std::max(maxIterations, row.iterations);
+        if (firstResident == 0)
+            firstResident = row.residentBytes;
+        lastResident = row.residentBytes;
+    }
+
+    snprintf(line, sizeof(line), "\n%-18s %-12s %10s %10s %10s %10s %9s %8s\n",
+             "consumer", "policy", "delivered", "dropped", "decimated", "coalesced", "timeouts", "max lag");
+    out += line;
+    for (const BusConsumerStats& consumer : report.consumers)
+    {
+        snprintf(line, sizeof(line), "%-18s %-12s %10llu %10llu %10llu %10llu %9llu %8llu\n",
+                 consumer.name.c_str(), TelemetryBus::policyName(consumer.policy),
+                 static_cast<unsigned long long>(consumer.delivered), static_cast<unsigned long long>(consumer.dropped),
+                 static_cast<unsigned long long>(consumer.decimated), static_cast<unsigned long long>(consumer.coalesced),
+                 static_cast<unsigned long long>(consumer.timeouts), static_cast<unsigned long long>(consumer.maxLag));
+        out += line;
+    }
+
+    snprintf(line, sizeof(line), "\nPublished %llu samples; the sampler waited %.1f ms in total for BLOCK consumers\n",
+             static_cast<unsigned long long>(report.published), report.publishBlockedUs / 1000.0);
+    out += line;
+    if (maxIterations > 0)
+    {
+        snprintf(line, sizeof(line), "Sampler rate after the first second: %llu to %llu iterations/s\n",
+                 static_cast<unsigned long long>(minIterations), static_cast<unsigned long long>(maxIterations));
+        out += line;
+    }
+    if (firstResident > 0)
+    {
+        snprintf(line, sizeof(line), "Resident memory after the first second: %+lld KiB\n",
+                 (static_cast<long long>(lastResident) - static_cast<long long>(firstResident)) / 1024);
+        out += line;
+    }
+    if (AllocationTracker::enabled())
+    {
+        snprintf(line, sizeof(line), "Sampler thread allocations: %llu\n", static_cast<unsigned long long>(report.publishAllocations));
+        out += line;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef BUS_STRESS_H
+#define BUS_STRESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "telemetry_bus.h"
+
+struct BusStressOptions
+{
+    double seconds = 10.0;
+    double rateHz = 1000.0;    /* Sampler iterations per second, one sample per channel each */
+    int channels = 2;
+    size_t slots = 4096;
+    uint32_t slowReadMs = 100; /* Pause of a slow consumer after every read */
+    size_t slowBatch = 64;     /* Samples a slow consumer takes per read */
+    uint32_t blockTimeoutMs = 20;
+};
+
+/* One second of the run */
+struct BusStressSecond
+{
+    uint64_t iterations = 0;      /* Sampler iterations completed in the second */
+    uint32_t maxPublishUs = 0;    /* Longest publish of one sample, waits included */
+    size_t residentBytes = 0;     /* Of the process, at the end of the second */
+    std::vector<uint64_t> lag;    /* Unread samples of every consumer */
+};
+
+struct BusStressReport
+{
+    BusStressOptions options;
+    std::vector<BusStressSecond> seconds;
+    std::vector<BusConsumerStats> consumers;
+    uint64_t published = 0;
+    uint64_t publishBlockedUs = 0;
+    size_t busBytes = 0;
+    uint64_t publishAllocations = 0;  /* Heap allocations of the sampler thread; PS_TRACK_ALLOCATIONS builds only */
+};
+
+/* Runs a sampler at a fixed rate into a telemetry bus read by one fast
+   consumer and one deliberately slow consumer per backpressure policy.
+   Every second it records the sampler's iterations, its longest publish,
+   the resident memory of the process and every consumer's lag, so a
+   sampler slowed down or memory growing with the backlog shows as a trend. */
+class BusStress
+{
+    public:
+        static constexpr double minRateShare = 0.8;           /* Of the sampler rate, in every second after the first */
+        static constexpr size_t maxResidentGrowth = 1 << 20;  /* Bytes the process may grow after the first second */
+
+        explicit BusStress(const BusStressOptions& options);
+
+        BusStressReport run(void);
+        static bool passed(const BusStressReport& report);
+        static void render(const BusStressReport& report, std::string& out);
+
+    private:
+        BusStressOptions options;
+};
+
+#endif /* BUS_STRESS_H */
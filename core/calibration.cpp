@@ -0,0 +1,354 @@
+/**
+ * @file calibration.cpp
+ * @brief Per-channel calibration and unit conversion of raw V/I samples.
+ *
+ * Corrections are applied to whole batches of samples. On CPUs with AVX2 the
+ * batches are processed four samples at a time; otherwise a scalar kernel is
+ * used. Both kernels evaluate the same operations in the same order, so a
+ * batch produces bit-identical results on either path.
+ */
+
+#include "calibration.h"
+#include "alloc_tracker.h"
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#if defined(PS_ENABLE_AVX2) && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+/**
+ * @brief Checks that a curve can be evaluated.
+ * @return True if the curve has enough coefficients or table entries.
+ */
+bool CalibrationCurve::isValid(void) const
+{
+    if (kind == Kind::POLYNOMIAL)
+        return !coefficients.empty();
+    return lutValues.size() >= 2 && lutStep > 0.0;
+}
+
+/**
+ * @brief Sets the correction curves of a channel.
+ * @param channel Channel number (0 for single output supplies).
+ * @param calibration Voltage and current curves.
+ */
+void Calibration::setChannel(int channel, const ChannelCalibration& calibration)
+{
+    channels[channel] = calibration;
+}
+
+/**
+ * @brief Returns the correction curves of a channel.
+ * @param channel Channel number.
+ * @return Pointer to the curves or nullptr if the channel is uncalibrated.
+ */
+const ChannelCalibration* Calibration::channel(int channel) const
+{
+    auto it = channels.find(channel);
+    if (it == channels.end())
+        return nullptr;
+    return &it->second;
+}
+
+/**
+ * @brief Checks if any channel has a calibration.
+ */
+bool Calibration::empty(void) const
+{
+    return channels.empty();
+}
+
+/**
+ * @brief Forces the scalar kernels even when AVX2 is available.
+ * @param scalar True to disable the vectorized path.
+ */
+void Calibration::forceScalar(bool scalar)
+{
+    scalarOnly = scalar;
+}
+
+/**
+ * @brief Checks at runtime whether the CPU supports AVX2.
+ */
+bool Calibration::avx2Available(void)
+{
+#if defined(PS_ENABLE_AVX2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#elif defined(PS_ENABLE_AVX2) && defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    static const bool supported = []
+    {
+        int info[4];
+
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        /* AVX and OSXSAVE, and the OS saves the YMM registers (XCR0 bits 1 and 2) */
+        __cpuidex(info, 1, 0);
+        if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        /* AVX2: leaf 7, EBX bit 5 */
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Applies the calibration of a channel to a batch of raw samples in place.
+ * Uncalibrated channels are left untouched.
+ * @param channel Channel number.
+ * @param voltage Raw voltage samples, replaced by corrected values. May be nullptr.
+ * @param current Raw current samples, replaced by corrected values. May be nullptr.
+ * @param count Number of samples in each batch.
+ */
+void Calibration::apply(int channel, double *voltage, double *current, size_t count) const
+{
+    PS_ZERO_ALLOCATION_PROBE("calibration.apply");
+    const ChannelCalibration *cal = this->channel(channel);
+    if (cal == nullptr)
+        return;
+
+    if (voltage)
+        applyCurve(cal->voltage, voltage, count);
+    if (current)
+        applyCurve(cal->current, current, count);
+}
+
+/**
+ * @brief Applies a single correction curve to a batch of values in place.
+ * @param curve Correction curve.
+ * @param values Values to correct.
+ * @param count Number of values.
+ */
+void Calibration::applyCurve(const CalibrationCurve& curve, double *values, size_t count) const
+{
+    bool vectorized = !scalarOnly && avx2Available();
+
+    if (!curve.isValid() || count == 0)
+        return;
+
+    if (curve.kind == CalibrationCurve::Kind::POLYNOMIAL)
+    {
+        if (vectorized)
+            calibration_kernels::polynomialAvx2(curve.coefficients.data(), curve.coefficients.size(),
+                                                curve.unitScale, values, count);
+        else
+            calibration_kernels::polynomialScalar(curve.coefficients.data(), curve.coefficients.size(),
+                                                  curve.unitScale, values, count);
+    }
+    else
+    {
+        if (vectorized)
+            calibration_kernels::lookupAvx2(curve.lutValues.data(), curve.lutValues.size(), curve.lutStart,
+                                            curve.lutStep, curve.unitScale, values, count);
+        else
+            calibration_kernels::lookupScalar(curve.lutValues.data(), curve.lutValues.size(), curve.lutStart,
+                                              curve.lutStep, curve.unitScale, values, count);
+    }
+}
+
+/**
+ * @brief Serializes all channel curves to text.
+ *
+ * One line per curve:
+ *   <channel> <V|I> poly <scale> <c0> <c1> ...
+ *   <channel> <V|I> lut <scale> <start> <step> <v0> <v1> ...
+ */
+std::string Calibration::serialize(void) const
+{
+    std::ostringstream out;
+    out.precision(17);
+
+    for (const auto& entry : channels)
+    {
+        const CalibrationCurve *curves[2] = {&entry.second.voltage, &entry.second.current};
+        const char quantity[2] = {'V', 'I'};
+
+        for (int i = 0; i < 2; i++)
+        {
+            const CalibrationCurve& curve = *curves[i];
+            out << entry.first << ' ' << quantity[i] << ' ';
+            if (curve.kind == CalibrationCurve::Kind::POLYNOMIAL)
+            {
+                out << "poly " << curve.unitScale;
+                for (double c : curve.coefficients)
+                    out << ' ' << c;
+            }
+            else
+            {
+                out << "lut " << curve.unitScale << ' ' << curve.lutStart << ' ' << curve.lutStep;
+                for (double v : curve.lutValues)
+                    out << ' ' << v;
+            }
+            out << '\n';
+        }
+    }
+    return out.str();
+}
+
+/**
+ * @brief Replaces all channel curves with the ones parsed from text.
+ * @param text Text produced by serialize().
+ * @return True on success. On failure the calibration is left unchanged.
+ */
+bool Calibration::deserialize(const std::string& text)
+{
+    std::map<int, ChannelCalibration> parsed;
+    std::istringstream in(text);
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        int channelNumber;
+        char quantity;
+        std::string kind;
+        CalibrationCurve curve;
+        double value;
+
+        if (line.empty())
+            continue;
+
+        if (!(fields >> channelNumber >> quantity >> kind >> curve.unitScale))
+            goto err_deserialize;
+
+        if (kind == "poly")
+        {
+            curve.kind = CalibrationCurve::Kind::POLYNOMIAL;
+            curve.coefficients.clear();
+            while (fields >> value)
+                curve.coefficients.push_back(value);
+        }
+        else if (kind == "lut")
+        {
+            curve.kind = CalibrationCurve::Kind::LOOKUP_TABLE;
+            if (!(fields >> curve.lutStart >> curve.lutStep))
+                goto err_deserialize;
+            while (fields >> value)
+                curve.lutValues.push_back(value);
+        }
+        else
+        {
+            goto err_deserialize;
+        }
+
+        if (!curve.isValid())
+            goto err_deserialize;
+
+        if (quantity == 'V')
+            parsed[channelNumber].voltage = curve;
+        else if (quantity == 'I')
+            parsed[channelNumber].current = curve;
+        else
+            goto err_deserialize;
+    }
+
+    channels = parsed;
+    return true;
+
+err_deserialize:
+    std::cout << "Calibration: Invalid calibration line: " << line << std::endl;
+    return false;
+}
+
+/**
+ * @brief Returns the calibration of an instrument, creating an empty one if needed.
+ * @param serialNumber Serial number reported by *IDN?.
+ */
+Calibration& CalibrationStore::forSerial(const std::string& serialNumber)
+{
+    return tables[serialNumber];
+}
+
+/**
+ * @brief Looks up the calibration of an instrument.
+ * @param serialNumber Serial number reported by *IDN?.
+ * @return Pointer to the calibration or nullptr if the instrument has none.
+ */
+const Calibration* CalibrationStore::find(const std::string& serialNumber) const
+{
+    auto it = tables.find(serialNumber);
+    if (it == tables.end())
+        return nullptr;
+    return &it->second;
+}
+
+/**
+ * @brief Drops the calibration of an instrument.
+ * @param serialNumber Serial number reported by *IDN?.
+ */
+void CalibrationStore::remove(const std::string& serialNumber)
+{
+    tables.erase(serialNumber);
+}
+
+namespace calibration_kernels
+{
+
+/**
+ * @brief Scalar polynomial kernel (Horner's rule, then unit scale).
+ */
+void polynomialScalar(const double *coefficients, size_t order, double scale, double *values, size_t count)
+{
+    for (size_t n = 0; n < count; n++)
+    {
+        double x = values[n];
+        double y = coefficients[order - 1];
+        for (size_t k = order - 1; k-- > 0;)
+        {
+            y = y * x;
+            y = y + coefficients[k];
+        }
+        values[n] = y * scale;
+    }
+}
+
+/**
+ * @brief Scalar lookup table kernel (clamped linear interpolation, then unit scale).
+ *
+ * The clamps are written as the comparisons performed by the AVX2 min/max
+ * instructions so that NaN inputs also map to the same result on both paths.
+ */
+void lookupScalar(const double *table, size_t size, double start, double step, double scale, double *values, size_t count)
+{
+    const double invStep = 1.0 / step;
+    const double last = static_cast<double>(size - 1);
+    const double lastSegment = static_cast<double>(size - 2);
+
+    for (size_t n = 0; n < count; n++)
+    {
+        double t = (values[n] - start) * invStep;
+        t = (t > 0.0) ? t : 0.0;
+        t = (t < last) ? t : last;
+
+        double segment = std::floor(t);
+        segment = (segment < lastSegment) ? segment : lastSegment;
+
+        size_t i = static_cast<size_t>(static_cast<int>(segment));
+        double fraction = t - segment;
+        double y = table[i] + fraction * (table[i + 1] - table[i]);
+        values[n] = y * scale;
+    }
+}
+
+#if !defined(PS_ENABLE_AVX2)
+/* AVX2 support not compiled in: the vector entry points fall back to scalar */
+void polynomialAvx2(const double *coefficients, size_t order, double scale, double *values, size_t count)
+{
+    polynomialScalar(coefficients, order, scale, values, count);
+}
+
+void lookupAvx2(const double *table, size_t size, double start, double step, double scale, double *values, size_t count)
+{
+    lookupScalar(table, size, start, step, scale, values, count);
+}
+#endif
+
+} /* namespace calibration_kernels */
@@ -0,0 +1,81 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Correction curve applied to one quantity (voltage or current) of a channel.
+   The corrected value is curve(raw) * unitScale, where curve is either a
+   polynomial c0 + c1*x + c2*x^2 + ... evaluated with Horner's rule, or a
+   piecewise linear lookup table sampled on a uniform grid. */
+struct CalibrationCurve
+{
+    enum class Kind
+    {
+        POLYNOMIAL = 0,
+        LOOKUP_TABLE
+    };
+
+    Kind kind = Kind::POLYNOMIAL;
+    std::vector<double> coefficients = {0.0, 1.0}; /* c0, c1, ... (identity by default) */
+    double lutStart = 0.0;                          /* Raw value of the first table entry */
+    double lutStep = 1.0;                           /* Raw distance between table entries */
+    std::vector<double> lutValues;                  /* Corrected values at each grid point */
+    double unitScale = 1.0;                         /* Unit conversion applied after correction */
+
+    bool isValid(void) const;
+};
+
+struct ChannelCalibration
+{
+    CalibrationCurve voltage;
+    CalibrationCurve current;
+};
+
+class Calibration
+{
+    public:
+        void setChannel(int channel, const ChannelCalibration& calibration);
+        const ChannelCalibration* channel(int channel) const;
+        bool empty(void) const;
+
+        void apply(int channel, double *voltage, double *current, size_t count) const;
+        void applyCurve(const CalibrationCurve& curve, double *values, size_t count) const;
+
+        void forceScalar(bool scalar);
+        static bool avx2Available(void);
+
+        std::string serialize(void) const;
+        bool deserialize(const std::string& text);
+
+    private:
+        std::map<int, ChannelCalibration> channels;
+        bool scalarOnly = false;
+};
+
+/* Calibration tables keyed by the instrument serial number from *IDN? */
+class CalibrationStore
+{
+    public:
+        Calibration& forSerial(const std::string& serialNumber);
+        const Calibration* find(const std::string& serialNumber) const;
+        void remove(const std::string& serialNumber);
+
+    private:
+        std::map<std::string, Calibration> tables;
+};
+
+/* Kernels shared by the scalar and AVX2 paths. Both evaluate the exact same
+   sequence of IEEE operations (no fused multiply-add) so results are
+   bit-identical regardless of the path taken. */
+namespace calibration_kernels
+{
+    void polynomialScalar(const double *coefficients, size_t order, double scale, double *values, size_t count);
+    void lookupScalar(const double *table, size_t size, double start, double step, double scale, double *values, size_t count);
+    void polynomialAvx2(const double *coefficients, size_t order, double scale, double *values, size_t count);
+    void lookupAvx2(const double *table, size_t size, double start, double step, double scale, double *values, size_t count);
+}
+
+#endif /* CALIBRATION_H */
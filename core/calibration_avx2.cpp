@@ -0,0 +1,77 @@
+/**
+ * @file calibration_avx2.cpp
+ * @brief AVX2 calibration kernels.
+ *
+ * This file is the only one built with AVX2 code generation enabled and is
+ * only entered after a runtime CPU check. Every operation mirrors the scalar
+ * kernels in calibration.cpp one for one (multiply and add are never fused),
+ * and any tail shorter than a vector is handed to the scalar kernel.
+ */
+
+#include "calibration.h"
+
+#if defined(PS_ENABLE_AVX2)
+#include <immintrin.h>
+
+namespace calibration_kernels
+{
+
+/**
+ * @brief AVX2 polynomial kernel, four samples per iteration.
+ */
+void polynomialAvx2(const double *coefficients, size_t order, double scale, double *values, size_t count)
+{
+    const __m256d vScale = _mm256_set1_pd(scale);
+    size_t n = 0;
+
+    for (; n + 4 <= count; n += 4)
+    {
+        __m256d x = _mm256_loadu_pd(values + n);
+        __m256d y = _mm256_set1_pd(coefficients[order - 1]);
+        for (size_t k = order - 1; k-- > 0;)
+        {
+            y = _mm256_mul_pd(y, x);
+            y = _mm256_add_pd(y, _mm256_set1_pd(coefficients[k]));
+        }
+        _mm256_storeu_pd(values + n, _mm256_mul_pd(y, vScale));
+    }
+
+    polynomialScalar(coefficients, order, scale, values + n, count - n);
+}
+
+/**
+ * @brief AVX2 lookup table kernel, four samples per iteration.
+ */
+void lookupAvx2(const double *table, size_t size, double start, double step, double scale, double *values, size_t count)
+{
+    const double invStep = 1.0 / step;
+    const __m256d vStart = _mm256_set1_pd(start);
+    const __m256d vInvStep = _mm256_set1_pd(invStep);
+    const __m256d vZero = _mm256_setzero_pd();
+    const __m256d vLast = _mm256_set1_pd(static_cast<double>(size - 1));
+    const __m256d vLastSegment = _mm256_set1_pd(static_cast<double>(size - 2));
+    const __m256d vScale = _mm256_set1_pd(scale);
+    size_t n = 0;
+
+    for (; n + 4 <= count; n += 4)
+    {
+        __m256d t = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(values + n), vStart), vInvStep);
+        t = _mm256_max_pd(t, vZero);
+        t = _mm256_min_pd(t, vLast);
+
+        __m256d segment = _mm256_floor_pd(t);
+        segment = _mm256_min_pd(segment, vLastSegment);
+
+        __m128i index = _mm256_cvttpd_epi32(segment);
+        __m256d fraction = _mm256_sub_pd(t, segment);
+        __m256d lower = _mm256_i32gather_pd(table, index, 8);
+        __m256d upper = _mm256_i32gather_pd(table + 1, index, 8);
+        __m256d y = _mm256_add_pd(lower, _mm256_mul_pd(fraction, _mm256_sub_pd(upper, lower)));
+        _mm256_storeu_pd(values + n, _mm256_mul_pd(y, vScale));
+    }
+
+    lookupScalar(table, size, start, step, scale, values + n, count - n);
+}
+
+} /* namespace calibration_kernels */
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file capture_log.cpp
+ * @brief Crash-safe log of the captured samples.
+ *
+ * Record payload (little endian, 40 bytes):
+ *   [version u8][channel u8][quality u8][reserved u8][latency us u32]
+ *   [sequence u64][timestamp ms i64][voltage f64][current f64]
+ * Framing, checksums and durability are provided by LogWriter.
+ */
+
+#include "capture_log.h"
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief Opens the log, continuing after its last durable record.
+ * @param directory Log directory, created if missing.
+ * @param durabilityMs A sample is durable at most this long after it was appended.
+ */
+CaptureLog::CaptureError CaptureLog::open(const std::string& directory, uint32_t durabilityMs)
+{
+    GroupCommitPolicy policy;
+
+    close();
+    policy.maxDelayMs = durabilityMs;
+    if (log.open(directory, segmentBytes, policy) != LogWriter::LogError::ERR_SUCCESS)
+    {
+        std::cout << "Capture log: Failed to open " << directory << std::endl;
+        return CaptureError::ERR_OPEN_FAILED;
+    }
+    opened = true;
+    return CaptureError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Makes the pending samples durable and closes the log.
+ */
+void CaptureLog::close(void)
+{
+    log.close();
+    opened = false;
+}
+
+/**
+ * @brief Queues a sample. It becomes durable with the next group commit.
+ * @param channel Channel number, 0 to 255.
+ * @param sample Sample as delivered to the window.
+ */
+CaptureLog::CaptureError CaptureLog::append(int channel, const Sample& sample)
+{
+    uint8_t record[recordSize];
+
+    if (channel < 0 || channel > 255)
+        return CaptureError::ERR_IO_FAILED;
+
+    memset(record, 0, 4);
+    record[0] = recordVersion;
+    record[1] = static_cast<uint8_t>(channel);
+    record[2] = sample.quality;
+    memcpy(record + 4, &sample.latencyUs, 4);
+    memcpy(record + 8, &sample.sequence, 8);
+    memcpy(record + 16, &sample.timestampMs, 8);
+    memcpy(record + 24, &sample.voltage, 8);
+    memcpy(record + 32, &sample.current, 8);
+    if (log.append(record, sizeof(record)) != LogWriter::LogError::ERR_SUCCESS)
+        return CaptureError::ERR_IO_FAILED;
+    return CaptureError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Reads every durable sample of a capture log in order.
+ * @param directory Log directory.
+ * @param handler Called for every sample.
+ */
+CaptureLog::CaptureError CaptureLog::replay(const std::string& directory, const SampleHandler& handler)
+{
+    LogWriter::RecordHandler decode = [&handler](uint64_t, const uint8_t *payload, size_t size)
+    {
+        Sample sample;
+
+        if (size != recordSize || payload[0] != recordVersion)
+            return;
+        sample.quality = payload[2];
+        memcpy(&sample.latencyUs, payload + 4, 4);
+        memcpy(&sample.sequence, payload + 8, 8);
+        memcpy(&sample.timestampMs, payload + 16, 8);
+        memcpy(&sample.voltage, payload + 24, 8);
+        memcpy(&sample.current, payload + 32, 8);
+        handler(payload[1], sample);
+    };
+
+    if (LogWriter::replay(directory, decode) != LogWriter::LogError::ERR_SUCCESS)
+        return CaptureError::ERR_OPEN_FAILED;
+    return CaptureError::ERR_SUCCESS;
+}
@@ -0,0 +1,46 @@
+#ifndef CAPTURE_LOG_H
+#define CAPTURE_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "log_writer.h"
+#include "sample.h"
+
+/* Crash-safe copy of the session capture.
+   Every sample the window receives while capturing, flagged ones included,
+   is appended as one record to a LogWriter, which group-commits them within
+   the durability interval. After a power cut the log ends at the last
+   durable record; replay() reads it back in sequence order. */
+class CaptureLog
+{
+    public:
+        enum class CaptureError
+        {
+            ERR_SUCCESS = 0,
+            ERR_OPEN_FAILED,
+            ERR_IO_FAILED
+        };
+
+        using SampleHandler = std::function<void(int channel, const Sample& sample)>;
+
+        CaptureError open(const std::string& directory, uint32_t durabilityMs);
+        void close(void);
+        bool isOpen(void) const { return opened; }
+        CaptureError append(int channel, const Sample& sample);
+        LogWriterStats stats(void) { return log.stats(); }
+
+        static CaptureError replay(const std::string& directory, const SampleHandler& handler);
+
+        static constexpr size_t recordSize = 40;
+
+    private:
+        static constexpr uint8_t recordVersion = 1;
+        static constexpr size_t segmentBytes = 16 * 1024 * 1024;
+
+        LogWriter log;
+        bool opened = false;
+};
+
+#endif /* CAPTURE_LOG_H */
@@ -0,0 +1,371 @@
+/**
+ * @file compressed_history.cpp
+ * @brief Bounded-memory, block-compressed in-RAM sample history.
+ *
+ * Only the newest block of every channel is kept as plain integers. Older
+ * blocks are compressed with delta + zigzag + bit-packing, which decodes with
+ * a handful of shifts per value so that zooming into any window only costs
+ * the few blocks it overlaps. Typical slowly varying supply readings pack to
+ * a few bits per column per sample.
+ */
+
+#include "compressed_history.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels.
+ * @param memoryCapBytes Hard limit for the whole history (active and sealed blocks).
+ * @param blockSamples Samples per block.
+ */
+CompressedHistory::CompressedHistory(size_t channels, size_t memoryCapBytes, size_t blockSamples)
+    : channelHistory(channels), blockSamples(std::max<size_t>(blockSamples, 2)), memoryCap(memoryCapBytes)
+{
+    for (ChannelHistory& history : channelHistory)
+    {
+        history.activeTimestamp.reserve(this->blockSamples);
+        history.activeVoltage.reserve(this->blockSamples);
+        history.activeCurrent.reserve(this->blockSamples);
+    }
+    activeBytes = channels * this->blockSamples * (sizeof(int64_t) + 2 * sizeof(int32_t));
+    if (activeBytes > memoryCap)
+        std::cout << "History: Memory cap is smaller than the active blocks (" << activeBytes << " bytes)" << std::endl;
+}
+
+/**
+ * @brief Sets the count-to-unit conversion of a channel.
+ */
+void CompressedHistory::setScale(size_t channel, const ChannelScale& scale)
+{
+    if (channel < channelHistory.size())
+        channelHistory[channel].scale = scale;
+}
+
+/**
+ * @brief Appends a sample, sealing the active block when it becomes full.
+ * @param channel Channel number.
+ * @param timestampMs Sample time in milliseconds, non-decreasing per channel.
+ * @param voltage Voltage in volts.
+ * @param current Current in amps.
+ * @return False if the sample cannot be represented.
+ */
+bool CompressedHistory::append(size_t channel, int64_t timestampMs, double voltage, double current)
+{
+    double voltageCounts;
+    double currentCounts;
+
+    if (channel >= channelHistory.size())
+        return false;
+
+    ChannelHistory& history = channelHistory[channel];
+    voltageCounts = std::nearbyint(voltage / history.scale.voltsPerCount);
+    currentCounts = std::nearbyint(current / history.scale.ampsPerCount);
+    if (!(std::fabs(voltageCounts) <= std::numeric_limits<int32_t>::max()) ||
+        !(std::fabs(currentCounts) <= std::numeric_limits<int32_t>::max()))
+        return false;
+
+    history.activeTimestamp.push_back(timestampMs);
+    history.activeVoltage.push_back(static_cast<int32_t>(voltageCounts));
+    history.activeCurrent.push_back(static_cast<int32_t>(currentCounts));
+
+    if (history.activeTimestamp.size() == blockSamples)
+        seal(channel);
+    return true;
+}
+
+/**
+ * @brief Bits per zigzagged delta that fit every delta of a column.
+ * @param values Column values.
+ * @param count Number of values (at least 1).
+ */
+template <typename T>
+uint8_t CompressedHistory::deltaWidth(const T *values, size_t count)
+{
+    uint64_t maxZigzag = 0;
+    uint8_t width = 0;
+
+    for (size_t k = 1; k < count; k++)
+    {
+        int64_t delta = static_cast<int64_t>(values[k]) - static_cast<int64_t>(values[k - 1]);
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        maxZigzag |= zigzag;
+    }
+    while (width < 64 && (maxZigzag >> width) != 0)
+        width++;
+    return width;
+}
+
+/**
+ * @brief Delta, zigzag and bit-pack one column.
+ * @param values Column values.
+ * @param count Number of values (at least 1).
+ * @param width Width from deltaWidth().
+ * @param wordOffset First word of the column in words, which is already sized and zeroed.
+ * @param column Receives the first value, width and word offset.
+ * @param words Packed deltas are written here.
+ * @return Word offset of the next column.
+ */
+template <typename T>
+size_t CompressedHistory::packColumn(const T *values, size_t count, uint8_t width, size_t wordOffset, PackedColumn& column,
+                                     std::vector<uint64_t>& words)
+{
+    size_t bit = 0;
+
+    column.first = values[0];
+    column.width = width;
+    column.wordOffset = wordOffset;
+    if (width == 0)
+        return wordOffset;
+
+    for (size_t k = 1; k < count; k++, bit += width)
+    {
+        int64_t delta = static_cast<int64_t>(values[k]) - static_cast<int64_t>(values[k - 1]);
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        size_t word = wordOffset + bit / 64;
+        unsigned shift = bit % 64;
+
+        words[word] |= zigzag << shift;
+        if (shift + width > 64)
+            words[word + 1] |= zigzag >> (64 - shift);
+    }
+    return wordOffset + ((count - 1) * width + 63) / 64;
+}
+
+/**
+ * @brief Reverses packColumn().
+ */
+void CompressedHistory::unpackColumn(const PackedColumn& column, const std::vector<uint64_t>& words, size_t count, int64_t *values)
+{
+    const uint64_t mask = (column.width == 64) ? ~0ULL : ((1ULL << column.width) - 1);
+    const uint64_t *packed = words.data() + column.wordOffset;
+    int64_t value = column.first;
+    size_t bit = 0;
+
+    values[0] = value;
+    if (column.width == 0)
+    {
+        std::fill(values + 1, values + count, value);
+        return;
+    }
+
+    for (size_t k = 1; k < count; k++, bit += column.width)
+    {
+        size_t word = bit / 64;
+        unsigned shift = bit % 64;
+        uint64_t zigzag = packed[word] >> shift;
+
+        if (shift + column.width > 64)
+            zigzag |= packed[word + 1] << (64 - shift);
+        zigzag &= mask;
+        value += static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+        values[k] = value;
+    }
+}
+
+/**
+ * @brief Compresses the active block of a channel and starts a new one.
+ * Older blocks are evicted before the new one is allocated, so the history
+ * never holds more than the cap, not even while sealing.
+ */
+void CompressedHistory::seal(size_t channel)
+{
+    ChannelHistory& history = channelHistory[channel];
+    SealedBlock block;
+    size_t count = history.activeTimestamp.size();
+    uint8_t widths[3];
+    size_t words = 0;
+    size_t blockBytes;
+    size_t offset;
+
+    if (count == 0)
+        return;
+
+    widths[0] = deltaWidth(history.activeTimestamp.data(), count);
+    widths[1] = deltaWidth(history.activeVoltage.data(), count);
+    widths[2] = deltaWidth(history.activeCurrent.data(), count);
+    for (uint8_t width : widths)
+        words += ((count - 1) * width + 63) / 64;
+    blockBytes = sizeof(SealedBlock) + words * sizeof(uint64_t);
+
+    /* Make room under the cap before allocating the new block */
+    while (!sealOrder.empty() && activeBytes + sealedBytes + blockBytes > memoryCap)
+        evictOldest();
+    if (activeBytes + sealedBytes + blockBytes <= memoryCap)
+    {
+        block.count = static_cast<uint32_t>(count);
+        block.firstTimestampMs = history.activeTimestamp.front();
+        block.lastTimestampMs = history.activeTimestamp.back();
+        block.words.assign(words, 0);
+
+        offset = packColumn(history.activeTimestamp.data(), count, widths[0], 0, block.timestamp, block.words);
+        offset = packColumn(history.activeVoltage.data(), count, widths[1], offset, block.voltage, block.words);
+        packColumn(history.activeCurrent.data(), count, widths[2], offset, block.current, block.words);
+
+        sealedBytes += block.bytes();
+        history.sealed.push_back(std::move(block));
+        sealOrder.push_back(static_cast<uint32_t>(channel));
+    }
+    else
+    {
+        /* Nothing older is left to evict: the block itself is the oldest data */
+        evicted++;
+    }
+
+    history.activeTimestamp.clear();
+    history.activeVoltage.clear();
+    history.activeCurrent.clear();
+}
+
+/**
+ * @brief Drops the oldest sealed block of the whole history.
+ */
+void CompressedHistory::evictOldest(void)
+{
+    ChannelHistory& history = channelHistory[sealOrder.front()];
+
+    sealOrder.pop_front();
+    sealedBytes -= history.sealed.front().bytes();
+    history.sealed.pop_front();
+    evicted++;
+}
+
+/**
+ * @brief Decodes one sealed block, keeping the samples inside [fromMs, toMs].
+ */
+void CompressedHistory::decodeBlock(const ChannelHistory& history, const SealedBlock& block, int64_t fromMs, int64_t toMs,
+                                    std::vector<HistoryPoint>& points) const
+{
+    std::vector<int64_t> timestamp(block.count);
+    std::vector<int64_t> voltage(block.count);
+    std::vector<int64_t> current(block.count);
+
+    unpackColumn(block.timestamp, block.words, block.count, timestamp.data());
+    unpackColumn(block.voltage, block.words, block.count, voltage.data());
+    unpackColumn(block.current, block.words, block.count, current.data());
+
+    for (size_t k = 0; k < block.count; k++)
+    {
+        if (timestamp[k] < fromMs || timestamp[k] > toMs)
+            continue;
+        points.push_back({timestamp[k], voltage[k] * history.scale.voltsPerCount, current[k] * history.scale.ampsPerCount});
+    }
+}
+
+/**
+ * @brief Returns the samples of a channel inside a time window.
+ *
+ * Only the sealed blocks overlapping the window are decompressed. A window
+ * so wide that the point budget leaves less than one point per block is
+ * served without decoding: the first sample of every block is stored
+ * verbatim and stands for the block.
+ * @param channel Channel number.
+ * @param fromMs Window start, inclusive.
+ * @param toMs Window end, inclusive.
+ * @param points Receives the samples, oldest first.
+ * @param maxPoints If non-zero, the result is thinned to at most this many samples.
+ * @return Number of samples returned.
+ */
+size_t CompressedHistory::query(size_t channel, int64_t fromMs, int64_t toMs, std::vector<HistoryPoint>& points,
+                                size_t maxPoints) const
+{
+    size_t blocks = 0;
+    size_t samples = 0;
+
+    points.clear();
+    if (channel >= channelHistory.size() || fromMs > toMs)
+        return 0;
+
+    const ChannelHistory& history = channelHistory[channel];
+    auto first = std::lower_bound(history.sealed.begin(), history.sealed.end(), fromMs,
+                                  [](const SealedBlock& block, int64_t t) { return block.lastTimestampMs < t; });
+
+    for (auto it = first; it != history.sealed.end() && it->firstTimestampMs <= toMs; ++it)
+    {
+        blocks++;
+        samples += it->count;
+    }
+
+    if (maxPoints != 0 && samples / maxPoints >= blockSamples)
+    {
+        size_t blockStride = (blocks + maxPoints - 1) / maxPoints;
+        auto it = first;
+
+        for (size_t k = 0; k < blocks; k++, ++it)
+        {
+            if (k % blockStride == 0 && it->firstTimestampMs >= fromMs)
+                points.push_back({it->timestamp.first, it->voltage.first * history.scale.voltsPerCount,
+                                  it->current.first * history.scale.ampsPerCount});
+        }
+        for (size_t k = 0; k < history.activeTimestamp.size(); k++)
+        {
+            if (history.activeTimestamp[k] < fromMs || history.activeTimestamp[k] > toMs)
+                continue;
+            points.push_back({history.activeTimestamp[k], history.activeVoltage[k] * history.scale.voltsPerCount,
+                              history.activeCurrent[k] * history.scale.ampsPerCount});
+            break;
+        }
+        return points.size();
+    }
+
+    for (auto it = first; it != history.sealed.end() && it->firstTimestampMs <= toMs; ++it)
+        decodeBlock(history, *it, fromMs, toMs, points);
+
+    for (size_t k = 0; k < history.activeTimestamp.size(); k++)
+    {
+        if (history.activeTimestamp[k] < fromMs || history.activeTimestamp[k] > toMs)
+            continue;
+        points.push_back({history.activeTimestamp[k], history.activeVoltage[k] * history.scale.voltsPerCount,
+                          history.activeCurrent[k] * history.scale.ampsPerCount});
+    }
+
+    /* Thin to the requested number of points with a fixed stride */
+    if (maxPoints != 0 && points.size() > maxPoints)
+    {
+        size_t stride = (points.size() + maxPoints - 1) / maxPoints;
+        size_t kept = 0;
+        for (size_t k = 0; k < points.size(); k += stride)
+            points[kept++] = points[k];
+        points.resize(kept);
+    }
+    return points.size();
+}
+
+/**
+ * @brief Returns the timestamp of the oldest retained sample of a channel.
+ * @return Oldest timestamp, or INT64_MAX if the channel has no samples.
+ */
+int64_t CompressedHistory::oldestTimestampMs(size_t channel) const
+{
+    const ChannelHistory& history = channelHistory[channel];
+
+    if (!history.sealed.empty())
+        return history.sealed.front().firstTimestampMs;
+    if (!history.activeTimestamp.empty())
+        return history.activeTimestamp.front();
+    return std::numeric_limits<int64_t>::max();
+}
+
+/**
+ * @brief Returns memory and block counters.
+ */
+HistoryStats CompressedHistory::stats(void) const
+{
+    HistoryStats result;
+
+    for (const ChannelHistory& history : channelHistory)
+    {
+        result.sealedBlocks += history.sealed.size();
+        result.samples += history.activeTimestamp.size();
+        for (const SealedBlock& block : history.sealed)
+        {
+            result.samples += block.count;
+            result.compressedBytes += block.words.size() * sizeof(uint64_t);
+        }
+    }
+    result.evictedBlocks = evicted;
+    result.memoryBytes = activeBytes + sealedBytes;
+    return result;
+}
@@ -0,0 +1,98 @@
+#ifndef COMPRESSED_HISTORY_H
+#define COMPRESSED_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "sample_store.h"
+
+/* Decompressed sample returned by history queries */
+struct HistoryPoint
+{
+    int64_t timestampMs;
+    double voltage;
+    double current;
+};
+
+struct HistoryStats
+{
+    size_t sealedBlocks = 0;
+    size_t evictedBlocks = 0;
+    size_t compressedBytes = 0;  /* Payload of all sealed blocks */
+    size_t memoryBytes = 0;      /* Sealed blocks plus the active blocks */
+    uint64_t samples = 0;        /* Samples currently retained */
+};
+
+/* Bounded-memory in-RAM history of every channel.
+   Samples are written into a fixed-size uncompressed active block per
+   channel. A full block is sealed: each column is delta encoded, zigzag
+   mapped and bit-packed at the narrowest width that fits the block. The
+   size of a sealed block is known before it is allocated, and sealed blocks
+   are evicted oldest first (across all channels) until it fits under the
+   cap; a block that does not fit next to the active blocks even then is
+   dropped. */
+class CompressedHistory
+{
+    public:
+        CompressedHistory(size_t channels, size_t memoryCapBytes, size_t blockSamples = 1024);
+
+        void setScale(size_t channel, const ChannelScale& scale);
+        bool append(size_t channel, int64_t timestampMs, double voltage, double current);
+        size_t query(size_t channel, int64_t fromMs, int64_t toMs, std::vector<HistoryPoint>& points,
+                     size_t maxPoints = 0) const;
+        int64_t oldestTimestampMs(size_t channel) const;
+        HistoryStats stats(void) const;
+
+    private:
+        /* One bit-packed column of a sealed block */
+        struct PackedColumn
+        {
+            int64_t first = 0;     /* First value, stored verbatim */
+            uint8_t width = 0;     /* Bits per zigzagged delta */
+            size_t wordOffset = 0; /* Start of the deltas in SealedBlock::words */
+        };
+
+        struct SealedBlock
+        {
+            int64_t firstTimestampMs = 0;
+            int64_t lastTimestampMs = 0;
+            uint32_t count = 0;
+            PackedColumn timestamp;
+            PackedColumn voltage;
+            PackedColumn current;
+            std::vector<uint64_t> words;
+
+            size_t bytes(void) const { return sizeof(SealedBlock) + words.capacity() * sizeof(uint64_t); }
+        };
+
+        struct ChannelHistory
+        {
+            ChannelScale scale;
+            std::vector<int64_t> activeTimestamp;  /* Active block, uncompressed */
+            std::vector<int32_t> activeVoltage;
+            std::vector<int32_t> activeCurrent;
+            std::deque<SealedBlock> sealed;        /* Oldest first */
+        };
+
+        std::vector<ChannelHistory> channelHistory;
+        std::deque<uint32_t> sealOrder;  /* Channel of every sealed block, oldest first */
+        size_t blockSamples;
+        size_t memoryCap;
+        size_t activeBytes = 0;
+        size_t sealedBytes = 0;
+        size_t evicted = 0;
+
+        void seal(size_t channel);
+        void evictOldest(void);
+        template <typename T>
+        static uint8_t deltaWidth(const T *values, size_t count);
+        template <typename T>
+        static size_t packColumn(const T *values, size_t count, uint8_t width, size_t wordOffset, PackedColumn& column,
+                                 std::vector<uint64_t>& words);
+        static void unpackColumn(const PackedColumn& column, const std::vector<uint64_t>& words, size_t count, int64_t *values);
+        void decodeBlock(const ChannelHistory& history, const SealedBlock& block, int64_t fromMs, int64_t toMs,
+                         std::vector<HistoryPoint>& points) const;
+};
+
+#endif /* COMPRESSED_HISTORY_H */
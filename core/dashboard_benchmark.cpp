@@ -0,0 +1,201 @@
+/**
+ * @file dashboard_benchmark.cpp
+ * @brief Many browser clients streaming from the web dashboard.
+ *
+ * Clients, server and publisher share one event loop, like the window and
+ * its dashboard do, so the measured timer lateness includes the cost of
+ * accepting, serializing and writing every frame to every client.
+ */
+
+#include "dashboard_benchmark.h"
+#include "web_dashboard.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QTcpSocket>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+    const int tierRates[] = {20, 10, 5, 2, 1};
+
+    /* One browser: counts the frames of its event stream */
+    struct StreamClient
+    {
+        QTcpSocket socket;
+        int rateHz = 0;
+        bool streaming = false;  /* The response header was received */
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        QByteArray tail;         /* Unterminated end of the last read */
+    };
+}
+
+/**
+ * @brief Constructor.
+ * @param clients Event streams opened.
+ * @param channels Channels published at 100 Hz.
+ * @param seconds Length of the run once every client is connected.
+ */
+DashboardBenchmark::DashboardBenchmark(int clients, int channels, double seconds)
+    : clients(std::max(clients, 1)), channels(std::max(channels, 1)), seconds(std::max(seconds, 1.0))
+{
+}
+
+/**
+ * @brief Runs the load test on the calling thread's event loop.
+ */
+DashboardLoadResult DashboardBenchmark::run(void)
+{
+    DashboardLoadResult result;
+    WebDashboard dashboard(channels);
+    std::vector<std::unique_ptr<StreamClient>> streams;
+    QTimer publisher;
+    QTimer frameTimer;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    qint64 lastFrameMs = 0;
+    uint64_t lateTicks = 0;
+    double lateSumMs = 0.0;
+    bool measuring = false;
+
+    result.clients = clients;
+    result.channels = channels;
+    if (!dashboard.start(QHostAddress::LocalHost, 0))
+        return result;
+
+    for (int k = 0; k < clients; k++)
+    {
+        std::unique_ptr<StreamClient> stream(new StreamClient);
+        StreamClient *client = stream.get();
+
+        client->rateHz = tierRates[k % (sizeof(tierRates) / sizeof(tierRates[0]))];
+        QObject::connect(&client->socket, &QTcpSocket::connected, [client] {
+            client->socket.write("GET /events?rate=" + QByteArray::number(client->rateHz) + " HTTP/1.1\r\n\r\n");
+        });
+        QObject::connect(&client->socket, &QTcpSocket::readyRead, [client, &measuring] {
+            QByteArray data = client->tail + client->socket.readAll();
+            int end = data.lastIndexOf("\n\n");
+
+            if (!client->streaming && data.contains("\r\n\r\n"))
+                client->streaming = true;
+            if (measuring)
+            {
+                client->bytes += static_cast<uint64_t>(data.size() - client->tail.size());
+                client->frames += static_cast<uint64_t>(data.left(end < 0 ? 0 : end + 2).count("data: ["));
+            }
+            client->tail = end < 0 ? data : data.mid(end + 2);
+        });
+        client->socket.connectToHost(QHostAddress::LocalHost, dashboard.serverPort());
+        streams.push_back(std::move(stream));
+    }
+
+    /* Wait until every stream is served, at most 10 s */
+    clock.start();
+    while (clock.elapsed() < 10000 && dashboard.clientCount() < clients)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    publisher.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&publisher, &QTimer::timeout, [&] {
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+        for (int channel = 0; channel < channels; channel++)
+            dashboard.publish(channel, now, 12.0 + channel * 0.001, 0.5 + (now % 1000) * 1e-4);
+        result.published += static_cast<uint64_t>(channels);
+    });
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&frameTimer, &QTimer::timeout, [&] {
+        qint64 now = clock.elapsed();
+        double late = lastFrameMs ? std::max(0.0, static_cast<double>(now - lastFrameMs - 16)) : 0.0;
+
+        result.maxTickLateMs = std::max(result.maxTickLateMs, late);
+        lateSumMs += late;
+        lateTicks++;
+        lastFrameMs = now;
+    });
+
+    measuring = true;
+    clock.restart();
+    publisher.start(10);
+    frameTimer.start(16);
+    QTimer::singleShot(static_cast<int>(seconds * 1000.0), &loop, &QEventLoop::quit);
+    loop.exec();
+    publisher.stop();
+    frameTimer.stop();
+    measuring = false;
+
+    result.seconds = clock.elapsed() / 1000.0;
+    result.connected = dashboard.clientCount();
+    result.droppedFrames = dashboard.droppedFrames();
+    result.meanTickLateMs = lateTicks ? lateSumMs / lateTicks : 0.0;
+    for (int rate : tierRates)
+    {
+        DashboardTierResult tier;
+
+        tier.rateHz = rate;
+        for (const std::unique_ptr<StreamClient>& stream : streams)
+        {
+            if (stream->rateHz != rate)
+                continue;
+            tier.clients++;
+            tier.frames += stream->frames;
+            tier.bytes += stream->bytes;
+        }
+        tier.expectedFrames = tier.clients * rate * result.seconds;
+        result.tiers.push_back(tier);
+    }
+
+    dashboard.stop();
+    for (std::unique_ptr<StreamClient>& stream : streams)
+        stream->socket.abort();
+    QCoreApplication::processEvents();
+    return result;
+}
+
+/**
+ * @brief True if every client was served, every tier got its frames and the
+ * shared event loop kept up with the window's frame rate.
+ */
+bool DashboardBenchmark::passed(const DashboardLoadResult& result)
+{
+    if (result.connected != result.clients || result.meanTickLateMs > maxMeanTickLateMs)
+        return false;
+    for (const DashboardTierResult& tier : result.tiers)
+    {
+        if (tier.clients > 0 && tier.deliveredRatio() < minDeliveredRatio)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Formats the results.
+ * @param result Result of run().
+ * @param out Text is appended here.
+ */
+void DashboardBenchmark::render(const DashboardLoadResult& result, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%d of %d clients streaming, %d channels at 100 Hz for %.1f s, %llu samples published\n",
+             result.connected, result.clients, result.channels, result.seconds,
+             static_cast<unsigned long long>(result.published));
+    out += line;
+    snprintf(line, sizeof(line), "%-8s %8s %10s %10s %10s %10s\n", "tier Hz", "clients", "frames", "expected", "delivered", "KiB/s");
+    out += line;
+    for (const DashboardTierResult& tier : result.tiers)
+    {
+        snprintf(line, sizeof(line), "%-8d %8d %10llu %10.0f %9.1f%% %10.1f\n", tier.rateHz, tier.clients,
+                 static_cast<unsigned long long>(tier.frames), tier.expectedFrames, tier.deliveredRatio() * 100.0,
+                 result.seconds > 0.0 ? tier.bytes / 1024.0 / result.seconds : 0.0);
+        out += line;
+    }
+    snprintf(line, sizeof(line), "Frames skipped for slow clients: %lld; 16 ms timer late by %.2f ms mean, %.1f ms max\n",
+             static_cast<long long>(result.droppedFrames), result.meanTickLateMs, result.maxTickLateMs);
+    out += line;
+}
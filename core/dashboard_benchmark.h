@@ -0,0 +1,58 @@
+#ifndef DASHBOARD_BENCHMARK_H
+#define DASHBOARD_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Frames received by the clients of one rate tier */
+struct DashboardTierResult
+{
+    int rateHz = 0;
+    int clients = 0;
+    uint64_t frames = 0;     /* Over all clients of the tier */
+    uint64_t bytes = 0;
+    double expectedFrames = 0.0;
+
+    double deliveredRatio(void) const { return expectedFrames > 0.0 ? frames / expectedFrames : 0.0; }
+};
+
+struct DashboardLoadResult
+{
+    int clients = 0;
+    int connected = 0;           /* Event streams the server held at the end */
+    int channels = 0;
+    double seconds = 0.0;
+    uint64_t published = 0;      /* Samples handed to the dashboard */
+    int64_t droppedFrames = 0;   /* Skipped by the server for slow clients */
+    double maxTickLateMs = 0.0;  /* Worst lateness of a 16 ms timer on the same event loop */
+    double meanTickLateMs = 0.0;
+    std::vector<DashboardTierResult> tiers;
+};
+
+/* Load test of the web dashboard: starts it on a free localhost port and
+   opens the requested number of server-sent event streams from the same
+   event loop, spread over the 20, 10, 5, 2 and 1 Hz tiers. Samples of every
+   channel are published at 100 Hz meanwhile. Each client counts the frames
+   it receives; a 16 ms timer measures how late the shared event loop runs,
+   as the window's frames would. */
+class DashboardBenchmark
+{
+    public:
+        static constexpr double minDeliveredRatio = 0.9;  /* Of the expected frames, in every tier */
+        static constexpr double maxMeanTickLateMs = 16.0; /* Mean lateness of the frame timer: under one frame */
+
+        DashboardBenchmark(int clients, int channels, double seconds);
+
+        DashboardLoadResult run(void);
+        static bool passed(const DashboardLoadResult& result);
+        static void render(const DashboardLoadResult& result, std::string& out);
+
+    private:
+        int clients;
+        int channels;
+        double seconds;
+};
+
+#endif /* DASHBOARD_BENCHMARK_H */
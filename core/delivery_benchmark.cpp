@@ -0,0 +1,220 @@
+/**
+ * @file delivery_benchmark.cpp
+ * @brief Allocations and CPU per 1000 samples delivered to the GUI thread.
+ *
+ * The producer hands samples over in 1 ms batches at the requested rate, the
+ * way a fast sampler or the engine's telemetry reader would. With queued
+ * signals every sample becomes a posted event holding a copy of its
+ * arguments; with frames the samples go to a ring and the GUI thread gets one
+ * pooled event per 16 ms frame.
+ */
+
+#include "delivery_benchmark.h"
+#include "alloc_tracker.h"
+#include "frame_event.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEventLoop>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace
+{
+    /* Frames of the benchmark: counts the samples of each span */
+    class FrameReceiver : public QObject
+    {
+        public:
+            FrameDispatcher *dispatcher = nullptr;
+            uint64_t delivered = 0;
+            uint64_t events = 0;
+            double lastCurrent = 0.0;
+
+        protected:
+            void customEvent(QEvent *event) override
+            {
+                const FrameEvent *frame;
+
+                if (event->type() != FrameEvent::frameType())
+                    return;
+                frame = static_cast<const FrameEvent*>(event);
+                for (uint64_t index = frame->begin; index < frame->end; index++)
+                    lastCurrent = dispatcher->at(index).sample.current;
+                delivered += frame->end - frame->begin;
+                events++;
+                dispatcher->finish(*frame);
+            }
+    };
+
+    /**
+     * @brief CPU time of the process, all threads, in milliseconds.
+     */
+    double processCpuMs(void)
+    {
+#if defined(_WIN32)
+        FILETIME created, exited, kernel, user;
+        ULARGE_INTEGER kernelTime, userTime;
+
+        if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user))
+            return 0.0;
+        kernelTime.LowPart = kernel.dwLowDateTime;
+        kernelTime.HighPart = kernel.dwHighDateTime;
+        userTime.LowPart = user.dwLowDateTime;
+        userTime.HighPart = user.dwHighDateTime;
+        return (kernelTime.QuadPart + userTime.QuadPart) / 1e4;  /* 100 ns units */
+#else
+        struct timespec now;
+
+        if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now) != 0)
+            return 0.0;
+        return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+#endif
+    }
+
+    /**
+     * @brief Produces the samples on a worker thread while this thread runs the event loop.
+     * @param handOver Called for every sample, on the worker thread.
+     * @param tick Called after every 1 ms batch, on the worker thread.
+     * @param drain Called once after the last sample, on the worker thread; returns when all were delivered.
+     */
+    DeliveryResult measure(const char *method, uint64_t samples, double rateHz,
+                           const std::function<void(const Sample&)>& handOver, const std::function<void(void)>& tick,
+                           const std::function<void(void)>& drain, const uint64_t& delivered, const uint64_t& events)
+    {
+        using Clock = std::chrono::steady_clock;
+        DeliveryResult result;
+        QEventLoop loop;
+        AllocationCounters before = AllocationTracker::processCounters();
+        AllocationCounters after;
+        double cpuBefore = processCpuMs();
+        Clock::time_point start = Clock::now();
+
+        std::thread producer([&] {
+            Clock::time_point next = Clock::now();
+            Sample sample;
+            double due = 0.0;
+            uint64_t produced = 0;
+
+            while (produced < samples)
+            {
+                for (due += rateHz / 1000.0; produced < samples && due >= 1.0; due -= 1.0)
+                {
+                    sample.sequence = ++produced;
+                    sample.timestampMs = QDateTime::currentMSecsSinceEpoch();
+                    sample.voltage = 5.0;
+                    sample.current = 0.001 * static_cast<double>(produced % 1000);
+                    handOver(sample);
+                }
+                tick();
+                next += std::chrono::milliseconds(1);
+                std::this_thread::sleep_until(next);
+            }
+            drain();
+
+            /* Posted after every sample event, so it is handled last */
+            QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+        });
+        loop.exec();
+        producer.join();
+
+        after = AllocationTracker::processCounters();
+        result.method = method;
+        result.samples = samples;
+        result.delivered = delivered;
+        result.events = events;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.cpuMs = processCpuMs() - cpuBefore;
+        result.allocations = after.allocations - before.allocations;
+        result.bytes = after.bytes - before.bytes;
+        return result;
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param samples Samples delivered by each run.
+ * @param rateHz Samples per second.
+ */
+DeliveryBenchmark::DeliveryBenchmark(uint64_t samples, double rateHz)
+    : samples(samples), rateHz(rateHz)
+{
+}
+
+/**
+ * @brief Delivers every sample as a queued signal, one event per sample.
+ */
+DeliveryResult DeliveryBenchmark::runSignals(void)
+{
+    SampleEmitter emitter;
+    QObject context;
+    uint64_t delivered = 0;
+    double lastCurrent = 0.0;
+
+    QObject::connect(&emitter, &SampleEmitter::sampleReady, &context,
+                     [&](int, qint64, double, double current) {
+                         lastCurrent = current;
+                         delivered++;
+                     }, Qt::QueuedConnection);
+    return measure("queued signal per sample", samples, rateHz,
+                   [&](const Sample& sample) { emit emitter.sampleReady(0, sample.timestampMs, sample.voltage, sample.current); },
+                   [] {}, [] {}, delivered, delivered);
+}
+
+/**
+ * @brief Delivers the samples through a ring, one pooled event per frame.
+ */
+DeliveryResult DeliveryBenchmark::runFrames(void)
+{
+    FrameReceiver receiver;
+    FrameDispatcher dispatcher(&receiver);
+
+    receiver.dispatcher = &dispatcher;
+    return measure("pooled event per frame", samples, rateHz,
+                   [&](const Sample& sample) { dispatcher.push(0, sample); },
+                   [&] { dispatcher.flush(); },
+                   [&] {
+                       while (!dispatcher.idle())
+                       {
+                           dispatcher.flush();
+                           std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                       }
+                   }, receiver.delivered, receiver.events);
+}
+
+/**
+ * @brief Formats the results, per 1000 delivered samples.
+ * @param results Results of the runs.
+ * @param out Text is appended here.
+ */
+void DeliveryBenchmark::render(const std::vector<DeliveryResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-26s %9s %9s %8s %13s %12s %13s\n",
+             "method", "samples", "delivered", "events", "CPU ms / 1k", "allocs / 1k", "bytes / 1k");
+    out += line;
+    for (const DeliveryResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-26s %9llu %9llu %8llu %13.3f ", result.method.c_str(),
+                 static_cast<unsigned long long>(result.samples), static_cast<unsigned long long>(result.delivered),
+                 static_cast<unsigned long long>(result.events), result.per1k(result.cpuMs));
+        out += line;
+        if (AllocationTracker::enabled())
+            snprintf(line, sizeof(line), "%12.1f %13.0f\n", result.per1k(static_cast<double>(result.allocations)),
+                     result.per1k(static_cast<double>(result.bytes)));
+        else
+            snprintf(line, sizeof(line), "%12s %13s\n", "n/a", "n/a");
+        out += line;
+    }
+    if (!AllocationTracker::enabled())
+        out += "Allocations are counted in builds configured with PS_TRACK_ALLOCATIONS\n";
+    snprintf(line, sizeof(line), "Frame events in flight at once: at most %zu of %zu pooled; postponed for an empty pool: %llu\n",
+             FrameEvent::poolHighWater(), FrameEvent::poolSlots, static_cast<unsigned long long>(FrameEvent::poolExhausted()));
+    out += line;
+}
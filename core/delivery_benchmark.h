@@ -0,0 +1,53 @@
+#ifndef DELIVERY_BENCHMARK_H
+#define DELIVERY_BENCHMARK_H
+
+#include <QObject>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Cost of one way of getting samples from a worker thread to the GUI thread */
+struct DeliveryResult
+{
+    std::string method;
+    uint64_t samples = 0;
+    uint64_t delivered = 0;      /* Samples the GUI thread saw */
+    uint64_t events = 0;         /* Events the GUI thread handled for them */
+    double seconds = 0.0;
+    double cpuMs = 0.0;          /* Process CPU time, both threads */
+    uint64_t allocations = 0;    /* Process heap allocations; PS_TRACK_ALLOCATIONS builds only */
+    uint64_t bytes = 0;
+
+    double per1k(double total) const { return delivered ? total * 1000.0 / delivered : 0.0; }
+};
+
+/* Queued signal carrying one sample, as the worker used to emit them */
+class SampleEmitter : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void sampleReady(int channel, qint64 timestampMs, double voltage, double current);
+};
+
+/* Delivers the same sample stream to the GUI thread twice: as one queued
+   signal per sample, and as one pooled frame event per 16 ms frame pointing
+   into a ring. A worker thread produces the samples at a fixed rate while the
+   calling thread runs the event loop; CPU time and, in allocation tracking
+   builds, heap allocations of the whole process are measured around each run. */
+class DeliveryBenchmark
+{
+    public:
+        DeliveryBenchmark(uint64_t samples, double rateHz);
+
+        DeliveryResult runSignals(void);
+        DeliveryResult runFrames(void);
+        static void render(const std::vector<DeliveryResult>& results, std::string& out);
+
+    private:
+        uint64_t samples;
+        double rateHz;
+};
+
+#endif /* DELIVERY_BENCHMARK_H */
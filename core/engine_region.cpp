@@ -0,0 +1,170 @@
+/**
+ * @file engine_region.cpp
+ * @brief Shared memory between the instrument engine process and its GUI clients.
+ *
+ * Nothing here takes a lock or waits: a client that hangs, crashes or is
+ * restarted never holds anything the engine needs, and the engine going
+ * away is seen by clients as a heartbeat that stops advancing.
+ */
+
+#include "engine_region.h"
+#include <new>
+
+/**
+ * @brief Builds an empty region in freshly mapped or stale memory.
+ * The magic number is stored last, so clients polling valid() never see a
+ * half initialized region.
+ * @param memory Start of the mapping, at least sizeof(EngineRegion) bytes.
+ * @param sessionId Identifies this engine run; clients restart their cursors when it changes.
+ * @param processId Engine process id, reported to clients.
+ * @param nowMs Wall clock in milliseconds since the epoch.
+ * @return The region.
+ */
+EngineRegion* EngineRegion::initialize(void *memory, uint64_t sessionId, int64_t processId, int64_t nowMs)
+{
+    EngineRegion *region = static_cast<EngineRegion*>(memory);
+
+    region->magic.store(0, std::memory_order_release);
+    region = new (memory) EngineRegion();
+    region->version.store(layoutVersion, std::memory_order_relaxed);
+    region->session.store(sessionId, std::memory_order_relaxed);
+    region->pid.store(processId, std::memory_order_relaxed);
+    region->heartbeatMs.store(nowMs, std::memory_order_relaxed);
+    region->state.store(EngineState());
+    region->magic.store(magicValue, std::memory_order_release);
+    return region;
+}
+
+/**
+ * @brief Appends a sample to the telemetry ring, overwriting the oldest one when full.
+ * @param channel Output the sample belongs to.
+ * @param sample Raw reading with its sequence and quality.
+ */
+void EngineRegion::publish(int channel, const Sample& sample)
+{
+    uint64_t head = telemetryHead.load(std::memory_order_relaxed);
+    EngineSample entry;
+
+    entry.index = head;
+    entry.channel = channel;
+    entry.sample = sample;
+    telemetry[head % telemetrySlots].store(entry);
+    telemetryHead.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Takes the oldest queued command.
+ * @param command Filled with the command.
+ * @return False when the queue is empty.
+ */
+bool EngineRegion::nextCommand(EngineCommand& command)
+{
+    uint64_t tail = commandTail.load(std::memory_order_relaxed);
+
+    if (tail == commandHead.load(std::memory_order_acquire))
+        return false;
+    command = commands[tail % commandSlots];
+    commandTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Publishes the answer to a command in the reply slot of its id.
+ */
+void EngineRegion::reply(const EngineReply& answer)
+{
+    replies[answer.id % commandSlots].store(answer);
+}
+
+/**
+ * @brief Tells whether an engine finished initializing the region with this layout.
+ */
+bool EngineRegion::valid(void) const
+{
+    return magic.load(std::memory_order_acquire) == magicValue &&
+           version.load(std::memory_order_relaxed) == layoutVersion;
+}
+
+/**
+ * @brief Tells whether the engine ran its loop recently.
+ * @param nowMs Wall clock in milliseconds since the epoch.
+ */
+bool EngineRegion::engineAlive(int64_t nowMs) const
+{
+    return valid() && nowMs - heartbeatMs.load(std::memory_order_relaxed) < heartbeatTimeoutMs;
+}
+
+/**
+ * @brief Makes the caller the owner of the command ring.
+ * A previous owner's submissions fail from now on.
+ * @return Token to pass to submit().
+ */
+uint64_t EngineRegion::attachClient(void)
+{
+    return clientToken.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+/**
+ * @brief Queues a command.
+ * @param token Token of attachClient().
+ * @param command Command to queue; its id is assigned here.
+ * @return False when the queue is full or another client attached since.
+ */
+bool EngineRegion::submit(uint64_t token, EngineCommand& command)
+{
+    uint64_t head = commandHead.load(std::memory_order_relaxed);
+
+    if (clientToken.load(std::memory_order_acquire) != token)
+        return false;
+    if (head - commandTail.load(std::memory_order_acquire) >= commandSlots)
+        return false;
+    command.id = head + 1;
+    commands[head % commandSlots] = command;
+    commandHead.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Reads the answer to a command.
+ * @param id Id assigned by submit().
+ * @param answer Filled with the answer.
+ * @return False while the engine has not answered it yet.
+ */
+bool EngineRegion::replyFor(uint64_t id, EngineReply& answer) const
+{
+    return replies[id % commandSlots].load(answer) && answer.id == id;
+}
+
+/**
+ * @brief Reads the samples published since the cursor.
+ * A reader more than a ring behind skips to the oldest sample still held;
+ * slots overwritten while being read are skipped too. Both count as lost.
+ * @param cursor Stream index of the next sample to read; advanced.
+ * @param samples Filled with up to capacity samples, oldest first.
+ * @param capacity Size of samples.
+ * @param lost Increased by the samples the reader will never see.
+ * @return Number of samples read.
+ */
+size_t EngineRegion::readTelemetry(uint64_t& cursor, EngineSample *samples, size_t capacity, uint64_t& lost) const
+{
+    uint64_t head = telemetryHead.load(std::memory_order_acquire);
+    size_t count = 0;
+
+    if (cursor > head)
+        cursor = head;  /* A new engine restarted the stream */
+    if (head - cursor > telemetrySlots)
+    {
+        lost += head - telemetrySlots - cursor;
+        cursor = head - telemetrySlots;
+    }
+
+    while (cursor < head && count < capacity)
+    {
+        if (telemetry[cursor % telemetrySlots].load(samples[count]) && samples[count].index == cursor)
+            count++;
+        else
+            lost++;
+        cursor++;
+    }
+    return count;
+}
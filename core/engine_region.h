@@ -0,0 +1,165 @@
+#ifndef ENGINE_REGION_H
+#define ENGINE_REGION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sample.h"
+
+/* The region is mapped by two processes: every field shared between them
+   must be an address-free lock-free atomic, or be guarded by one */
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free in shared memory");
+
+/* Sequence-locked copy of a trivially copyable value with a single writer.
+   The value is stored as relaxed atomic words, so a read racing the writer
+   is detected and retried instead of being a data race. A writer that dies
+   mid-update leaves the sequence odd; reads then fail instead of spinning */
+template <typename T>
+class SeqBox
+{
+    public:
+        void store(const T& value)
+        {
+            uint64_t words[wordCount] = {};
+            uint32_t seq = sequence.load(std::memory_order_relaxed);
+
+            std::memcpy(words, &value, sizeof(T));
+            sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < wordCount; i++)
+                data[i].store(words[i], std::memory_order_relaxed);
+            sequence.store(seq + 2, std::memory_order_release);
+        }
+
+        bool load(T& value) const
+        {
+            uint64_t words[wordCount];
+
+            for (int attempt = 0; attempt < 64; attempt++)
+            {
+                uint32_t before = sequence.load(std::memory_order_acquire);
+                if (before & 1)
+                    continue;
+                for (size_t i = 0; i < wordCount; i++)
+                    words[i] = data[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before)
+                {
+                    std::memcpy(&value, words, sizeof(T));
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static constexpr size_t wordCount = (sizeof(T) + 7) / 8;
+        std::atomic<uint32_t> sequence{0};   /* Odd while the writer updates the words */
+        std::atomic<uint64_t> data[wordCount] = {};
+};
+
+/* Published by the engine after every sample and state change */
+struct EngineState
+{
+    int64_t updatedMs = 0;
+    uint64_t samples = 0;          /* Sampler iterations */
+    uint64_t statusChanges = 0;    /* Status reports; a reader compares counts to see every change */
+    uint64_t protectionTrips = 0;
+    double protectionCurrent = 0.0;  /* Raw reading of the last trip */
+    double protectionLimit = 0.0;    /* Amperes, 0 when protection is off */
+    int32_t protectionChannel = 0;
+    int32_t channels = 1;
+    int32_t sampleTimeMs = 1000;
+    int32_t error = 0;             /* Oldest instrument error of the last status report */
+    uint16_t questionable = 0;     /* Questionable events of the last status report */
+    bool linkUp = false;
+    bool output = false;           /* Output 1, from the last status report or trip */
+    char port[32] = {};
+};
+
+/* One sample of one output, numbered in the engine's telemetry stream */
+struct EngineSample
+{
+    uint64_t index = 0;   /* Position in the stream; tells a slot's generations apart */
+    int32_t channel = 0;
+    Sample sample;
+};
+
+enum class EngineOp : uint32_t
+{
+    WRITE = 1,      /* Program message; one holding a query is answered in the same turn */
+    CLEAR,          /* Discard unread instrument output */
+    OPEN,           /* data: port; reopens only when it differs from the engine's */
+    SAMPLE_TIME,    /* value: milliseconds */
+    STATUS_WATCH,   /* value: samples per status check, 1 for every sample, 0 for none */
+    PROTECTION,     /* value: current limit in amperes, 0 to disable */
+    SHUTDOWN
+};
+
+static constexpr size_t engineMessageBytes = 512;
+
+struct EngineCommand
+{
+    uint64_t id = 0;
+    EngineOp op = EngineOp::WRITE;
+    uint32_t size = 0;
+    double value = 0.0;
+    bool expectReply = false;
+    char data[engineMessageBytes] = {};
+};
+
+struct EngineReply
+{
+    uint64_t id = 0;
+    int32_t status = 0;   /* ViStatus of the command */
+    uint32_t size = 0;
+    char data[engineMessageBytes] = {};
+};
+
+/* Shared memory between the instrument engine and the GUI.
+   The engine is the only writer of the state and the telemetry ring and
+   never waits for a reader: the ring overwrites its oldest samples and a
+   reader that falls behind learns how many it lost from the stream index.
+   Commands go through a single-producer ring answered in a reply slot per
+   command id. The latest client to attach owns the command ring, so a GUI
+   restarted after a hang takes over at once; any number may read. */
+struct EngineRegion
+{
+    static constexpr const char *sharedMemoryKey = "powerSupplyEngine";
+    static constexpr uint32_t magicValue = 0x50534547;  /* "PSEG" */
+    static constexpr uint32_t layoutVersion = 1;
+    static constexpr size_t telemetrySlots = 1024;
+    static constexpr size_t commandSlots = 16;
+    static constexpr int64_t heartbeatTimeoutMs = 5000;  /* Longer than a read timeout plus a reconnect */
+
+    std::atomic<uint32_t> magic{0};      /* Stored last by initialize() */
+    std::atomic<uint32_t> version{0};
+    std::atomic<uint64_t> session{0};    /* Start time of the engine owning the region */
+    std::atomic<int64_t> heartbeatMs{0}; /* Wall clock of the engine's last loop */
+    std::atomic<int64_t> pid{0};
+    std::atomic<uint64_t> clientToken{0};
+    SeqBox<EngineState> state;
+    std::atomic<uint64_t> telemetryHead{0};  /* Samples ever published */
+    SeqBox<EngineSample> telemetry[telemetrySlots];
+    std::atomic<uint64_t> commandHead{0};    /* Written by the client */
+    std::atomic<uint64_t> commandTail{0};    /* Written by the engine */
+    EngineCommand commands[commandSlots];
+    SeqBox<EngineReply> replies[commandSlots];
+
+    /* Engine side */
+    static EngineRegion* initialize(void *memory, uint64_t sessionId, int64_t processId, int64_t nowMs);
+    void publish(int channel, const Sample& sample);
+    bool nextCommand(EngineCommand& command);
+    void reply(const EngineReply& answer);
+
+    /* Client side */
+    bool valid(void) const;
+    bool engineAlive(int64_t nowMs) const;
+    uint64_t attachClient(void);
+    bool submit(uint64_t token, EngineCommand& command);
+    bool replyFor(uint64_t id, EngineReply& answer) const;
+    size_t readTelemetry(uint64_t& cursor, EngineSample *samples, size_t capacity, uint64_t& lost) const;
+};
+
+#endif /* ENGINE_REGION_H */
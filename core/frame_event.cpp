@@ -0,0 +1,144 @@
+/**
+ * @file frame_event.cpp
+ * @brief Per-frame delivery of samples from the worker thread to the GUI thread.
+ *
+ * A queued signal costs the GUI one event per sample, and Qt allocates the
+ * event and a copy of the arguments for each. Here the samples stay in a
+ * ring allocated once and the GUI gets one pooled event per frame pointing
+ * at the part of the ring it has not seen.
+ */
+
+#include "frame_event.h"
+#include "message_pool.h"
+#include <QCoreApplication>
+
+namespace
+{
+    MessagePool<FrameEvent, FrameEvent::poolSlots>& framePool(void)
+    {
+        static MessagePool<FrameEvent, FrameEvent::poolSlots> pool;
+        return pool;
+    }
+}
+
+/**
+ * @brief Constructor. Use create(), which takes the memory from the pool.
+ */
+FrameEvent::FrameEvent(FrameDispatcher *dispatcher, uint64_t begin, uint64_t end)
+    : QEvent(frameType()), dispatcher(dispatcher), begin(begin), end(end)
+{
+}
+
+/**
+ * @brief Event type of frames, registered with Qt on first use.
+ */
+QEvent::Type FrameEvent::frameType(void)
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+/**
+ * @brief Builds a frame event in a pool block.
+ * @return The event, or nullptr when every block is in use.
+ */
+FrameEvent* FrameEvent::create(FrameDispatcher *dispatcher, uint64_t begin, uint64_t end)
+{
+    void *block = framePool().allocate();
+
+    if (block == nullptr)
+        return nullptr;
+    return new (block) FrameEvent(dispatcher, begin, end);
+}
+
+/**
+ * @brief Returns the block of a deleted event to the pool.
+ */
+void FrameEvent::operator delete(void *memory)
+{
+    framePool().deallocate(memory);
+}
+
+/**
+ * @brief Returns the block when the constructor throws.
+ */
+void FrameEvent::operator delete(void *memory, void *where)
+{
+    (void)where;
+    framePool().deallocate(memory);
+}
+
+/**
+ * @brief Most events in flight at once since start.
+ */
+size_t FrameEvent::poolHighWater(void)
+{
+    return framePool().highWater();
+}
+
+/**
+ * @brief Frames postponed because the pool was empty.
+ */
+uint64_t FrameEvent::poolExhausted(void)
+{
+    return framePool().exhausted();
+}
+
+/**
+ * @brief Constructor.
+ * @param receiver Object of the GUI thread that gets the frames.
+ * @param slots Samples the GUI may fall behind by before new ones are dropped.
+ * @param frameMs Shortest time between frames.
+ */
+FrameDispatcher::FrameDispatcher(QObject *receiver, size_t slots, int frameMs)
+    : receiver(receiver), ring(slots), frameTime(std::chrono::milliseconds(frameMs)),
+      lastFrame(std::chrono::steady_clock::now() - std::chrono::milliseconds(frameMs))
+{
+}
+
+/**
+ * @brief Posts the samples pushed since the last frame, when a frame is due.
+ * Worker thread only. Nothing is posted while the previous frame is being
+ * handled, before the frame time has passed, or when the pool is empty; the
+ * samples then go with a later frame.
+ * @return True when a frame was posted.
+ */
+bool FrameDispatcher::flush(void)
+{
+    uint64_t end = ring.written();
+    std::chrono::steady_clock::time_point now;
+    FrameEvent *event;
+
+    if (end == posted || pending.load(std::memory_order_acquire))
+        return false;
+    now = std::chrono::steady_clock::now();
+    if (now - lastFrame < frameTime)
+        return false;
+    event = FrameEvent::create(this, posted, end);
+    if (event == nullptr)
+        return false;
+
+    pending.store(true, std::memory_order_relaxed);
+    QCoreApplication::postEvent(receiver, event);
+    posted = end;
+    lastFrame = now;
+    frameCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Tells whether every pushed sample was posted and handled. Worker thread only.
+ */
+bool FrameDispatcher::idle(void) const
+{
+    return posted == ring.written() && !pending.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Frees the span of a handled frame and allows the next one. GUI thread only.
+ */
+void FrameDispatcher::finish(const FrameEvent& event)
+{
+    ring.release(event.end);
+    pending.store(false, std::memory_order_release);
+}
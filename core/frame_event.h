@@ -0,0 +1,74 @@
+#ifndef FRAME_EVENT_H
+#define FRAME_EVENT_H
+
+#include <QEvent>
+#include <QObject>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "frame_ring.h"
+
+class FrameDispatcher;
+
+/* Posted to the GUI thread once per frame. It carries no samples, only the
+   span of the dispatcher's ring written since the previous frame. Events come
+   from a fixed pool: Qt deletes a delivered or discarded event with delete,
+   and the class operator delete hands the block back. */
+class FrameEvent : public QEvent
+{
+    public:
+        static constexpr size_t poolSlots = 32;
+
+        FrameEvent(FrameDispatcher *dispatcher, uint64_t begin, uint64_t end);
+
+        static QEvent::Type frameType(void);
+        static FrameEvent* create(FrameDispatcher *dispatcher, uint64_t begin, uint64_t end);
+        static size_t poolHighWater(void);
+        static uint64_t poolExhausted(void);
+
+        static void* operator new(size_t size, void *where) { (void)size; return where; }
+        static void operator delete(void *memory);
+        static void operator delete(void *memory, void *where);
+
+        FrameDispatcher *dispatcher;
+        uint64_t begin;  /* First ring index of the frame */
+        uint64_t end;    /* One past the last */
+};
+
+/* Hands samples from the worker thread to a GUI object, one event per frame.
+   The worker pushes every sample into the ring and calls flush() after each
+   sampler iteration; a frame is posted when the previous one was handled and
+   the frame time has passed, so the GUI sees one event per frame however
+   fast the samples come, and a GUI that falls behind gets fewer, larger
+   frames. Samples pushed while the ring is full are dropped and counted. The
+   receiver handles FrameEvent::frameType() in customEvent(), reads the span
+   with at() and ends with finish(). */
+class FrameDispatcher
+{
+    public:
+        explicit FrameDispatcher(QObject *receiver, size_t slots = 4096, int frameMs = 16);
+
+        /* Worker side */
+        bool push(int channel, const Sample& sample) { return ring.push(channel, sample); }
+        bool flush(void);
+        bool idle(void) const;
+
+        /* GUI side */
+        const FrameSample& at(uint64_t index) const { return ring.at(index); }
+        void finish(const FrameEvent& event);
+
+        uint64_t frames(void) const { return frameCount.load(std::memory_order_relaxed); }
+        uint64_t dropped(void) const { return ring.dropped(); }
+
+    private:
+        QObject *receiver;
+        FrameRing ring;
+        std::chrono::steady_clock::duration frameTime;
+        std::chrono::steady_clock::time_point lastFrame;  /* Worker side only */
+        uint64_t posted = 0;                     /* End of the last posted span, worker side only */
+        std::atomic<bool> pending{false};        /* A frame is posted and not finished */
+        std::atomic<uint64_t> frameCount{0};
+};
+
+#endif /* FRAME_EVENT_H */
@@ -0,0 +1,49 @@
+/**
+ * @file frame_ring.cpp
+ * @brief Sample ring between the worker thread and the GUI thread.
+ */
+
+#include "frame_ring.h"
+#include "alloc_tracker.h"
+
+namespace
+{
+    size_t powerOfTwoAtLeast(size_t value)
+    {
+        size_t size = 16;
+
+        while (size < value)
+            size <<= 1;
+        return size;
+    }
+}
+
+/**
+ * @brief Constructor. The ring is allocated here, once.
+ * @param slots Samples held; rounded up to a power of two.
+ */
+FrameRing::FrameRing(size_t slots)
+    : slots(powerOfTwoAtLeast(slots)), mask(powerOfTwoAtLeast(slots) - 1)
+{
+}
+
+/**
+ * @brief Appends a sample. Producer thread only.
+ * @return False when the ring is full; the sample is counted as dropped.
+ */
+bool FrameRing::push(int channel, const Sample& sample)
+{
+    PS_ZERO_ALLOCATION_PROBE("frames.push");
+    uint64_t index = head.load(std::memory_order_relaxed);
+    FrameSample& slot = slots[index & mask];
+
+    if (index - tail.load(std::memory_order_acquire) >= slots.size())
+    {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    slot.channel = channel;
+    slot.sample = sample;
+    head.store(index + 1, std::memory_order_release);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "sample.h"
+
+/* One sample of one output on its way to the GUI thread */
+struct FrameSample
+{
+    int32_t channel = 0;
+    Sample sample;
+};
+
+/* Single-producer single-consumer ring of samples addressed by stream index.
+   The producer appends; the consumer reads any index between the released
+   end and what was written, and releases what it has read in one step. A
+   full ring rejects new samples instead of overwriting unread ones, so a
+   span handed to the consumer stays valid until it releases it. */
+class FrameRing
+{
+    public:
+        explicit FrameRing(size_t slots = 4096);
+
+        bool push(int channel, const Sample& sample);
+        uint64_t written(void) const { return head.load(std::memory_order_acquire); }
+        const FrameSample& at(uint64_t index) const { return slots[index & mask]; }
+        void release(uint64_t end) { tail.store(end, std::memory_order_release); }
+
+        size_t capacity(void) const { return slots.size(); }
+        uint64_t dropped(void) const { return droppedCount.load(std::memory_order_relaxed); }
+
+    private:
+        std::vector<FrameSample> slots;
+        uint64_t mask;
+        std::atomic<uint64_t> head{0};          /* Written by the producer */
+        std::atomic<uint64_t> tail{0};          /* Released by the consumer */
+        std::atomic<uint64_t> droppedCount{0};  /* Rejected because the consumer was a full ring behind */
+};
+
+#endif /* FRAME_RING_H */
@@ -0,0 +1,152 @@
+/**
+ * @file gap_tracker.cpp
+ * @brief Gap detection and latency accounting of sequenced sample streams.
+ *
+ * Every sample carries a sequence number and quality flags. A channel is in a
+ * gap from the first flagged or missing sample until the next good one; the
+ * gap is measured between the good samples on either side, which is also the
+ * span over which no energy can be integrated.
+ */
+
+#include "gap_tracker.h"
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels.
+ * @param historyPerChannel Closed gaps kept per channel for recentGaps().
+ */
+GapTracker::GapTracker(size_t channels, size_t historyPerChannel)
+    : states(channels), historyPerChannel(historyPerChannel)
+{
+}
+
+/**
+ * @brief Accounts one received sample.
+ * @param channel Channel number.
+ * @param sample Sample as produced by the sampler.
+ * @param closed Receives the gap closed by this sample, may be nullptr.
+ * @return True if the sample closed a gap.
+ */
+bool GapTracker::record(size_t channel, const Sample& sample, GapRecord *closed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ChannelState& state = states[channel];
+    ChannelGapReport& report = state.report;
+    uint64_t lost = 0;
+
+    if (state.hasSequence && sample.sequence <= state.lastSequence)
+    {
+        report.reordered++;
+        return false;
+    }
+    if (state.hasSequence)
+        lost = sample.sequence - state.lastSequence - 1;
+    state.hasSequence = true;
+    state.lastSequence = sample.sequence;
+
+    report.samples++;
+    report.lost += lost;
+    if (sample.quality & SAMPLE_TIMEOUT)
+        report.timeouts++;
+    if (sample.quality & SAMPLE_PARSE_ERROR)
+        report.parseErrors++;
+    if (sample.quality & SAMPLE_IO_ERROR)
+        report.ioErrors++;
+    if (sample.quality & SAMPLE_RECONNECTING)
+        report.reconnecting++;
+
+    if (sample.quality == SAMPLE_PREDICTED && lost == 0)
+    {
+        report.predicted++;
+        if (report.inGap)
+            state.open.lastSequence = sample.sequence;
+        return false;
+    }
+
+    /* Open a gap at the first sample that is missing or not good */
+    if (!report.inGap && (lost != 0 || !sample.good()))
+    {
+        state.open = GapRecord();
+        state.open.firstSequence = sample.sequence - lost;
+        state.open.startMs = report.good ? state.lastGoodMs : sample.timestampMs;
+        report.inGap = true;
+    }
+    if (report.inGap)
+    {
+        state.open.lostSamples += lost;
+        state.open.causes |= sample.quality;
+        state.open.lastSequence = sample.good() ? sample.sequence - 1 : sample.sequence;
+    }
+
+    if (!sample.good())
+        return false;
+
+    /* Good sample: latency figures and gap closing */
+    report.minLatencyUs = report.good ? std::min(report.minLatencyUs, sample.latencyUs) : sample.latencyUs;
+    report.maxLatencyUs = std::max(report.maxLatencyUs, sample.latencyUs);
+    report.sumLatencyUs += sample.latencyUs;
+    report.good++;
+    state.lastGoodMs = sample.timestampMs;
+
+    if (!report.inGap)
+        return false;
+
+    state.open.endMs = sample.timestampMs;
+    report.inGap = false;
+    report.gaps++;
+    report.gapMs += state.open.durationMs();
+    report.longestGapMs = std::max(report.longestGapMs, state.open.durationMs());
+    state.history.push_back(state.open);
+    if (state.history.size() > historyPerChannel)
+        state.history.pop_front();
+    if (closed)
+        *closed = state.open;
+    return true;
+}
+
+/**
+ * @brief Returns a copy of the figures of a channel.
+ */
+ChannelGapReport GapTracker::report(size_t channel) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return states[channel].report;
+}
+
+/**
+ * @brief Returns the most recent closed gaps of a channel, oldest first.
+ */
+std::vector<GapRecord> GapTracker::recentGaps(size_t channel) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<GapRecord>(states[channel].history.begin(), states[channel].history.end());
+}
+
+/**
+ * @brief Renders a human readable report, one line per channel.
+ * @param out The report is appended here.
+ */
+void GapTracker::render(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    char line[352];
+
+    for (size_t ch = 0; ch < states.size(); ch++)
+    {
+        const ChannelGapReport& report = states[ch].report;
+        snprintf(line, sizeof(line),
+                 "channel %u: samples %llu good %llu lost %llu timeouts %llu parse errors %llu io errors %llu "
+                 "reconnecting %llu predicted %llu | gaps %llu total %.3f s longest %.3f s%s | latency mean %.2f ms min %.2f ms max %.2f ms\n",
+                 static_cast<unsigned>(ch),
+                 static_cast<unsigned long long>(report.samples), static_cast<unsigned long long>(report.good),
+                 static_cast<unsigned long long>(report.lost), static_cast<unsigned long long>(report.timeouts),
+                 static_cast<unsigned long long>(report.parseErrors), static_cast<unsigned long long>(report.ioErrors),
+                 static_cast<unsigned long long>(report.reconnecting), static_cast<unsigned long long>(report.predicted),
+                 static_cast<unsigned long long>(report.gaps),
+                 report.gapMs / 1000.0, report.longestGapMs / 1000.0, report.inGap ? " (in gap)" : "",
+                 report.meanLatencyMs(), report.minLatencyUs / 1000.0, report.maxLatencyUs / 1000.0);
+        out += line;
+    }
+}
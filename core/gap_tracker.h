@@ -0,0 +1,80 @@
+#ifndef GAP_TRACKER_H
+#define GAP_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "sample.h"
+
+/* A span without good samples, bounded by the good samples around it */
+struct GapRecord
+{
+    uint64_t firstSequence = 0;  /* First sequence number not delivered as good */
+    uint64_t lastSequence = 0;   /* Last one */
+    int64_t startMs = 0;         /* Timestamp of the good sample before the gap */
+    int64_t endMs = 0;           /* Timestamp of the good sample closing it, 0 while open */
+    uint8_t causes = 0;          /* SampleQuality flags seen, SAMPLE_GOOD for lost samples only */
+    uint64_t lostSamples = 0;    /* Sequence numbers never received */
+
+    int64_t durationMs(void) const { return endMs - startMs; }
+};
+
+/* Per-channel gap and latency figures since the tracker was created */
+struct ChannelGapReport
+{
+    uint64_t samples = 0;         /* Samples received, good or flagged */
+    uint64_t good = 0;
+    uint64_t timeouts = 0;
+    uint64_t parseErrors = 0;
+    uint64_t ioErrors = 0;
+    uint64_t reconnecting = 0;
+    uint64_t predicted = 0;       /* Ticks served by the poll model instead of a read */
+    uint64_t lost = 0;            /* Sequence numbers skipped between received samples */
+    uint64_t reordered = 0;       /* Samples older than the newest one, ignored */
+    uint64_t gaps = 0;            /* Closed gaps */
+    int64_t gapMs = 0;            /* Total duration of closed gaps */
+    int64_t longestGapMs = 0;
+    bool inGap = false;           /* A gap is open right now */
+    uint32_t minLatencyUs = 0;    /* Of good samples */
+    uint32_t maxLatencyUs = 0;
+    uint64_t sumLatencyUs = 0;
+
+    double meanLatencyMs(void) const { return good ? sumLatencyUs / 1000.0 / good : 0.0; }
+};
+
+/* Detects gaps in per-channel sample streams.
+   A gap opens at the first flagged sample or skipped sequence number after
+   a good sample and closes at the next good sample. Predicted samples are
+   planned skips of the read and neither open nor close a gap. The sampler and the
+   consumers may run on different threads; all members lock. */
+class GapTracker
+{
+    public:
+        explicit GapTracker(size_t channels, size_t historyPerChannel = 32);
+
+        size_t channels(void) const { return states.size(); }
+        bool record(size_t channel, const Sample& sample, GapRecord *closed = nullptr);
+        ChannelGapReport report(size_t channel) const;
+        std::vector<GapRecord> recentGaps(size_t channel) const;
+        void render(std::string& out) const;
+
+    private:
+        struct ChannelState
+        {
+            ChannelGapReport report;
+            bool hasSequence = false;
+            uint64_t lastSequence = 0;
+            int64_t lastGoodMs = 0;
+            GapRecord open;
+            std::deque<GapRecord> history;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<ChannelState> states;
+        size_t historyPerChannel;
+};
+
+#endif /* GAP_TRACKER_H */
@@ -0,0 +1,131 @@
+/**
+ * @file history_benchmark.cpp
+ * @brief Memory bound and frame budget of the compressed in-RAM history.
+ *
+ * The capture wanders slowly around a setpoint the way supply readings do,
+ * with an occasional load step, so the blocks pack the way real ones would.
+ */
+
+#include "history_benchmark.h"
+#include "compressed_history.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param hours Capture length.
+ * @param channels Number of channels.
+ * @param memoryCapBytes Cap of the history.
+ * @param plotPoints Point budget of each query, one per plot pixel.
+ * @param passes Queries of each window; the fastest counts.
+ */
+HistoryBenchmark::HistoryBenchmark(double hours, size_t channels, size_t memoryCapBytes, size_t plotPoints, unsigned passes)
+    : hours(std::max(hours, 0.01)), channels(std::max<size_t>(channels, 1)), memoryCapBytes(memoryCapBytes),
+      plotPoints(std::max<size_t>(plotPoints, 1)), passes(std::max(passes, 1u))
+{
+}
+
+/**
+ * @brief Fills the history and queries it.
+ */
+HistoryBenchmarkResult HistoryBenchmark::run(void)
+{
+    const int64_t startMs = 1700000000000LL;
+    const int64_t periodMs = 10;
+    const uint64_t samplesPerChannel = static_cast<uint64_t>(hours * 3600.0 * 1000.0 / periodMs);
+    const struct { const char *name; int64_t ms; } windows[] = {
+        {"1 min", 60LL * 1000}, {"1 h", 3600LL * 1000}, {"24 h", 24LL * 3600 * 1000}};
+    HistoryBenchmarkResult result;
+    CompressedHistory history(channels, memoryCapBytes);
+    std::vector<int64_t> voltageCounts(channels, 12000000);
+    std::vector<int64_t> currentCounts(channels, 1500000);
+    std::vector<HistoryPoint> points;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    std::chrono::steady_clock::time_point start;
+    int64_t newestMs = startMs + static_cast<int64_t>(samplesPerChannel - 1) * periodMs;
+
+    result.memoryCapBytes = memoryCapBytes;
+    start = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < samplesPerChannel; n++)
+    {
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            voltageCounts[channel] += static_cast<int64_t>((state >> 33) % 21) - 10;
+            currentCounts[channel] += static_cast<int64_t>((state >> 40) % 201) - 100;
+            if ((state >> 56) == 0)
+                currentCounts[channel] = 500000 + static_cast<int64_t>((state >> 20) % 2000000);  /* Load step */
+            history.append(channel, startMs + static_cast<int64_t>(n) * periodMs, voltageCounts[channel] * 1e-6,
+                           currentCounts[channel] * 1e-6);
+        }
+        result.appended += channels;
+
+        /* The footprint only changes when a block is sealed */
+        if ((n + 1) % 1024 == 0)
+            result.highWaterBytes = std::max(result.highWaterBytes, history.stats().memoryBytes);
+    }
+    result.fillMs = elapsedMs(start);
+
+    HistoryStats stats = history.stats();
+    result.retained = stats.samples;
+    result.memoryBytes = stats.memoryBytes;
+    result.highWaterBytes = std::max(result.highWaterBytes, stats.memoryBytes);
+    result.evictedBlocks = stats.evictedBlocks;
+    result.retainedHours = (newestMs - history.oldestTimestampMs(0)) / 3600000.0;
+
+    for (const auto& window : windows)
+    {
+        HistoryWindowResult windowResult;
+
+        windowResult.window = window.name;
+        windowResult.windowMs = window.ms;
+        for (unsigned pass = 0; pass < passes; pass++)
+        {
+            double queryMs;
+
+            start = std::chrono::steady_clock::now();
+            windowResult.points = history.query(0, newestMs - window.ms, newestMs, points, plotPoints);
+            queryMs = elapsedMs(start);
+            windowResult.queryMs = pass == 0 ? queryMs : std::min(windowResult.queryMs, queryMs);
+        }
+        result.windows.push_back(windowResult);
+    }
+    return result;
+}
+
+/**
+ * @brief Formats the results.
+ * @param result Result of run().
+ * @param out Text is appended here.
+ */
+void HistoryBenchmark::render(const HistoryBenchmarkResult& result, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "Appended %llu samples in %.0f ms, %llu retained (%.1f h of channel 0), %zu blocks evicted\n",
+             static_cast<unsigned long long>(result.appended), result.fillMs,
+             static_cast<unsigned long long>(result.retained), result.retainedHours, result.evictedBlocks);
+    out += line;
+    snprintf(line, sizeof(line), "Memory %.2f MiB, at most %.2f MiB while filling, cap %.2f MiB (%s), %.2f B/sample\n",
+             result.memoryBytes / (1024.0 * 1024.0), result.highWaterBytes / (1024.0 * 1024.0),
+             result.memoryCapBytes / (1024.0 * 1024.0), result.highWaterBytes <= result.memoryCapBytes ? "held" : "EXCEEDED",
+             result.retained ? static_cast<double>(result.memoryBytes) / result.retained : 0.0);
+    out += line;
+    snprintf(line, sizeof(line), "%-8s %8s %10s %13s\n", "window", "points", "query ms", "frame budget");
+    out += line;
+    for (const HistoryWindowResult& window : result.windows)
+    {
+        snprintf(line, sizeof(line), "%-8s %8zu %10.3f %13s\n", window.window.c_str(), window.points, window.queryMs,
+                 window.queryMs <= frameBudgetMs ? "within" : "over");
+        out += line;
+    }
+}
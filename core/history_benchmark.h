@@ -0,0 +1,54 @@
+#ifndef HISTORY_BENCHMARK_H
+#define HISTORY_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Time to serve one scroll-back window */
+struct HistoryWindowResult
+{
+    std::string window;
+    int64_t windowMs = 0;
+    size_t points = 0;      /* Returned for the plot */
+    double queryMs = 0.0;   /* Best pass */
+};
+
+struct HistoryBenchmarkResult
+{
+    uint64_t appended = 0;       /* Over all channels */
+    uint64_t retained = 0;       /* Samples still in the history */
+    size_t memoryBytes = 0;
+    size_t memoryCapBytes = 0;
+    size_t highWaterBytes = 0;   /* Largest footprint seen while filling */
+    size_t evictedBlocks = 0;
+    double fillMs = 0.0;
+    double retainedHours = 0.0;  /* Span of channel 0 still queryable */
+    std::vector<HistoryWindowResult> windows;
+};
+
+/* Fills a CompressedHistory with a synthetic 100 Hz capture of every channel
+   under a memory cap, then times the window queries of the dashboard's
+   scroll-back chart (1 min, 1 h and 24 h back from the newest sample, thinned
+   to one point per plot pixel) against a 16 ms frame. */
+class HistoryBenchmark
+{
+    public:
+        HistoryBenchmark(double hours, size_t channels, size_t memoryCapBytes, size_t plotPoints = 2000,
+                         unsigned passes = 5);
+
+        HistoryBenchmarkResult run(void);
+        static void render(const HistoryBenchmarkResult& result, std::string& out);
+
+        static constexpr double frameBudgetMs = 16.0;
+
+    private:
+        double hours;
+        size_t channels;
+        size_t memoryCapBytes;
+        size_t plotPoints;
+        unsigned passes;
+};
+
+#endif /* HISTORY_BENCHMARK_H */
@@ -0,0 +1,352 @@
+/**
+ * @file instrument_engine.cpp
+ * @brief Sampling, protection and command service of the engine process.
+ *
+ * One loop does everything, so instrument exchanges never overlap: a sample
+ * when its time comes, then the queued commands, then a 1 ms nap when
+ * there was nothing to do. A GUI command therefore waits at most for the
+ * sample in progress.
+ */
+
+#include "instrument_engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    int64_t wallClockMs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief Constructor. Opens the retention store of every output.
+ * @param region Initialized shared region.
+ * @param powerSupply Driver of the instrument.
+ * @param link Transport owned by the driver; client messages are forwarded on it.
+ * @param options Initial settings; clients may change them later.
+ */
+InstrumentEngine::InstrumentEngine(EngineRegion& region, PowerSupply& powerSupply, Transport& link, const EngineOptions& options)
+    : region(region), powerSupply(powerSupply), link(link), options(options)
+{
+    this->options.channels = std::max(1, options.channels);
+    readings.assign(this->options.channels, PsChannelReading());
+    lastGood.assign(this->options.channels, Sample());
+    state.channels = this->options.channels;
+    state.sampleTimeMs = std::max(1, options.sampleTimeMs);
+    state.protectionLimit = std::max(0.0, options.protectionLimit);
+    this->options.protectionLimit = state.protectionLimit;
+    powerSupply.channels = this->options.channels;
+
+    for (int channel = 0; !options.logDirectory.empty() && channel < this->options.channels; channel++)
+    {
+        std::unique_ptr<RetentionStore> log(new RetentionStore());
+
+        if (log->open(options.logDirectory, "ch" + std::to_string(channel)) != RetentionStore::RetentionError::ERR_SUCCESS)
+        {
+            std::cout << "Engine: Failed to open the log of output " << channel + 1 << std::endl;
+            log.reset();
+        }
+        logs.push_back(std::move(log));
+    }
+}
+
+InstrumentEngine::~InstrumentEngine()
+{
+    for (std::unique_ptr<RetentionStore>& log : logs)
+    {
+        if (log)
+            log->flush();
+    }
+}
+
+/**
+ * @brief Maps a driver error to sample quality flags.
+ */
+uint8_t InstrumentEngine::qualityFor(PowerSupply::PsError error)
+{
+    switch (error)
+    {
+        case PowerSupply::PsError::ERR_SUCCESS:
+            return SAMPLE_GOOD;
+        case PowerSupply::PsError::ERR_TIMEOUT:
+            return SAMPLE_TIMEOUT | SAMPLE_STALE;
+        case PowerSupply::PsError::ERR_INVALID_RESPONSE:
+            return SAMPLE_PARSE_ERROR | SAMPLE_STALE;
+        case PowerSupply::PsError::ERR_DEVICE_NOT_CONNECTED:
+            return SAMPLE_RECONNECTING | SAMPLE_STALE;
+        default:
+            return SAMPLE_IO_ERROR | SAMPLE_STALE;
+    }
+}
+
+/**
+ * @brief Engine loop. Returns after a SHUTDOWN command or stop().
+ */
+void InstrumentEngine::run(void)
+{
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    if (options.statusWatch && powerSupply.isOpen() == PowerSupply::PsError::ERR_SUCCESS &&
+        powerSupply.enableStatusReporting() != PowerSupply::PsError::ERR_SUCCESS)
+        std::cout << "Engine: Status reporting unavailable, polling the full state" << std::endl;
+    snprintf(state.port, sizeof(state.port), "%s", powerSupply.port.c_str());
+    publishState();
+
+    while (!stopFlag)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        region.heartbeatMs.store(wallClockMs(), std::memory_order_relaxed);
+        if (now >= next)
+        {
+            sample();
+            next += std::chrono::milliseconds(state.sampleTimeMs);
+            if (next < now)
+                next = now + std::chrono::milliseconds(state.sampleTimeMs);  /* Late: do not catch up in a burst */
+        }
+        if (!serviceCommands())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * @brief Reads every output once and publishes, logs and checks the readings.
+ */
+void InstrumentEngine::sample(void)
+{
+    Sample sample;
+    PowerSupply::PsError err;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* Every iteration produces a sample, with or without a fresh reading */
+    sample.sequence = nextSequence++;
+    sample.timestampMs = wallClockMs();
+    if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        err = PowerSupply::PsError::ERR_DEVICE_NOT_CONNECTED;
+
+        /* A link lost mid-session is reopened; the sample stays flagged as reconnecting */
+        if (powerSupply.reconnect() == PowerSupply::PsError::ERR_SUCCESS)
+            std::cout << "Engine: Reconnected" << std::endl;
+    }
+    else if (options.channels > 1)
+    {
+        /* One compound query reads every output; then back to output 1 for the clients */
+        err = powerSupply.readChannels(readings, true);
+        if (err == PowerSupply::PsError::ERR_SUCCESS)
+            powerSupply.selectChannel(1);
+    }
+    else
+    {
+        err = powerSupply.readCurrent(readings[0].current);
+        if (err == PowerSupply::PsError::ERR_SUCCESS)
+            err = powerSupply.readVoltage(readings[0].voltage);
+    }
+    sample.quality = qualityFor(err);
+    sample.latencyUs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 std::chrono::steady_clock::now() - start).count());
+
+    /* The outputs of one read share sequence, timestamp, quality and latency */
+    for (int channel = 0; channel < options.channels; channel++)
+    {
+        RetentionStore *log = channel < static_cast<int>(logs.size()) ? logs[channel].get() : nullptr;
+
+        if (sample.good())
+        {
+            sample.voltage = readings[channel].voltage;
+            sample.current = readings[channel].current;
+            lastGood[channel] = sample;
+            if (log)
+                log->add(sample.timestampMs, sample.voltage, sample.current);
+        }
+        else
+        {
+            /* Stale sample: the last good reading, flagged */
+            sample.voltage = lastGood[channel].voltage;
+            sample.current = lastGood[channel].current;
+            if (log)
+                log->markGap();
+        }
+        region.publish(channel, sample);
+        if (sample.good())
+            protect(channel, sample.current);
+    }
+
+    /* One status byte every statusEvery samples; the full state only when it reports a change */
+    if (options.statusWatch && err == PowerSupply::PsError::ERR_SUCCESS &&
+        state.samples % static_cast<uint64_t>(options.statusEvery) == 0)
+    {
+        bool changed = false;
+
+        if (powerSupply.pollStatus(status, changed) == PowerSupply::PsError::ERR_SUCCESS && changed)
+        {
+            state.output = status.output;
+            state.questionable = status.questionable;
+            state.error = status.error;
+            state.statusChanges++;
+        }
+    }
+
+    state.samples++;
+    publishState();
+}
+
+/**
+ * @brief Switches an output off when its current is over the protection limit.
+ * The check uses the raw reading; a failed switch is retried with the next sample.
+ * @param channel Output index from 0.
+ * @param current Raw current reading.
+ */
+void InstrumentEngine::protect(int channel, double current)
+{
+    PowerSupply::PsError err;
+
+    if (options.protectionLimit <= 0.0 || std::fabs(current) <= options.protectionLimit)
+        return;
+
+    if (options.channels > 1)
+    {
+        err = powerSupply.writeChannels({{channel + 1, "turnOff", ""}});
+        powerSupply.selectChannel(1);
+    }
+    else
+    {
+        err = powerSupply.turnOff();
+    }
+    if (err != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        std::cout << "Engine: Failed to switch off output " << channel + 1 << std::endl;
+        return;
+    }
+
+    std::cout << "Engine: Output " << channel + 1 << " switched off at " << current << " A" << std::endl;
+    state.protectionTrips++;
+    state.protectionChannel = channel;
+    state.protectionCurrent = current;
+    if (channel == 0)
+        state.output = false;
+}
+
+/**
+ * @brief Serves the commands queued by the client.
+ * @return True when at least one command was served.
+ */
+bool InstrumentEngine::serviceCommands(void)
+{
+    EngineCommand command;
+    EngineReply answer;
+    bool served = false;
+
+    while (!stopFlag && region.nextCommand(command))
+    {
+        answer = EngineReply();
+        answer.id = command.id;
+        execute(command, answer);
+        region.reply(answer);
+        served = true;
+    }
+    if (served)
+        publishState();
+    return served;
+}
+
+/**
+ * @brief Executes one client command.
+ * A forwarded message is written and, when it holds a query, its reply is
+ * read at once. A failed exchange is cleaned up as the driver does, and on
+ * multi-output supplies the driver forgets which output is selected.
+ * @param command Command to execute.
+ * @param answer Filled with the status and the reply.
+ */
+void InstrumentEngine::execute(const EngineCommand& command, EngineReply& answer)
+{
+    ViStatus status = VI_SUCCESS;
+    ViUInt32 count = 0;
+    std::string port;
+
+    switch (command.op)
+    {
+        case EngineOp::WRITE:
+            if (!link.isOpen())
+            {
+                status = VI_ERROR_CONN_LOST;
+                break;
+            }
+            status = link.write(command.data, std::min<size_t>(command.size, sizeof(command.data)));
+            if (status == VI_SUCCESS && command.expectReply)
+            {
+                status = link.read(answer.data, sizeof(answer.data), count);
+                answer.size = count;
+            }
+            if (status == VI_ERROR_CONN_LOST)
+                link.close();
+            else if (status < VI_SUCCESS)
+                link.clear();
+            if (options.channels > 1)
+                powerSupply.forgetSelection();
+            break;
+
+        case EngineOp::CLEAR:
+            status = link.isOpen() ? link.clear() : VI_SUCCESS;
+            break;
+
+        case EngineOp::OPEN:
+            port.assign(command.data, std::min<size_t>(command.size, sizeof(command.data)));
+            if (port == powerSupply.port && powerSupply.isOpen() == PowerSupply::PsError::ERR_SUCCESS)
+                break;
+            if (powerSupply.open(port) != PowerSupply::PsError::ERR_SUCCESS)
+            {
+                status = VI_ERROR_RSRC_NFOUND;
+                break;
+            }
+            std::cout << "Engine: Opened " << port << std::endl;
+            if (options.statusWatch)
+                powerSupply.enableStatusReporting();
+            snprintf(state.port, sizeof(state.port), "%s", port.c_str());
+            break;
+
+        case EngineOp::SAMPLE_TIME:
+            state.sampleTimeMs = std::max(1, static_cast<int>(command.value));
+            break;
+
+        case EngineOp::STATUS_WATCH:
+            options.statusWatch = command.value >= 1.0;
+            options.statusEvery = std::max(1, static_cast<int>(command.value));
+            if (options.statusWatch && powerSupply.isOpen() == PowerSupply::PsError::ERR_SUCCESS &&
+                !powerSupply.statusReportingEnabled())
+                powerSupply.enableStatusReporting();
+            break;
+
+        case EngineOp::PROTECTION:
+            options.protectionLimit = std::max(0.0, command.value);
+            state.protectionLimit = options.protectionLimit;
+            break;
+
+        case EngineOp::SHUTDOWN:
+            stopFlag = true;
+            break;
+
+        default:
+            status = VI_ERROR_INV_PARAMETER;
+            break;
+    }
+    answer.status = status;
+}
+
+/**
+ * @brief Publishes the engine state to the region.
+ */
+void InstrumentEngine::publishState(void)
+{
+    state.updatedMs = wallClockMs();
+    state.linkUp = powerSupply.isOpen() == PowerSupply::PsError::ERR_SUCCESS;
+    region.state.store(state);
+}
@@ -0,0 +1,61 @@
+#ifndef INSTRUMENT_ENGINE_H
+#define INSTRUMENT_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "drv_power_supply.h"
+#include "engine_region.h"
+#include "retention_store.h"
+#include "sample.h"
+
+struct EngineOptions
+{
+    int channels = 1;
+    int sampleTimeMs = 1000;
+    bool statusWatch = true;
+    int statusEvery = 1;           /* Samples per status check, from the link budget */
+    double protectionLimit = 0.0;  /* Amperes of raw reading above which an output is switched off, 0 for none */
+    std::string logDirectory;      /* Retention store of every output, empty for none */
+};
+
+/* Instrument I/O, sampling and protection of one supply, run in a process
+   of its own so that a GUI that hangs, crashes or restarts never stops
+   them. Samples and state go to the shared region, every output is logged
+   to a retention store, and commands of the attached GUI are served between
+   samples. The engine leaves output 1 selected between its own exchanges,
+   where the unaddressed commands of the GUI's driver expect it. */
+class InstrumentEngine
+{
+    public:
+        InstrumentEngine(EngineRegion& region, PowerSupply& powerSupply, Transport& link, const EngineOptions& options);
+        ~InstrumentEngine();
+
+        void run(void);
+        void stop(void) { stopFlag = true; }
+
+        static uint8_t qualityFor(PowerSupply::PsError error);
+
+    private:
+        EngineRegion& region;
+        PowerSupply& powerSupply;
+        Transport& link;          /* Transport owned by powerSupply, for forwarded messages */
+        EngineOptions options;
+        EngineState state;
+        std::atomic<bool> stopFlag{false};
+        uint64_t nextSequence = 1;
+        std::vector<PsChannelReading> readings;
+        std::vector<Sample> lastGood;
+        std::vector<std::unique_ptr<RetentionStore>> logs;
+        PsStatus status;
+
+        void sample(void);
+        void protect(int channel, double current);
+        bool serviceCommands(void);
+        void execute(const EngineCommand& command, EngineReply& answer);
+        void publishState(void);
+};
+
+#endif /* INSTRUMENT_ENGINE_H */
@@ -0,0 +1,128 @@
+/**
+ * @file log_benchmark.cpp
+ * @brief Sustained ingest rate of the log writer against the durability interval.
+ *
+ * Every run writes into its own fresh directory below the one given, which
+ * is removed afterwards. Records have the size of a capture log sample.
+ */
+
+#include "log_benchmark.h"
+#include "capture_log.h"
+#include "log_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+namespace
+{
+    const uint64_t maxUndurableRecords = 256 * 1024;
+    const size_t segmentBytes = 16 * 1024 * 1024;
+
+    double elapsedSeconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param directory Scratch directory on the disk to measure.
+ * @param seconds Length of every run.
+ */
+LogBenchmark::LogBenchmark(const std::string& directory, double seconds)
+    : directory(directory), seconds(std::max(seconds, 0.1))
+{
+}
+
+/**
+ * @brief Runs one durability setting.
+ * @param name Label of the setting.
+ * @param delayMs Group commit delay budget.
+ * @param syncEach Wait for every record to be durable before the next one.
+ */
+LogIngestResult LogBenchmark::measure(const std::string& name, uint32_t delayMs, bool syncEach)
+{
+    std::string path = directory + "/run_" + std::to_string(delayMs) + (syncEach ? "_each" : "");
+    uint8_t record[CaptureLog::recordSize] = {};
+    GroupCommitPolicy policy;
+    LogIngestResult result;
+    LogWriter log;
+    std::error_code ec;
+    uint64_t sequence = 0;
+    bool failed = false;
+
+    result.durability = name;
+    std::filesystem::remove_all(path, ec);
+    policy.maxDelayMs = delayMs;
+    policy.maxBatchBytes = 4 * 1024 * 1024;  /* The delay decides the batch */
+    if (log.open(path, segmentBytes, policy) != LogWriter::LogError::ERR_SUCCESS)
+        return result;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (!failed && elapsedSeconds(start) < seconds)
+    {
+        for (int k = 0; k < 256 && !failed; k++)
+        {
+            memcpy(record, &sequence, sizeof(sequence));
+            failed = log.append(record, sizeof(record), &sequence) != LogWriter::LogError::ERR_SUCCESS ||
+                     (syncEach && log.waitDurable(sequence) != LogWriter::LogError::ERR_SUCCESS);
+        }
+        while (sequence - log.durableSequence() > maxUndurableRecords)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    log.sync();
+    result.seconds = elapsedSeconds(start);
+    result.records = log.durableSequence();
+    result.syncs = log.stats().syncs;
+    result.maxSyncUs = log.stats().maxSyncUs;
+    log.close();
+
+    start = std::chrono::steady_clock::now();
+    if (log.open(path, segmentBytes, policy) == LogWriter::LogError::ERR_SUCCESS)
+        result.recoveryMs = elapsedSeconds(start) * 1000.0;
+    log.close();
+    std::filesystem::remove_all(path, ec);
+    return result;
+}
+
+/**
+ * @brief Runs a data sync per record, then group commit at 1 to 200 ms.
+ */
+std::vector<LogIngestResult> LogBenchmark::run(void)
+{
+    const uint32_t delays[] = {1, 5, 20, 50, 200};
+    std::vector<LogIngestResult> results;
+    std::error_code ec;
+
+    std::filesystem::create_directories(directory, ec);
+    results.push_back(measure("sync per record", 0, true));
+    for (uint32_t delay : delays)
+        results.push_back(measure("group " + std::to_string(delay) + " ms", delay, false));
+    return results;
+}
+
+/**
+ * @brief Formats the results.
+ * @param results Results of run().
+ * @param out Text is appended here.
+ */
+void LogBenchmark::render(const std::vector<LogIngestResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-16s %12s %9s %9s %13s %12s %12s\n",
+             "durability", "records/s", "MiB/s", "syncs/s", "records/sync", "max sync ms", "recovery ms");
+    out += line;
+    for (const LogIngestResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-16s %12.0f %9.2f %9.0f %13.1f %12.2f %12.2f\n", result.durability.c_str(),
+                 result.recordsPerSecond(), result.recordsPerSecond() * CaptureLog::recordSize / (1024.0 * 1024.0),
+                 result.seconds > 0.0 ? result.syncs / result.seconds : 0.0,
+                 result.syncs ? static_cast<double>(result.records) / result.syncs : 0.0, result.maxSyncUs / 1000.0,
+                 result.recoveryMs);
+        out += line;
+    }
+}
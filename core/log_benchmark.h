@@ -0,0 +1,43 @@
+#ifndef LOG_BENCHMARK_H
+#define LOG_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Sustained ingest of one durability setting */
+struct LogIngestResult
+{
+    std::string durability;
+    uint64_t records = 0;     /* Durable at the end of the run */
+    double seconds = 0.0;
+    uint64_t syncs = 0;
+    uint64_t maxSyncUs = 0;
+    double recoveryMs = 0.0;  /* Reopening the log: tail segment scan */
+
+    double recordsPerSecond(void) const { return seconds > 0.0 ? records / seconds : 0.0; }
+};
+
+/* Appends capture-sized records as fast as the log sustains for a fixed
+   time, first with a data sync after every record, then with group commit
+   at a range of durability intervals, and reopens each log to time the
+   recovery scan. The producer is held back when more than a bounded number
+   of records are waiting to become durable, so the rate is the one the
+   disk sustains and not the speed of filling memory. */
+class LogBenchmark
+{
+    public:
+        LogBenchmark(const std::string& directory, double seconds);
+
+        std::vector<LogIngestResult> run(void);
+        static void render(const std::vector<LogIngestResult>& results, std::string& out);
+
+    private:
+        std::string directory;
+        double seconds;
+
+        LogIngestResult measure(const std::string& name, uint32_t delayMs, bool syncEach);
+};
+
+#endif /* LOG_BENCHMARK_H */
@@ -0,0 +1,828 @@
+/**
+ * @file log_writer.cpp
+ * @brief Crash-safe append-only log with preallocated segments and group commit.
+ *
+ * Segment layout:
+ *   [magic "PSLOG001"][segment number u64][first sequence u64][reserved u64]
+ *   [frame]...[zeros up to the preallocated size]
+ * Frame layout:
+ *   [payload length u32][crc32 u32][sequence u64][payload]
+ * The CRC covers the length, the sequence and the payload. The zeros of the
+ * preallocated area read as a zero-length frame, which ends the log.
+ *
+ * On Linux the batch can optionally be submitted through io_uring as a linked
+ * write + fdatasync pair (PS_HAVE_LIBURING). Otherwise, and whenever the ring
+ * cannot be created, plain positioned writes and a data sync are used.
+ */
+
+#include "log_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(PS_HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
+namespace
+{
+    const char segmentMagic[8] = {'P', 'S', 'L', 'O', 'G', '0', '0', '1'};
+    const size_t segmentHeaderSize = 32;
+    const size_t frameHeaderSize = 16;
+
+    uint64_t nowUs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Minimal positioned file I/O on top of the platform descriptors */
+    int fileOpen(const std::string& path, bool create)
+    {
+#if defined(_WIN32)
+        return _open(path.c_str(), _O_RDWR | _O_BINARY | (create ? _O_CREAT | _O_EXCL : 0), _S_IREAD | _S_IWRITE);
+#else
+        return ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+#endif
+    }
+
+    void fileClose(int fd)
+    {
+#if defined(_WIN32)
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+
+    bool fileWriteAt(int fd, const void *data, size_t size, size_t offset)
+    {
+        const char *bytes = static_cast<const char*>(data);
+#if defined(_WIN32)
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+            return false;
+        while (size > 0)
+        {
+            int written = _write(fd, bytes, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= written;
+        }
+#else
+        while (size > 0)
+        {
+            ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+            if (written <= 0)
+                return false;
+            bytes += written;
+            size -= written;
+            offset += written;
+        }
+#endif
+        return true;
+    }
+
+    bool fileReadAt(int fd, void *data, size_t size, size_t offset)
+    {
+        char *bytes = static_cast<char*>(data);
+#if defined(_WIN32)
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0)
+            return false;
+        while (size > 0)
+        {
+            int count = _read(fd, bytes, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+            if (count <= 0)
+                return false;
+            bytes += count;
+            size -= count;
+        }
+#else
+        while (size > 0)
+        {
+            ssize_t count = ::pread(fd, bytes, size, static_cast<off_t>(offset));
+            if (count <= 0)
+                return false;
+            bytes += count;
+            size -= count;
+            offset += count;
+        }
+#endif
+        return true;
+    }
+
+    bool fileSync(int fd)
+    {
+#if defined(_WIN32)
+        return _commit(fd) == 0;
+#elif defined(__APPLE__)
+        return ::fsync(fd) == 0;
+#else
+        return ::fdatasync(fd) == 0;
+#endif
+    }
+
+    /* Makes a new directory entry durable; NTFS journals it with the file */
+    bool directorySync(const std::string& directory)
+    {
+#if defined(_WIN32)
+        (void)directory;
+        return true;
+#else
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        bool ok;
+
+        if (fd < 0)
+            return false;
+        ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    bool filePreallocate(int fd, size_t size)
+    {
+#if defined(_WIN32)
+        return _chsize_s(fd, static_cast<__int64>(size)) == 0;
+#elif defined(__linux__)
+        return ::posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0;
+#else
+        return ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+    }
+
+    size_t fileSize(int fd)
+    {
+#if defined(_WIN32)
+        __int64 size = _lseeki64(fd, 0, SEEK_END);
+#else
+        off_t size = ::lseek(fd, 0, SEEK_END);
+#endif
+        return size < 0 ? 0 : static_cast<size_t>(size);
+    }
+
+    void putU32(uint8_t *out, uint32_t value)
+    {
+        memcpy(out, &value, sizeof(value));
+    }
+
+    void putU64(uint8_t *out, uint64_t value)
+    {
+        memcpy(out, &value, sizeof(value));
+    }
+
+    uint32_t getU32(const uint8_t *in)
+    {
+        uint32_t value;
+        memcpy(&value, in, sizeof(value));
+        return value;
+    }
+
+    uint64_t getU64(const uint8_t *in)
+    {
+        uint64_t value;
+        memcpy(&value, in, sizeof(value));
+        return value;
+    }
+
+    /* CRC of a frame: length, sequence and payload */
+    uint32_t frameCrc(uint32_t length, uint64_t sequence, const uint8_t *payload)
+    {
+        uint32_t crc = LogWriter::crc32(&length, sizeof(length));
+        crc = LogWriter::crc32(&sequence, sizeof(sequence), crc);
+        return LogWriter::crc32(payload, length, crc);
+    }
+}
+
+LogWriter::LogWriter()
+{
+}
+
+LogWriter::~LogWriter()
+{
+    close();
+}
+
+/**
+ * @brief Standard CRC-32 (IEEE 802.3), table driven.
+ * @param data Bytes to checksum.
+ * @param size Number of bytes.
+ * @param crc CRC of the preceding bytes when checksumming in pieces.
+ */
+uint32_t LogWriter::crc32(const void *data, size_t size, uint32_t crc)
+{
+    static const struct Table
+    {
+        uint32_t entries[256];
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++)
+                    value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+                entries[i] = value;
+            }
+        }
+    } table;
+    const uint8_t *bytes = static_cast<const uint8_t*>(data);
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+std::string LogWriter::segmentPath(const std::string& directory, uint64_t number)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "seg_%010llu.log", static_cast<unsigned long long>(number));
+    return directory + "/" + name;
+}
+
+/**
+ * @brief Returns the segment numbers found in a directory, ascending.
+ */
+std::vector<uint64_t> LogWriter::listSegments(const std::string& directory)
+{
+    std::vector<uint64_t> numbers;
+    std::error_code ec;
+
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.size() != 18 || name.compare(0, 4, "seg_") != 0 || name.compare(14, 4, ".log") != 0)
+            continue;
+        if (!std::all_of(name.begin() + 4, name.begin() + 14, [](char c) { return c >= '0' && c <= '9'; }))
+            continue;
+        numbers.push_back(std::stoull(name.substr(4, 10)));
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+/**
+ * @brief Checks the header of a segment.
+ * @param fd Open segment.
+ * @param firstSeq Receives the sequence of the first record of the segment.
+ * @return False if the segment is too short or its magic does not match.
+ */
+bool LogWriter::readSegmentHeader(int fd, uint64_t& firstSeq)
+{
+    uint8_t header[segmentHeaderSize];
+
+    if (!fileReadAt(fd, header, sizeof(header), 0) || memcmp(header, segmentMagic, sizeof(segmentMagic)) != 0)
+        return false;
+    firstSeq = getU64(header + 16);
+    return true;
+}
+
+/**
+ * @brief Walks the valid frames of one segment.
+ * The segment is read in large chunks, so small records cost no system
+ * call of their own; only a frame larger than a chunk is read on its own.
+ * @param fd Open segment.
+ * @param segmentBytes Size of the segment file.
+ * @param lastSeq In: sequence preceding the segment. Out: last valid sequence.
+ * @param handler Called for every valid record, may be nullptr.
+ * @return Offset just past the last valid frame.
+ */
+size_t LogWriter::scanSegment(int fd, size_t segmentBytes, uint64_t& lastSeq, const RecordHandler *handler)
+{
+    const size_t chunkBytes = 256 * 1024;
+    size_t offset = segmentHeaderSize;
+    std::vector<uint8_t> chunk(chunkBytes);
+    std::vector<uint8_t> large;
+    size_t chunkStart = 0;
+    size_t chunkSize = 0;
+
+    /* Makes [at, at + size) readable from the chunk, when it fits in one */
+    auto load = [&](size_t at, size_t size) -> const uint8_t*
+    {
+        if (at >= chunkStart && at + size <= chunkStart + chunkSize)
+            return &chunk[at - chunkStart];
+        if (size > chunkBytes)
+            return nullptr;
+        chunkStart = at;
+        chunkSize = std::min(chunkBytes, segmentBytes - at);
+        if (!fileReadAt(fd, chunk.data(), chunkSize, at))
+        {
+            chunkSize = 0;
+            return nullptr;
+        }
+        return chunk.data();
+    };
+
+    while (offset + frameHeaderSize <= segmentBytes)
+    {
+        const uint8_t *header = load(offset, frameHeaderSize);
+        const uint8_t *payload;
+
+        if (header == nullptr)
+            break;
+
+        uint32_t length = getU32(header);
+        uint32_t crc = getU32(header + 4);
+        uint64_t sequence = getU64(header + 8);
+        if (length == 0 || offset + frameHeaderSize + length > segmentBytes || sequence != lastSeq + 1)
+            break;
+
+        payload = load(offset + frameHeaderSize, length);
+        if (payload == nullptr && length > chunkBytes)
+        {
+            large.resize(length);
+            if (fileReadAt(fd, large.data(), length, offset + frameHeaderSize))
+                payload = large.data();
+        }
+        if (payload == nullptr || frameCrc(length, sequence, payload) != crc)
+            break;
+
+        if (handler)
+            (*handler)(sequence, payload, length);
+        lastSeq = sequence;
+        offset += frameHeaderSize + length;
+    }
+    return offset;
+}
+
+/**
+ * @brief Opens or creates a segment and makes it the write target.
+ * @param number Segment number.
+ * @param offset Write position (ignored when creating).
+ * @param create True to create and preallocate a new segment.
+ * @param firstSeq Sequence of the first record of a new segment.
+ */
+LogWriter::LogError LogWriter::openSegment(uint64_t number, size_t offset, bool create, uint64_t firstSeq)
+{
+    uint8_t header[segmentHeaderSize];
+    int fd;
+
+    fd = fileOpen(segmentPath(directory, number), create);
+    if (fd < 0)
+        return LogError::ERR_OPEN_FAILED;
+
+    if (create)
+    {
+        memset(header, 0, sizeof(header));
+        memcpy(header, segmentMagic, sizeof(segmentMagic));
+        putU64(header + 8, number);
+        putU64(header + 16, firstSeq);
+        if (!filePreallocate(fd, segmentBytes) || !fileWriteAt(fd, header, sizeof(header), 0) || !fileSync(fd) ||
+            !directorySync(directory))
+        {
+            /* Removed so that a retry can create it again */
+            std::error_code ec;
+            fileClose(fd);
+            std::filesystem::remove(segmentPath(directory, number), ec);
+            return LogError::ERR_IO_FAILED;
+        }
+        offset = segmentHeaderSize;
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.segments++;
+    }
+
+    if (segment.fd >= 0)
+        fileClose(segment.fd);
+    segment.fd = fd;
+    segment.number = number;
+    segment.offset = offset;
+    return LogError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Opens the log, recovering the write position from the newest segment.
+ * @param directory Log directory, created if missing.
+ * @param segmentBytes Preallocated size of every segment.
+ * @param policy Group commit budgets.
+ * @param useIoUring Submit batches through io_uring when available.
+ */
+LogWriter::LogError LogWriter::open(const std::string& directory, size_t segmentBytes,
+                                    const GroupCommitPolicy& policy, bool useIoUring)
+{
+    std::vector<uint64_t> segments;
+    uint64_t firstSeq = 0;
+    std::error_code ec;
+    LogError err = LogError::ERR_SUCCESS;
+
+    close();
+    this->directory = directory;
+    this->segmentBytes = std::max<size_t>(segmentBytes, 4096);
+    this->policy = policy;
+    counters = LogWriterStats();
+    flusherError = LogError::ERR_SUCCESS;
+    stopFlag = false;
+    nextSeq = 1;
+    std::filesystem::create_directories(directory, ec);
+
+    /* Recovery: only the newest segment is scanned, older ones were synced
+       before the writer moved past them. A power cut while rolling over can
+       leave the newest segment empty or without its header; it holds no
+       record yet, so it is removed and created again after the previous one. */
+    segments = listSegments(directory);
+    if (segments.empty())
+    {
+        err = openSegment(1, 0, true, nextSeq);
+    }
+    else
+    {
+        err = openSegment(segments.back(), 0, false, 0);
+        if (err == LogError::ERR_SUCCESS && readSegmentHeader(segment.fd, firstSeq))
+        {
+            uint64_t lastSeq = firstSeq - 1;
+            this->segmentBytes = fileSize(segment.fd);
+            segment.offset = scanSegment(segment.fd, this->segmentBytes, lastSeq, nullptr);
+            nextSeq = lastSeq + 1;
+        }
+        else if (err == LogError::ERR_SUCCESS)
+        {
+            std::cout << "Log Writer: Recreating incomplete segment " << segments.back() << std::endl;
+            fileClose(segment.fd);
+            segment = Segment();
+            if (!std::filesystem::remove(segmentPath(directory, segments.back()), ec))
+                err = LogError::ERR_OPEN_FAILED;
+            segments.pop_back();
+
+            /* The sequence continues after the last record of the previous segment */
+            if (err == LogError::ERR_SUCCESS && !segments.empty())
+            {
+                int fd = fileOpen(segmentPath(directory, segments.back()), false);
+                uint64_t lastSeq = 0;
+
+                if (fd >= 0 && readSegmentHeader(fd, firstSeq))
+                {
+                    lastSeq = firstSeq - 1;
+                    scanSegment(fd, fileSize(fd), lastSeq, nullptr);
+                }
+                if (fd >= 0)
+                    fileClose(fd);
+                nextSeq = lastSeq + 1;
+            }
+            if (err == LogError::ERR_SUCCESS)
+                err = openSegment(segments.empty() ? 1 : segments.back() + 1, 0, true, nextSeq);
+        }
+    }
+    if (err != LogError::ERR_SUCCESS)
+    {
+        std::cout << "Log Writer: Failed to open log in " << directory << std::endl;
+        close();
+        return err;
+    }
+    durableSeq = nextSeq - 1;
+
+#if defined(PS_HAVE_LIBURING)
+    if (useIoUring)
+    {
+        io_uring *uring = new io_uring;
+        if (io_uring_queue_init(8, uring, 0) == 0)
+        {
+            ring = uring;
+            counters.ioUring = true;
+        }
+        else
+        {
+            std::cout << "Log Writer: io_uring unavailable, using positioned writes" << std::endl;
+            delete uring;
+        }
+    }
+#else
+    (void)useIoUring;
+#endif
+
+    flusher = std::thread(&LogWriter::flusherLoop, this);
+    return LogError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Commits pending records and closes the log.
+ */
+void LogWriter::close(void)
+{
+    if (flusher.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopFlag = true;
+        }
+        wakeFlusher.notify_all();
+        flusher.join();
+    }
+
+#if defined(PS_HAVE_LIBURING)
+    if (ring)
+    {
+        io_uring_queue_exit(static_cast<io_uring*>(ring));
+        delete static_cast<io_uring*>(ring);
+    }
+#endif
+    ring = nullptr;
+
+    if (segment.fd >= 0)
+        fileClose(segment.fd);
+    segment = Segment();
+    pending.clear();
+    writing.clear();
+    writingDone = 0;
+    durableChanged.notify_all();
+}
+
+/**
+ * @brief Queues a record. It becomes durable with the next group commit.
+ * @param payload Record bytes.
+ * @param size Number of bytes.
+ * @param sequence Receives the sequence number of the record, may be nullptr.
+ */
+LogWriter::LogError LogWriter::append(const void *payload, size_t size, uint64_t *sequence)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t offset = pending.size();
+    uint64_t seq;
+
+    if (segment.fd < 0)
+        return LogError::ERR_NOT_OPEN;
+    /* While commits fail, one batch more is queued for the retry; beyond it records are refused */
+    if (flusherError != LogError::ERR_SUCCESS && pending.size() >= policy.maxBatchBytes)
+        return flusherError;
+    if (size == 0 || size + frameHeaderSize + segmentHeaderSize > segmentBytes)
+        return LogError::ERR_RECORD_TOO_LARGE;
+
+    seq = nextSeq++;
+    pending.resize(offset + frameHeaderSize + size);
+    putU32(&pending[offset], static_cast<uint32_t>(size));
+    putU64(&pending[offset + 8], seq);
+    memcpy(&pending[offset + frameHeaderSize], payload, size);
+    putU32(&pending[offset + 4], frameCrc(static_cast<uint32_t>(size), seq, &pending[offset + frameHeaderSize]));
+
+    if (offset == 0)
+        pendingSinceUs = nowUs();
+    pendingLastSeq = seq;
+    counters.records++;
+    counters.bytes += size;
+    if (sequence)
+        *sequence = seq;
+
+    /* The first record starts the delay budget of an idle flusher */
+    if (offset == 0 || pending.size() >= policy.maxBatchBytes)
+    {
+        lock.unlock();
+        wakeFlusher.notify_one();
+    }
+    return LogError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Forces a group commit and waits until every queued record is durable.
+ */
+LogWriter::LogError LogWriter::sync(void)
+{
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = nextSeq - 1;
+        syncRequested = true;
+    }
+    wakeFlusher.notify_one();
+    return waitDurable(target);
+}
+
+/**
+ * @brief Waits until a record is durable.
+ * @param sequence Sequence number returned by append().
+ */
+LogWriter::LogError LogWriter::waitDurable(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    durableChanged.wait(lock, [&] {
+        return durableSeq.load() >= sequence || flusherError != LogError::ERR_SUCCESS || stopFlag;
+    });
+    if (durableSeq.load() >= sequence)
+        return LogError::ERR_SUCCESS;
+    return flusherError != LogError::ERR_SUCCESS ? flusherError : LogError::ERR_NOT_OPEN;
+}
+
+/**
+ * @brief Returns a copy of the writer counters.
+ */
+LogWriterStats LogWriter::stats(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+/**
+ * @brief Background group commit loop.
+ * A batch that fails to commit is kept and retried with a growing delay;
+ * the error is reported until a retry succeeds, and then cleared.
+ */
+void LogWriter::flusherLoop(void)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint32_t retryDelayMs = minRetryDelayMs;
+
+    while (true)
+    {
+        if (writing.empty())
+        {
+            /* Sleep until a budget is exhausted, a sync is requested or the log closes */
+            while (!stopFlag && !syncRequested && pending.size() < policy.maxBatchBytes)
+            {
+                if (pending.empty())
+                {
+                    wakeFlusher.wait(lock);
+                    continue;
+                }
+                uint64_t deadline = pendingSinceUs + policy.maxDelayMs * 1000ULL;
+                uint64_t now = nowUs();
+                if (now >= deadline)
+                    break;
+                wakeFlusher.wait_for(lock, std::chrono::microseconds(deadline - now));
+            }
+
+            if (pending.empty())
+            {
+                syncRequested = false;
+                durableChanged.notify_all();
+                if (stopFlag)
+                    break;
+                continue;
+            }
+
+            writingLastSeq = pendingLastSeq;
+            writingDone = 0;
+            writing.swap(pending);
+            syncRequested = false;
+        }
+
+        lock.unlock();
+        uint64_t start = nowUs();
+        LogError err = commit(writing, writingDone);
+        uint64_t elapsed = nowUs() - start;
+        lock.lock();
+
+        if (err != LogError::ERR_SUCCESS)
+        {
+            if (flusherError == LogError::ERR_SUCCESS)
+                std::cout << "Log Writer: Group commit failed, retrying" << std::endl;
+            flusherError = err;
+            counters.failedCommits++;
+            durableChanged.notify_all();
+            if (stopFlag)
+                break;
+            wakeFlusher.wait_for(lock, std::chrono::milliseconds(retryDelayMs), [this] { return stopFlag; });
+            retryDelayMs = std::min(retryDelayMs * 2, maxRetryDelayMs);
+            continue;
+        }
+
+        if (flusherError != LogError::ERR_SUCCESS)
+            std::cout << "Log Writer: Group commit recovered" << std::endl;
+        flusherError = LogError::ERR_SUCCESS;
+        retryDelayMs = minRetryDelayMs;
+        writing.clear();
+        durableSeq = writingLastSeq;
+        counters.syncs++;
+        counters.lastSyncUs = elapsed;
+        counters.maxSyncUs = std::max(counters.maxSyncUs, elapsed);
+        durableChanged.notify_all();
+    }
+}
+
+/**
+ * @brief Writes a run of bytes at an offset of the current segment, optionally followed by a data sync.
+ */
+LogWriter::LogError LogWriter::writeAndSync(const uint8_t *data, size_t size, size_t offset, bool sync)
+{
+#if defined(PS_HAVE_LIBURING)
+    if (ring)
+    {
+        io_uring *uring = static_cast<io_uring*>(ring);
+        io_uring_sqe *sqe = io_uring_get_sqe(uring);
+        io_uring_cqe *cqe;
+        int expected = sync ? 2 : 1;
+        bool ok = true;
+
+        io_uring_prep_write(sqe, segment.fd, data, static_cast<unsigned>(size), offset);
+        if (sync)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe = io_uring_get_sqe(uring);
+            io_uring_prep_fsync(sqe, segment.fd, IORING_FSYNC_DATASYNC);
+        }
+        if (io_uring_submit_and_wait(uring, expected) < expected)
+            return LogError::ERR_IO_FAILED;
+        for (int i = 0; i < expected; i++)
+        {
+            if (io_uring_wait_cqe(uring, &cqe) != 0)
+                return LogError::ERR_IO_FAILED;
+            /* A short write is reported as a positive count below size */
+            if (cqe->res < 0 || (i == 0 && static_cast<size_t>(cqe->res) != size))
+                ok = false;
+            io_uring_cqe_seen(uring, cqe);
+        }
+        return ok ? LogError::ERR_SUCCESS : LogError::ERR_IO_FAILED;
+    }
+#endif
+    if (!fileWriteAt(segment.fd, data, size, offset))
+        return LogError::ERR_IO_FAILED;
+    if (sync && !fileSync(segment.fd))
+        return LogError::ERR_IO_FAILED;
+    return LogError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Writes a batch of frames, rotating segments at frame boundaries, then syncs.
+ * @param batch Frames to write.
+ * @param done In: bytes of the batch already durable from an earlier attempt.
+ * Out: bytes durable now, so that a retry neither skips nor repeats a frame.
+ */
+LogWriter::LogError LogWriter::commit(const std::vector<uint8_t>& batch, size_t& done)
+{
+    size_t cursor = done;
+    LogError err;
+
+    while (cursor < batch.size())
+    {
+        size_t frameSize = frameHeaderSize + getU32(&batch[cursor]);
+
+        /* Frame does not fit: flush the run and continue in a new segment */
+        if (segment.offset + (cursor - done) + frameSize > segmentBytes)
+        {
+            if (cursor > done)
+            {
+                err = writeAndSync(&batch[done], cursor - done, segment.offset, true);
+                if (err != LogError::ERR_SUCCESS)
+                    return err;
+                segment.offset += cursor - done;
+                done = cursor;
+            }
+            err = openSegment(segment.number + 1, 0, true, getU64(&batch[cursor + 8]));
+            if (err != LogError::ERR_SUCCESS)
+                return err;
+        }
+        cursor += frameSize;
+    }
+
+    err = writeAndSync(&batch[done], cursor - done, segment.offset, true);
+    if (err == LogError::ERR_SUCCESS)
+    {
+        segment.offset += cursor - done;
+        done = cursor;
+    }
+    return err;
+}
+
+/**
+ * @brief Deletes every segment older than the one being written.
+ * Used by logs whose newest records supersede the older ones. Call it
+ * before appending, while the flusher cannot be rotating segments.
+ */
+void LogWriter::removeOldSegments(void)
+{
+    std::error_code ec;
+
+    for (uint64_t number : listSegments(directory))
+    {
+        if (number < segment.number)
+            std::filesystem::remove(segmentPath(directory, number), ec);
+    }
+}
+
+/**
+ * @brief Reads every valid record of a log directory in sequence order.
+ * @param directory Log directory.
+ * @param handler Called for every record.
+ * @param tailOnly Only read the newest segment.
+ */
+LogWriter::LogError LogWriter::replay(const std::string& directory, const RecordHandler& handler, bool tailOnly)
+{
+    std::vector<uint64_t> segments = listSegments(directory);
+    uint64_t firstSeq;
+
+    if (tailOnly && segments.size() > 1)
+        segments.erase(segments.begin(), segments.end() - 1);
+
+    for (uint64_t number : segments)
+    {
+        int fd = fileOpen(segmentPath(directory, number), false);
+        if (fd < 0)
+            return LogError::ERR_OPEN_FAILED;
+        if (readSegmentHeader(fd, firstSeq))
+        {
+            uint64_t lastSeq = firstSeq - 1;
+            scanSegment(fd, fileSize(fd), lastSeq, &handler);
+        }
+        fileClose(fd);
+    }
+    return LogError::ERR_SUCCESS;
+}
@@ -0,0 +1,116 @@
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* When the writer makes a batch of records durable */
+struct GroupCommitPolicy
+{
+    uint32_t maxDelayMs = 50;           /* Oldest unsynced record waits at most this long */
+    size_t maxBatchBytes = 256 * 1024;  /* Or until this many bytes are pending */
+};
+
+struct LogWriterStats
+{
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t syncs = 0;
+    uint64_t segments = 0;
+    uint64_t lastSyncUs = 0;
+    uint64_t maxSyncUs = 0;
+    uint64_t failedCommits = 0;  /* Attempts that failed and were retried */
+    bool ioUring = false;  /* True if batches are submitted through io_uring */
+};
+
+/* Append-only, crash-safe record log.
+   Records are framed as [length][crc32][sequence][payload] and written into
+   segments that are preallocated to their full size, so appends never grow
+   the file metadata. A background thread group-commits pending records:
+   one write and one data sync per batch, issued when the batch reaches the
+   size budget or its oldest record reaches the delay budget. After a crash
+   only the newest segment needs to be scanned; the first frame whose CRC
+   does not match marks the end of the log. A failed commit is retried, so a
+   transient I/O error delays durability instead of ending the log. */
+class LogWriter
+{
+    public:
+        enum class LogError
+        {
+            ERR_SUCCESS = 0,
+            ERR_OPEN_FAILED,
+            ERR_IO_FAILED,
+            ERR_RECORD_TOO_LARGE,
+            ERR_NOT_OPEN
+        };
+
+        using RecordHandler = std::function<void(uint64_t sequence, const uint8_t *payload, size_t size)>;
+
+        LogWriter();
+        ~LogWriter();
+
+        LogError open(const std::string& directory, size_t segmentBytes = 16 * 1024 * 1024,
+                      const GroupCommitPolicy& policy = GroupCommitPolicy(), bool useIoUring = false);
+        void close(void);
+        LogError append(const void *payload, size_t size, uint64_t *sequence = nullptr);
+        LogError sync(void);
+        LogError waitDurable(uint64_t sequence);
+        uint64_t durableSequence(void) const { return durableSeq.load(); }
+        LogWriterStats stats(void);
+        void removeOldSegments(void);
+
+        static LogError replay(const std::string& directory, const RecordHandler& handler, bool tailOnly = false);
+        static uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+
+    private:
+        struct Segment
+        {
+            int fd = -1;
+            uint64_t number = 0;
+            size_t offset = 0;  /* Next write position */
+        };
+
+        std::string directory;
+        size_t segmentBytes = 0;
+        GroupCommitPolicy policy;
+        Segment segment;
+        void *ring = nullptr;  /* io_uring instance when enabled */
+
+        std::mutex mutex;
+        std::condition_variable wakeFlusher;
+        std::condition_variable durableChanged;
+        std::vector<uint8_t> pending;
+        std::vector<uint8_t> writing;   /* Batch being committed, kept until it is durable */
+        size_t writingDone = 0;          /* Bytes of it already durable */
+        uint64_t writingLastSeq = 0;
+        uint64_t nextSeq = 1;
+        uint64_t pendingLastSeq = 0;
+        uint64_t pendingSinceUs = 0;
+        bool syncRequested = false;
+        bool stopFlag = false;
+        LogError flusherError = LogError::ERR_SUCCESS;
+        std::atomic<uint64_t> durableSeq{0};
+        LogWriterStats counters;
+        std::thread flusher;
+
+        static constexpr uint32_t minRetryDelayMs = 10;
+        static constexpr uint32_t maxRetryDelayMs = 2000;
+
+        void flusherLoop(void);
+        LogError commit(const std::vector<uint8_t>& batch, size_t& done);
+        LogError openSegment(uint64_t number, size_t offset, bool create, uint64_t firstSeq);
+        LogError writeAndSync(const uint8_t *data, size_t size, size_t offset, bool sync);
+        static std::string segmentPath(const std::string& directory, uint64_t number);
+        static std::vector<uint64_t> listSegments(const std::string& directory);
+        static bool readSegmentHeader(int fd, uint64_t& firstSeq);
+        static size_t scanSegment(int fd, size_t segmentBytes, uint64_t& lastSeq, const RecordHandler *handler);
+};
+
+#endif /* LOG_WRITER_H */
@@ -0,0 +1,105 @@
+#ifndef MESSAGE_POOL_H
+#define MESSAGE_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* Fixed set of equally sized message blocks shared between threads.
+   Free blocks form a stack of indices whose head carries a generation tag,
+   so a block taken and returned while another thread was between reading
+   the head and swapping it cannot be handed out twice. allocate() and
+   deallocate() never lock and never touch the heap; an empty pool makes
+   allocate() return nullptr, and the caller decides what to skip. Objects are
+   built in a block with placement new and must give it back on destruction,
+   typically from a class operator delete. */
+template <typename T, size_t Slots>
+class MessagePool
+{
+    static_assert(Slots > 0 && Slots < 0xFFFFFFFFu, "Slot indices are 32-bit");
+
+    public:
+        MessagePool()
+        {
+            for (size_t i = 0; i < Slots; i++)
+                next[i].store(i + 1 < Slots ? static_cast<uint32_t>(i + 1) : none, std::memory_order_relaxed);
+            head.store(0, std::memory_order_release);
+        }
+
+        MessagePool(const MessagePool&) = delete;
+        MessagePool& operator=(const MessagePool&) = delete;
+
+        void* allocate(void)
+        {
+            uint64_t top = head.load(std::memory_order_acquire);
+            uint32_t index;
+            size_t used;
+
+            for (;;)
+            {
+                index = static_cast<uint32_t>(top);
+                if (index == none)
+                {
+                    exhaustedCount.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                if (head.compare_exchange_weak(top, pack(tagOf(top) + 1, next[index].load(std::memory_order_relaxed)),
+                                               std::memory_order_acq_rel, std::memory_order_acquire))
+                    break;
+            }
+
+            allocatedCount.fetch_add(1, std::memory_order_relaxed);
+            used = inUseCount.fetch_add(1, std::memory_order_relaxed) + 1;
+            for (size_t peak = highWaterCount.load(std::memory_order_relaxed);
+                 used > peak && !highWaterCount.compare_exchange_weak(peak, used, std::memory_order_relaxed);)
+            {
+            }
+            return &blocks[index];
+        }
+
+        void deallocate(void *memory)
+        {
+            uint32_t index = static_cast<uint32_t>(static_cast<Block*>(memory) - blocks);
+            uint64_t top = head.load(std::memory_order_relaxed);
+
+            do
+            {
+                next[index].store(static_cast<uint32_t>(top), std::memory_order_relaxed);
+            } while (!head.compare_exchange_weak(top, pack(tagOf(top) + 1, index),
+                                                 std::memory_order_release, std::memory_order_relaxed));
+            inUseCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        bool owns(const void *memory) const
+        {
+            const Block *block = static_cast<const Block*>(memory);
+            return block >= blocks && block < blocks + Slots;
+        }
+
+        size_t capacity(void) const { return Slots; }
+        size_t inUse(void) const { return inUseCount.load(std::memory_order_relaxed); }
+        size_t highWater(void) const { return highWaterCount.load(std::memory_order_relaxed); }
+        uint64_t allocated(void) const { return allocatedCount.load(std::memory_order_relaxed); }
+        uint64_t exhausted(void) const { return exhaustedCount.load(std::memory_order_relaxed); }
+
+    private:
+        struct alignas(T) Block
+        {
+            unsigned char bytes[sizeof(T)];
+        };
+
+        static constexpr uint32_t none = 0xFFFFFFFFu;
+
+        static uint64_t pack(uint32_t tag, uint32_t index) { return static_cast<uint64_t>(tag) << 32 | index; }
+        static uint32_t tagOf(uint64_t top) { return static_cast<uint32_t>(top >> 32); }
+
+        Block blocks[Slots];
+        std::atomic<uint32_t> next[Slots];      /* Free list link of every block */
+        std::atomic<uint64_t> head{0};          /* Generation tag << 32 | index of the first free block */
+        std::atomic<size_t> inUseCount{0};
+        std::atomic<size_t> highWaterCount{0};
+        std::atomic<uint64_t> allocatedCount{0};
+        std::atomic<uint64_t> exhaustedCount{0};  /* allocate() calls that found no free block */
+};
+
+#endif /* MESSAGE_POOL_H */
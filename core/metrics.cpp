@@ -0,0 +1,333 @@
+/**
+ * @file metrics.cpp
+ * @brief OpenMetrics rendering of live telemetry and driver health.
+ *
+ * Exposed families:
+ * - ps_channel_voltage_volts, ps_channel_current_amperes, ps_channel_power_watts (gauges)
+ * - ps_channel_energy_joules, ps_channel_samples, ps_channel_flagged_samples (counters)
+ * - ps_channel_gaps, ps_channel_gap_seconds, ps_channel_lost_samples (counters, with a gap tracker)
+ * - ps_channel_polls, ps_channel_polls_skipped (counters), ps_channel_prediction_error_amperes
+ *   (histogram), with a poll predictor
+ * - ps_command_latency_seconds (histogram per device)
+ * - ps_commands, ps_command_errors, ps_command_timeouts, ps_command_cancellations, ps_reconnects
+ *   (counters per device)
+ * - ps_link_sent_bytes, ps_link_received_bytes (counters per device)
+ */
+
+#include "metrics.h"
+#include "alloc_tracker.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    void appendLine(std::string& out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    void appendLine(std::string& out, const char *format, ...)
+    {
+        char line[256];
+        va_list args;
+
+        va_start(args, format);
+        int size = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (size > 0)
+            out.append(line, std::min<size_t>(size, sizeof(line) - 1));
+    }
+
+    void appendFamily(std::string& out, const char *name, const char *type, const char *unit, const char *help)
+    {
+        appendLine(out, "# TYPE %s %s\n", name, type);
+        if (unit)
+            appendLine(out, "# UNIT %s %s\n", name, unit);
+        appendLine(out, "# HELP %s %s\n", name, help);
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels exposed.
+ */
+TelemetryMetrics::TelemetryMetrics(size_t channels)
+    : channelCount(channels), snapshots(new ChannelSnapshot[channels])
+{
+}
+
+/**
+ * @brief Registers the health counters of a driver instance.
+ * Must be called before rendering starts.
+ * @param name Value of the device label.
+ * @param health Counters owned by the driver, must outlive this object.
+ */
+void TelemetryMetrics::addDevice(const std::string& name, const PsHealth *health)
+{
+    devices.push_back({name, health});
+}
+
+/**
+ * @brief Publishes a new sample of a channel. Only one thread may publish a given channel.
+ *
+ * Flagged samples are only counted; the gauges keep the last good reading.
+ * Energy is integrated between good samples with consecutive sequence
+ * numbers only, so nothing is extrapolated over a gap.
+ * @param channel Channel number.
+ * @param sample Sample with calibrated voltage and current.
+ */
+void TelemetryMetrics::publish(size_t channel, const Sample& sample)
+{
+    PS_ZERO_ALLOCATION_PROBE("metrics.publish");
+    ChannelSnapshot& snapshot = snapshots[channel];
+    uint32_t sequence = snapshot.sequence.load(std::memory_order_relaxed);
+    double energy = snapshot.energyJoules.load(std::memory_order_relaxed);
+    int64_t lastTimestampMs = snapshot.timestampMs.load(std::memory_order_relaxed);
+    double voltage = sample.voltage;
+    double current = sample.current;
+    int64_t timestampMs = sample.timestampMs;
+    bool contiguous = snapshot.lastGood && sample.sequence == snapshot.lastSequence + 1;
+
+    snapshot.lastSequence = sample.sequence;
+    snapshot.lastGood = sample.usable();
+    if (!sample.good())
+        snapshot.flagged.fetch_add(1, std::memory_order_relaxed);
+    if (!sample.usable())
+        return;
+
+    /* Trapezoidal integration against the previous sample, predicted ones included */
+    if (contiguous && timestampMs > lastTimestampMs)
+    {
+        double lastPower = snapshot.voltage.load(std::memory_order_relaxed) * snapshot.current.load(std::memory_order_relaxed);
+        energy += 0.5 * (lastPower + voltage * current) * (timestampMs - lastTimestampMs) / 1000.0;
+    }
+
+    snapshot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    snapshot.voltage.store(voltage, std::memory_order_relaxed);
+    snapshot.current.store(current, std::memory_order_relaxed);
+    snapshot.energyJoules.store(energy, std::memory_order_relaxed);
+    snapshot.timestampMs.store(timestampMs, std::memory_order_relaxed);
+    snapshot.samples.store(snapshot.samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    snapshot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Reads a consistent copy of a channel snapshot without blocking the writer.
+ */
+TelemetryMetrics::ChannelValues TelemetryMetrics::read(size_t channel) const
+{
+    const ChannelSnapshot& snapshot = snapshots[channel];
+    ChannelValues values;
+    uint32_t before;
+    uint32_t after;
+
+    do
+    {
+        before = snapshot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        values.voltage = snapshot.voltage.load(std::memory_order_relaxed);
+        values.current = snapshot.current.load(std::memory_order_relaxed);
+        values.energyJoules = snapshot.energyJoules.load(std::memory_order_relaxed);
+        values.timestampMs = snapshot.timestampMs.load(std::memory_order_relaxed);
+        values.flagged = snapshot.flagged.load(std::memory_order_relaxed);
+        values.samples = snapshot.samples.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = snapshot.sequence.load(std::memory_order_relaxed);
+        if (before == after)
+            break;
+    } while (true);
+
+    return values;
+}
+
+/**
+ * @brief Renders all metrics in OpenMetrics text format.
+ * @param out Receives the exposition, terminated by "# EOF".
+ */
+void TelemetryMetrics::render(std::string& out) const
+{
+    std::vector<ChannelValues> values(channelCount);
+
+    out.clear();
+    out.reserve(512 + channelCount * 400 + devices.size() * 1500);
+
+    for (size_t ch = 0; ch < channelCount; ch++)
+        values[ch] = read(ch);
+
+    appendFamily(out, "ps_channel_voltage_volts", "gauge", "volts", "Last measured output voltage.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_voltage_volts{channel=\"%u\"} %.9g\n", static_cast<unsigned>(ch), values[ch].voltage);
+
+    appendFamily(out, "ps_channel_current_amperes", "gauge", "amperes", "Last measured output current.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_current_amperes{channel=\"%u\"} %.9g\n", static_cast<unsigned>(ch), values[ch].current);
+
+    appendFamily(out, "ps_channel_power_watts", "gauge", "watts", "Last measured output power.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_power_watts{channel=\"%u\"} %.9g\n", static_cast<unsigned>(ch), values[ch].voltage * values[ch].current);
+
+    appendFamily(out, "ps_channel_energy_joules", "counter", "joules", "Energy delivered since start.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_energy_joules_total{channel=\"%u\"} %.9g\n", static_cast<unsigned>(ch), values[ch].energyJoules);
+
+    appendFamily(out, "ps_channel_samples", "counter", nullptr, "Good samples published.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_samples_total{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch), static_cast<unsigned long long>(values[ch].samples));
+
+    appendFamily(out, "ps_channel_flagged_samples", "counter", nullptr, "Samples published without a fresh reading.");
+    for (size_t ch = 0; ch < channelCount; ch++)
+        appendLine(out, "ps_channel_flagged_samples_total{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch), static_cast<unsigned long long>(values[ch].flagged));
+
+    if (gapTracker)
+    {
+        std::vector<ChannelGapReport> reports;
+        for (size_t ch = 0; ch < std::min(channelCount, gapTracker->channels()); ch++)
+            reports.push_back(gapTracker->report(ch));
+
+        appendFamily(out, "ps_channel_gaps", "counter", nullptr, "Closed gaps in the sample stream.");
+        for (size_t ch = 0; ch < reports.size(); ch++)
+            appendLine(out, "ps_channel_gaps_total{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch), static_cast<unsigned long long>(reports[ch].gaps));
+
+        appendFamily(out, "ps_channel_gap_seconds", "counter", "seconds", "Time spent in closed gaps.");
+        for (size_t ch = 0; ch < reports.size(); ch++)
+            appendLine(out, "ps_channel_gap_seconds_total{channel=\"%u\"} %.3f\n", static_cast<unsigned>(ch), reports[ch].gapMs / 1000.0);
+
+        appendFamily(out, "ps_channel_lost_samples", "counter", nullptr, "Sequence numbers never received.");
+        for (size_t ch = 0; ch < reports.size(); ch++)
+            appendLine(out, "ps_channel_lost_samples_total{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch), static_cast<unsigned long long>(reports[ch].lost));
+    }
+
+    if (pollPredictor)
+    {
+        static const char *const reasons[] = {"uncertainty", "staleness", "setpoint", "first"};
+        std::vector<PollStats> stats;
+        for (size_t ch = 0; ch < std::min(channelCount, pollPredictor->channels()); ch++)
+            stats.push_back(pollPredictor->stats(ch));
+
+        appendFamily(out, "ps_channel_polls", "counter", nullptr, "Instrument reads issued by the poll predictor.");
+        for (size_t ch = 0; ch < stats.size(); ch++)
+            for (int reason = 0; reason < 4; reason++)
+                appendLine(out, "ps_channel_polls_total{channel=\"%u\",reason=\"%s\"} %llu\n", static_cast<unsigned>(ch),
+                           reasons[reason], static_cast<unsigned long long>(stats[ch].polls[reason]));
+
+        appendFamily(out, "ps_channel_polls_skipped", "counter", nullptr, "Sampling ticks served by the prediction.");
+        for (size_t ch = 0; ch < stats.size(); ch++)
+            appendLine(out, "ps_channel_polls_skipped_total{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch),
+                       static_cast<unsigned long long>(stats[ch].skipped));
+
+        appendFamily(out, "ps_channel_prediction_error_amperes", "histogram", "amperes", "Difference between prediction and reading.");
+        for (size_t ch = 0; ch < stats.size(); ch++)
+        {
+            uint64_t cumulative = 0;
+            for (int bucket = 0; bucket < PollStats::errorBuckets; bucket++)
+            {
+                cumulative += stats[ch].errorCount[bucket];
+                if (bucket < PollStats::errorBuckets - 1)
+                    appendLine(out, "ps_channel_prediction_error_amperes_bucket{channel=\"%u\",le=\"%g\"} %llu\n", static_cast<unsigned>(ch),
+                               PollStats::errorBoundsA[bucket], static_cast<unsigned long long>(cumulative));
+                else
+                    appendLine(out, "ps_channel_prediction_error_amperes_bucket{channel=\"%u\",le=\"+Inf\"} %llu\n", static_cast<unsigned>(ch),
+                               static_cast<unsigned long long>(cumulative));
+            }
+            appendLine(out, "ps_channel_prediction_error_amperes_count{channel=\"%u\"} %llu\n", static_cast<unsigned>(ch),
+                       static_cast<unsigned long long>(cumulative));
+            appendLine(out, "ps_channel_prediction_error_amperes_sum{channel=\"%u\"} %.9g\n", static_cast<unsigned>(ch), stats[ch].errorSum);
+        }
+    }
+
+    if (telemetryBus)
+    {
+        std::vector<BusConsumerStats> consumers = telemetryBus->stats();
+        const struct
+        {
+            const char *reason;
+            uint64_t BusConsumerStats::*counter;
+        } skips[] =
+        {
+            {"dropped", &BusConsumerStats::dropped},
+            {"decimated", &BusConsumerStats::decimated},
+            {"coalesced", &BusConsumerStats::coalesced}
+        };
+
+        appendFamily(out, "ps_bus_published", "counter", nullptr, "Samples published on the telemetry bus.");
+        appendLine(out, "ps_bus_published_total %llu\n", static_cast<unsigned long long>(telemetryBus->published()));
+
+        appendFamily(out, "ps_bus_publish_blocked_seconds", "counter", "seconds", "Time the sampler waited for blocking consumers.");
+        appendLine(out, "ps_bus_publish_blocked_seconds_total %.6f\n", telemetryBus->publishBlockedUs() / 1e6);
+
+        appendFamily(out, "ps_bus_consumer_lag_samples", "gauge", nullptr, "Samples published and not yet read by the consumer.");
+        for (const BusConsumerStats& consumer : consumers)
+            appendLine(out, "ps_bus_consumer_lag_samples{consumer=\"%s\",policy=\"%s\"} %llu\n", consumer.name.c_str(),
+                       TelemetryBus::policyName(consumer.policy), static_cast<unsigned long long>(consumer.lag));
+
+        appendFamily(out, "ps_bus_consumer_lag_seconds", "gauge", "seconds", "Age of the oldest sample unread by the consumer.");
+        for (const BusConsumerStats& consumer : consumers)
+            appendLine(out, "ps_bus_consumer_lag_seconds{consumer=\"%s\",policy=\"%s\"} %.3f\n", consumer.name.c_str(),
+                       TelemetryBus::policyName(consumer.policy), consumer.lagMs / 1000.0);
+
+        appendFamily(out, "ps_bus_consumer_delivered", "counter", nullptr, "Samples read by the consumer.");
+        for (const BusConsumerStats& consumer : consumers)
+            appendLine(out, "ps_bus_consumer_delivered_total{consumer=\"%s\"} %llu\n", consumer.name.c_str(),
+                       static_cast<unsigned long long>(consumer.delivered));
+
+        appendFamily(out, "ps_bus_consumer_skipped", "counter", nullptr, "Samples the consumer never read, by backpressure action.");
+        for (const BusConsumerStats& consumer : consumers)
+            for (const auto& skip : skips)
+                appendLine(out, "ps_bus_consumer_skipped_total{consumer=\"%s\",reason=\"%s\"} %llu\n", consumer.name.c_str(),
+                           skip.reason, static_cast<unsigned long long>(consumer.*skip.counter));
+
+        appendFamily(out, "ps_bus_consumer_block_timeouts", "counter", nullptr, "Sampler waits for the consumer that ran out.");
+        for (const BusConsumerStats& consumer : consumers)
+            appendLine(out, "ps_bus_consumer_block_timeouts_total{consumer=\"%s\"} %llu\n", consumer.name.c_str(),
+                       static_cast<unsigned long long>(consumer.timeouts));
+    }
+
+    appendFamily(out, "ps_command_latency_seconds", "histogram", "seconds", "Instrument command round trip time.");
+    for (const Device& device : devices)
+    {
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < PsHealth::latencyBuckets; bucket++)
+        {
+            cumulative += device.health->latencyCount[bucket].load(std::memory_order_relaxed);
+            if (bucket < PsHealth::latencyBuckets - 1)
+                appendLine(out, "ps_command_latency_seconds_bucket{device=\"%s\",le=\"%g\"} %llu\n", device.name.c_str(),
+                           PsHealth::latencyBoundsMs[bucket] / 1000.0, static_cast<unsigned long long>(cumulative));
+            else
+                appendLine(out, "ps_command_latency_seconds_bucket{device=\"%s\",le=\"+Inf\"} %llu\n", device.name.c_str(),
+                           static_cast<unsigned long long>(cumulative));
+        }
+        appendLine(out, "ps_command_latency_seconds_count{device=\"%s\"} %llu\n", device.name.c_str(),
+                   static_cast<unsigned long long>(cumulative));
+        appendLine(out, "ps_command_latency_seconds_sum{device=\"%s\"} %.6f\n", device.name.c_str(),
+                   device.health->latencySumUs.load(std::memory_order_relaxed) / 1e6);
+    }
+
+    const struct
+    {
+        const char *name;
+        const char *help;
+        const std::atomic<uint64_t> PsHealth::*counter;
+    } counters[] =
+    {
+        {"ps_commands", "Commands sent to the instrument.", &PsHealth::commands},
+        {"ps_command_errors", "Failed instrument writes or reads.", &PsHealth::errors},
+        {"ps_command_timeouts", "Instrument reads or writes that timed out.", &PsHealth::timeouts},
+        {"ps_command_cancellations", "Instrument exchanges cut off by a cancellation.", &PsHealth::cancellations},
+        {"ps_reconnects", "Successful reopenings of the instrument session.", &PsHealth::reconnects},
+        {"ps_link_sent_bytes", "Bytes of program messages written to the instrument.", &PsHealth::bytesSent},
+        {"ps_link_received_bytes", "Bytes of replies read from the instrument.", &PsHealth::bytesReceived}
+    };
+    for (const auto& counter : counters)
+    {
+        appendFamily(out, counter.name, "counter", nullptr, counter.help);
+        for (const Device& device : devices)
+            appendLine(out, "%s_total{device=\"%s\"} %llu\n", counter.name, device.name.c_str(),
+                       static_cast<unsigned long long>((device.health->*counter.counter).load(std::memory_order_relaxed)));
+    }
+
+    out.append("# EOF\n");
+}
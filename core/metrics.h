@@ -0,0 +1,74 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "drv_power_supply.h"
+#include "gap_tracker.h"
+#include "poll_predictor.h"
+#include "telemetry_bus.h"
+#include "sample.h"
+
+/* Pre-aggregated telemetry for monitoring.
+   Samplers publish into per-channel snapshots protected by a sequence lock
+   (one writer per channel, never blocked). Rendering only reads the
+   snapshots and the driver health counters, so a scrape never touches an
+   instrument nor waits on the sampler. */
+class TelemetryMetrics
+{
+    public:
+        explicit TelemetryMetrics(size_t channels);
+
+        size_t channels(void) const { return channelCount; }
+        void publish(size_t channel, const Sample& sample);
+        void addDevice(const std::string& name, const PsHealth *health);
+        void setGapTracker(const GapTracker *tracker) { gapTracker = tracker; }
+        void setPollPredictor(const PollPredictor *predictor) { pollPredictor = predictor; }
+        void setTelemetryBus(const TelemetryBus *bus) { telemetryBus = bus; }
+        void render(std::string& out) const;
+
+    private:
+        struct ChannelSnapshot
+        {
+            std::atomic<uint32_t> sequence{0};   /* Odd while the writer updates the fields */
+            std::atomic<double> voltage{0.0};
+            std::atomic<double> current{0.0};
+            std::atomic<double> energyJoules{0.0};
+            std::atomic<int64_t> timestampMs{0};
+            std::atomic<uint64_t> samples{0};
+            std::atomic<uint64_t> flagged{0};    /* Samples without a fresh reading */
+            uint64_t lastSequence = 0;           /* Writer side only */
+            bool lastGood = false;               /* Writer side only */
+        };
+
+        struct ChannelValues
+        {
+            double voltage;
+            double current;
+            double energyJoules;
+            int64_t timestampMs;
+            uint64_t samples;
+            uint64_t flagged;
+        };
+
+        struct Device
+        {
+            std::string name;
+            const PsHealth *health;
+        };
+
+        size_t channelCount;
+        std::unique_ptr<ChannelSnapshot[]> snapshots;
+        std::vector<Device> devices;  /* Registered before serving starts */
+        const GapTracker *gapTracker = nullptr;
+        const PollPredictor *pollPredictor = nullptr;
+        const TelemetryBus *telemetryBus = nullptr;
+
+        ChannelValues read(size_t channel) const;
+};
+
+#endif /* METRICS_H */
@@ -0,0 +1,161 @@
+/**
+ * @file metrics_benchmark.cpp
+ * @brief Scrape render time of the OpenMetrics endpoint for many channels.
+ */
+
+#include "metrics_benchmark.h"
+#include "gap_tracker.h"
+#include "metrics.h"
+#include "poll_predictor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* Fills every channel and counter with plausible values */
+    void seed(TelemetryMetrics& metrics, GapTracker& gaps, PollPredictor& predictor, PsHealth& health)
+    {
+        for (size_t channel = 0; channel < metrics.channels(); channel++)
+        {
+            for (uint64_t n = 1; n <= 16; n++)
+            {
+                Sample sample;
+
+                sample.sequence = n;
+                sample.timestampMs = 1700000000000LL + static_cast<int64_t>(n) * 10;
+                sample.voltage = 12.0 + channel * 1e-3;
+                sample.current = 0.5 + n * 1e-4;
+                sample.latencyUs = 900;
+                sample.quality = (n == 8) ? SAMPLE_TIMEOUT : SAMPLE_GOOD;
+                metrics.publish(channel, sample);
+                gaps.record(channel, sample);
+                if (predictor.shouldPoll(channel, sample.timestampMs))
+                    predictor.update(channel, sample.timestampMs, sample.current);
+            }
+        }
+        for (uint64_t n = 0; n < 1000; n++)
+        {
+            health.commands++;
+            health.recordLatency(500 + (n % 50) * 100);
+        }
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param channels Channels exposed by the page.
+ * @param scrapes Scrapes timed per load.
+ */
+MetricsBenchmark::MetricsBenchmark(size_t channels, unsigned scrapes)
+    : channels(std::max<size_t>(channels, 1)), scrapes(std::max(scrapes, 10u))
+{
+}
+
+/**
+ * @brief Times the scrapes at rest, then under sampling load.
+ */
+std::vector<ScrapeResult> MetricsBenchmark::run(void)
+{
+    TelemetryMetrics metrics(channels);
+    GapTracker gaps(channels);
+    PollPredictor predictor(channels);
+    PsHealth health;
+    std::vector<ScrapeResult> results;
+    std::string page;
+
+    metrics.addDevice("ps0", &health);
+    metrics.setGapTracker(&gaps);
+    metrics.setPollPredictor(&predictor);
+    seed(metrics, gaps, predictor, health);
+
+    for (bool loaded : {false, true})
+    {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> published{0};
+        std::vector<double> times;
+        std::thread sampler;
+        ScrapeResult result;
+
+        /* 100 Hz per channel, published in 10 ms rounds */
+        if (loaded)
+        {
+            sampler = std::thread([&] {
+                std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+                uint64_t sequence = 17;
+
+                while (!stop.load())
+                {
+                    for (size_t channel = 0; channel < channels; channel++)
+                    {
+                        Sample sample;
+
+                        sample.sequence = sequence;
+                        sample.timestampMs = 1700000000000LL + static_cast<int64_t>(sequence) * 10;
+                        sample.voltage = 12.0;
+                        sample.current = 0.5 + (sequence % 100) * 1e-4;
+                        metrics.publish(channel, sample);
+                    }
+                    published += channels;
+                    sequence++;
+                    next += std::chrono::milliseconds(10);
+                    std::this_thread::sleep_until(next);
+                }
+            });
+        }
+
+        for (unsigned scrape = 0; scrape < scrapes; scrape++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            page.clear();
+            metrics.render(page);
+            times.push_back(elapsedMs(start));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        stop = true;
+        if (sampler.joinable())
+            sampler.join();
+
+        std::sort(times.begin(), times.end());
+        result.load = loaded ? "100 Hz sampler" : "at rest";
+        result.channels = channels;
+        result.bytes = page.size();
+        for (double time : times)
+            result.meanMs += time / times.size();
+        result.p99Ms = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+        result.maxMs = times.back();
+        result.published = published.load();
+        results.push_back(result);
+    }
+    return results;
+}
+
+/**
+ * @brief Formats the results.
+ * @param results Results of run().
+ * @param out Text is appended here.
+ */
+void MetricsBenchmark::render(const std::vector<ScrapeResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-16s %9s %10s %9s %9s %9s %11s\n",
+             "load", "channels", "KiB", "mean ms", "p99 ms", "max ms", "published");
+    out += line;
+    for (const ScrapeResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-16s %9zu %10.1f %9.3f %9.3f %9.3f %11llu\n", result.load.c_str(),
+                 result.channels, result.bytes / 1024.0, result.meanMs, result.p99Ms, result.maxMs,
+                 static_cast<unsigned long long>(result.published));
+        out += line;
+    }
+}
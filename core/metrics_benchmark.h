@@ -0,0 +1,40 @@
+#ifndef METRICS_BENCHMARK_H
+#define METRICS_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Cost of rendering one scrape */
+struct ScrapeResult
+{
+    std::string load;
+    size_t channels = 0;
+    size_t bytes = 0;           /* Of one scrape */
+    double meanMs = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    uint64_t published = 0;     /* Samples published by the sampler during the scrapes */
+};
+
+/* Renders the OpenMetrics page of a large channel count, the way the
+   metrics endpoint does for every scrape, with the gap tracker, poll
+   predictor and a device's health counters attached. Scrapes are timed
+   once with the snapshots at rest and once while a sampler thread
+   publishes 100 Hz samples to every channel, so the seqlock retries are
+   included. */
+class MetricsBenchmark
+{
+    public:
+        MetricsBenchmark(size_t channels, unsigned scrapes);
+
+        std::vector<ScrapeResult> run(void);
+        static void render(const std::vector<ScrapeResult>& results, std::string& out);
+
+    private:
+        size_t channels;
+        unsigned scrapes;
+};
+
+#endif /* METRICS_BENCHMARK_H */
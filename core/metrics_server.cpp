@@ -0,0 +1,120 @@
+/**
+ * @file metrics_server.cpp
+ * @brief Localhost OpenMetrics endpoint.
+ *
+ * Only `GET /metrics` is served, one request per connection. The exposition
+ * is rendered from the atomic snapshots of TelemetryMetrics, so a scrape
+ * never issues instrument commands and never waits on the sampling thread.
+ */
+
+#include "metrics_server.h"
+#include <QDebug>
+#include <QHostAddress>
+
+/**
+ * @brief Constructor.
+ * @param metrics Metrics rendered on every scrape.
+ * @param parent Parent QObject.
+ */
+MetricsServer::MetricsServer(const TelemetryMetrics *metrics, QObject *parent)
+    : QObject(parent), metrics(metrics)
+{
+    connect(&server, &QTcpServer::newConnection, this, &MetricsServer::on_newConnection);
+}
+
+/**
+ * @brief Starts listening on the loopback interface.
+ * @param port TCP port.
+ * @return True if the port could be bound.
+ */
+bool MetricsServer::start(quint16 port)
+{
+    if (!server.listen(QHostAddress::LocalHost, port))
+    {
+        qDebug() << "Metrics: Failed to listen on port" << port << server.errorString();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops listening. Connections in progress are left to finish.
+ */
+void MetricsServer::stop(void)
+{
+    server.close();
+}
+
+quint16 MetricsServer::port(void) const
+{
+    return server.serverPort();
+}
+
+/**
+ * @brief Slot called when a client connects.
+ */
+void MetricsServer::on_newConnection(void)
+{
+    while (server.hasPendingConnections())
+    {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, &MetricsServer::on_readyRead);
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+    }
+}
+
+/**
+ * @brief Slot called when request bytes arrive. Replies once the header is complete.
+ */
+void MetricsServer::on_readyRead(void)
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    QByteArray request;
+    QList<QByteArray> requestLine;
+
+    if (socket == nullptr)
+        return;
+
+    /* Wait for the full request header */
+    request = socket->peek(maxRequestSize);
+    if (!request.contains("\r\n\r\n"))
+    {
+        if (request.size() >= maxRequestSize)
+            socket->abort();
+        return;
+    }
+    socket->readAll();
+
+    requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    if (requestLine.size() < 2 || requestLine[0] != "GET")
+    {
+        reply(socket, "405 Method Not Allowed", "text/plain", "", 0);
+        return;
+    }
+    if (requestLine[1] != "/metrics")
+    {
+        reply(socket, "404 Not Found", "text/plain", "", 0);
+        return;
+    }
+
+    metrics->render(body);
+    reply(socket, "200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", body.data(), body.size());
+}
+
+/**
+ * @brief Writes a complete HTTP response and closes the connection.
+ */
+void MetricsServer::reply(QTcpSocket *socket, const QByteArray& status, const QByteArray& contentType, const char *data, qint64 size)
+{
+    QByteArray header;
+
+    header.reserve(160);
+    header += "HTTP/1.1 " + status + "\r\n";
+    header += "Content-Type: " + contentType + "\r\n";
+    header += "Content-Length: " + QByteArray::number(size) + "\r\n";
+    header += "Connection: close\r\n\r\n";
+    socket->write(header);
+    if (size > 0)
+        socket->write(data, size);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,35 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "metrics.h"
+
+/* Minimal HTTP endpoint serving GET /metrics on localhost.
+   Runs in the thread that owns it and only renders pre-aggregated metrics. */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(const TelemetryMetrics *metrics, QObject *parent = nullptr);
+
+    bool start(quint16 port);
+    void stop(void);
+    quint16 port(void) const;
+
+private slots:
+    void on_newConnection(void);
+    void on_readyRead(void);
+
+private:
+    const TelemetryMetrics *metrics;  /* Metrics rendered on every scrape */
+    QTcpServer server;
+    std::string body;                 /* Reused exposition buffer */
+    int maxRequestSize = 8192;        /* Requests larger than this are dropped */
+
+    void reply(QTcpSocket *socket, const QByteArray& status, const QByteArray& contentType, const char *data, qint64 size);
+};
+
+#endif /* METRICS_SERVER_H */
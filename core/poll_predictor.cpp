@@ -0,0 +1,193 @@
+/**
+ * @file poll_predictor.cpp
+ * @brief Kalman-filter based decision of when a reading is worth a round trip.
+ *
+ * Model: x(t + dt) = x(t) + w, with Var(w) = q * dt, and z = x + v, with
+ * Var(v) = R. q is re-estimated from every innovation (exponential average
+ * of the excess innovation energy per second), so noisy or drifting loads
+ * are polled more often than steady ones.
+ */
+
+#include "poll_predictor.h"
+#include "alloc_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels.
+ * @param policy Polling bounds and noise model.
+ */
+PollPredictor::PollPredictor(size_t channels, const PollPolicy& policy)
+    : policy(policy), states(channels)
+{
+}
+
+/**
+ * @brief Variance of the prediction of a channel at a given time.
+ */
+double PollPredictor::varianceAt(const ChannelState& state, int64_t nowMs) const
+{
+    int64_t elapsedMs = std::max<int64_t>(0, nowMs - state.lastUpdateMs);
+    return state.variance + state.processNoise * elapsedMs / 1000.0;
+}
+
+/**
+ * @brief Decides whether a sampling tick must read the instrument.
+ * Called once per tick; ticks answered with false are served by predict().
+ * @param channel Channel number.
+ * @param nowMs Current time in milliseconds.
+ */
+bool PollPredictor::shouldPoll(size_t channel, int64_t nowMs)
+{
+    PS_ZERO_ALLOCATION_PROBE("predictor.shouldPoll");
+    std::lock_guard<std::mutex> lock(mutex);
+    ChannelState& state = states[channel];
+    PollReason reason;
+
+    state.stats.ticks++;
+    if (!state.initialized)
+        reason = PollReason::FIRST;
+    else if (state.setpointChanged)
+        reason = PollReason::SETPOINT;
+    else if (nowMs - state.lastUpdateMs >= policy.maxStalenessMs)
+        reason = PollReason::STALENESS;
+    else if (std::sqrt(varianceAt(state, nowMs)) >= policy.maxUncertainty)
+        reason = PollReason::UNCERTAINTY;
+    else
+    {
+        state.stats.skipped++;
+        return false;
+    }
+
+    state.stats.polls[static_cast<int>(reason)]++;
+    return true;
+}
+
+/**
+ * @brief Feeds a fresh reading into the filter of a channel.
+ * @param channel Channel number.
+ * @param nowMs Time of the reading in milliseconds.
+ * @param reading Measured value.
+ */
+void PollPredictor::update(size_t channel, int64_t nowMs, double reading)
+{
+    PS_ZERO_ALLOCATION_PROBE("predictor.update");
+    std::lock_guard<std::mutex> lock(mutex);
+    ChannelState& state = states[channel];
+    PollStats& stats = state.stats;
+    double measurementNoise = policy.measurementNoise;
+    double elapsed;
+    double predicted;
+    double innovation;
+    double innovationVariance;
+    double error;
+    int bucket = 0;
+
+    if (!state.initialized)
+    {
+        state.initialized = true;
+        state.setpointChanged = false;
+        state.estimate = reading;
+        state.variance = measurementNoise;
+        state.processNoise = policy.minProcessNoise;
+        state.lastUpdateMs = nowMs;
+        return;
+    }
+
+    elapsed = std::max(1e-3, (nowMs - state.lastUpdateMs) / 1000.0);
+    predicted = varianceAt(state, nowMs);
+    innovation = reading - state.estimate;
+    innovationVariance = predicted + measurementNoise;
+
+    /* Prediction error distribution */
+    error = std::fabs(innovation);
+    while (bucket < PollStats::errorBuckets - 1 && error > PollStats::errorBoundsA[bucket])
+        bucket++;
+    stats.errorCount[bucket]++;
+    stats.errorSum += error;
+    stats.errorMax = std::max(stats.errorMax, error);
+
+    if (state.setpointChanged || error > policy.stepSigmas * std::sqrt(innovationVariance))
+    {
+        /* Load step or new setpoint: restart from the reading and expect more movement */
+        if (!state.setpointChanged)
+            stats.steps++;
+        state.estimate = reading;
+        state.variance = measurementNoise;
+        state.processNoise = std::max(state.processNoise, innovation * innovation / elapsed);
+    }
+    else
+    {
+        double gain = predicted / innovationVariance;
+        double excess = std::max(0.0, innovation * innovation - innovationVariance);
+
+        state.estimate += gain * innovation;
+        state.variance = (1.0 - gain) * predicted;
+        state.processNoise = std::max(policy.minProcessNoise, 0.8 * state.processNoise + 0.2 * excess / elapsed);
+    }
+    state.setpointChanged = false;
+    state.lastUpdateMs = nowMs;
+}
+
+/**
+ * @brief Predicted reading of a channel.
+ * @param channel Channel number.
+ * @param nowMs Time of the prediction in milliseconds.
+ * @param sigma Receives the 1-sigma uncertainty, may be nullptr.
+ */
+double PollPredictor::predict(size_t channel, int64_t nowMs, double *sigma) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const ChannelState& state = states[channel];
+
+    if (sigma)
+        *sigma = std::sqrt(varianceAt(state, nowMs));
+    return state.estimate;
+}
+
+/**
+ * @brief Forces a read at the next tick. May be called from any thread.
+ */
+void PollPredictor::setpointChanged(size_t channel)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    states[channel].setpointChanged = true;
+}
+
+PollStats PollPredictor::stats(size_t channel) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return states[channel].stats;
+}
+
+/**
+ * @brief Renders a human readable report, one line per channel.
+ * @param out The report is appended here.
+ */
+void PollPredictor::render(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    char line[320];
+
+    for (size_t ch = 0; ch < states.size(); ch++)
+    {
+        const PollStats& stats = states[ch].stats;
+        uint64_t polls = stats.totalPolls();
+        uint64_t errors = 0;
+
+        for (int bucket = 0; bucket < PollStats::errorBuckets; bucket++)
+            errors += stats.errorCount[bucket];
+        snprintf(line, sizeof(line),
+                 "channel %u: ticks %llu polls %llu (uncertainty %llu staleness %llu setpoint %llu) skipped %llu (%.1f%%) "
+                 "steps %llu | prediction error mean %.3g A max %.3g A\n",
+                 static_cast<unsigned>(ch), static_cast<unsigned long long>(stats.ticks), static_cast<unsigned long long>(polls),
+                 static_cast<unsigned long long>(stats.polls[static_cast<int>(PollReason::UNCERTAINTY)]),
+                 static_cast<unsigned long long>(stats.polls[static_cast<int>(PollReason::STALENESS)]),
+                 static_cast<unsigned long long>(stats.polls[static_cast<int>(PollReason::SETPOINT)]),
+                 static_cast<unsigned long long>(stats.skipped), stats.ticks ? 100.0 * stats.skipped / stats.ticks : 0.0,
+                 static_cast<unsigned long long>(stats.steps), errors ? stats.errorSum / errors : 0.0, stats.errorMax);
+        out += line;
+    }
+}
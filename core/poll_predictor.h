@@ -0,0 +1,84 @@
+#ifndef POLL_PREDICTOR_H
+#define POLL_PREDICTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* When a channel has to be read instead of predicted */
+struct PollPolicy
+{
+    double maxUncertainty = 0.005;    /* Poll when the 1-sigma prediction error exceeds this (A) */
+    int64_t maxStalenessMs = 10000;   /* Poll at least this often whatever the model says */
+    double measurementNoise = 1e-6;   /* Variance of one reading (A^2) */
+    double minProcessNoise = 1e-8;    /* Floor of the random walk variance rate (A^2/s) */
+    double stepSigmas = 4.0;          /* Innovations beyond this many sigmas are load steps */
+};
+
+enum class PollReason
+{
+    UNCERTAINTY = 0,  /* Prediction uncertainty reached the bound */
+    STALENESS,        /* Maximum staleness reached */
+    SETPOINT,         /* The output was reprogrammed */
+    FIRST             /* No reading yet */
+};
+
+/* Per-channel polling and prediction figures */
+struct PollStats
+{
+    static constexpr int errorBuckets = 10;
+    static constexpr double errorBoundsA[errorBuckets - 1] = {1e-4, 2e-4, 5e-4, 1e-3, 2e-3, 5e-3, 1e-2, 2e-2, 5e-2};
+
+    uint64_t ticks = 0;               /* Sampling opportunities */
+    uint64_t polls[4] = {};           /* Reads issued, per PollReason */
+    uint64_t skipped = 0;             /* Ticks served by the prediction */
+    uint64_t steps = 0;               /* Load steps detected */
+    uint64_t errorCount[errorBuckets] = {};  /* |prediction - reading| per bucket, last one is +Inf */
+    double errorSum = 0.0;
+    double errorMax = 0.0;
+
+    uint64_t totalPolls(void) const { return polls[0] + polls[1] + polls[2] + polls[3]; }
+};
+
+/* Model-based polling of slowly varying readings.
+   Each channel runs a scalar Kalman filter over a random walk whose
+   variance rate adapts to the observed innovations. Between readings the
+   prediction variance grows with time; a read is due once its square root
+   reaches the bound, the staleness limit is hit or a setpoint changed.
+   An innovation beyond stepSigmas resets the filter to the reading, so a
+   load step costs one surprise and a few quick polls, not a lag. */
+class PollPredictor
+{
+    public:
+        explicit PollPredictor(size_t channels, const PollPolicy& policy = PollPolicy());
+
+        size_t channels(void) const { return states.size(); }
+        bool shouldPoll(size_t channel, int64_t nowMs);
+        void update(size_t channel, int64_t nowMs, double reading);
+        double predict(size_t channel, int64_t nowMs, double *sigma = nullptr) const;
+        void setpointChanged(size_t channel);
+        PollStats stats(size_t channel) const;
+        void render(std::string& out) const;
+
+    private:
+        struct ChannelState
+        {
+            bool initialized = false;
+            bool setpointChanged = false;
+            double estimate = 0.0;        /* Filtered reading */
+            double variance = 0.0;        /* Of the estimate at lastUpdateMs */
+            double processNoise = 0.0;    /* Random walk variance rate (A^2/s) */
+            int64_t lastUpdateMs = 0;
+            PollStats stats;
+        };
+
+        PollPolicy policy;
+        mutable std::mutex mutex;
+        std::vector<ChannelState> states;
+
+        double varianceAt(const ChannelState& state, int64_t nowMs) const;
+};
+
+#endif /* POLL_PREDICTOR_H */
@@ -0,0 +1,253 @@
+/**
+ * @file preset_store.cpp
+ * @brief Named instrument presets and the memory slots holding them.
+ *
+ * The store is serialized as text, one line per preset and one per slot:
+ *   preset <voltage> <current limit> <0|1> <name>
+ *   slot <serial number> <slot> <last used> <voltage> <current limit> <0|1> <name>
+ * Names come last so they may contain spaces.
+ */
+
+#include "preset_store.h"
+#include <algorithm>
+#include <sstream>
+
+/**
+ * @brief Adds or replaces a preset.
+ * @param name Preset name, not empty.
+ * @param preset Settings of the preset.
+ */
+void PresetStore::setPreset(const std::string& name, const Preset& preset)
+{
+    presets[name] = preset;
+}
+
+/**
+ * @brief Settings of a preset.
+ * @return The preset, nullptr when there is none with that name.
+ */
+const Preset* PresetStore::find(const std::string& name) const
+{
+    auto entry = presets.find(name);
+    return entry == presets.end() ? nullptr : &entry->second;
+}
+
+/**
+ * @brief Removes a preset and forgets the slots holding it.
+ */
+void PresetStore::remove(const std::string& name)
+{
+    presets.erase(name);
+    for (auto& instrument : slots)
+    {
+        for (auto entry = instrument.second.begin(); entry != instrument.second.end();)
+        {
+            if (entry->second.name == name)
+                entry = instrument.second.erase(entry);
+            else
+                ++entry;
+        }
+    }
+}
+
+/**
+ * @brief Names of all presets, in alphabetical order.
+ */
+std::vector<std::string> PresetStore::names(void) const
+{
+    std::vector<std::string> result;
+
+    for (const auto& entry : presets)
+        result.push_back(entry.first);
+    return result;
+}
+
+/**
+ * @brief Slot of an instrument holding the current settings of a preset.
+ * @param serialNumber Instrument serial number from *IDN?.
+ * @param name Preset name.
+ * @return Slot number, 0 when no slot holds the preset as it is now.
+ */
+int PresetStore::slotFor(const std::string& serialNumber, const std::string& name) const
+{
+    auto instrument = slots.find(serialNumber);
+    const Preset *preset = find(name);
+
+    if (instrument == slots.end() || preset == nullptr)
+        return 0;
+    for (const auto& entry : instrument->second)
+    {
+        if (entry.second.name == name && entry.second.saved == *preset)
+            return entry.first;
+    }
+    return 0;
+}
+
+/**
+ * @brief Slot to save a preset to: the one already holding an older version
+ * of it, else a free one, else the least recently used one.
+ * @param serialNumber Instrument serial number from *IDN?.
+ * @param name Preset name.
+ * @param slots Slots of the model, numbered from 1.
+ * @return Slot number, 0 when the model has no slots.
+ */
+int PresetStore::assignSlot(const std::string& serialNumber, const std::string& name, int slots) const
+{
+    auto instrument = this->slots.find(serialNumber);
+    int oldest = 1;
+    uint64_t oldestUse = UINT64_MAX;
+
+    if (slots <= 0)
+        return 0;
+    if (instrument == this->slots.end())
+        return 1;
+
+    for (const auto& entry : instrument->second)
+    {
+        if (entry.second.name == name && entry.first <= slots)
+            return entry.first;
+    }
+    for (int slot = 1; slot <= slots; slot++)
+    {
+        auto entry = instrument->second.find(slot);
+        if (entry == instrument->second.end())
+            return slot;
+        if (entry->second.lastUsed < oldestUse)
+        {
+            oldest = slot;
+            oldestUse = entry->second.lastUsed;
+        }
+    }
+    return oldest;
+}
+
+/**
+ * @brief Records that a slot now holds the current settings of a preset.
+ * @param serialNumber Instrument serial number from *IDN?.
+ * @param slot Slot saved to.
+ * @param name Preset saved.
+ */
+void PresetStore::recordSaved(const std::string& serialNumber, int slot, const std::string& name)
+{
+    const Preset *preset = find(name);
+    SlotEntry& entry = slots[serialNumber][slot];
+
+    entry.name = name;
+    entry.saved = preset ? *preset : Preset();
+    entry.lastUsed = ++useClock;
+}
+
+/**
+ * @brief Records a recall of a slot, which keeps it from being given away.
+ */
+void PresetStore::recordUsed(const std::string& serialNumber, int slot)
+{
+    auto instrument = slots.find(serialNumber);
+
+    if (instrument == slots.end())
+        return;
+    auto entry = instrument->second.find(slot);
+    if (entry != instrument->second.end())
+        entry->second.lastUsed = ++useClock;
+}
+
+/**
+ * @brief Stops trusting a slot, after it was found to hold other settings.
+ */
+void PresetStore::forgetSlot(const std::string& serialNumber, int slot)
+{
+    auto instrument = slots.find(serialNumber);
+
+    if (instrument != slots.end())
+        instrument->second.erase(slot);
+}
+
+/**
+ * @brief Serializes presets and slots as text.
+ * @return Text accepted by deserialize().
+ */
+std::string PresetStore::serialize(void) const
+{
+    std::ostringstream out;
+    out.precision(17);
+
+    for (const auto& entry : presets)
+    {
+        const Preset& preset = entry.second;
+        out << "preset " << preset.voltage << ' ' << preset.currentLimit << ' ' << (preset.output ? 1 : 0)
+            << ' ' << entry.first << '\n';
+    }
+    for (const auto& instrument : slots)
+    {
+        for (const auto& entry : instrument.second)
+        {
+            const SlotEntry& slot = entry.second;
+            out << "slot " << instrument.first << ' ' << entry.first << ' ' << slot.lastUsed << ' '
+                << slot.saved.voltage << ' ' << slot.saved.currentLimit << ' ' << (slot.saved.output ? 1 : 0)
+                << ' ' << slot.name << '\n';
+        }
+    }
+    return out.str();
+}
+
+/**
+ * @brief Replaces presets and slots with the ones parsed from text.
+ * @param text Text produced by serialize().
+ * @return True on success. On failure the store is left unchanged.
+ */
+bool PresetStore::deserialize(const std::string& text)
+{
+    PresetStore parsed;
+    std::istringstream in(text);
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        std::string serialNumber;
+        std::string name;
+        Preset preset;
+        SlotEntry slot;
+        int number = 0;
+        int output = 0;
+
+        if (line.empty())
+            continue;
+        fields >> key;
+        if (key == "preset")
+        {
+            if (!(fields >> preset.voltage >> preset.currentLimit >> output))
+                return false;
+        }
+        else if (key == "slot")
+        {
+            if (!(fields >> serialNumber >> number >> slot.lastUsed >> preset.voltage >> preset.currentLimit >> output) ||
+                number < 0)
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+        std::getline(fields >> std::ws, name);
+        if (name.empty())
+            return false;
+        preset.output = (output != 0);
+
+        if (key == "preset")
+        {
+            parsed.presets[name] = preset;
+        }
+        else
+        {
+            slot.name = name;
+            slot.saved = preset;
+            parsed.slots[serialNumber][number] = slot;
+            parsed.useClock = std::max(parsed.useClock, slot.lastUsed);
+        }
+    }
+
+    *this = parsed;
+    return true;
+}
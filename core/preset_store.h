@@ -0,0 +1,59 @@
+#ifndef PRESET_STORE_H
+#define PRESET_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Instrument configuration switched to as a whole */
+struct Preset
+{
+    double voltage = 0.0;
+    double currentLimit = 1.0;
+    bool output = false;
+
+    bool operator==(const Preset& other) const
+    {
+        return voltage == other.voltage && currentLimit == other.currentLimit && output == other.output;
+    }
+    bool operator!=(const Preset& other) const { return !(*this == other); }
+};
+
+/* Named presets and the instrument memory slots holding them. Slots are
+   tracked per instrument serial number, and a slot is trusted to hold a
+   preset only while the preset is unchanged since this store saved it
+   there; editing a preset makes its next use save it again. When every
+   slot is taken, the least recently used one is given away. */
+class PresetStore
+{
+    public:
+        void setPreset(const std::string& name, const Preset& preset);
+        const Preset* find(const std::string& name) const;
+        void remove(const std::string& name);
+        std::vector<std::string> names(void) const;
+
+        int slotFor(const std::string& serialNumber, const std::string& name) const;
+        int assignSlot(const std::string& serialNumber, const std::string& name, int slots) const;
+        void recordSaved(const std::string& serialNumber, int slot, const std::string& name);
+        void recordUsed(const std::string& serialNumber, int slot);
+        void forgetSlot(const std::string& serialNumber, int slot);
+
+        std::string serialize(void) const;
+        bool deserialize(const std::string& text);
+
+    private:
+        struct SlotEntry
+        {
+            std::string name;       /* Preset saved in the slot */
+            Preset saved;           /* Its settings when saved */
+            uint64_t lastUsed = 0;  /* Value of useClock at the last save or recall */
+        };
+
+        std::map<std::string, Preset> presets;
+        std::map<std::string, std::map<int, SlotEntry>> slots;  /* Serial number, then slot */
+        uint64_t useClock = 0;
+};
+
+#endif /* PRESET_STORE_H */
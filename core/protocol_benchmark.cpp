@@ -0,0 +1,197 @@
+/**
+ * @file protocol_benchmark.cpp
+ * @brief Binary telemetry framing against a text line per sample.
+ *
+ * Readings are int32 microvolt and microamp counts. The text form prints
+ * them as volts and amps with six decimals, which is exact for those
+ * counts, and is parsed back with strtod.
+ */
+
+#include "protocol_benchmark.h"
+#include "telemetry_protocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* Synthetic stream: frames x channels counts, row per frame */
+    struct Stream
+    {
+        std::vector<int64_t> timestampMs;
+        std::vector<int32_t> voltage;
+        std::vector<int32_t> current;
+    };
+
+    Stream generate(size_t channels, size_t frames, double changedRatio)
+    {
+        Stream stream;
+        uint64_t state = 0x2545F4914F6CDD1DULL;
+        uint64_t threshold = static_cast<uint64_t>(changedRatio * 1000000.0);
+
+        stream.timestampMs.resize(frames);
+        stream.voltage.resize(frames * channels);
+        stream.current.resize(frames * channels);
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+            stream.timestampMs[frame] = 1700000000000LL + static_cast<int64_t>(frame) * 10;
+            for (size_t ch = 0; ch < channels; ch++)
+            {
+                size_t at = frame * channels + ch;
+                int32_t voltage = frame ? stream.voltage[at - channels] : 12000000 + static_cast<int32_t>(ch) * 1000;
+                int32_t current = frame ? stream.current[at - channels] : 500000;
+
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                if ((state >> 40) % 1000000 < threshold)
+                {
+                    voltage += static_cast<int32_t>((state >> 20) % 21) - 10;
+                    current += static_cast<int32_t>((state >> 8) % 401) - 200;
+                }
+                stream.voltage[at] = voltage;
+                stream.current[at] = current;
+            }
+        }
+        return stream;
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param channels Channels per frame.
+ * @param frames Frames of the stream.
+ */
+ProtocolBenchmark::ProtocolBenchmark(size_t channels, size_t frames)
+    : channels(std::max<size_t>(channels, 1)), frames(std::max<size_t>(frames, 2))
+{
+}
+
+/**
+ * @brief Encodes and decodes the stream both ways.
+ * @param changedRatio Share of the channels changing per frame, 0 to 1.
+ * @return Binary frames first, then text lines.
+ */
+std::vector<ProtocolResult> ProtocolBenchmark::run(double changedRatio)
+{
+    Stream stream = generate(channels, frames, std::min(std::max(changedRatio, 0.0), 1.0));
+    std::vector<ProtocolResult> results(2);
+    ProtocolResult& binary = results[0];
+    ProtocolResult& text = results[1];
+    std::chrono::steady_clock::time_point start;
+
+    binary.encoding = "binary frames";
+    text.encoding = "text lines";
+    binary.changedRatio = text.changedRatio = changedRatio;
+    binary.samples = text.samples = static_cast<uint64_t>(frames) * channels;
+
+    {
+        std::vector<TelemetryChannelInfo> info(channels);
+        TelemetryEncoder encoder(info);
+        TelemetryDecoder decoder;
+        std::vector<uint8_t> buffer;
+        std::vector<int32_t> lastFrameVoltage(channels);
+        size_t offset = 0;
+        size_t consumed;
+        TelemetryDecoder::Frame frame;
+        uint64_t mismatches = 0;
+        size_t decodedFrames = 0;
+
+        for (size_t ch = 0; ch < channels; ch++)
+            info[ch].name = "ch" + std::to_string(ch);
+        buffer.reserve(frames * (8 + channels / 4));
+
+        start = std::chrono::steady_clock::now();
+        encoder.encodeSchema(buffer);
+        for (size_t n = 0; n < frames; n++)
+            encoder.encodeSamples(stream.timestampMs[n], &stream.voltage[n * channels], &stream.current[n * channels], buffer);
+        binary.encodeMs = elapsedMs(start);
+        binary.bytes = buffer.size();
+
+        start = std::chrono::steady_clock::now();
+        while (TelemetryDecoder::parse(buffer.data() + offset, buffer.size() - offset, consumed, frame) ==
+               TelemetryDecoder::DecodeStatus::FRAME)
+        {
+            decoder.apply(frame);
+            offset += consumed;
+            if (frame.type == TelemetryFrameType::KEYFRAME || frame.type == TelemetryFrameType::DELTA)
+            {
+                /* The decoder state must equal the encoded row */
+                const std::vector<int32_t>& voltage = decoder.voltage();
+                const std::vector<int32_t>& current = decoder.current();
+                size_t row = decodedFrames++ * channels;
+
+                for (size_t ch = 0; ch < channels; ch++)
+                    mismatches += (voltage[ch] != stream.voltage[row + ch]) + (current[ch] != stream.current[row + ch]);
+            }
+        }
+        binary.decodeMs = elapsedMs(start);
+        binary.verified = mismatches == 0 && decodedFrames == frames && offset == buffer.size();
+    }
+
+    {
+        std::string buffer;
+        char line[96];
+        uint64_t mismatches = 0;
+        size_t lines = 0;
+
+        buffer.reserve(frames * channels * 40);
+        start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < frames; n++)
+        {
+            for (size_t ch = 0; ch < channels; ch++)
+            {
+                size_t at = n * channels + ch;
+                int size = snprintf(line, sizeof(line), "%lld,%zu,%.6f,%.6f\n", static_cast<long long>(stream.timestampMs[n]),
+                                    ch, stream.voltage[at] * 1e-6, stream.current[at] * 1e-6);
+                buffer.append(line, static_cast<size_t>(size));
+            }
+        }
+        text.encodeMs = elapsedMs(start);
+        text.bytes = buffer.size();
+
+        start = std::chrono::steady_clock::now();
+        for (const char *position = buffer.c_str(); *position; lines++)
+        {
+            char *end;
+            long long timestampMs = strtoll(position, &end, 10);
+            unsigned long ch = strtoul(end + 1, &end, 10);
+            double voltage = strtod(end + 1, &end);
+            double current = strtod(end + 1, &end);
+            size_t at = lines;
+
+            mismatches += (timestampMs != stream.timestampMs[at / channels]) + (ch != at % channels) +
+                          (std::lround(voltage * 1e6) != stream.voltage[at]) + (std::lround(current * 1e6) != stream.current[at]);
+            position = end + 1;
+        }
+        text.decodeMs = elapsedMs(start);
+        text.verified = mismatches == 0 && lines == frames * channels;
+    }
+    return results;
+}
+
+/**
+ * @brief Formats the results.
+ * @param results Results of run().
+ * @param out Text is appended here.
+ */
+void ProtocolBenchmark::render(const std::vector<ProtocolResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-14s %8s %12s %9s %13s %13s %9s\n",
+             "encoding", "changed", "samples", "B/sample", "enc Msmp/s", "dec Msmp/s", "verified");
+    out += line;
+    for (const ProtocolResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-14s %7.0f%% %12llu %9.2f %13.1f %13.1f %9s\n", result.encoding.c_str(),
+                 result.changedRatio * 100.0, static_cast<unsigned long long>(result.samples), result.bytesPerSample(),
+                 result.encodeRate() / 1e6, result.decodeRate() / 1e6, result.verified ? "yes" : "NO");
+        out += line;
+    }
+}
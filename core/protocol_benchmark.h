@@ -0,0 +1,42 @@
+#ifndef PROTOCOL_BENCHMARK_H
+#define PROTOCOL_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Size and speed of one telemetry encoding */
+struct ProtocolResult
+{
+    std::string encoding;
+    double changedRatio = 0.0;  /* Channels whose values change per frame */
+    uint64_t samples = 0;       /* Channel readings carried */
+    uint64_t bytes = 0;
+    double encodeMs = 0.0;
+    double decodeMs = 0.0;
+    bool verified = false;      /* Decoded values match the encoded ones */
+
+    double bytesPerSample(void) const { return samples ? static_cast<double>(bytes) / samples : 0.0; }
+    double encodeRate(void) const { return encodeMs > 0.0 ? samples / (encodeMs / 1000.0) : 0.0; }
+    double decodeRate(void) const { return decodeMs > 0.0 ? samples / (decodeMs / 1000.0) : 0.0; }
+};
+
+/* Encodes the same synthetic multi-channel stream as binary telemetry
+   frames and as one text line per sample ("t,ch,V,I"), then decodes both
+   and checks the values. Every frame samples every channel; a given share
+   of the channels changes per frame, the others repeat their reading. */
+class ProtocolBenchmark
+{
+    public:
+        ProtocolBenchmark(size_t channels, size_t frames);
+
+        std::vector<ProtocolResult> run(double changedRatio);
+        static void render(const std::vector<ProtocolResult>& results, std::string& out);
+
+    private:
+        size_t channels;
+        size_t frames;
+};
+
+#endif /* PROTOCOL_BENCHMARK_H */
@@ -0,0 +1,366 @@
+/**
+ * @file retention_store.cpp
+ * @brief Round-robin multi-resolution retention database.
+ *
+ * Raw samples are rolled up at ingest time into 1 s, 1 min and 1 h buckets
+ * (min/max/mean of voltage and current plus energy). Each level lives in its
+ * own preallocated file of fixed size, so long term trending has bounded disk
+ * use and constant-time writes. Queries read only the coarsest level that
+ * still satisfies the requested resolution.
+ */
+
+#include "retention_store.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    const char retentionMagic[8] = {'P', 'S', 'R', 'R', 'D', '0', '0', '1'};
+
+    /* File header, followed by the slots */
+    struct RetentionHeader
+    {
+        char magic[8];
+        int64_t resolutionMs;
+        uint32_t slots;
+        uint32_t recordSize;
+        uint8_t reserved[40];
+    };
+
+    int seekTo(std::FILE *file, int64_t offset)
+    {
+#if defined(_WIN32)
+        return _fseeki64(file, offset, SEEK_SET);
+#else
+        return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    }
+
+    int64_t floorDiv(int64_t value, int64_t divisor)
+    {
+        int64_t quotient = value / divisor;
+        if ((value % divisor != 0) && ((value < 0) != (divisor < 0)))
+            quotient--;
+        return quotient;
+    }
+
+    int64_t slotOffset(const RetentionLevel& level, int64_t bucketIndex)
+    {
+        int64_t slot = bucketIndex % level.slots;
+        if (slot < 0)
+            slot += level.slots;
+        return static_cast<int64_t>(sizeof(RetentionHeader)) + slot * static_cast<int64_t>(sizeof(RetentionBucket));
+    }
+
+    void fold(RetentionBucket& bucket, int64_t startMs, double voltage, double current, double energy)
+    {
+        if (bucket.count == 0)
+        {
+            bucket = RetentionBucket();
+            bucket.startMs = startMs;
+            bucket.minVoltage = bucket.maxVoltage = voltage;
+            bucket.minCurrent = bucket.maxCurrent = current;
+        }
+        bucket.count++;
+        bucket.minVoltage = std::min(bucket.minVoltage, voltage);
+        bucket.maxVoltage = std::max(bucket.maxVoltage, voltage);
+        bucket.sumVoltage += voltage;
+        bucket.minCurrent = std::min(bucket.minCurrent, current);
+        bucket.maxCurrent = std::max(bucket.maxCurrent, current);
+        bucket.sumCurrent += current;
+        bucket.energyJoules += energy;
+    }
+}
+
+/**
+ * @brief Default levels: 1 s for 2 days, 1 min for 90 days and 1 h for 5 years.
+ */
+const std::vector<RetentionLevel>& RetentionStore::defaultLevels(void)
+{
+    static const std::vector<RetentionLevel> levels =
+    {
+        {1000,        2 * 24 * 3600},
+        {60 * 1000,   90 * 24 * 60},
+        {3600 * 1000, 5 * 365 * 24}
+    };
+    return levels;
+}
+
+RetentionStore::RetentionStore()
+{
+}
+
+RetentionStore::~RetentionStore()
+{
+    close();
+}
+
+/**
+ * @brief Opens the level files of a store, creating and preallocating missing ones.
+ * @param directory Existing directory holding the files.
+ * @param name Store name, typically the channel name. Files are <name>_<resolution>ms.rrd.
+ * @param levels Levels, finest first.
+ */
+RetentionStore::RetentionError RetentionStore::open(const std::string& directory, const std::string& name,
+                                                    const std::vector<RetentionLevel>& levels)
+{
+    RetentionError err = RetentionError::ERR_SUCCESS;
+
+    close();
+    levelFiles.resize(levels.size());
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        std::string path = directory + "/" + name + "_" + std::to_string(levels[i].resolutionMs) + "ms.rrd";
+        levelFiles[i].level = levels[i];
+        err = openLevel(levelFiles[i], path);
+        if (err != RetentionError::ERR_SUCCESS)
+        {
+            std::cout << "Retention: Failed to open " << path << std::endl;
+            close();
+            return err;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Opens one level file, validating or writing its header.
+ */
+RetentionStore::RetentionError RetentionStore::openLevel(LevelFile& levelFile, const std::string& path)
+{
+    RetentionHeader header;
+    std::vector<char> zeros(64 * 1024, 0);
+    int64_t remaining;
+
+    levelFile.file = std::fopen(path.c_str(), "r+b");
+    if (levelFile.file != nullptr)
+    {
+        if (std::fread(&header, sizeof(header), 1, levelFile.file) != 1 ||
+            memcmp(header.magic, retentionMagic, sizeof(retentionMagic)) != 0 ||
+            header.resolutionMs != levelFile.level.resolutionMs ||
+            header.slots != levelFile.level.slots ||
+            header.recordSize != sizeof(RetentionBucket))
+            return RetentionError::ERR_BAD_FORMAT;
+        return RetentionError::ERR_SUCCESS;
+    }
+
+    /* New file: header followed by zeroed slots, written out in full so the
+       space is allocated up front */
+    levelFile.file = std::fopen(path.c_str(), "w+b");
+    if (levelFile.file == nullptr)
+        return RetentionError::ERR_OPEN_FAILED;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, retentionMagic, sizeof(retentionMagic));
+    header.resolutionMs = levelFile.level.resolutionMs;
+    header.slots = levelFile.level.slots;
+    header.recordSize = sizeof(RetentionBucket);
+    if (std::fwrite(&header, sizeof(header), 1, levelFile.file) != 1)
+        return RetentionError::ERR_IO_FAILED;
+
+    remaining = static_cast<int64_t>(levelFile.level.slots) * sizeof(RetentionBucket);
+    while (remaining > 0)
+    {
+        size_t chunk = static_cast<size_t>(std::min<int64_t>(remaining, zeros.size()));
+        if (std::fwrite(zeros.data(), 1, chunk, levelFile.file) != chunk)
+            return RetentionError::ERR_IO_FAILED;
+        remaining -= chunk;
+    }
+    if (std::fflush(levelFile.file) != 0)
+        return RetentionError::ERR_IO_FAILED;
+    return RetentionError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Writes pending buckets and closes all level files.
+ */
+void RetentionStore::close(void)
+{
+    flush();
+    for (LevelFile& levelFile : levelFiles)
+    {
+        if (levelFile.file)
+            std::fclose(levelFile.file);
+        levelFile.file = nullptr;
+    }
+    levelFiles.clear();
+    lastTimestampMs = -1;
+    lastPower = 0.0;
+}
+
+/**
+ * @brief Writes one bucket into its slot.
+ */
+RetentionStore::RetentionError RetentionStore::writeBucket(LevelFile& levelFile, const RetentionBucket& bucket)
+{
+    int64_t index = floorDiv(bucket.startMs, levelFile.level.resolutionMs);
+
+    if (seekTo(levelFile.file, slotOffset(levelFile.level, index)) != 0 ||
+        std::fwrite(&bucket, sizeof(bucket), 1, levelFile.file) != 1)
+        return RetentionError::ERR_IO_FAILED;
+    return RetentionError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Folds a raw sample into the buckets of every level.
+ *
+ * Energy is integrated with the trapezoidal rule between consecutive samples
+ * and credited to the bucket of the later sample, except across a gap
+ * reported with markGap(). Samples older than the previous one are ignored.
+ * @param timestampMs Sample time in milliseconds since the epoch.
+ * @param voltage Voltage in volts.
+ * @param current Current in amps.
+ */
+RetentionStore::RetentionError RetentionStore::add(int64_t timestampMs, double voltage, double current)
+{
+    RetentionError err = RetentionError::ERR_SUCCESS;
+    double power = voltage * current;
+    double energy = 0.0;
+
+    if (levelFiles.empty())
+        return RetentionError::ERR_OPEN_FAILED;
+    if (timestampMs < lastTimestampMs)
+        return RetentionError::ERR_SUCCESS;
+
+    if (lastTimestampMs >= 0 && !gapPending)
+        energy = 0.5 * (lastPower + power) * (timestampMs - lastTimestampMs) / 1000.0;
+    gapPending = false;
+    lastTimestampMs = timestampMs;
+    lastPower = power;
+
+    for (LevelFile& levelFile : levelFiles)
+    {
+        int64_t startMs = floorDiv(timestampMs, levelFile.level.resolutionMs) * levelFile.level.resolutionMs;
+
+        /* A new bucket starts: the finished one goes to its slot */
+        if (levelFile.pending.count != 0 && levelFile.pending.startMs != startMs)
+        {
+            if (writeBucket(levelFile, levelFile.pending) != RetentionError::ERR_SUCCESS)
+                err = RetentionError::ERR_IO_FAILED;
+            levelFile.pending = RetentionBucket();
+        }
+        fold(levelFile.pending, startMs, voltage, current, energy);
+    }
+    return err;
+}
+
+/**
+ * @brief Writes the partially filled buckets and flushes the files.
+ */
+RetentionStore::RetentionError RetentionStore::flush(void)
+{
+    RetentionError err = RetentionError::ERR_SUCCESS;
+
+    for (LevelFile& levelFile : levelFiles)
+    {
+        if (levelFile.file == nullptr)
+            continue;
+        if (levelFile.pending.count != 0 && writeBucket(levelFile, levelFile.pending) != RetentionError::ERR_SUCCESS)
+            err = RetentionError::ERR_IO_FAILED;
+        if (std::fflush(levelFile.file) != 0)
+            err = RetentionError::ERR_IO_FAILED;
+    }
+    return err;
+}
+
+/**
+ * @brief Returns the resolution of the level a query would read.
+ * @param resolutionMs Requested resolution.
+ * @return Coarsest level resolution not above the request, or the finest level.
+ */
+int64_t RetentionStore::levelResolutionForQuery(int64_t resolutionMs) const
+{
+    int64_t chosen = -1;
+
+    for (const LevelFile& levelFile : levelFiles)
+    {
+        if (levelFile.level.resolutionMs <= resolutionMs && levelFile.level.resolutionMs > chosen)
+            chosen = levelFile.level.resolutionMs;
+    }
+    if (chosen < 0 && !levelFiles.empty())
+        chosen = levelFiles.front().level.resolutionMs;
+    return chosen;
+}
+
+/**
+ * @brief Reads consecutive bucket indexes with at most two contiguous reads.
+ */
+RetentionStore::RetentionError RetentionStore::readBuckets(LevelFile& levelFile, int64_t firstIndex, int64_t lastIndex,
+                                                           std::vector<RetentionBucket>& buckets)
+{
+    const RetentionLevel& level = levelFile.level;
+    std::vector<RetentionBucket> records;
+    int64_t index = firstIndex;
+
+    while (index <= lastIndex)
+    {
+        int64_t slot = ((index % level.slots) + level.slots) % level.slots;
+        int64_t run = std::min<int64_t>(lastIndex - index + 1, level.slots - slot);
+
+        records.resize(static_cast<size_t>(run));
+        if (seekTo(levelFile.file, slotOffset(level, index)) != 0 ||
+            std::fread(records.data(), sizeof(RetentionBucket), records.size(), levelFile.file) != records.size())
+            return RetentionError::ERR_IO_FAILED;
+
+        /* A slot holds the expected bucket only if its start matches */
+        for (int64_t k = 0; k < run; k++)
+        {
+            if (records[k].count != 0 && records[k].startMs == (index + k) * level.resolutionMs)
+                buckets.push_back(records[k]);
+        }
+        index += run;
+    }
+    return RetentionError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Returns the buckets covering a time range.
+ *
+ * Only the coarsest level whose resolution is at or below the requested one
+ * is read. Empty buckets are omitted.
+ * @param fromMs Range start, inclusive.
+ * @param toMs Range end, inclusive.
+ * @param resolutionMs Finest resolution the caller needs.
+ * @param buckets Receives the buckets, oldest first.
+ */
+RetentionStore::RetentionError RetentionStore::query(int64_t fromMs, int64_t toMs, int64_t resolutionMs,
+                                                     std::vector<RetentionBucket>& buckets)
+{
+    RetentionError err;
+    int64_t resolution = levelResolutionForQuery(resolutionMs);
+    int64_t firstIndex;
+    int64_t lastIndex;
+    LevelFile *levelFile = nullptr;
+
+    buckets.clear();
+    for (LevelFile& candidate : levelFiles)
+    {
+        if (candidate.level.resolutionMs == resolution)
+            levelFile = &candidate;
+    }
+    if (levelFile == nullptr)
+        return RetentionError::ERR_OPEN_FAILED;
+    if (fromMs > toMs)
+        return RetentionError::ERR_SUCCESS;
+
+    /* Only the newest `slots` buckets of a level can still be on disk */
+    firstIndex = floorDiv(fromMs, resolution);
+    lastIndex = floorDiv(toMs, resolution);
+    firstIndex = std::max(firstIndex, lastIndex - static_cast<int64_t>(levelFile->level.slots) + 1);
+
+    /* Pending buckets are not on disk yet */
+    err = readBuckets(*levelFile, firstIndex, lastIndex, buckets);
+    if (err != RetentionError::ERR_SUCCESS)
+        return err;
+
+    const RetentionBucket& pending = levelFile->pending;
+    if (pending.count != 0 && pending.startMs >= firstIndex * resolution && pending.startMs <= lastIndex * resolution)
+    {
+        if (!buckets.empty() && buckets.back().startMs == pending.startMs)
+            buckets.back() = pending;
+        else
+            buckets.push_back(pending);
+    }
+    return RetentionError::ERR_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#ifndef RETENTION_STORE_H
+#define RETENTION_STORE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Rolled-up statistics of one time bucket, stored verbatim on disk */
+struct RetentionBucket
+{
+    int64_t startMs = -1;      /* Bucket start, -1 for an empty slot */
+    uint32_t count = 0;        /* Raw samples folded into the bucket */
+    uint32_t reserved = 0;
+    double minVoltage = 0.0;
+    double maxVoltage = 0.0;
+    double sumVoltage = 0.0;
+    double minCurrent = 0.0;
+    double maxCurrent = 0.0;
+    double sumCurrent = 0.0;
+    double energyJoules = 0.0;
+
+    double meanVoltage(void) const { return count ? sumVoltage / count : 0.0; }
+    double meanCurrent(void) const { return count ? sumCurrent / count : 0.0; }
+};
+
+/* Resolution and number of slots of one round-robin level */
+struct RetentionLevel
+{
+    int64_t resolutionMs;
+    uint32_t slots;
+};
+
+/* Round-robin multi-resolution store for one channel.
+   Each level is a fixed-size file preallocated at creation. The slot of a
+   bucket is (start / resolution) % slots, so every write is a single seek and
+   write of one record and disk use never grows. Buckets of all levels are
+   accumulated in memory while raw samples are ingested and written once when
+   the next bucket starts. */
+class RetentionStore
+{
+    public:
+        enum class RetentionError
+        {
+            ERR_SUCCESS = 0,
+            ERR_OPEN_FAILED,
+            ERR_BAD_FORMAT,
+            ERR_IO_FAILED
+        };
+
+        /* 1 s for 2 days, 1 min for 90 days, 1 h for 5 years */
+        static const std::vector<RetentionLevel>& defaultLevels(void);
+
+        RetentionStore();
+        ~RetentionStore();
+
+        RetentionError open(const std::string& directory, const std::string& name,
+                            const std::vector<RetentionLevel>& levels = defaultLevels());
+        void close(void);
+        RetentionError add(int64_t timestampMs, double voltage, double current);
+        void markGap(void) { gapPending = true; }
+        RetentionError flush(void);
+        RetentionError query(int64_t fromMs, int64_t toMs, int64_t resolutionMs, std::vector<RetentionBucket>& buckets);
+        int64_t levelResolutionForQuery(int64_t resolutionMs) const;
+
+    private:
+        struct LevelFile
+        {
+            RetentionLevel level;
+            std::FILE *file = nullptr;
+            RetentionBucket pending;   /* Bucket being accumulated in memory */
+        };
+
+        std::vector<LevelFile> levelFiles;
+        int64_t lastTimestampMs = -1;
+        double lastPower = 0.0;
+        bool gapPending = false;   /* Do not integrate energy up to the next sample */
+
+        RetentionError openLevel(LevelFile& levelFile, const std::string& path);
+        RetentionError writeBucket(LevelFile& levelFile, const RetentionBucket& bucket);
+        RetentionError readBuckets(LevelFile& levelFile, int64_t firstIndex, int64_t lastIndex,
+                                   std::vector<RetentionBucket>& buckets);
+};
+
+#endif /* RETENTION_STORE_H */
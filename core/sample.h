@@ -0,0 +1,34 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <cstdint>
+
+/* Why a sample does not carry a fresh reading. Flags combine */
+enum SampleQuality : uint8_t
+{
+    SAMPLE_GOOD         = 0,
+    SAMPLE_TIMEOUT      = 1 << 0,  /* The instrument did not answer in time */
+    SAMPLE_PARSE_ERROR  = 1 << 1,  /* The answer was not a number */
+    SAMPLE_STALE        = 1 << 2,  /* Values repeat the last good reading */
+    SAMPLE_RECONNECTING = 1 << 3,  /* The port is closed or being reopened */
+    SAMPLE_IO_ERROR     = 1 << 4,  /* Any other transfer failure */
+    SAMPLE_PREDICTED    = 1 << 5   /* Current predicted by the poll model, voltage of the last reading */
+};
+
+/* One sampler iteration. The sequence number increases by one per iteration
+   whether or not the reading succeeded, so consumers can tell a missing
+   sample from a flat signal and count samples lost on the way. */
+struct Sample
+{
+    uint64_t sequence = 0;
+    int64_t timestampMs = 0;
+    double voltage = 0.0;
+    double current = 0.0;
+    uint32_t latencyUs = 0;  /* Time spent reading the instrument */
+    uint8_t quality = SAMPLE_GOOD;
+
+    bool good(void) const { return quality == SAMPLE_GOOD; }
+    bool usable(void) const { return quality == SAMPLE_GOOD || quality == SAMPLE_PREDICTED; }  /* Read or predicted */
+};
+
+#endif /* SAMPLE_H */
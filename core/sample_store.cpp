@@ -0,0 +1,310 @@
+/**
+ * @file sample_store.cpp
+ * @brief Fixed-point structure-of-arrays storage for V/I samples.
+ *
+ * Samples are kept as three cache-aligned int32 columns per channel so that
+ * long, many-channel captures stay compact and analysis loops stream through
+ * contiguous integers instead of strided structs of doubles. Physical values
+ * are only reconstructed at the end of a computation using the channel scale.
+ */
+
+#include "sample_store.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+AlignedColumn::AlignedColumn(const AlignedColumn& other)
+{
+    *this = other;
+}
+
+AlignedColumn& AlignedColumn::operator=(const AlignedColumn& other)
+{
+    if (this == &other)
+        return *this;
+    clear();
+    reserve(other.count);
+    if (other.count)
+        memcpy(values, other.values, other.count * sizeof(int32_t));
+    count = other.count;
+    return *this;
+}
+
+AlignedColumn::~AlignedColumn()
+{
+    delete[] storage;
+}
+
+/**
+ * @brief Grows the column so it can hold at least count values.
+ * @param newCapacity Number of values to make room for.
+ */
+void AlignedColumn::reserve(size_t newCapacity)
+{
+    unsigned char *newStorage;
+    int32_t *newValues;
+    uintptr_t address;
+
+    if (newCapacity <= allocated)
+        return;
+
+    newStorage = new unsigned char[newCapacity * sizeof(int32_t) + alignment];
+    address = reinterpret_cast<uintptr_t>(newStorage);
+    address = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    newValues = reinterpret_cast<int32_t*>(address);
+
+    if (count)
+        memcpy(newValues, values, count * sizeof(int32_t));
+    delete[] storage;
+    storage = newStorage;
+    values = newValues;
+    allocated = newCapacity;
+}
+
+/**
+ * @brief Appends a value, doubling the capacity when the column is full.
+ */
+void AlignedColumn::push_back(int32_t value)
+{
+    if (count == allocated)
+        reserve(allocated ? allocated * 2 : 1024);
+    values[count++] = value;
+}
+
+/**
+ * @brief Drops all values. The allocation is kept for reuse.
+ */
+void AlignedColumn::clear(void)
+{
+    count = 0;
+}
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels.
+ * @param reservePerChannel Samples to preallocate per channel.
+ */
+SampleStore::SampleStore(size_t channels, size_t reservePerChannel) : columns(channels)
+{
+    for (ChannelColumns& column : columns)
+    {
+        column.timestamp.reserve(reservePerChannel);
+        column.voltage.reserve(reservePerChannel);
+        column.current.reserve(reservePerChannel);
+    }
+}
+
+/**
+ * @brief Sets the count-to-unit conversion of a channel.
+ * Must be set before the first sample is appended to the channel.
+ */
+void SampleStore::setScale(size_t channel, const ChannelScale& scale)
+{
+    if (channel >= columns.size() || columns[channel].voltage.size() != 0)
+    {
+        std::cout << "Sample Store: Scale of channel " << channel << " cannot be changed" << std::endl;
+        return;
+    }
+    columns[channel].scale = scale;
+}
+
+const ChannelScale& SampleStore::scale(size_t channel) const
+{
+    return columns[channel].scale;
+}
+
+/**
+ * @brief Converts a physical value to counts, rounding to nearest.
+ * @return False if the value does not fit in an int32.
+ */
+bool SampleStore::toCounts(double value, double unitsPerCount, int32_t& counts)
+{
+    double scaled = std::nearbyint(value / unitsPerCount);
+
+    if (!(scaled >= std::numeric_limits<int32_t>::min() && scaled <= std::numeric_limits<int32_t>::max()))
+        return false;
+    counts = static_cast<int32_t>(scaled);
+    return true;
+}
+
+/**
+ * @brief Appends a sample to a channel.
+ * @param channel Channel number.
+ * @param timestampMs Sample time in milliseconds (any epoch, monotonic per channel).
+ * @param voltage Voltage in volts.
+ * @param current Current in amps.
+ * @return False if the sample is out of the representable range.
+ */
+bool SampleStore::append(size_t channel, int64_t timestampMs, double voltage, double current)
+{
+    int32_t voltageCounts;
+    int32_t currentCounts;
+    int64_t offset;
+
+    if (channel >= columns.size())
+        return false;
+
+    ChannelColumns& column = columns[channel];
+    if (column.timestamp.size() == 0)
+        column.baseTimestampMs = timestampMs;
+
+    /* int32 milliseconds cover ~24 days from the first sample */
+    offset = timestampMs - column.baseTimestampMs;
+    if (offset < 0 || offset > std::numeric_limits<int32_t>::max())
+        return false;
+
+    if (!toCounts(voltage, column.scale.voltsPerCount, voltageCounts) ||
+        !toCounts(current, column.scale.ampsPerCount, currentCounts))
+        return false;
+
+    column.timestamp.push_back(static_cast<int32_t>(offset));
+    column.voltage.push_back(voltageCounts);
+    column.current.push_back(currentCounts);
+    return true;
+}
+
+/**
+ * @brief Drops all samples of a channel.
+ */
+void SampleStore::clear(size_t channel)
+{
+    columns[channel].timestamp.clear();
+    columns[channel].voltage.clear();
+    columns[channel].current.clear();
+}
+
+size_t SampleStore::size(size_t channel) const
+{
+    return columns[channel].timestamp.size();
+}
+
+int64_t SampleStore::baseTimestampMs(size_t channel) const
+{
+    return columns[channel].baseTimestampMs;
+}
+
+const int32_t* SampleStore::timestampColumn(size_t channel) const
+{
+    return columns[channel].timestamp.data();
+}
+
+const int32_t* SampleStore::voltageColumn(size_t channel) const
+{
+    return columns[channel].voltage.data();
+}
+
+const int32_t* SampleStore::currentColumn(size_t channel) const
+{
+    return columns[channel].current.data();
+}
+
+double SampleStore::voltageAt(size_t channel, size_t index) const
+{
+    return columns[channel].voltage.data()[index] * columns[channel].scale.voltsPerCount;
+}
+
+double SampleStore::currentAt(size_t channel, size_t index) const
+{
+    return columns[channel].current.data()[index] * columns[channel].scale.ampsPerCount;
+}
+
+/**
+ * @brief Computes min/max/mean and energy over a range of samples.
+ *
+ * The loops only touch the int32 columns and accumulate in integers, which
+ * keeps them simple enough for the compiler to vectorize. Units are applied
+ * once at the end.
+ * @param channel Channel number.
+ * @param begin Index of the first sample.
+ * @param end Index past the last sample.
+ */
+ColumnStats SampleStore::stats(size_t channel, size_t begin, size_t end) const
+{
+    ColumnStats result;
+    const ChannelColumns& column = columns[channel];
+    const int32_t *t = column.timestamp.data();
+    const int32_t *v = column.voltage.data();
+    const int32_t *i = column.current.data();
+    int32_t minV, maxV, minI, maxI;
+    int64_t sumV = 0;
+    int64_t sumI = 0;
+    double energy = 0.0;
+    int64_t gapMs = 0;
+
+    end = std::min(end, column.timestamp.size());
+    if (begin >= end)
+        return result;
+
+    minV = maxV = v[begin];
+    minI = maxI = i[begin];
+    for (size_t n = begin; n < end; n++)
+    {
+        minV = std::min(minV, v[n]);
+        maxV = std::max(maxV, v[n]);
+        minI = std::min(minI, i[n]);
+        maxI = std::max(maxI, i[n]);
+        sumV += v[n];
+        sumI += i[n];
+    }
+
+    /* Trapezoidal integration of power, in count^2 * ms. Intervals longer
+       than the gap threshold span missing samples and are not integrated */
+    for (size_t n = begin + 1; n < end; n++)
+    {
+        double p0 = static_cast<double>(static_cast<int64_t>(v[n - 1]) * i[n - 1]);
+        double p1 = static_cast<double>(static_cast<int64_t>(v[n]) * i[n]);
+        int32_t dt = t[n] - t[n - 1];
+        if (gapThresholdMs > 0 && dt > gapThresholdMs)
+        {
+            result.gaps++;
+            gapMs += dt;
+            continue;
+        }
+        energy += (p0 + p1) * static_cast<double>(dt);
+    }
+
+    result.count = end - begin;
+    result.minVoltage = minV * column.scale.voltsPerCount;
+    result.maxVoltage = maxV * column.scale.voltsPerCount;
+    result.meanVoltage = static_cast<double>(sumV) / result.count * column.scale.voltsPerCount;
+    result.minCurrent = minI * column.scale.ampsPerCount;
+    result.maxCurrent = maxI * column.scale.ampsPerCount;
+    result.meanCurrent = static_cast<double>(sumI) / result.count * column.scale.ampsPerCount;
+    result.energyJoules = energy * 0.5e-3 * column.scale.voltsPerCount * column.scale.ampsPerCount;
+    result.gapSeconds = gapMs / 1000.0;
+    return result;
+}
+
+/**
+ * @brief Finds the first sample at or after a timestamp.
+ * @param channel Channel number.
+ * @param timestampMs Absolute timestamp in milliseconds.
+ * @return Sample index, or size(channel) if all samples are older.
+ */
+size_t SampleStore::lowerBound(size_t channel, int64_t timestampMs) const
+{
+    const ChannelColumns& column = columns[channel];
+    int64_t offset = timestampMs - column.baseTimestampMs;
+    const int32_t *first = column.timestamp.data();
+    const int32_t *last = first + column.timestamp.size();
+
+    if (offset <= 0)
+        return 0;
+    if (offset > std::numeric_limits<int32_t>::max())
+        return column.timestamp.size();
+    return std::lower_bound(first, last, static_cast<int32_t>(offset)) - first;
+}
+
+/**
+ * @brief Returns the bytes allocated by all columns.
+ */
+size_t SampleStore::memoryBytes(void) const
+{
+    size_t bytes = 0;
+
+    for (const ChannelColumns& column : columns)
+        bytes += (column.timestamp.capacity() + column.voltage.capacity() + column.current.capacity()) * sizeof(int32_t);
+    return bytes;
+}
@@ -0,0 +1,102 @@
+#ifndef SAMPLE_STORE_H
+#define SAMPLE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Column of int32 values whose storage starts on a cache line boundary */
+class AlignedColumn
+{
+    public:
+        static constexpr size_t alignment = 64;
+
+        AlignedColumn() = default;
+        AlignedColumn(const AlignedColumn& other);
+        AlignedColumn& operator=(const AlignedColumn& other);
+        ~AlignedColumn();
+
+        void reserve(size_t count);
+        void push_back(int32_t value);
+        void clear(void);
+        size_t size(void) const { return count; }
+        size_t capacity(void) const { return allocated; }
+        const int32_t* data(void) const { return values; }
+        int32_t* data(void) { return values; }
+
+    private:
+        unsigned char *storage = nullptr;  /* Raw allocation, over-sized for alignment */
+        int32_t *values = nullptr;         /* First aligned element inside storage */
+        size_t count = 0;
+        size_t allocated = 0;
+};
+
+/* Conversion between stored counts and physical units of one channel.
+   The default stores microvolts and microamps (+/-2147 V, +/-2147 A). */
+struct ChannelScale
+{
+    double voltsPerCount = 1e-6;
+    double ampsPerCount = 1e-6;
+};
+
+/* Aggregates computed directly on the integer columns */
+struct ColumnStats
+{
+    size_t count = 0;
+    double minVoltage = 0.0;
+    double maxVoltage = 0.0;
+    double meanVoltage = 0.0;
+    double minCurrent = 0.0;
+    double maxCurrent = 0.0;
+    double meanCurrent = 0.0;
+    double energyJoules = 0.0;  /* Trapezoidal integral of V * I over the range, gaps excluded */
+    size_t gaps = 0;            /* Intervals longer than the gap threshold */
+    double gapSeconds = 0.0;    /* Their total duration */
+};
+
+/* Structure-of-arrays sample storage. Each channel keeps three parallel
+   columns: a millisecond timestamp relative to the channel's first sample,
+   and the voltage and current as scaled int32 counts. A sample costs 12 bytes
+   instead of the 24+ bytes of a {int64 time, double V, double I} struct. */
+class SampleStore
+{
+    public:
+        explicit SampleStore(size_t channels = 1, size_t reservePerChannel = 0);
+
+        size_t channels(void) const { return columns.size(); }
+        void setScale(size_t channel, const ChannelScale& scale);
+        const ChannelScale& scale(size_t channel) const;
+        void setGapThresholdMs(int32_t thresholdMs) { gapThresholdMs = thresholdMs; }
+
+        bool append(size_t channel, int64_t timestampMs, double voltage, double current);
+        void clear(size_t channel);
+        size_t size(size_t channel) const;
+
+        int64_t baseTimestampMs(size_t channel) const;
+        const int32_t* timestampColumn(size_t channel) const;
+        const int32_t* voltageColumn(size_t channel) const;
+        const int32_t* currentColumn(size_t channel) const;
+        double voltageAt(size_t channel, size_t index) const;
+        double currentAt(size_t channel, size_t index) const;
+
+        ColumnStats stats(size_t channel, size_t begin, size_t end) const;
+        size_t lowerBound(size_t channel, int64_t timestampMs) const;
+        size_t memoryBytes(void) const;
+        static constexpr size_t bytesPerSample = 3 * sizeof(int32_t);
+
+    private:
+        struct ChannelColumns
+        {
+            ChannelScale scale;
+            int64_t baseTimestampMs = 0;
+            AlignedColumn timestamp;  /* ms since baseTimestampMs */
+            AlignedColumn voltage;    /* counts of scale.voltsPerCount */
+            AlignedColumn current;    /* counts of scale.ampsPerCount */
+        };
+        std::vector<ChannelColumns> columns;
+        int32_t gapThresholdMs = 0;  /* Longer intervals are gaps, 0 disables detection */
+
+        static bool toCounts(double value, double unitsPerCount, int32_t& counts);
+};
+
+#endif /* SAMPLE_STORE_H */
@@ -0,0 +1,164 @@
+/**
+ * @file setpoint_journal.cpp
+ * @brief Crash-safe journal of the setpoints applied to the instrument.
+ *
+ * Record payload (little endian, 32 bytes):
+ *   [version u8][flags u8, bit 0 = output on, bit 1 = current limit set][reserved 6]
+ *   [voltage f64][timestamp ms i64][current limit f64]
+ * Framing, checksums and durability are provided by LogWriter.
+ */
+
+#include "setpoint_journal.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief Opens the journal and rebuilds the last consistent state.
+ * @param directory Journal directory, created if missing.
+ */
+SetpointJournal::JournalError SetpointJournal::open(const std::string& directory)
+{
+    GroupCommitPolicy policy;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    LogWriter::RecordHandler handler = [this](uint64_t, const uint8_t *payload, size_t size)
+    {
+        SetpointState state;
+        if (decode(payload, size, state))
+        {
+            current = state;
+            valid = true;
+        }
+    };
+
+    close();
+    current = SetpointState();
+    valid = false;
+
+    /* The newest segment holds the newest record unless the crash hit right
+       after a rotation; only then are the older segments read */
+    LogWriter::replay(directory, handler, true);
+    if (!valid)
+        LogWriter::replay(directory, handler, false);
+    recoveryUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    /* Setpoints are rare, keep the window of loss short */
+    policy.maxDelayMs = 10;
+    policy.maxBatchBytes = 4096;
+    if (log.open(directory, segmentBytes, policy) != LogWriter::LogError::ERR_SUCCESS)
+    {
+        std::cout << "Setpoint journal: Failed to open " << directory << std::endl;
+        return JournalError::ERR_OPEN_FAILED;
+    }
+    opened = true;
+
+    /* Make the recovered state durable in the newest segment before the
+       older segments, which may be the only other copy, are deleted */
+    if (valid && appendDurable() != JournalError::ERR_SUCCESS)
+        return JournalError::ERR_IO_FAILED;
+    log.removeOldSegments();
+    return JournalError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Flushes pending records and closes the journal. The recovered state is kept.
+ */
+void SetpointJournal::close(void)
+{
+    log.close();
+    opened = false;
+}
+
+/**
+ * @brief Records a voltage setpoint. Returns once the record is durable;
+ * call it before the voltage is written to the instrument.
+ */
+SetpointJournal::JournalError SetpointJournal::recordVoltage(double voltage, int64_t timestampMs)
+{
+    current.voltage = voltage;
+    current.timestampMs = timestampMs;
+    valid = true;
+    return appendDurable();
+}
+
+/**
+ * @brief Records an output state change. Returns once the record is durable.
+ */
+SetpointJournal::JournalError SetpointJournal::recordOutput(bool output, int64_t timestampMs)
+{
+    current.output = output;
+    current.timestampMs = timestampMs;
+    valid = true;
+    return appendDurable();
+}
+
+/**
+ * @brief Records a current limit. Returns once the record is durable.
+ */
+SetpointJournal::JournalError SetpointJournal::recordCurrentLimit(double currentLimit, int64_t timestampMs)
+{
+    current.currentLimit = currentLimit;
+    current.currentLimitKnown = true;
+    current.timestampMs = timestampMs;
+    valid = true;
+    return appendDurable();
+}
+
+/**
+ * @brief Records a complete state, e.g. a preset, as one record. Returns once it is durable.
+ * Also used to undo a change the instrument refused.
+ */
+SetpointJournal::JournalError SetpointJournal::record(const SetpointState& state)
+{
+    current = state;
+    valid = true;
+    return appendDurable();
+}
+
+/**
+ * @brief Appends the complete current state as one record.
+ */
+SetpointJournal::JournalError SetpointJournal::append(void)
+{
+    uint8_t payload[recordSize];
+
+    memset(payload, 0, sizeof(payload));
+    payload[0] = recordVersion;
+    payload[1] = (current.output ? 1 : 0) | (current.currentLimitKnown ? 2 : 0);
+    memcpy(&payload[8], &current.voltage, sizeof(double));
+    memcpy(&payload[16], &current.timestampMs, sizeof(int64_t));
+    memcpy(&payload[24], &current.currentLimit, sizeof(double));
+
+    if (log.append(payload, sizeof(payload)) != LogWriter::LogError::ERR_SUCCESS)
+        return JournalError::ERR_IO_FAILED;
+    return JournalError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Appends the current state and commits it at once instead of
+ * waiting for the group commit delay.
+ */
+SetpointJournal::JournalError SetpointJournal::appendDurable(void)
+{
+    if (append() != JournalError::ERR_SUCCESS || log.sync() != LogWriter::LogError::ERR_SUCCESS)
+        return JournalError::ERR_IO_FAILED;
+    return JournalError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Decodes one record payload.
+ * @return False if the payload is not a record of a known version.
+ */
+bool SetpointJournal::decode(const uint8_t *payload, size_t size, SetpointState& state)
+{
+    if (size != recordSize || payload[0] != recordVersion)
+        return false;
+
+    state = SetpointState();
+    state.output = (payload[1] & 1) != 0;
+    state.currentLimitKnown = (payload[1] & 2) != 0;
+    memcpy(&state.voltage, &payload[8], sizeof(double));
+    memcpy(&state.timestampMs, &payload[16], sizeof(int64_t));
+    memcpy(&state.currentLimit, &payload[24], sizeof(double));
+    return true;
+}
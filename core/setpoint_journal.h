@@ -0,0 +1,66 @@
+#ifndef SETPOINT_JOURNAL_H
+#define SETPOINT_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "log_writer.h"
+
+/* Last state commanded to the instrument */
+struct SetpointState
+{
+    double voltage = 0.0;
+    double currentLimit = 0.0;
+    bool currentLimitKnown = false;  /* Set once a current limit was commanded */
+    bool output = false;
+    int64_t timestampMs = 0;  /* When the last change was commanded */
+};
+
+/* Write-ahead journal of commanded setpoints.
+   A change is recorded, and durable, before it is written to the instrument;
+   a write that fails is undone by recording the previous state again. Every
+   record carries the complete commanded state, so the newest valid record is
+   the state to restore. Recovery still walks every frame of the newest
+   segment to find it, but a segment is at most 64 KiB and is read in one go.
+   Records go through LogWriter, which checksums every frame; a torn record
+   at the end of the journal is ignored and the previous one wins. Older
+   segments are dropped on open since nothing in them can still be needed. */
+class SetpointJournal
+{
+    public:
+        enum class JournalError
+        {
+            ERR_SUCCESS = 0,
+            ERR_OPEN_FAILED,
+            ERR_IO_FAILED
+        };
+
+        JournalError open(const std::string& directory);
+        void close(void);
+        JournalError recordVoltage(double voltage, int64_t timestampMs);
+        JournalError recordOutput(bool output, int64_t timestampMs);
+        JournalError recordCurrentLimit(double currentLimit, int64_t timestampMs);
+        JournalError record(const SetpointState& state);
+
+        bool isOpen(void) const { return opened; }
+        bool hasState(void) const { return valid; }
+        const SetpointState& state(void) const { return current; }
+        uint64_t recoveryMicroseconds(void) const { return recoveryUs; }
+
+    private:
+        static constexpr uint8_t recordVersion = 1;
+        static constexpr size_t recordSize = 32;
+        static constexpr size_t segmentBytes = 64 * 1024;
+
+        LogWriter log;
+        SetpointState current;
+        bool opened = false;
+        bool valid = false;
+        uint64_t recoveryUs = 0;
+
+        JournalError append(void);
+        JournalError appendDurable(void);
+        static bool decode(const uint8_t *payload, size_t size, SetpointState& state);
+};
+
+#endif /* SETPOINT_JOURNAL_H */
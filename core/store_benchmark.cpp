@@ -0,0 +1,202 @@
+/**
+ * @file store_benchmark.cpp
+ * @brief Structure-of-arrays sample store against an array of structs.
+ *
+ * The capture is a 100 Hz stream per channel with readings that wander
+ * slowly around a setpoint, quantized to the microvolt and microamp the
+ * store keeps, so both layouts hold exactly the same values.
+ */
+
+#include "store_benchmark.h"
+#include "sample_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    /* The natural layout: one struct of doubles per sample */
+    struct AosSample
+    {
+        int64_t timestampMs;
+        double voltage;
+        double current;
+    };
+
+    /* Deterministic readings, the same for both layouts */
+    class Readings
+    {
+        public:
+            explicit Readings(size_t channel) : state(0x9E3779B97F4A7C15ULL * (channel + 1)) {}
+
+            void next(double& voltage, double& current)
+            {
+                voltageCounts += static_cast<int64_t>(step() % 21) - 10;
+                currentCounts += static_cast<int64_t>(step() % 201) - 100;
+                voltage = voltageCounts * 1e-6;
+                current = currentCounts * 1e-6;
+            }
+
+        private:
+            uint64_t state;
+            int64_t voltageCounts = 12000000;  /* 12 V */
+            int64_t currentCounts = 1500000;   /* 1.5 A */
+
+            uint64_t step(void)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                return state >> 33;
+            }
+    };
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param samplesPerChannel Samples of every channel.
+ * @param channels Number of channels.
+ * @param passes Scans of each layout; the fastest counts.
+ */
+StoreBenchmark::StoreBenchmark(size_t samplesPerChannel, size_t channels, unsigned passes)
+    : samplesPerChannel(std::max<size_t>(samplesPerChannel, 2)), channels(std::max<size_t>(channels, 1)),
+      passes(std::max(passes, 1u))
+{
+}
+
+/**
+ * @brief Fills and scans both layouts.
+ * @return Array of structs first, then the sample store.
+ */
+std::vector<StoreResult> StoreBenchmark::run(void)
+{
+    const int64_t startMs = 1700000000000LL;
+    const int64_t periodMs = 10;
+    std::vector<StoreResult> results(2);
+    StoreResult& aos = results[0];
+    StoreResult& soa = results[1];
+    std::chrono::steady_clock::time_point start;
+
+    aos.layout = "struct per sample";
+    soa.layout = "int32 columns";
+    aos.samples = soa.samples = samplesPerChannel * channels;
+
+    {
+        std::vector<std::vector<AosSample>> structs(channels);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            Readings readings(channel);
+
+            structs[channel].reserve(samplesPerChannel);
+            for (size_t n = 0; n < samplesPerChannel; n++)
+            {
+                AosSample sample;
+
+                sample.timestampMs = startMs + static_cast<int64_t>(n) * periodMs;
+                readings.next(sample.voltage, sample.current);
+                structs[channel].push_back(sample);
+            }
+            aos.bytes += structs[channel].capacity() * sizeof(AosSample);
+        }
+        aos.fillMs = elapsedMs(start);
+
+        for (unsigned pass = 0; pass < passes; pass++)
+        {
+            double energy = 0.0;
+
+            start = std::chrono::steady_clock::now();
+            for (const std::vector<AosSample>& samples : structs)
+            {
+                double minV = samples[0].voltage, maxV = minV, sumV = 0.0;
+                double minI = samples[0].current, maxI = minI, sumI = 0.0;
+
+                for (const AosSample& sample : samples)
+                {
+                    minV = std::min(minV, sample.voltage);
+                    maxV = std::max(maxV, sample.voltage);
+                    minI = std::min(minI, sample.current);
+                    maxI = std::max(maxI, sample.current);
+                    sumV += sample.voltage;
+                    sumI += sample.current;
+                }
+                for (size_t n = 1; n < samples.size(); n++)
+                    energy += 0.5 * (samples[n - 1].voltage * samples[n - 1].current + samples[n].voltage * samples[n].current) *
+                              (samples[n].timestampMs - samples[n - 1].timestampMs) * 1e-3;
+
+                /* Keeps the aggregates alive */
+                energy += (minV + maxV + minI + maxI + sumV + sumI) * 0.0;
+            }
+            aos.scanMs = pass == 0 ? elapsedMs(start) : std::min(aos.scanMs, elapsedMs(start));
+            aos.energyJoules = energy;
+        }
+    }
+
+    {
+        SampleStore store(channels, samplesPerChannel);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t channel = 0; channel < channels; channel++)
+        {
+            Readings readings(channel);
+
+            for (size_t n = 0; n < samplesPerChannel; n++)
+            {
+                double voltage;
+                double current;
+
+                readings.next(voltage, current);
+                store.append(channel, startMs + static_cast<int64_t>(n) * periodMs, voltage, current);
+            }
+        }
+        soa.fillMs = elapsedMs(start);
+        soa.bytes = store.memoryBytes();
+
+        for (unsigned pass = 0; pass < passes; pass++)
+        {
+            double energy = 0.0;
+
+            start = std::chrono::steady_clock::now();
+            for (size_t channel = 0; channel < channels; channel++)
+            {
+                ColumnStats stats = store.stats(channel, 0, store.size(channel));
+                energy += stats.energyJoules + (stats.minVoltage + stats.meanCurrent) * 0.0;
+            }
+            soa.scanMs = pass == 0 ? elapsedMs(start) : std::min(soa.scanMs, elapsedMs(start));
+            soa.energyJoules = energy;
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief Formats the results.
+ * @param results Results of run().
+ * @param out Text is appended here.
+ */
+void StoreBenchmark::render(const std::vector<StoreResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-18s %12s %9s %9s %9s %9s %15s\n",
+             "layout", "samples", "MiB", "B/sample", "fill ms", "scan ms", "scan Msamples/s");
+    out += line;
+    for (const StoreResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-18s %12zu %9.1f %9.1f %9.1f %9.2f %15.1f\n", result.layout.c_str(),
+                 result.samples, result.bytes / (1024.0 * 1024.0), result.bytesPerSample(), result.fillMs,
+                 result.scanMs, result.samplesPerSecond() / 1e6);
+        out += line;
+    }
+    if (results.size() == 2)
+    {
+        snprintf(line, sizeof(line), "Energy %.3f J against %.3f J (difference %.2e J)\n", results[1].energyJoules,
+                 results[0].energyJoules, std::fabs(results[1].energyJoules - results[0].energyJoules));
+        out += line;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef STORE_BENCHMARK_H
+#define STORE_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Footprint and scan speed of one sample layout */
+struct StoreResult
+{
+    std::string layout;
+    size_t samples = 0;         /* Over all channels */
+    size_t bytes = 0;           /* Allocated by the layout */
+    double fillMs = 0.0;        /* Appending every sample */
+    double scanMs = 0.0;        /* Best pass of min/max/mean and energy over every channel */
+    double energyJoules = 0.0;  /* Of all channels, to check that both layouts agree */
+
+    double bytesPerSample(void) const { return samples ? static_cast<double>(bytes) / samples : 0.0; }
+    double samplesPerSecond(void) const { return scanMs > 0.0 ? samples / (scanMs / 1000.0) : 0.0; }
+};
+
+/* Stores the same synthetic capture twice: as one {int64 time, double V,
+   double I} struct per sample, and in a SampleStore with int32 columns of
+   microvolts and microamps. Both are then scanned for the statistics the
+   capture view shows, min/max/mean of V and I and the energy, computed on
+   doubles for the structs and on the integer columns for the store. */
+class StoreBenchmark
+{
+    public:
+        StoreBenchmark(size_t samplesPerChannel, size_t channels, unsigned passes = 5);
+
+        std::vector<StoreResult> run(void);
+        static void render(const std::vector<StoreResult>& results, std::string& out);
+
+    private:
+        size_t samplesPerChannel;
+        size_t channels;
+        unsigned passes;
+};
+
+#endif /* STORE_BENCHMARK_H */
@@ -0,0 +1,358 @@
+/**
+ * @file telemetry_bus.cpp
+ * @brief Fan-out of the sample stream with a backpressure policy per consumer.
+ *
+ * The ring holds the last slots() samples and every consumer a cursor into
+ * it. The lag of a consumer is the distance from its cursor to the head; a
+ * consumer at a lag of a full ring is about to lose its oldest unread sample,
+ * and that is the only moment its policy is asked what to do, on the
+ * sampler's side for DROP_OLDEST and BLOCK, on the reader's side for
+ * DECIMATE and COALESCE.
+ */
+
+#include "telemetry_bus.h"
+#include "alloc_tracker.h"
+#include <algorithm>
+
+namespace
+{
+    int64_t wallClockMs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief Constructor. The ring is allocated here, once.
+ * @param slots Samples held for the slowest consumer; a sample of each channel counts as one.
+ */
+TelemetryBus::TelemetryBus(size_t slots)
+    : ring(std::max<size_t>(slots, 16))
+{
+}
+
+/**
+ * @brief Adds a consumer. It reads the samples published from now on.
+ * @param options Name and backpressure policy.
+ * @return Consumer id for read(), or -1 when maxConsumers are subscribed.
+ */
+int TelemetryBus::subscribe(const BusConsumerOptions& options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (size_t id = 0; id < maxConsumers; id++)
+    {
+        Consumer& consumer = consumers[id];
+
+        if (consumer.active)
+            continue;
+        consumer = Consumer();
+        consumer.active = true;
+        consumer.options = options;
+        consumer.cursor = head;
+        consumer.stats.name = options.name;
+        consumer.stats.policy = options.policy;
+        return static_cast<int>(id);
+    }
+    return -1;
+}
+
+/**
+ * @brief Removes a consumer. A sampler waiting for it stops waiting.
+ */
+void TelemetryBus::unsubscribe(int consumer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (consumer < 0 || consumer >= static_cast<int>(maxConsumers))
+        return;
+    consumers[consumer].active = false;
+    if (producerWaiting)
+        space.notify_all();
+}
+
+/**
+ * @brief Frees the slot of the oldest sample unread by a consumer a full ring behind.
+ * A BLOCK consumer is waited for first, up to its timeout counted from the
+ * start of the publish.
+ * @return True when the sampler waited.
+ */
+bool TelemetryBus::makeRoom(Consumer& consumer, std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point start)
+{
+    bool waited = false;
+    uint64_t skipped;
+
+    if (consumer.options.policy == BackpressurePolicy::BLOCK && !consumer.overrun)
+    {
+        producerWaiting++;
+        space.wait_until(lock, start + std::chrono::milliseconds(consumer.options.blockTimeoutMs), [&]
+        {
+            return closed || !consumer.active || head - consumer.cursor < ring.size();
+        });
+        producerWaiting--;
+        waited = true;
+        if (closed || !consumer.active || head - consumer.cursor < ring.size())
+            return waited;
+
+        /* Too slow to wait for: dropped from until it catches up */
+        consumer.overrun = true;
+        consumer.stats.timeouts++;
+    }
+
+    skipped = head - consumer.cursor - ring.size() + 1;
+    consumer.cursor += skipped;
+    if (consumer.options.policy == BackpressurePolicy::COALESCE)
+        consumer.stats.coalesced += skipped;  /* A later sample of the channel is still unread */
+    else
+        consumer.stats.dropped += skipped;
+    return waited;
+}
+
+/**
+ * @brief Publishes one sample of one channel.
+ * Waits only for BLOCK consumers a full ring behind, each for at most its timeout.
+ */
+void TelemetryBus::publish(int channel, const Sample& sample)
+{
+    PS_ZERO_ALLOCATION_PROBE("bus.publish");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    bool waited = false;
+    BusEntry *entry;
+
+    if (closed)
+        return;
+    for (Consumer& consumer : consumers)
+    {
+        if (consumer.active && head - consumer.cursor >= ring.size())
+            waited |= makeRoom(consumer, lock, start);
+    }
+
+    entry = &ring[head % ring.size()];
+    entry->index = head;
+    entry->channel = channel;
+    entry->sample = sample;
+    head++;
+    for (Consumer& consumer : consumers)
+    {
+        if (consumer.active)
+            consumer.stats.maxLag = std::max(consumer.stats.maxLag, head - consumer.cursor);
+    }
+
+    if (waited)
+    {
+        uint32_t us = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                std::chrono::steady_clock::now() - start).count());
+        blockedUs += us;
+        maxBlockedUs = std::max(maxBlockedUs, us);
+    }
+    if (consumersWaiting)
+        data.notify_all();
+}
+
+/**
+ * @brief Reads the unread samples of a consumer, oldest first, as its policy delivers them.
+ * DECIMATE keeps the samples whose sequence number is a multiple of the
+ * stride, so the outputs of one read stay together; the stride is 1 up to
+ * the decimation lag and grows by one per further multiple of it. COALESCE
+ * consumes everything unread and returns one sample per channel, the latest;
+ * capacity should be at least the number of channels.
+ * @param consumer Id from subscribe().
+ * @param entries Filled with up to capacity samples.
+ * @param capacity Size of entries.
+ * @return Number of samples read.
+ */
+size_t TelemetryBus::read(int consumer, BusEntry *entries, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+
+    if (consumer < 0 || consumer >= static_cast<int>(maxConsumers) || !consumers[consumer].active || capacity == 0)
+        return 0;
+    Consumer& reader = consumers[consumer];
+
+    switch (reader.options.policy)
+    {
+        case BackpressurePolicy::COALESCE:
+            for (; reader.cursor < head; reader.cursor++)
+            {
+                const BusEntry& entry = ring[reader.cursor % ring.size()];
+                size_t i = 0;
+
+                while (i < count && entries[i].channel != entry.channel)
+                    i++;
+                if (i == count && count == capacity)
+                    break;  /* No room for another channel; left for the next read */
+                if (i < count)
+                    reader.stats.coalesced++;
+                else
+                    count++;
+                entries[i] = entry;
+            }
+            break;
+
+        case BackpressurePolicy::DECIMATE:
+        {
+            uint64_t above = decimateAbove(reader);
+            uint64_t lag = head - reader.cursor;
+            uint64_t stride = lag > above ? (lag + above - 1) / above : 1;
+
+            while (reader.cursor < head && count < capacity)
+            {
+                const BusEntry& entry = ring[reader.cursor % ring.size()];
+
+                reader.cursor++;
+                if (stride > 1 && entry.sample.sequence % stride != 0)
+                {
+                    reader.stats.decimated++;
+                    continue;
+                }
+                entries[count++] = entry;
+            }
+            break;
+        }
+
+        default:
+            while (reader.cursor < head && count < capacity)
+                entries[count++] = ring[reader.cursor++ % ring.size()];
+            break;
+    }
+
+    reader.stats.delivered += count;
+    if (reader.overrun && head - reader.cursor <= ring.size() / 2)
+        reader.overrun = false;
+    if (producerWaiting && reader.options.policy == BackpressurePolicy::BLOCK)
+        space.notify_all();
+    return count;
+}
+
+/**
+ * @brief Waits until a consumer has unread samples.
+ * @param consumer Id from subscribe().
+ * @param timeoutMs Longest wait.
+ * @return True when there is something to read.
+ */
+bool TelemetryBus::waitForData(int consumer, uint32_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (consumer < 0 || consumer >= static_cast<int>(maxConsumers) || !consumers[consumer].active)
+        return false;
+    Consumer& reader = consumers[consumer];
+
+    consumersWaiting++;
+    data.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]
+    {
+        return closed || !reader.active || head > reader.cursor;
+    });
+    consumersWaiting--;
+    return reader.active && head > reader.cursor;
+}
+
+/**
+ * @brief Stops publishing and wakes every waiting thread.
+ */
+void TelemetryBus::close(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    closed = true;
+    space.notify_all();
+    data.notify_all();
+}
+
+uint64_t TelemetryBus::published(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return head;
+}
+
+/**
+ * @brief Total time the sampler spent waiting for BLOCK consumers.
+ */
+uint64_t TelemetryBus::publishBlockedUs(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return blockedUs;
+}
+
+uint32_t TelemetryBus::maxPublishBlockedUs(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return maxBlockedUs;
+}
+
+/**
+ * @brief Memory held by the bus. Fixed at construction.
+ */
+size_t TelemetryBus::memoryBytes(void) const
+{
+    return sizeof(*this) + ring.capacity() * sizeof(BusEntry);
+}
+
+/**
+ * @brief Figures of every subscribed consumer, with their lag now.
+ */
+std::vector<BusConsumerStats> TelemetryBus::stats(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<BusConsumerStats> all;
+    int64_t nowMs = wallClockMs();
+
+    for (const Consumer& consumer : consumers)
+    {
+        if (!consumer.active)
+            continue;
+        all.push_back(consumer.stats);
+        all.back().lag = head - consumer.cursor;
+        if (consumer.cursor < head)
+            all.back().lagMs = std::max<int64_t>(0, nowMs - ring[consumer.cursor % ring.size()].sample.timestampMs);
+    }
+    return all;
+}
+
+/**
+ * @brief Lag from which a DECIMATE consumer is decimated.
+ */
+size_t TelemetryBus::decimateAbove(const Consumer& consumer) const
+{
+    if (consumer.options.decimateAbove == 0)
+        return std::max<size_t>(1, ring.size() / 4);
+    return std::min(consumer.options.decimateAbove, ring.size());
+}
+
+const char* TelemetryBus::policyName(BackpressurePolicy policy)
+{
+    switch (policy)
+    {
+        case BackpressurePolicy::DECIMATE:
+            return "decimate";
+        case BackpressurePolicy::BLOCK:
+            return "block";
+        case BackpressurePolicy::COALESCE:
+            return "coalesce";
+        default:
+            return "drop-oldest";
+    }
+}
+
+/**
+ * @brief Reads a policy by the name policyName() gives it.
+ * @return False for an unknown name; policy is then unchanged.
+ */
+bool TelemetryBus::parsePolicy(const std::string& name, BackpressurePolicy& policy)
+{
+    static const BackpressurePolicy all[] = {BackpressurePolicy::DROP_OLDEST, BackpressurePolicy::DECIMATE,
+                                             BackpressurePolicy::BLOCK, BackpressurePolicy::COALESCE};
+
+    for (BackpressurePolicy candidate : all)
+    {
+        if (name == policyName(candidate))
+        {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
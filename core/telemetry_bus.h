@@ -0,0 +1,112 @@
+#ifndef TELEMETRY_BUS_H
+#define TELEMETRY_BUS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "sample.h"
+
+/* What the bus does when a consumer is a full ring behind */
+enum class BackpressurePolicy
+{
+    DROP_OLDEST = 0,  /* The oldest unread samples are overwritten */
+    DECIMATE,         /* A lagging consumer gets every nth sample; n grows with the lag */
+    BLOCK,            /* The sampler waits for room up to a timeout, then drops the oldest */
+    COALESCE          /* A read returns only the latest unread sample of each channel */
+};
+
+struct BusConsumerOptions
+{
+    std::string name;
+    BackpressurePolicy policy = BackpressurePolicy::DROP_OLDEST;
+    uint32_t blockTimeoutMs = 20;  /* BLOCK: longest wait of the sampler for one sample */
+    size_t decimateAbove = 0;      /* DECIMATE: lag where decimation starts, 0 for a quarter of the ring */
+};
+
+/* One sample of one channel, numbered in the bus stream */
+struct BusEntry
+{
+    uint64_t index = 0;
+    int32_t channel = 0;
+    Sample sample;
+};
+
+/* Delivery and lag figures of one consumer since it subscribed */
+struct BusConsumerStats
+{
+    std::string name;
+    BackpressurePolicy policy = BackpressurePolicy::DROP_OLDEST;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;      /* Overwritten before they were read */
+    uint64_t decimated = 0;    /* Skipped by decimation */
+    uint64_t coalesced = 0;    /* Replaced by a later sample of their channel */
+    uint64_t timeouts = 0;     /* BLOCK waits of the sampler that ended in a drop */
+    uint64_t lag = 0;          /* Unread samples now */
+    uint64_t maxLag = 0;
+    int64_t lagMs = 0;         /* Age of the oldest unread sample */
+};
+
+/* Fan-out of the sampler's stream to consumers on other threads.
+   Samples go to one fixed ring; every consumer reads it through a cursor of
+   its own, so a slow consumer never holds back a fast one, and memory does
+   not depend on how far anyone falls behind. A consumer a full ring behind
+   is handled by its policy. Only BLOCK consumers make the sampler wait, for
+   at most their timeout per sample; one that times out is treated as
+   DROP_OLDEST until it has caught up to half a ring, so a consumer that
+   stays slow costs the sampler one timeout, not one per sample. Publishing
+   never allocates. All members lock. */
+class TelemetryBus
+{
+    public:
+        static constexpr size_t maxConsumers = 8;
+
+        explicit TelemetryBus(size_t slots = 4096);
+
+        int subscribe(const BusConsumerOptions& options);
+        void unsubscribe(int consumer);
+        void publish(int channel, const Sample& sample);
+        size_t read(int consumer, BusEntry *entries, size_t capacity);
+        bool waitForData(int consumer, uint32_t timeoutMs);
+        void close(void);
+
+        size_t slots(void) const { return ring.size(); }
+        uint64_t published(void) const;
+        uint64_t publishBlockedUs(void) const;
+        uint32_t maxPublishBlockedUs(void) const;
+        size_t memoryBytes(void) const;
+        std::vector<BusConsumerStats> stats(void) const;
+
+        static const char* policyName(BackpressurePolicy policy);
+        static bool parsePolicy(const std::string& name, BackpressurePolicy& policy);
+
+    private:
+        struct Consumer
+        {
+            bool active = false;
+            bool overrun = false;  /* BLOCK timed out; no waiting until caught up */
+            BusConsumerOptions options;
+            uint64_t cursor = 0;   /* Stream index of the next unread sample */
+            BusConsumerStats stats;
+        };
+
+        mutable std::mutex mutex;
+        std::condition_variable space;  /* A BLOCK consumer read */
+        std::condition_variable data;   /* A sample was published */
+        std::vector<BusEntry> ring;
+        uint64_t head = 0;              /* Samples ever published */
+        uint64_t blockedUs = 0;
+        uint32_t maxBlockedUs = 0;
+        int producerWaiting = 0;
+        int consumersWaiting = 0;
+        bool closed = false;
+        Consumer consumers[maxConsumers];
+
+        bool makeRoom(Consumer& consumer, std::unique_lock<std::mutex>& lock, std::chrono::steady_clock::time_point start);
+        size_t decimateAbove(const Consumer& consumer) const;
+};
+
+#endif /* TELEMETRY_BUS_H */
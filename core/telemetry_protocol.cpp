@@ -0,0 +1,357 @@
+/**
+ * @file telemetry_protocol.cpp
+ * @brief Encoder and zero-copy decoder of the binary telemetry framing.
+ *
+ * Steady readings change rarely, so after the schema and a keyframe most
+ * frames carry a small timestamp delta, a changed-channel bitmap and one or
+ * two bytes per changed value. The decoder walks varints directly in the
+ * receive buffer; nothing is copied before values reach the handler.
+ */
+
+#include "telemetry_protocol.h"
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    void putVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putSigned(std::vector<uint8_t>& out, int64_t value)
+    {
+        putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void putDouble(std::vector<uint8_t>& out, double value)
+    {
+        uint8_t bytes[sizeof(double)];
+        memcpy(bytes, &value, sizeof(value));
+        out.insert(out.end(), bytes, bytes + sizeof(bytes));
+    }
+
+    size_t varintSize(uint64_t value)
+    {
+        size_t size = 1;
+        while (value >= 0x80)
+        {
+            value >>= 7;
+            size++;
+        }
+        return size;
+    }
+
+    /* Bounds-checked reader over a frame body */
+    struct Cursor
+    {
+        const uint8_t *position;
+        const uint8_t *end;
+        bool ok = true;
+
+        uint64_t varint(void)
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (position >= end)
+                    break;
+                uint8_t byte = *position++;
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            ok = false;
+            return 0;
+        }
+
+        int64_t signedVarint(void)
+        {
+            uint64_t zigzag = varint();
+            return static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+        }
+
+        const uint8_t* bytes(size_t count)
+        {
+            const uint8_t *start = position;
+            if (static_cast<size_t>(end - position) < count)
+            {
+                ok = false;
+                return nullptr;
+            }
+            position += count;
+            return start;
+        }
+
+        uint8_t u8(void)
+        {
+            const uint8_t *raw = bytes(1);
+            return raw ? *raw : 0;
+        }
+
+        double float64(void)
+        {
+            double value = 0.0;
+            const uint8_t *raw = bytes(sizeof(double));
+            if (raw)
+                memcpy(&value, raw, sizeof(value));
+            return value;
+        }
+    };
+
+    int32_t clampToInt32(int64_t value, bool& ok)
+    {
+        if (value < INT32_MIN || value > INT32_MAX)
+        {
+            ok = false;
+            return 0;
+        }
+        return static_cast<int32_t>(value);
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param channels Channel names and units, announced by the schema frame.
+ * @param keyframeInterval A keyframe replaces a delta frame every this many sample frames.
+ */
+TelemetryEncoder::TelemetryEncoder(const std::vector<TelemetryChannelInfo>& channels, uint32_t keyframeInterval)
+    : channels(channels), lastVoltage(channels.size(), 0), lastCurrent(channels.size(), 0),
+      keyframeInterval(keyframeInterval ? keyframeInterval : 1), framesSinceKeyframe(this->keyframeInterval)
+{
+}
+
+/**
+ * @brief Prefixes the scratch body with the frame header and appends it to out.
+ */
+void TelemetryEncoder::finishFrame(TelemetryFrameType type, std::vector<uint8_t>& out)
+{
+    putVarint(out, 1 + varintSize(sequence) + body.size());
+    out.push_back(static_cast<uint8_t>(type));
+    putVarint(out, sequence);
+    out.insert(out.end(), body.begin(), body.end());
+    sequence++;
+}
+
+/**
+ * @brief Appends the schema frame. The next sample frame is a keyframe.
+ */
+void TelemetryEncoder::encodeSchema(std::vector<uint8_t>& out)
+{
+    body.clear();
+    body.push_back(1);
+    putVarint(body, channels.size());
+    for (const TelemetryChannelInfo& channel : channels)
+    {
+        putVarint(body, channel.name.size());
+        body.insert(body.end(), channel.name.begin(), channel.name.end());
+        putDouble(body, channel.voltsPerCount);
+        putDouble(body, channel.ampsPerCount);
+    }
+    finishFrame(TelemetryFrameType::SCHEMA, out);
+    framesSinceKeyframe = keyframeInterval;
+}
+
+/**
+ * @brief Appends a keyframe or a delta frame with the values of all channels.
+ * @param timestampMs Sample time in milliseconds since the epoch.
+ * @param voltage Voltage counts, one per channel.
+ * @param current Current counts, one per channel.
+ * @param out Frame bytes are appended here.
+ */
+void TelemetryEncoder::encodeSamples(int64_t timestampMs, const int32_t *voltage, const int32_t *current, std::vector<uint8_t>& out)
+{
+    size_t channelCount = channels.size();
+
+    body.clear();
+    if (framesSinceKeyframe >= keyframeInterval)
+    {
+        putVarint(body, static_cast<uint64_t>(timestampMs));
+        for (size_t ch = 0; ch < channelCount; ch++)
+        {
+            putSigned(body, voltage[ch]);
+            putSigned(body, current[ch]);
+        }
+        finishFrame(TelemetryFrameType::KEYFRAME, out);
+        framesSinceKeyframe = 0;
+    }
+    else
+    {
+        size_t bitmapOffset;
+
+        putSigned(body, timestampMs - lastTimestampMs);
+        bitmapOffset = body.size();
+        body.resize(bitmapOffset + (channelCount + 7) / 8, 0);
+        for (size_t ch = 0; ch < channelCount; ch++)
+        {
+            if (voltage[ch] == lastVoltage[ch] && current[ch] == lastCurrent[ch])
+                continue;
+            body[bitmapOffset + ch / 8] |= static_cast<uint8_t>(1u << (ch % 8));
+            putSigned(body, static_cast<int64_t>(voltage[ch]) - lastVoltage[ch]);
+            putSigned(body, static_cast<int64_t>(current[ch]) - lastCurrent[ch]);
+        }
+        finishFrame(TelemetryFrameType::DELTA, out);
+        framesSinceKeyframe++;
+    }
+
+    memcpy(lastVoltage.data(), voltage, channelCount * sizeof(int32_t));
+    memcpy(lastCurrent.data(), current, channelCount * sizeof(int32_t));
+    lastTimestampMs = timestampMs;
+}
+
+/**
+ * @brief Appends a heartbeat so receivers can tell an idle link from a dead one.
+ */
+void TelemetryEncoder::encodeHeartbeat(int64_t timestampMs, std::vector<uint8_t>& out)
+{
+    body.clear();
+    putVarint(body, static_cast<uint64_t>(timestampMs));
+    finishFrame(TelemetryFrameType::HEARTBEAT, out);
+}
+
+/**
+ * @brief Locates the next frame in a receive buffer without copying it.
+ * @param data Start of the unread bytes.
+ * @param size Number of unread bytes.
+ * @param consumed Receives the size of the frame when FRAME is returned.
+ * @param frame Receives a view of the frame; valid while the buffer is.
+ */
+TelemetryDecoder::DecodeStatus TelemetryDecoder::parse(const uint8_t *data, size_t size, size_t& consumed, Frame& frame)
+{
+    Cursor header{data, data + size};
+    uint64_t length;
+    const uint8_t *frameStart;
+    uint8_t type;
+
+    consumed = 0;
+    length = header.varint();
+    if (!header.ok)
+        return (size < 10) ? DecodeStatus::NEED_MORE : DecodeStatus::CORRUPT;
+    if (length < 2 || length > (1u << 24))
+        return DecodeStatus::CORRUPT;
+    if (static_cast<size_t>(header.end - header.position) < length)
+        return DecodeStatus::NEED_MORE;
+
+    frameStart = header.position;
+    Cursor cursor{frameStart, frameStart + length};
+    type = cursor.u8();
+    if (type < static_cast<uint8_t>(TelemetryFrameType::SCHEMA) || type > static_cast<uint8_t>(TelemetryFrameType::HEARTBEAT))
+        return DecodeStatus::CORRUPT;
+    frame.type = static_cast<TelemetryFrameType>(type);
+    frame.sequence = cursor.varint();
+    if (!cursor.ok)
+        return DecodeStatus::CORRUPT;
+
+    frame.body = cursor.position;
+    frame.bodySize = static_cast<size_t>(cursor.end - cursor.position);
+    consumed = static_cast<size_t>(cursor.end - data);
+    return DecodeStatus::FRAME;
+}
+
+/**
+ * @brief Applies a frame to the decoder state.
+ * @param frame Frame returned by parse().
+ * @param handler Called for every channel carried by the frame, may be empty.
+ * @return False if the frame is malformed or cannot be applied (no schema or keyframe yet).
+ */
+bool TelemetryDecoder::apply(const Frame& frame, const ChannelHandler& handler)
+{
+    Cursor cursor{frame.body, frame.body + frame.bodySize};
+
+    /* Lost frames invalidate the delta chain until the next keyframe */
+    if (hasSequence && frame.sequence != expectedSequence)
+    {
+        lost += frame.sequence - expectedSequence;
+        hasState = false;
+    }
+    hasSequence = true;
+    expectedSequence = frame.sequence + 1;
+
+    switch (frame.type)
+    {
+        case TelemetryFrameType::SCHEMA:
+        {
+            std::vector<TelemetryChannelInfo> parsed;
+            uint8_t version = cursor.u8();
+            uint64_t count = cursor.varint();
+            if (!cursor.ok || version != 1 || count > frame.bodySize)
+                return false;
+            parsed.resize(count);
+            for (TelemetryChannelInfo& channel : parsed)
+            {
+                uint64_t nameSize = cursor.varint();
+                const uint8_t *name = cursor.bytes(nameSize);
+                if (!cursor.ok)
+                    return false;
+                channel.name.assign(reinterpret_cast<const char*>(name), nameSize);
+                channel.voltsPerCount = cursor.float64();
+                channel.ampsPerCount = cursor.float64();
+            }
+            if (!cursor.ok)
+                return false;
+            channels = parsed;
+            lastVoltage.assign(count, 0);
+            lastCurrent.assign(count, 0);
+            hasSchema = true;
+            hasState = false;
+            return true;
+        }
+
+        case TelemetryFrameType::KEYFRAME:
+        {
+            if (!hasSchema)
+                return false;
+            lastTimestampMs = static_cast<int64_t>(cursor.varint());
+            for (size_t ch = 0; ch < channels.size(); ch++)
+            {
+                lastVoltage[ch] = clampToInt32(cursor.signedVarint(), cursor.ok);
+                lastCurrent[ch] = clampToInt32(cursor.signedVarint(), cursor.ok);
+            }
+            if (!cursor.ok)
+                return false;
+            hasState = true;
+            if (handler)
+            {
+                for (size_t ch = 0; ch < channels.size(); ch++)
+                    handler(ch, lastVoltage[ch], lastCurrent[ch]);
+            }
+            return true;
+        }
+
+        case TelemetryFrameType::DELTA:
+        {
+            const uint8_t *bitmap;
+            if (!synchronized())
+                return false;
+            lastTimestampMs += cursor.signedVarint();
+            bitmap = cursor.bytes((channels.size() + 7) / 8);
+            if (!cursor.ok)
+                return false;
+            for (size_t ch = 0; ch < channels.size(); ch++)
+            {
+                if ((bitmap[ch / 8] & (1u << (ch % 8))) == 0)
+                    continue;
+                lastVoltage[ch] = clampToInt32(lastVoltage[ch] + cursor.signedVarint(), cursor.ok);
+                lastCurrent[ch] = clampToInt32(lastCurrent[ch] + cursor.signedVarint(), cursor.ok);
+                if (!cursor.ok)
+                {
+                    hasState = false;
+                    return false;
+                }
+                if (handler)
+                    handler(ch, lastVoltage[ch], lastCurrent[ch]);
+            }
+            return true;
+        }
+
+        case TelemetryFrameType::HEARTBEAT:
+            lastTimestampMs = static_cast<int64_t>(cursor.varint());
+            return cursor.ok;
+    }
+    return false;
+}
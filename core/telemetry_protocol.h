@@ -0,0 +1,109 @@
+#ifndef TELEMETRY_PROTOCOL_H
+#define TELEMETRY_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Compact binary telemetry framing.
+
+   Every frame:   [length varint][type u8][sequence varint][body]
+   where length counts the bytes after the length field itself.
+
+   SCHEMA     [version u8][channels varint] then per channel
+              [name length varint][name][volts per count f64][amps per count f64]
+   KEYFRAME   [timestamp ms varint] then per channel [voltage zz][current zz]
+   DELTA      [timestamp delta zz][changed bitmap, 1 bit per channel]
+              then per changed channel [voltage delta zz][current delta zz]
+   HEARTBEAT  [timestamp ms varint]
+
+   zz = zigzag mapped signed varint. Values are int32 counts scaled by the
+   per-channel units announced in the schema. Sequence numbers increase by
+   one per frame; a receiver that sees a jump drops its state until the next
+   keyframe. */
+
+enum class TelemetryFrameType : uint8_t
+{
+    SCHEMA = 1,
+    KEYFRAME = 2,
+    DELTA = 3,
+    HEARTBEAT = 4
+};
+
+struct TelemetryChannelInfo
+{
+    std::string name;
+    double voltsPerCount = 1e-6;
+    double ampsPerCount = 1e-6;
+};
+
+class TelemetryEncoder
+{
+    public:
+        explicit TelemetryEncoder(const std::vector<TelemetryChannelInfo>& channels, uint32_t keyframeInterval = 100);
+
+        void encodeSchema(std::vector<uint8_t>& out);
+        void encodeSamples(int64_t timestampMs, const int32_t *voltage, const int32_t *current, std::vector<uint8_t>& out);
+        void encodeHeartbeat(int64_t timestampMs, std::vector<uint8_t>& out);
+        void requestKeyframe(void) { framesSinceKeyframe = keyframeInterval; }
+
+    private:
+        std::vector<TelemetryChannelInfo> channels;
+        std::vector<int32_t> lastVoltage;
+        std::vector<int32_t> lastCurrent;
+        std::vector<uint8_t> body;   /* Scratch for the frame being built */
+        uint64_t sequence = 0;
+        int64_t lastTimestampMs = 0;
+        uint32_t keyframeInterval;
+        uint32_t framesSinceKeyframe;
+
+        void finishFrame(TelemetryFrameType type, std::vector<uint8_t>& out);
+};
+
+class TelemetryDecoder
+{
+    public:
+        enum class DecodeStatus
+        {
+            FRAME = 0,   /* A complete frame was parsed */
+            NEED_MORE,   /* The buffer ends inside a frame */
+            CORRUPT      /* The buffer does not hold a valid frame */
+        };
+
+        /* View of one frame inside the caller's receive buffer */
+        struct Frame
+        {
+            TelemetryFrameType type;
+            uint64_t sequence;
+            const uint8_t *body;
+            size_t bodySize;
+        };
+
+        /* Called for every channel carried by a keyframe or delta frame */
+        using ChannelHandler = std::function<void(size_t channel, int32_t voltage, int32_t current)>;
+
+        static DecodeStatus parse(const uint8_t *data, size_t size, size_t& consumed, Frame& frame);
+        bool apply(const Frame& frame, const ChannelHandler& handler = nullptr);
+
+        bool synchronized(void) const { return hasSchema && hasState; }
+        const std::vector<TelemetryChannelInfo>& schema(void) const { return channels; }
+        const std::vector<int32_t>& voltage(void) const { return lastVoltage; }
+        const std::vector<int32_t>& current(void) const { return lastCurrent; }
+        int64_t timestampMs(void) const { return lastTimestampMs; }
+        uint64_t lostFrames(void) const { return lost; }
+
+    private:
+        std::vector<TelemetryChannelInfo> channels;
+        std::vector<int32_t> lastVoltage;
+        std::vector<int32_t> lastCurrent;
+        int64_t lastTimestampMs = 0;
+        uint64_t expectedSequence = 0;
+        bool hasSequence = false;
+        bool hasSchema = false;
+        bool hasState = false;
+        uint64_t lost = 0;
+};
+
+#endif /* TELEMETRY_PROTOCOL_H */
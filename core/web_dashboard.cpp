@@ -0,0 +1,525 @@
+/**
+ * @file web_dashboard.cpp
+ * @brief Embedded web dashboard with server-sent event streaming.
+ *
+ * A 20 Hz base tick drives rate tiers of 20, 10, 5, 2 and 1 Hz. Incoming
+ * samples are folded into one accumulator per tier and channel (mean voltage,
+ * mean/min/max current). When a tier's frame is due each channel's JSON
+ * fragment is built once, and each client subscribed to that tier receives
+ * the concatenation of the fragments it asked for. Clients whose socket
+ * cannot keep up skip frames instead of growing the send buffer.
+ *
+ * GET /telemetry streams the 20 Hz means in the binary telemetry framing
+ * for remote tools: one delta frame per tick, encoded once for all of them.
+ *
+ * The optional history keeps every published sample at full rate in
+ * compressed blocks under a memory cap; /history decodes only the blocks of
+ * the requested window and thins them to the plot's point budget.
+ */
+
+#include "web_dashboard.h"
+#include "alloc_tracker.h"
+#include <QDebug>
+#include <QFile>
+#include <QHostAddress>
+#include <QUrlQuery>
+#include <cmath>
+#include <limits>
+
+/**
+ * @brief Constructor.
+ * @param channels Number of channels that can be published.
+ * @param parent Parent QObject.
+ */
+WebDashboard::WebDashboard(int channels, QObject *parent)
+    : QObject(parent), channelCount(channels), encoder(telemetryChannels(channels)),
+      binaryVoltage(static_cast<size_t>(qMax(channels, 0)), 0), binaryCurrent(static_cast<size_t>(qMax(channels, 0)), 0)
+{
+    const int rates[] = {20, 10, 5, 2, 1};
+
+    for (int rate : rates)
+    {
+        Tier tier;
+        tier.rateHz = rate;
+        tier.ticksPerFrame = baseRateHz / rate;
+        tier.channels.resize(channels);
+        tier.fragments.resize(channels);
+        tiers.push_back(tier);
+    }
+
+    connect(&server, &QTcpServer::newConnection, this, &WebDashboard::on_newConnection);
+    connect(&ticker, &QTimer::timeout, this, &WebDashboard::on_tick);
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(1000 / baseRateHz);
+}
+
+/**
+ * @brief Schema of the binary stream: one channel per output, microvolt and microamp counts.
+ */
+std::vector<TelemetryChannelInfo> WebDashboard::telemetryChannels(int channels)
+{
+    std::vector<TelemetryChannelInfo> info(static_cast<size_t>(qMax(channels, 0)));
+
+    for (size_t ch = 0; ch < info.size(); ch++)
+        info[ch].name = "out" + std::to_string(ch + 1);
+    return info;
+}
+
+/**
+ * @brief Keeps the published samples for the scroll-back chart.
+ * @param memoryCapBytes Memory cap of the history; the oldest samples are evicted beyond it.
+ */
+void WebDashboard::enableHistory(size_t memoryCapBytes)
+{
+    history.reset(new CompressedHistory(static_cast<size_t>(channelCount), memoryCapBytes));
+}
+
+/**
+ * @brief Starts serving.
+ * @param address Interface to listen on: QHostAddress::LocalHost, or QHostAddress::Any
+ * to expose the dashboard on the LAN.
+ * @param port TCP port, 0 for any free port.
+ * @return True if the port could be bound.
+ */
+bool WebDashboard::start(const QHostAddress& address, quint16 port)
+{
+    if (!server.listen(address, port))
+    {
+        qDebug() << "Dashboard: Failed to listen on port" << port << server.errorString();
+        return false;
+    }
+    ticker.start();
+    return true;
+}
+
+/**
+ * @brief Stops serving and drops all event streams.
+ */
+void WebDashboard::stop(void)
+{
+    QList<Client> closing;
+
+    ticker.stop();
+    server.close();
+
+    /* abort() emits disconnected() synchronously, which would edit the list being walked */
+    closing.swap(clients);
+    for (const Client& client : closing)
+    {
+        disconnect(client.socket, nullptr, this, nullptr);
+        client.socket->abort();
+        client.socket->deleteLater();
+    }
+}
+
+int WebDashboard::clientCount(void) const
+{
+    return clients.size();
+}
+
+quint16 WebDashboard::serverPort(void) const
+{
+    return server.serverPort();
+}
+
+/**
+ * @brief Frames skipped so far for the clients still connected.
+ */
+qint64 WebDashboard::droppedFrames(void) const
+{
+    qint64 dropped = 0;
+
+    for (const Client& client : clients)
+        dropped += client.droppedFrames;
+    return dropped;
+}
+
+/**
+ * @brief Slot receiving samples from the sampler.
+ * @param channel Channel number.
+ * @param timestampMs Sample time in milliseconds since the epoch.
+ * @param voltage Voltage in volts.
+ * @param current Current in amps.
+ */
+void WebDashboard::publish(int channel, qint64 timestampMs, double voltage, double current)
+{
+    if (channel < 0 || channel >= channelCount)
+        return;
+    if (history)
+        history->append(static_cast<size_t>(channel), timestampMs, voltage, current);
+
+    for (Tier& tier : tiers)
+    {
+        Accumulator& acc = tier.channels[channel];
+        if (acc.count == 0)
+        {
+            acc.minCurrent = current;
+            acc.maxCurrent = current;
+        }
+        acc.count++;
+        acc.lastTimestampMs = timestampMs;
+        acc.sumVoltage += voltage;
+        acc.sumCurrent += current;
+        acc.minCurrent = qMin(acc.minCurrent, current);
+        acc.maxCurrent = qMax(acc.maxCurrent, current);
+    }
+}
+
+/**
+ * @brief Returns the fastest tier not above the requested rate.
+ */
+int WebDashboard::tierForRate(int rateHz) const
+{
+    for (size_t i = 0; i < tiers.size(); i++)
+    {
+        if (tiers[i].rateHz <= rateHz)
+            return static_cast<int>(i);
+    }
+    return static_cast<int>(tiers.size()) - 1;
+}
+
+/**
+ * @brief Base tick: emits the frames of every tier that is due.
+ */
+void WebDashboard::on_tick(void)
+{
+    PS_ALLOCATION_PROBE("dashboard.frame");
+
+    tickCount++;
+
+    for (size_t t = 0; t < tiers.size(); t++)
+    {
+        Tier& tier = tiers[t];
+        bool subscribed = false;
+
+        if (tickCount % tier.ticksPerFrame != 0)
+            continue;
+
+        for (const Client& client : clients)
+            subscribed |= (client.tier == static_cast<int>(t));
+
+        /* Decimate once per tier: one fragment per channel with new samples */
+        for (int ch = 0; ch < channelCount; ch++)
+        {
+            Accumulator& acc = tier.channels[ch];
+            tier.fragments[ch].clear();
+            if (acc.count != 0 && subscribed)
+            {
+                tier.fragments[ch] = QByteArray("{\"ch\":") + QByteArray::number(ch) +
+                                     ",\"t\":" + QByteArray::number(acc.lastTimestampMs) +
+                                     ",\"v\":" + QByteArray::number(acc.sumVoltage / acc.count, 'g', 7) +
+                                     ",\"i\":" + QByteArray::number(acc.sumCurrent / acc.count, 'g', 7) +
+                                     ",\"imin\":" + QByteArray::number(acc.minCurrent, 'g', 7) +
+                                     ",\"imax\":" + QByteArray::number(acc.maxCurrent, 'g', 7) + "}";
+            }
+            if (t == 0 && acc.count != 0)
+            {
+                /* The fastest tier's means also feed the binary stream */
+                binaryVoltage[ch] = static_cast<int32_t>(std::lround(acc.sumVoltage / acc.count * 1e6));
+                binaryCurrent[ch] = static_cast<int32_t>(std::lround(acc.sumCurrent / acc.count * 1e6));
+                binaryTimestampMs = qMax(binaryTimestampMs, acc.lastTimestampMs);
+                binaryChanged = true;
+            }
+            acc = Accumulator();
+        }
+        if (!subscribed)
+            continue;
+
+        /* Per client work is only concatenation */
+        for (Client& client : clients)
+        {
+            QByteArray frame;
+            bool first = true;
+
+            if (client.tier != static_cast<int>(t))
+                continue;
+
+            frame.reserve(64 + 128 * (client.channels.empty() ? channelCount : static_cast<int>(client.channels.size())));
+            frame += "data: [";
+            for (int i = 0; i < (client.channels.empty() ? channelCount : static_cast<int>(client.channels.size())); i++)
+            {
+                int ch = client.channels.empty() ? i : client.channels[i];
+                if (tier.fragments[ch].isEmpty())
+                    continue;
+                if (!first)
+                    frame += ',';
+                frame += tier.fragments[ch];
+                first = false;
+            }
+            frame += "]\n\n";
+            if (first)
+                continue;
+
+            if (client.socket->bytesToWrite() > maxPendingBytes)
+            {
+                client.droppedFrames++;
+                continue;
+            }
+            client.socket->write(frame);
+        }
+    }
+
+    sendTelemetry();
+}
+
+/**
+ * @brief Writes one binary telemetry frame to the binary stream clients.
+ * A delta frame when new samples arrived since the last tick, otherwise a
+ * heartbeat once per second. A client that has to skip a frame loses the
+ * delta state, so the next frame is a keyframe.
+ */
+void WebDashboard::sendTelemetry(void)
+{
+    bool streaming = false;
+
+    for (const Client& client : clients)
+        streaming |= client.binary;
+    if (!streaming)
+        return;
+
+    binaryFrame.clear();
+    if (binaryChanged)
+        encoder.encodeSamples(binaryTimestampMs, binaryVoltage.data(), binaryCurrent.data(), binaryFrame);
+    else if (tickCount % baseRateHz == 0)
+        encoder.encodeHeartbeat(binaryTimestampMs, binaryFrame);
+    binaryChanged = false;
+    if (binaryFrame.empty())
+        return;
+
+    for (Client& client : clients)
+    {
+        if (!client.binary)
+            continue;
+        if (client.socket->bytesToWrite() > maxPendingBytes)
+        {
+            client.droppedFrames++;
+            encoder.requestKeyframe();
+            continue;
+        }
+        client.socket->write(reinterpret_cast<const char*>(binaryFrame.data()), static_cast<qint64>(binaryFrame.size()));
+    }
+}
+
+/**
+ * @brief Slot called when a client connects.
+ */
+void WebDashboard::on_newConnection(void)
+{
+    while (server.hasPendingConnections())
+    {
+        QTcpSocket *socket = server.nextPendingConnection();
+        connect(socket, &QTcpSocket::readyRead, this, &WebDashboard::on_readyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &WebDashboard::on_disconnected);
+    }
+}
+
+/**
+ * @brief Slot called when request bytes arrive.
+ */
+void WebDashboard::on_readyRead(void)
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    QByteArray request;
+    QList<QByteArray> requestLine;
+    QByteArray target;
+    QByteArray path;
+    QByteArray query;
+    QFile page(":/web/dashboard.html");
+
+    if (socket == nullptr)
+        return;
+
+    /* Event streams send nothing after their request */
+    for (const Client& client : clients)
+    {
+        if (client.socket == socket)
+        {
+            socket->readAll();
+            return;
+        }
+    }
+
+    request = socket->peek(maxRequestSize);
+    if (!request.contains("\r\n\r\n"))
+    {
+        if (request.size() >= maxRequestSize)
+            socket->abort();
+        return;
+    }
+    socket->readAll();
+
+    requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    if (requestLine.size() < 2 || requestLine[0] != "GET")
+    {
+        reply(socket, "405 Method Not Allowed", "text/plain", "");
+        return;
+    }
+    target = requestLine[1];
+    path = target.left(target.indexOf('?') < 0 ? target.size() : target.indexOf('?'));
+    query = target.mid(path.size() + 1);
+
+    if (path == "/events")
+    {
+        serveEvents(socket, query);
+    }
+    else if (path == "/telemetry")
+    {
+        serveTelemetry(socket);
+    }
+    else if (path == "/history")
+    {
+        serveHistory(socket, query);
+    }
+    else if ((path == "/" || path == "/index.html") && page.open(QIODevice::ReadOnly))
+    {
+        reply(socket, "200 OK", "text/html; charset=utf-8", page.readAll());
+    }
+    else
+    {
+        reply(socket, "404 Not Found", "text/plain", "");
+    }
+}
+
+/**
+ * @brief Turns a connection into a server-sent event stream.
+ * @param socket Client connection.
+ * @param query URL query: rate=<Hz>&channels=<n>,<n>,...
+ */
+void WebDashboard::serveEvents(QTcpSocket *socket, const QByteArray& query)
+{
+    QUrlQuery params(QString::fromUtf8(query));
+    Client client;
+    int rate = params.queryItemValue("rate").toInt();
+
+    client.socket = socket;
+    client.tier = tierForRate(rate > 0 ? rate : 1);
+    for (const QString& item : params.queryItemValue("channels").split(',', Qt::SkipEmptyParts))
+    {
+        bool ok = false;
+        int ch = item.toInt(&ok);
+        if (ok && ch >= 0 && ch < channelCount)
+            client.channels.push_back(ch);
+    }
+
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: text/event-stream\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: keep-alive\r\n\r\n");
+    socket->write("retry: 2000\nevent: hello\ndata: {\"rate\":" + QByteArray::number(tiers[client.tier].rateHz) +
+                  ",\"channels\":" + QByteArray::number(channelCount) + "}\n\n");
+    clients.append(client);
+}
+
+/**
+ * @brief Turns a connection into a binary telemetry stream (see telemetry_protocol.h).
+ * The stream starts with the schema; the next frame is a keyframe.
+ */
+void WebDashboard::serveTelemetry(QTcpSocket *socket)
+{
+    Client client;
+    std::vector<uint8_t> schema;
+
+    client.socket = socket;
+    client.tier = -1;
+    client.binary = true;
+
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: application/octet-stream\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: close\r\n\r\n");
+    encoder.encodeSchema(schema);
+    socket->write(reinterpret_cast<const char*>(schema.data()), static_cast<qint64>(schema.size()));
+
+    /* The schema took a sequence number from the other streams too; the keyframe resynchronizes them */
+    binaryChanged = true;
+    clients.append(client);
+}
+
+/**
+ * @brief Replies with a window of the history as JSON.
+ * @param socket Client connection.
+ * @param query URL query: channel=<n>&from=<ms>&to=<ms>&points=<n>. The
+ * window defaults to everything retained, points to 1000.
+ */
+void WebDashboard::serveHistory(QTcpSocket *socket, const QByteArray& query)
+{
+    QUrlQuery params(QString::fromUtf8(query));
+    std::vector<HistoryPoint> points;
+    QByteArray body;
+    bool ok = false;
+    int channel = params.queryItemValue("channel").toInt(&ok);
+    qint64 fromMs;
+    qint64 toMs;
+    int maxPoints;
+
+    if (!history)
+    {
+        reply(socket, "404 Not Found", "text/plain", "History disabled\n");
+        return;
+    }
+    if (!ok || channel < 0 || channel >= channelCount)
+    {
+        reply(socket, "400 Bad Request", "text/plain", "Invalid channel\n");
+        return;
+    }
+
+    fromMs = params.queryItemValue("from").toLongLong(&ok);
+    if (!ok)
+        fromMs = history->oldestTimestampMs(static_cast<size_t>(channel));
+    toMs = params.queryItemValue("to").toLongLong(&ok);
+    if (!ok)
+        toMs = std::numeric_limits<qint64>::max();
+    maxPoints = params.queryItemValue("points").toInt(&ok);
+    if (!ok || maxPoints <= 0)
+        maxPoints = 1000;
+    maxPoints = qMin(maxPoints, maxHistoryPoints);
+
+    history->query(static_cast<size_t>(channel), fromMs, toMs, points, static_cast<size_t>(maxPoints));
+
+    body.reserve(64 + static_cast<int>(points.size()) * 48);
+    body += "{\"ch\":" + QByteArray::number(channel) + ",\"points\":[";
+    for (size_t k = 0; k < points.size(); k++)
+    {
+        if (k != 0)
+            body += ',';
+        body += '[' + QByteArray::number(points[k].timestampMs) + ',' + QByteArray::number(points[k].voltage, 'g', 7) +
+                ',' + QByteArray::number(points[k].current, 'g', 7) + ']';
+    }
+    body += "]}";
+    reply(socket, "200 OK", "application/json", body);
+}
+
+/**
+ * @brief Slot called when a client goes away.
+ */
+void WebDashboard::on_disconnected(void)
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+    for (int i = 0; i < clients.size(); i++)
+    {
+        if (clients[i].socket == socket)
+        {
+            clients.removeAt(i);
+            break;
+        }
+    }
+    if (socket)
+        socket->deleteLater();
+}
+
+/**
+ * @brief Writes a complete HTTP response and closes the connection.
+ */
+void WebDashboard::reply(QTcpSocket *socket, const QByteArray& status, const QByteArray& contentType, const QByteArray& body)
+{
+    QByteArray header;
+
+    header += "HTTP/1.1 " + status + "\r\n";
+    header += "Content-Type: " + contentType + "\r\n";
+    header += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    header += "Connection: close\r\n\r\n";
+    socket->write(header);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
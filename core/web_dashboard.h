@@ -0,0 +1,105 @@
+#ifndef WEB_DASHBOARD_H
+#define WEB_DASHBOARD_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QHostAddress>
+#include <QByteArray>
+#include <QList>
+#include <memory>
+#include <vector>
+#include "compressed_history.h"
+#include "telemetry_protocol.h"
+
+/* Embedded HTTP server for a browser dashboard, on localhost or the lab LAN.
+   GET / serves the static page from the Qt resources and GET /events opens a
+   server-sent event stream. Each stream chooses its rate and channels
+   (/events?rate=5&channels=0,2). Requested rates are snapped to a fixed set
+   of tiers; samples are decimated and serialized once per tier and channel,
+   and every client of the tier only concatenates its channels' fragments.
+   GET /telemetry streams the 20 Hz means in the binary telemetry framing,
+   and with a history enabled GET /history serves scroll-back windows of
+   every published sample. */
+class WebDashboard : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WebDashboard(int channels, QObject *parent = nullptr);
+
+    void enableHistory(size_t memoryCapBytes);
+    bool start(const QHostAddress& address, quint16 port);
+    void stop(void);
+    int clientCount(void) const;
+    quint16 serverPort(void) const;
+    qint64 droppedFrames(void) const;
+
+public slots:
+    void publish(int channel, qint64 timestampMs, double voltage, double current);
+
+private slots:
+    void on_newConnection(void);
+    void on_readyRead(void);
+    void on_disconnected(void);
+    void on_tick(void);
+
+private:
+    /* Decimation state of one channel in one tier */
+    struct Accumulator
+    {
+        int count = 0;
+        qint64 lastTimestampMs = 0;
+        double sumVoltage = 0.0;
+        double sumCurrent = 0.0;
+        double minCurrent = 0.0;
+        double maxCurrent = 0.0;
+    };
+
+    struct Tier
+    {
+        int rateHz;
+        int ticksPerFrame;                  /* Base ticks between frames */
+        std::vector<Accumulator> channels;
+        std::vector<QByteArray> fragments;  /* JSON of the last frame, per channel */
+    };
+
+    struct Client
+    {
+        QTcpSocket *socket;
+        int tier;
+        std::vector<int> channels;  /* Empty means all channels */
+        qint64 droppedFrames = 0;
+        bool binary = false;        /* Binary telemetry stream, no tier */
+    };
+
+    static constexpr int baseRateHz = 20;
+    static constexpr qint64 maxPendingBytes = 256 * 1024;  /* Frames are skipped for slower clients */
+
+    int channelCount;
+    QTcpServer server;
+    QTimer ticker;
+    quint64 tickCount = 0;
+    std::vector<Tier> tiers;
+    QList<Client> clients;
+    int maxRequestSize = 8192;
+    std::unique_ptr<CompressedHistory> history;  /* Scroll-back, when enabled */
+    static constexpr int maxHistoryPoints = 5000;
+    TelemetryEncoder encoder;  /* Shared by every binary stream */
+    std::vector<int32_t> binaryVoltage;  /* Counts of the last 20 Hz frame */
+    std::vector<int32_t> binaryCurrent;
+    qint64 binaryTimestampMs = 0;
+    bool binaryChanged = false;
+    std::vector<uint8_t> binaryFrame;
+
+    int tierForRate(int rateHz) const;
+    void serveEvents(QTcpSocket *socket, const QByteArray& query);
+    void serveHistory(QTcpSocket *socket, const QByteArray& query);
+    void serveTelemetry(QTcpSocket *socket);
+    void sendTelemetry(void);
+    static std::vector<TelemetryChannelInfo> telemetryChannels(int channels);
+    void reply(QTcpSocket *socket, const QByteArray& status, const QByteArray& contentType, const QByteArray& body);
+};
+
+#endif /* WEB_DASHBOARD_H */
@@ -0,0 +1,214 @@
+
+#include "battery_emulator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    /* Sleeping alone wakes up to a scheduler tick late: sleep to this much
+       before a period, then spin. Windows ticks every 15.6 ms by default */
+#if defined(_WIN32)
+    const std::chrono::milliseconds spinMargin(16);
+#else
+    const std::chrono::milliseconds spinMargin(2);
+#endif
+
+    const int timingBuckets = 128;  /* Quarter octaves of microseconds */
+
+    /* Running mean, deviation and maximum, with a histogram for the 99th percentile */
+    struct TimingStats
+    {
+        uint64_t count = 0;
+        double sum = 0.0;
+        double squares = 0.0;
+        double max = 0.0;
+        uint64_t histogram[timingBuckets] = {};
+
+        void add(double us)
+        {
+            count++;
+            sum += us;
+            squares += us * us;
+            max = std::max(max, us);
+            histogram[std::min(timingBuckets - 1, static_cast<int>(4.0 * std::log2(std::max(0.0, us) + 1.0)))]++;
+        }
+
+        EmulatorTiming summary(void) const
+        {
+            EmulatorTiming timing;
+            uint64_t seen = 0;
+
+            if (count == 0)
+                return timing;
+            timing.meanUs = sum / count;
+            timing.stdDevUs = std::sqrt(std::max(0.0, squares / count - timing.meanUs * timing.meanUs));
+            timing.maxUs = max;
+            for (int bucket = 0; bucket < timingBuckets; bucket++)
+            {
+                seen += histogram[bucket];
+                if (seen * 100 >= count * 99)
+                {
+                    timing.p99Us = std::min(max, std::exp2((bucket + 1) / 4.0) - 1.0);
+                    break;
+                }
+            }
+            return timing;
+        }
+    };
+
+    void waitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        if (deadline - std::chrono::steady_clock::now() > spinMargin)
+            std::this_thread::sleep_until(deadline - spinMargin);
+        while (std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+    double microsecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::micro>(to - from).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param powerSupply Open driver; output 1 is driven. The current limit is left as set.
+ * @param parameters Battery to emulate.
+ * @param options Rate, duration and voltage checks.
+ */
+BatteryEmulator::BatteryEmulator(PowerSupply& powerSupply, const BatteryParameters& parameters, const EmulatorOptions& options)
+    : powerSupply(powerSupply), parameters(parameters), options(options)
+{
+    this->options.rateHz = std::max(1.0, options.rateHz);
+}
+
+/**
+ * @brief Emulates the battery for the configured time, or until it is empty.
+ * The output is switched on at the open-circuit voltage first.
+ */
+EmulatorReport BatteryEmulator::run(void)
+{
+    const std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / options.rateHz));
+    BatteryModel model(parameters, 1.0 / options.rateHz);
+    EmulatorReport report;
+    TimingStats lateness;
+    TimingStats exchange;
+    TimingStats modelStep;
+    PsChannelReading reading;
+    double voltage = model.terminalVoltage(0.0);
+    double current = 0.0;
+    double errorSquares = 0.0;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    std::chrono::steady_clock::time_point next;
+
+    report.rateHz = options.rateHz;
+    if (powerSupply.writeVoltage(voltage) != PowerSupply::PsError::ERR_SUCCESS ||
+        powerSupply.turnOn() != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        report.failures++;
+        return report;
+    }
+
+    begin = std::chrono::steady_clock::now();
+    end = begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.seconds));
+    next = begin;
+    while (next < end)
+    {
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point now;
+        bool check = options.checkEvery > 0 && report.exchanges % options.checkEvery == 0;
+        PowerSupply::PsError err;
+
+        waitUntil(next);
+        start = std::chrono::steady_clock::now();
+        lateness.add(microsecondsBetween(next, start));
+        err = powerSupply.trackVoltage(std::max(0.0, voltage), reading, check);
+        now = std::chrono::steady_clock::now();
+        exchange.add(microsecondsBetween(start, now));
+        report.exchanges++;
+
+        if (err != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            /* The last current is held; a lost link is reopened for the next period */
+            report.failures++;
+            if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+                powerSupply.reconnect();
+        }
+        else
+        {
+            current = reading.current;
+            if (check)
+            {
+                double errorMv = 1000.0 * (reading.voltage - model.terminalVoltage(current));
+
+                report.checks++;
+                errorSquares += errorMv * errorMv;
+                report.errorMaxMv = std::max(report.errorMaxMv, std::fabs(errorMv));
+            }
+        }
+
+        voltage = model.step(current);
+        report.steps++;
+        modelStep.add(microsecondsBetween(now, std::chrono::steady_clock::now()));
+
+        /* Periods that went by during a slow exchange are stepped without one */
+        next += period;
+        for (now = std::chrono::steady_clock::now(); now - next >= period && next < end; next += period)
+        {
+            voltage = model.step(current);
+            report.steps++;
+            report.missedPeriods++;
+        }
+
+        if (options.stopWhenEmpty && model.stateOfCharge() <= 0.0)
+        {
+            report.emptied = true;
+            powerSupply.turnOff();
+            break;
+        }
+    }
+
+    report.seconds = microsecondsBetween(begin, std::chrono::steady_clock::now()) / 1e6;
+    report.lateness = lateness.summary();
+    report.exchange = exchange.summary();
+    report.modelStep = modelStep.summary();
+    report.errorRmsMv = report.checks ? std::sqrt(errorSquares / report.checks) : 0.0;
+    report.finalSoc = model.stateOfCharge();
+    report.finalVoltage = voltage;
+    return report;
+}
+
+void BatteryEmulator::render(const EmulatorReport& report, std::string& out)
+{
+    char line[192];
+
+    snprintf(line, sizeof(line), "rate        %.0f Hz requested, %.1f Hz achieved over %.1f s\n",
+             report.rateHz, report.achievedHz(), report.seconds);
+    out += line;
+    snprintf(line, sizeof(line), "periods     %llu exchanged, %llu missed, %llu failed, %llu model steps\n",
+             static_cast<unsigned long long>(report.exchanges), static_cast<unsigned long long>(report.missedPeriods),
+             static_cast<unsigned long long>(report.failures), static_cast<unsigned long long>(report.steps));
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %9s %9s %9s %9s\n", "timing", "mean us", "sd us", "p99 us", "max us");
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %9.1f %9.1f %9.1f %9.1f\n", "lateness",
+             report.lateness.meanUs, report.lateness.stdDevUs, report.lateness.p99Us, report.lateness.maxUs);
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %9.1f %9.1f %9.1f %9.1f\n", "exchange",
+             report.exchange.meanUs, report.exchange.stdDevUs, report.exchange.p99Us, report.exchange.maxUs);
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %9.3f %9.3f %9.3f %9.3f\n", "model step",
+             report.modelStep.meanUs, report.modelStep.stdDevUs, report.modelStep.p99Us, report.modelStep.maxUs);
+    out += line;
+    snprintf(line, sizeof(line), "model error %.2f mV rms, %.2f mV max over %llu checks\n",
+             report.errorRmsMv, report.errorMaxMv, static_cast<unsigned long long>(report.checks));
+    out += line;
+    snprintf(line, sizeof(line), "battery     %.2f%% charge, %.4f V%s\n",
+             100.0 * report.finalSoc, report.finalVoltage, report.emptied ? ", empty: output off" : "");
+    out += line;
+}
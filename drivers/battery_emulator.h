@@ -0,0 +1,70 @@
+#ifndef BATTERY_EMULATOR_H
+#define BATTERY_EMULATOR_H
+
+#include <cstdint>
+#include <string>
+#include "drv_power_supply.h"
+#include "battery_model.h"
+
+struct EmulatorOptions
+{
+    double rateHz = 1000.0;      /* Model steps and voltage updates per second */
+    double seconds = 60.0;
+    unsigned checkEvery = 10;    /* Every nth exchange also measures the voltage, 0 for never */
+    bool stopWhenEmpty = true;   /* Switch the output off when the state of charge reaches 0 */
+};
+
+/* Spread of a timing, in microseconds */
+struct EmulatorTiming
+{
+    double meanUs = 0.0;
+    double stdDevUs = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+};
+
+struct EmulatorReport
+{
+    double rateHz = 0.0;
+    double seconds = 0.0;
+    uint64_t exchanges = 0;      /* Voltage writes with their current readings */
+    uint64_t steps = 0;          /* Model steps, those of missed periods included */
+    uint64_t missedPeriods = 0;  /* Periods stepped with the last current, without an exchange */
+    uint64_t failures = 0;       /* Failed exchanges; the last current is held */
+    EmulatorTiming lateness;     /* Exchange start after its scheduled time */
+    EmulatorTiming exchange;     /* Write and readings, one round trip */
+    EmulatorTiming modelStep;    /* Computing the next voltage */
+    uint64_t checks = 0;
+    double errorRmsMv = 0.0;     /* Measured output voltage against the model at the measured current */
+    double errorMaxMv = 0.0;
+    double finalSoc = 0.0;
+    double finalVoltage = 0.0;
+    bool emptied = false;
+
+    double achievedHz(void) const { return seconds > 0.0 ? exchanges / seconds : 0.0; }
+};
+
+/* Battery emulation on a supply. Each period is one round trip: the voltage
+   the model computed for the last current is written and the current is
+   read back in the same message, then the model steps with it. Periods are
+   scheduled on an absolute time line and the model always steps by the same
+   time: a period missed by a slow exchange is stepped with the last current,
+   so model time keeps up with the wall clock and runs stay reproducible.
+   Every checkEvery exchanges the output voltage is measured too, and its
+   difference to the model at the measured current is the model error: loop
+   delay, setpoint resolution and regulation of the supply together. */
+class BatteryEmulator
+{
+    public:
+        BatteryEmulator(PowerSupply& powerSupply, const BatteryParameters& parameters, const EmulatorOptions& options);
+
+        EmulatorReport run(void);
+        static void render(const EmulatorReport& report, std::string& out);
+
+    private:
+        PowerSupply& powerSupply;
+        BatteryParameters parameters;
+        EmulatorOptions options;
+};
+
+#endif /* BATTERY_EMULATOR_H */
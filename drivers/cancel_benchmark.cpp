@@ -0,0 +1,275 @@
+
+#include "cancel_benchmark.h"
+#include "cancel_token.h"
+#include "drv_power_supply.h"
+#include "sim_instrument.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace
+{
+    /* Swallows the driver's per-command log */
+    class NullBuffer : public std::streambuf
+    {
+        protected:
+            int overflow(int c) override { return c == EOF ? 0 : c; }
+    };
+
+    /* Programmed state; the resistive load makes the current 1.2345 A */
+    constexpr double setVoltage = 12.345;
+    constexpr double setCurrentLimit = 3.0;
+    constexpr double loadOhms = 10.0;
+    constexpr uint32_t serial = 42;
+
+    int64_t steadyNs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool near(double value, double expected)
+    {
+        return std::fabs(value - expected) < 1e-3;
+    }
+
+    /**
+     * @brief Runs one query chosen by kind and checks its answer.
+     * @param correct Set when the answer is the one of this query.
+     */
+    PowerSupply::PsError query(PowerSupply& powerSupply, int kind, bool& correct)
+    {
+        PowerSupply::PsError err;
+        PsIdentity identity;
+        PsSetpoints setpoints;
+        double value = 0.0;
+
+        switch (kind)
+        {
+            case 0:
+                err = powerSupply.readVoltage(value);
+                correct = near(value, setVoltage);
+                break;
+            case 1:
+                err = powerSupply.readCurrent(value);
+                correct = near(value, setVoltage / loadOhms);
+                break;
+            case 2:
+                err = powerSupply.readIdentity(identity);
+                correct = identity.model == "PS-SIM" && identity.serialNumber == "SN000042";
+                break;
+            default:
+                err = powerSupply.readSetpoints(setpoints);
+                correct = near(setpoints.voltage, setVoltage) && near(setpoints.currentLimit, setCurrentLimit) &&
+                          setpoints.output;
+                break;
+        }
+        return err;
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param profile Link faults; stalls make the exchanges worth cancelling.
+ * @param seed Seed of the faults, the query mix and the cancellation times.
+ */
+CancelBenchmark::CancelBenchmark(const FaultProfile& profile, uint64_t seed)
+    : profile(profile), seed(seed)
+{
+}
+
+/**
+ * @brief Link of a USB-serial adapter with the odd reply held back past the sample time.
+ */
+FaultProfile CancelBenchmark::defaultProfile(void)
+{
+    FaultProfile profile;
+
+    profile.name = "stalls";
+    profile.latencyModel = LatencyModel::UNIFORM;
+    profile.latencyMs = 2.0;
+    profile.jitterMs = 1.0;
+    profile.stallRate = 0.05;
+    profile.stallMs = 1500.0;
+    return profile;
+}
+
+/**
+ * @brief Queries for a while, cancelled from another thread at random times.
+ * @param seconds Length of the loaded part of the run.
+ * @param cancelEveryMs Mean of the exponential time between cancellations, 0 for none.
+ * @param threads Threads querying the driver at once, the way the sampler
+ * and the window share it; they share the cancel token as well.
+ */
+CancelResult CancelBenchmark::run(double seconds, double cancelEveryMs, unsigned threads)
+{
+    NullBuffer nullBuffer;
+    std::streambuf *console = std::cout.rdbuf(&nullBuffer);
+    SimLoad load;
+    std::shared_ptr<SimInstrument> instrument;
+    CancelToken token;
+    CancelResult result;
+    std::atomic<bool> done{false};
+    std::atomic<int64_t> cancelledAtNs{0};
+    std::vector<CancelResult> counts;
+    std::vector<std::vector<double>> threadLatencies;
+    std::vector<double> latencies;
+    std::vector<std::thread> operators;
+    std::thread canceller;
+    PsSetpoints setpoints;
+    bool correct = false;
+    int64_t end;
+
+    threads = std::max(threads, 1u);
+    load.ohms = loadOhms;
+    load.noiseA = 0.0;
+    instrument = std::make_shared<SimInstrument>(load, seed, serial);
+    PowerSupply powerSupply("SIM1", std::unique_ptr<Transport>(new FaultInjectingTransport(
+                                        std::unique_ptr<Transport>(new SimulatedTransport(instrument)), profile, seed)));
+    setpoints.voltage = setVoltage;
+    setpoints.currentLimit = setCurrentLimit;
+    setpoints.output = true;
+    for (int attempt = 0; attempt < 3 && powerSupply.writeSetpoints(setpoints) != PowerSupply::PsError::ERR_SUCCESS; attempt++)
+        ;
+    powerSupply.setCancelToken(&token);
+    result.cancelEveryMs = cancelEveryMs;
+    result.threads = threads;
+
+    if (cancelEveryMs > 0.0)
+    {
+        canceller = std::thread([&, cancelEveryMs] {
+            std::mt19937_64 timing(seed + 1);
+            std::exponential_distribution<double> interval(1.0 / cancelEveryMs);
+
+            while (!done)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(interval(timing) * 1000.0)));
+                if (!done && !token.cancelled())
+                {
+                    cancelledAtNs = steadyNs();
+                    token.cancel();
+                }
+            }
+        });
+    }
+
+    /* Loaded part: every operator thread queries without pause */
+    counts.resize(threads);
+    threadLatencies.resize(threads);
+    end = steadyNs() + static_cast<int64_t>(seconds * 1e9);
+    auto operate = [&, end](unsigned index) {
+        std::mt19937_64 random(seed + 2 + index);
+        CancelResult& count = counts[index];
+        bool answered = false;
+
+        while (steadyNs() < end)
+        {
+            PowerSupply::PsError err = query(powerSupply, static_cast<int>(random() % 4), answered);
+
+            count.operations++;
+            if (err == PowerSupply::PsError::ERR_CANCELLED)
+            {
+                count.cancelled++;
+                threadLatencies[index].push_back((steadyNs() - cancelledAtNs) / 1e6);
+                token.reset();
+            }
+            else if (err != PowerSupply::PsError::ERR_SUCCESS)
+                count.failed++;
+            else if (answered)
+                count.completed++;
+            else
+                count.mismatched++;
+
+            if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+                powerSupply.reconnect();
+        }
+    };
+    for (unsigned index = 1; index < threads; index++)
+        operators.emplace_back(operate, index);
+    operate(0);
+    for (std::thread& thread : operators)
+        thread.join();
+    done = true;
+    if (canceller.joinable())
+        canceller.join();
+    token.reset();
+
+    for (unsigned index = 0; index < threads; index++)
+    {
+        result.operations += counts[index].operations;
+        result.completed += counts[index].completed;
+        result.cancelled += counts[index].cancelled;
+        result.failed += counts[index].failed;
+        result.mismatched += counts[index].mismatched;
+        latencies.insert(latencies.end(), threadLatencies[index].begin(), threadLatencies[index].end());
+    }
+
+    /* Quiet part: every answer must be the right one again */
+    for (int check = 0; check < 100; check++)
+    {
+        PowerSupply::PsError err = query(powerSupply, check % 4, correct);
+
+        if (err == PowerSupply::PsError::ERR_SUCCESS && !correct)
+            result.mismatched++;
+    }
+
+    result.resyncs = powerSupply.health.cancellations;
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty())
+    {
+        result.cancelP50Ms = latencies[latencies.size() / 2];
+        result.cancelP99Ms = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        result.cancelMaxMs = latencies.back();
+    }
+    powerSupply.setCancelToken(nullptr);
+    std::cout.rdbuf(console);
+    return result;
+}
+
+/**
+ * @brief True if no query got another one's reply and every cancellation
+ * returned within maxCancelMs.
+ */
+bool CancelBenchmark::passed(const std::vector<CancelResult>& results)
+{
+    for (const CancelResult& result : results)
+    {
+        if (result.mismatched != 0 || result.cancelMaxMs > maxCancelMs)
+            return false;
+    }
+    return true;
+}
+
+void CancelBenchmark::render(const std::vector<CancelResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%-13s %7s %8s %8s %9s %7s %10s %8s %8s %8s %8s\n",
+             "cancel every", "threads", "ops", "correct", "cancelled", "failed", "mismatched", "resyncs", "p50 ms", "p99 ms", "max ms");
+    out += line;
+    for (const CancelResult& result : results)
+    {
+        char every[16];
+
+        if (result.cancelEveryMs > 0.0)
+            snprintf(every, sizeof(every), "%.0f ms", result.cancelEveryMs);
+        else
+            snprintf(every, sizeof(every), "never");
+        snprintf(line, sizeof(line), "%-13s %7u %8llu %8llu %9llu %7llu %10llu %8llu %8.2f %8.2f %8.2f\n",
+                 every, result.threads,
+                 static_cast<unsigned long long>(result.operations),
+                 static_cast<unsigned long long>(result.completed),
+                 static_cast<unsigned long long>(result.cancelled),
+                 static_cast<unsigned long long>(result.failed),
+                 static_cast<unsigned long long>(result.mismatched),
+                 static_cast<unsigned long long>(result.resyncs),
+                 result.cancelP50Ms, result.cancelP99Ms, result.cancelMaxMs);
+        out += line;
+    }
+}
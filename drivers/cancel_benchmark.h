@@ -0,0 +1,48 @@
+#ifndef CANCEL_BENCHMARK_H
+#define CANCEL_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "fault_transport.h"
+
+struct CancelResult
+{
+    double cancelEveryMs = 0.0;  /* Mean time between cancellations, 0 for none */
+    unsigned threads = 1;        /* Threads querying the same driver */
+    uint64_t operations = 0;
+    uint64_t completed = 0;      /* Answered with the expected value */
+    uint64_t cancelled = 0;
+    uint64_t failed = 0;         /* Timeouts and other errors */
+    uint64_t mismatched = 0;     /* Answered with the reply of another query */
+    uint64_t resyncs = 0;        /* Exchanges cut off and resynchronized */
+    double cancelP50Ms = 0.0;    /* Time from cancel() to the operation returning */
+    double cancelP99Ms = 0.0;
+    double cancelMaxMs = 0.0;
+};
+
+/* Cancels driver operations at random while one or more threads keep
+   querying a simulated supply behind a link with latency and stalled
+   replies. Every query has a known answer that no other query gives, so a
+   reply left over from a cancelled exchange, or read by the other thread,
+   shows up as a mismatch. After the run, queries without cancellation check
+   that the session ended in step. */
+class CancelBenchmark
+{
+    public:
+        CancelBenchmark(const FaultProfile& profile, uint64_t seed);
+
+        static constexpr double maxCancelMs = 100.0;  /* Longest acceptable wait for a cancelled operation */
+
+        CancelResult run(double seconds, double cancelEveryMs, unsigned threads = 1);
+        static FaultProfile defaultProfile(void);
+        static bool passed(const std::vector<CancelResult>& results);
+        static void render(const std::vector<CancelResult>& results, std::string& out);
+
+    private:
+        FaultProfile profile;
+        uint64_t seed;
+};
+
+#endif /* CANCEL_BENCHMARK_H */
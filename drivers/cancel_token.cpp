@@ -0,0 +1,76 @@
+
+#include "cancel_token.h"
+
+/**
+ * @brief Cancels the operation in progress and every later one until reset().
+ * Safe from any thread; returns without waiting for the operation to end.
+ */
+void CancelToken::cancel(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    flag.store(true, std::memory_order_release);
+    for (Exchange& exchange : inFlight)
+    {
+        if (exchange.transport && !exchange.aborted)
+        {
+            exchange.transport->abort();
+            exchange.aborted = true;
+        }
+    }
+}
+
+/**
+ * @brief Registers an exchange of the calling thread about to start on a transport.
+ * With more threads in an exchange than slots, the exchange runs
+ * unregistered: cancel() then stops it before its next exchange only.
+ * @return False when the token is already cancelled; nothing is registered.
+ */
+bool CancelToken::enter(Transport *transport)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::thread::id self = std::this_thread::get_id();
+    Exchange *slot = nullptr;
+
+    if (flag.load(std::memory_order_acquire))
+        return false;
+    for (Exchange& exchange : inFlight)
+    {
+        if (exchange.owner == self)
+        {
+            slot = &exchange;
+            break;
+        }
+        if (!slot && exchange.owner == std::thread::id())
+            slot = &exchange;
+    }
+    if (slot)
+    {
+        slot->owner = self;
+        slot->transport = transport;
+        slot->aborted = false;
+    }
+    return true;
+}
+
+/**
+ * @brief Ends the exchange the calling thread registered with enter().
+ * @return True when cancel() aborted it, even if it completed meanwhile.
+ */
+bool CancelToken::leave(void)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::thread::id self = std::this_thread::get_id();
+
+    for (Exchange& exchange : inFlight)
+    {
+        if (exchange.owner == self)
+        {
+            bool wasAborted = exchange.aborted;
+
+            exchange = Exchange();
+            return wasAborted;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,42 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "transport.h"
+
+/* Cancels the operations of a driver from another thread. The driver checks
+   the token before every exchange and registers the exchange in progress,
+   so cancel() also aborts a write or read that is blocked on the link. The
+   cancelled operation returns ERR_CANCELLED once the session is back in
+   step. The token stays cancelled until reset(). One token may serve
+   several threads or drivers: each thread registers its own exchange */
+class CancelToken
+{
+    public:
+        void cancel(void);
+        bool cancelled(void) const { return flag.load(std::memory_order_acquire); }
+        void reset(void) { flag.store(false, std::memory_order_release); }
+
+    private:
+        friend class PowerSupply;
+
+        /* Exchange in progress in one thread */
+        struct Exchange
+        {
+            std::thread::id owner;          /* No thread when the slot is free */
+            Transport *transport = nullptr;
+            bool aborted = false;           /* transport was aborted */
+        };
+        static constexpr int maxExchanges = 8;
+
+        std::atomic<bool> flag{false};
+        std::mutex mutex;
+        Exchange inFlight[maxExchanges];
+
+        bool enter(Transport *transport);
+        bool leave(void);
+};
+
+#endif /* CANCEL_TOKEN_H */
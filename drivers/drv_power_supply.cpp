@@ -1,17 +1,24 @@
 
 #include "drv_power_supply.h"
+#include "alloc_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
 
 /* Define a type alias for key:value pairs */
-PowerSupply::PowerSupply(std::string port)
+PowerSupply::PowerSupply(std::string port, std::unique_ptr<Transport> transport)
+    : transport(transport ? std::move(transport) : std::unique_ptr<Transport>(new VisaTransport()))
 {
+    /* Update new serial session attributes */
+    this->baudrate = defaultBaudrate;
     if (port.empty() || port.size() < 4)
     {
         std::cout << "Power Supply: Invalid port " << std::endl;
         return;
     }
 
-    /* Update new serial session attributes */
-    this->baudrate = defaultBaudrate;
     this->port = port;
     if(open(this->port) != PsError::ERR_SUCCESS)
         std::cout << "Power Supply: Failed to open port " << this->port << std::endl;
@@ -24,12 +31,8 @@ PowerSupply::~PowerSupply()
 
 PowerSupply::PsError PowerSupply::open(std::string port)
 {
-    char resourceName[14];
-    std::string resourceNameStr;
-    ViStatus status = VI_SUCCESS;
     PsError err = PsError::ERR_DEVICE_NOT_CONNECTED;
-
-    memset(resourceName, '\0', sizeof(resourceName));
+    bool opened = false;
 
     /* Check for emtpy port */
     if (port.empty() || port.size() < 4)
@@ -38,43 +41,27 @@ PowerSupply::PsError PowerSupply::open(std::string port)
         goto err_open;
     }
 
-    /* Open resource manager */
-    std::cout << "Power Supply: Opening " << resourceName << std::endl;
-    if (viOpenDefaultRM(&this->defaultRM) != VI_SUCCESS)
+    /* Open the link: resource, serial settings and termination character.
+       From here on a lost link may be reopened by reconnect() */
     {
-        std::cout << "Power Supply: Failed to open default resource manager" << std::endl;
-        goto err_open;
+        std::lock_guard<std::recursive_mutex> lock(ioMutex);
+        opened = transport->open(port, this->baudrate) == VI_SUCCESS;
+        if (opened)
+        {
+            this->port = port;
+            reconnectWanted = true;
+            timeoutMs = TimingProfile::defaultTimeoutMs;
+            selectedChannel = 0;
+            statusReporting = false;
+            statusKnown = false;
+            outOfStep = false;
+        }
     }
-
-    /* Open resource */
-    resourceNameStr = ("ASRL" + port.substr(3) + "::INSTR");
-    strncpy(resourceName, resourceNameStr.c_str(), sizeof(resourceName));
-    if (viOpen(defaultRM, (ViRsrc)resourceName, VI_NULL, VI_NULL, &this->instrument) != VI_SUCCESS)
-    {
-        std::cout << "Power Supply: Failed to open instrument" << std::endl;
+    if (!opened)
         goto err_open;
-    }
-
-    /* Set instrument configuration:
-         - 9600 baud rate
-         - 8 data bits
-         - No parity
-         - 1 stop bit
-         - No flow control
-         - Termination character: LF (0x0A)
-         - Termination character enabled
-         - Timeout: 2000 ms
-    */
-    viSetAttribute(instrument, VI_ATTR_ASRL_BAUD, this->baudrate);          /* 9600 baud rate */
-    viSetAttribute(instrument, VI_ATTR_ASRL_DATA_BITS, 8);                  /* 8 data bits */
-    viSetAttribute(instrument, VI_ATTR_ASRL_PARITY, VI_ASRL_PAR_NONE);      /* No parity */
-    viSetAttribute(instrument, VI_ATTR_ASRL_STOP_BITS, VI_ASRL_STOP_ONE);   /* 1 stop bit */
-    viSetAttribute(instrument, VI_ATTR_ASRL_FLOW_CNTRL, VI_ASRL_FLOW_NONE); /* No flow control */
-    viSetAttribute(instrument, VI_ATTR_TERMCHAR, '\n');
-    viSetAttribute(instrument, VI_ATTR_TERMCHAR_EN, VI_TRUE);
-    viSetAttribute(instrument, VI_ATTR_TMO_VALUE, 2000);                    /* in milliseconds */
-    std::cout << "Power Supply: opened resource: \n" << resourceNameStr << std::endl;
-    this->port = port;
+    if (openedBefore)
+        health.reconnects++;
+    openedBefore = true;
 
     /* Port opened successfully */
     return PsError::ERR_SUCCESS;
@@ -84,15 +71,51 @@ err_open:
     return err;
 }
 
+/**
+ * @brief Reopens the last port after the link was lost.
+ * Safe to call from a sampling thread while the GUI thread opens or closes
+ * the port: the intent to keep the link up is checked under the I/O lock,
+ * so a link the user closed is never reopened behind their back.
+ */
+PowerSupply::PsError PowerSupply::reconnect(void)
+{
+    bool reenableStatus;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(ioMutex);
+
+        if (!reconnectWanted)
+            return PsError::ERR_DEVICE_NOT_CONNECTED;
+        if (transport->isOpen())
+            return PsError::ERR_SUCCESS;  /* Reopened meanwhile */
+        transport->close();
+        if (transport->open(port, this->baudrate) != VI_SUCCESS)
+            return PsError::ERR_DEVICE_NOT_CONNECTED;
+        timeoutMs = TimingProfile::defaultTimeoutMs;
+        selectedChannel = 0;
+        statusKnown = false;
+        reenableStatus = statusReporting;
+        std::cout << "Power Supply: Reconnected " << port << std::endl;
+    }
+    health.reconnects++;
+
+    /* The instrument may have been power cycled and lost its status enables */
+    if (reenableStatus)
+        enableStatusReporting();
+    return PsError::ERR_SUCCESS;
+}
+
 PowerSupply::PsError PowerSupply::isOpen(void)
 {
-    if (instrument == VI_NULL)
+    if (!transport->isOpen())
         return PsError::ERR_DEVICE_NOT_CONNECTED;
     return PsError::ERR_SUCCESS;
 }
 
 PowerSupply:: PsError PowerSupply::isOn(bool& state)
 {
+    PS_ALLOCATION_PROBE("driver.isOn");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     char buffer[50];
     ViUInt32 bufferCount = 0;
     ViStatus status = VI_SUCCESS;
@@ -109,21 +132,26 @@ PowerSupply:: PsError PowerSupply::isOn(bool& state)
         goto err_isOn;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send get status command */
-    err = sendCommand(psCommands["isOn"], "");
+    err = sendCommand(psCommands["isOn"], "", {"isOn"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to get power supply status. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
         goto err_isOn;
     }
 
     /* Read response from power supply */
-    status = viRead(instrument, (unsigned char*)buffer, sizeof(buffer), &bufferCount);
+    status = readResponse(buffer, sizeof(buffer), bufferCount);
     if (status != VI_SUCCESS)
     {
         std::cout << "Failed to read power supply status. Status: " << status << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (status == VI_ERROR_ABORT) ? PsError::ERR_CANCELLED : PsError::ERR_OPERATION_FAILED;
         goto err_isOn;
     }
 
@@ -131,12 +159,14 @@ PowerSupply:: PsError PowerSupply::isOn(bool& state)
     if (buffer[0] == '1')
     {
         state = true;
-        std::cout << "Power Supply: Device is ON" << std::endl;
+        if (verbose)
+            std::cout << "Power Supply: Device is ON" << std::endl;
     }
     else if (buffer[0] == '0')
     {
         state = false;
-        std::cout << "Power Supply: Device is OFF" << std::endl;
+        if (verbose)
+            std::cout << "Power Supply: Device is OFF" << std::endl;
     }
     else
     {
@@ -148,38 +178,241 @@ err_isOn:
     return err;
 }
 
-PowerSupply::PsError PowerSupply::sendCommand(const std::string& command, const std::string& value)
+PowerSupply::PsError PowerSupply::sendCommand(const std::string& command, const std::string& value,
+                                              const std::vector<std::string>& names)
 {
-    ViUInt32 commandSize;
-    char commandBuffer[30];
+    PS_ALLOCATION_PROBE("driver.sendCommand");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char commandBuffer[maxProgramBytes + 16];
     ViStatus status = VI_SUCCESS;
     PsError err = PsError::ERR_SUCCESS;
+    int length;
+    uint32_t wantedTimeoutMs = 0;
+    bool unprofiled = names.empty();
 
     memset(commandBuffer, '\0', sizeof(commandBuffer));
 
+    /* A compound program takes as long as its commands together; the ones
+       without a profile share the default timeout */
+    for (const std::string& name : names)
+    {
+        auto timeout = commandTimeoutsMs.find(name);
+        if (timeout == commandTimeoutsMs.end())
+            unprofiled = true;
+        else
+            wantedTimeoutMs += timeout->second;
+    }
+    if (unprofiled)
+        wantedTimeoutMs += TimingProfile::defaultTimeoutMs;
+
+    /* Give the reply the time this model needs for this command */
+    if (wantedTimeoutMs != timeoutMs && transport->setTimeout(wantedTimeoutMs) == VI_SUCCESS)
+        timeoutMs = wantedTimeoutMs;
+
     /* Check if command is to be sent with/without parameters */
     if (value.empty())
         /* Command without parameters */
-        snprintf(commandBuffer, sizeof(commandBuffer), "%s\n", command.c_str());
+        length = snprintf(commandBuffer, sizeof(commandBuffer), "%s\n", command.c_str());
     else
         /* Command with parameters */
-        snprintf(commandBuffer, sizeof(commandBuffer), "%s %s\n", command.c_str(), value.c_str());
+        length = snprintf(commandBuffer, sizeof(commandBuffer), "%s %s\n", command.c_str(), value.c_str());
+    if (length < 0 || static_cast<size_t>(length) >= sizeof(commandBuffer))
+    {
+        std::cout << "Power Supply: Command too long: " << command << std::endl;
+        return PsError::ERR_OPERATION_FAILED;
+    }
+
+    /* A reply of an aborted exchange may still be on its way */
+    if (outOfStep && (err = resynchronize()) != PsError::ERR_SUCCESS)
+        return err;
 
     /* Send command to power supply device */
-    std::cout << "Power Supply: Sending command: " << commandBuffer << " (size: " << strlen(commandBuffer) << ")" << std::endl;
-    status = viWrite(this->instrument, (unsigned char*)commandBuffer, strlen(commandBuffer), VI_NULL);
-    if (status != VI_SUCCESS)
+    if (verbose)
+        std::cout << "Power Supply: Sending command: " << commandBuffer << " (size: " << length << ")" << std::endl;
+    transactionStart = std::chrono::steady_clock::now();
+    if (cancelToken && !cancelToken->enter(transport.get()))
+        return PsError::ERR_CANCELLED;
+    health.commands++;
+    status = transport->write(commandBuffer, length);
+    /* Cancelled after the write: the reply, if any, is left to resynchronize() */
+    if (cancelToken && cancelToken->leave())
+        status = VI_ERROR_ABORT;
+    if (status == VI_SUCCESS)
+        health.bytesSent += length;
+    if (status == VI_ERROR_ABORT)
+    {
+        std::cout << "Power Supply: Command cancelled: " << command << std::endl;
+        recordAbort();
+        err = PsError::ERR_CANCELLED;
+    }
+    else if (status != VI_SUCCESS)
     {
         std::cout << "Failed to send command: status: " << status << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        recordFailure(status);
+        err = (status == VI_ERROR_CONN_LOST) ? PsError::ERR_DEVICE_NOT_CONNECTED : PsError::ERR_OPERATION_FAILED;
+    }
+    else if (command.empty() || command.back() != '?')
+    {
+        /* Commands without a reply complete with the write */
+        health.recordLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - transactionStart).count());
     }
 
 err_send_command:
     return err;
 }
 
+ViStatus PowerSupply::readResponse(char *buffer, size_t size, ViUInt32& count)
+{
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    ViStatus status = VI_ERROR_ABORT;
+
+    count = 0;
+    if (!cancelToken || cancelToken->enter(transport.get()))
+    {
+        status = transport->read(buffer, size, count);
+        if (cancelToken && cancelToken->leave())
+            status = VI_ERROR_ABORT;
+    }
+
+    health.bytesReceived += count;
+    /* Queries complete with the reply: account the whole round trip */
+    if (status == VI_ERROR_ABORT)
+    {
+        std::cout << "Power Supply: Read cancelled" << std::endl;
+        recordAbort();
+    }
+    else if (status < VI_SUCCESS)
+        recordFailure(status);
+    else
+        health.recordLatency(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now() - transactionStart).count());
+    return status;
+}
+
+void PowerSupply::recordFailure(ViStatus status)
+{
+    health.errors++;
+    selectedChannel = 0;
+    statusKnown = false;
+    if (status == VI_ERROR_TMO)
+        health.timeouts++;
+
+    /* A late or partial reply would be read as the answer of the next
+       query: drop whatever is left. A lost link is closed so the sampler
+       sees it and reconnects */
+    if (status == VI_ERROR_CONN_LOST)
+        transport->close();
+    else
+        transport->clear();
+}
+
+/**
+ * @brief Accounts an exchange cut off by abort(). The operation returns at
+ * once; the next exchange first resynchronizes the session.
+ */
+void PowerSupply::recordAbort(void)
+{
+    health.cancellations++;
+    selectedChannel = 0;
+    statusKnown = false;
+    outOfStep = true;
+}
+
+/**
+ * @brief Brings the session back in step after an aborted exchange.
+ * Buffers and the instrument's queues are cleared, then a marker query is
+ * sent whose answer no other query gives: "*SRE a;*SRE?;*SRE b;*SRE?;*SRE 0"
+ * answers "a;b". Replies read before it belong to the aborted exchange and
+ * are dropped. The resynchronization is itself cancellable and is retried
+ * by the next exchange. A link that does not return the marker is closed,
+ * and the sampler reopens it.
+ * @return ERR_SUCCESS when the session is in step again.
+ */
+PowerSupply::PsError PowerSupply::resynchronize(void)
+{
+    char program[64];
+    char expected[16];
+    char buffer[64];
+    ViUInt32 count = 0;
+    ViStatus status;
+    int length;
+    unsigned first = resyncMarker++ % 63 + 1;  /* 1..63: bit 6 of *SRE is not settable */
+    unsigned second = first % 63 + 1;
+    bool matched = false;
+
+    if (!transport->isOpen())
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    if (cancelToken && !cancelToken->enter(transport.get()))
+        return PsError::ERR_CANCELLED;
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(ioMutex);
+
+        transport->clear();
+        transport->deviceClear();
+        length = snprintf(program, sizeof(program), "*SRE %u;*SRE?;*SRE %u;*SRE?;*SRE 0\n", first, second);
+        snprintf(expected, sizeof(expected), "%u;%u", first, second);
+        status = (cancelToken && cancelToken->cancelled()) ? VI_ERROR_ABORT : transport->write(program, length);
+
+        /* A few stale replies may still arrive ahead of the marker */
+        for (int attempt = 0; status >= VI_SUCCESS && !matched && attempt < 4; attempt++)
+        {
+            status = transport->read(buffer, sizeof(buffer) - 1, count);
+            if (status < VI_SUCCESS)
+                break;
+            while (count > 0 && (buffer[count - 1] == '\n' || buffer[count - 1] == '\r'))
+                count--;
+            buffer[count] = '\0';
+            matched = strcmp(buffer, expected) == 0;
+            if (!matched)
+                std::cout << "Power Supply: Dropped stale reply: " << buffer << std::endl;
+        }
+    }
+    if (cancelToken && cancelToken->leave())
+        status = VI_ERROR_ABORT;
+
+    if (status == VI_ERROR_ABORT)
+        return PsError::ERR_CANCELLED;
+    if (matched)
+    {
+        std::cout << "Power Supply: Session resynchronized" << std::endl;
+        outOfStep = false;
+        return PsError::ERR_SUCCESS;
+    }
+
+    std::cout << "Power Supply: Resynchronization failed, closing the link" << std::endl;
+    health.errors++;
+    transport->close();
+    return PsError::ERR_DEVICE_NOT_CONNECTED;
+}
+
+/**
+ * @brief Maps a failed VISA read to the driver error.
+ */
+PowerSupply::PsError PowerSupply::failureFor(ViStatus status)
+{
+    if (status == VI_ERROR_TMO)
+        return PsError::ERR_TIMEOUT;
+    if (status == VI_ERROR_ABORT)
+        return PsError::ERR_CANCELLED;
+    return PsError::ERR_OPERATION_FAILED;
+}
+
+void PsHealth::recordLatency(uint64_t latencyUs)
+{
+    int bucket = 0;
+
+    while (bucket < latencyBuckets - 1 && latencyUs > latencyBoundsMs[bucket] * 1000.0)
+        bucket++;
+    latencyCount[bucket]++;
+    latencySumUs += latencyUs;
+}
+
 PowerSupply::PsError PowerSupply::writeVoltage(double voltage)
 {
+    PS_ALLOCATION_PROBE("driver.writeVoltage");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     PsError err = PsError::ERR_SUCCESS;
 
     /* Check if the instrument is open */
@@ -189,25 +422,93 @@ PowerSupply::PsError PowerSupply::writeVoltage(double voltage)
         return PsError::ERR_DEVICE_NOT_CONNECTED;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send set voltage command */
-    err = sendCommand(psCommands["writeVoltage"], std::to_string(voltage));
+    err = sendCommand(psCommands["writeVoltage"], std::to_string(voltage), {"writeVoltage"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to set voltage " << static_cast<int>(voltage) << "V. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
     }
     else
     {
-        std::cout << "Power Supply: Set voltage to " << static_cast<int>(voltage) << "V" << std::endl;
+        if (verbose)
+            std::cout << "Power Supply: Set voltage to " << static_cast<int>(voltage) << "V" << std::endl;
     }
 
 ps_err_writeVoltage:
     return err;
 }
 
+/**
+ * @brief Sets the voltage of output 1 and reads back its current, and
+ * optionally its voltage, in one round trip: VOLT v;:MEAS:CURR?[;:MEAS:VOLT?].
+ * The readings are taken after the new setpoint applies. For loops that
+ * drive the output from a model of the load.
+ * @param voltage New setpoint in volts.
+ * @param reading Filled with the current, and the voltage when asked.
+ * @param withVoltage True to also measure the voltage.
+ */
+PowerSupply::PsError PowerSupply::trackVoltage(double voltage, PsChannelReading& reading, bool withVoltage)
+{
+    PS_ALLOCATION_PROBE("driver.trackVoltage");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char program[96];
+    char buffer[64];
+    char *next;
+    ViUInt32 bufferCount = 0;
+    ViStatus status;
+    PsError err;
+
+    memset(buffer, '\0', sizeof(buffer));
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    snprintf(program, sizeof(program), "%s %.6f;:%s%s%s", psCommands["writeVoltage"].c_str(), voltage,
+             psCommands["readCurrent"].c_str(), withVoltage ? ";:" : "", withVoltage ? psCommands["readVoltage"].c_str() : "");
+    if (withVoltage)
+        err = sendCommand(program, "", {"writeVoltage", "readCurrent", "readVoltage"});
+    else
+        err = sendCommand(program, "", {"writeVoltage", "readCurrent"});
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+        return failureFor(status);
+
+    /* Response format: <current>[;<voltage>] */
+    reading.current = strtod(buffer, &next);
+    if (next == buffer)
+        return PsError::ERR_INVALID_RESPONSE;
+    if (withVoltage)
+    {
+        char *field = next + 1;
+
+        if (*next != ';')
+            return PsError::ERR_INVALID_RESPONSE;
+        reading.voltage = strtod(field, &next);
+        if (next == field)
+            return PsError::ERR_INVALID_RESPONSE;
+    }
+    return PsError::ERR_SUCCESS;
+}
+
 PowerSupply::PsError PowerSupply::readVoltage(double& voltage)
 {
+    PS_ALLOCATION_PROBE("driver.readVoltage");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     char buffer[25];
+    char *end;
     PsError err = PsError::ERR_SUCCESS;
     ViUInt32 bufferCount = 0;
     ViStatus status = VI_SUCCESS;
@@ -222,27 +523,40 @@ PowerSupply::PsError PowerSupply::readVoltage(double& voltage)
         return PsError::ERR_DEVICE_NOT_CONNECTED;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send get voltage command */
-    err = sendCommand(psCommands["readVoltage"], "");
+    err = sendCommand(psCommands["readVoltage"], "", {"readVoltage"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to get voltage. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
         goto ps_err_readVoltage;
     }
 
     /* Read response from power supply */
-    status = viRead(instrument, (unsigned char*)buffer, sizeof(buffer), &bufferCount);
-    if (status != VI_SUCCESS)
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
     {
         std::cout << "Failed to read voltage. Status: " << status << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = failureFor(status);
         goto ps_err_readVoltage;
     }
 
     /* Convert response to double */
-    voltage = atof(buffer);
-    std::cout << "Power Supply: Voltage is " << voltage << "V" << std::endl;
+    voltage = strtod(buffer, &end);
+    if (end == buffer)
+    {
+        std::cout << "Power Supply: Unknown voltage response: " << buffer << std::endl;
+        voltage = 0.0;
+        err = PsError::ERR_INVALID_RESPONSE;
+        goto ps_err_readVoltage;
+    }
+    if (verbose)
+        std::cout << "Power Supply: Voltage is " << voltage << "V" << std::endl;
 
 ps_err_readVoltage:
     return err;
@@ -250,12 +564,16 @@ ps_err_readVoltage:
 
 PowerSupply::PsError PowerSupply::readCurrent(double& current)
 {
+    PS_ALLOCATION_PROBE("driver.readCurrent");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     char buffer[25];
+    char *end;
     ViUInt32 bufferCount = 0;
     ViStatus status = VI_SUCCESS;
     PsError err = PsError::ERR_SUCCESS;
 
     memset(buffer, '\0', sizeof(buffer));
+    current = 0.0;
 
     /* Check if the instrument is open */
     if (this->isOpen() != PsError::ERR_SUCCESS)
@@ -264,35 +582,178 @@ PowerSupply::PsError PowerSupply::readCurrent(double& current)
         return PsError::ERR_DEVICE_NOT_CONNECTED;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send get current command */
-    err = sendCommand(psCommands["readCurrent"], "");
+    err = sendCommand(psCommands["readCurrent"], "", {"readCurrent"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to get current. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
         goto ps_err_readCurrent;
     }
 
     /* Read response from power supply */
-    status = viRead(instrument, (unsigned char*)buffer, sizeof(buffer), &bufferCount);
-    if (status != VI_SUCCESS)
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
     {
         std::cout << "Failed to read current. Status: " << status << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = failureFor(status);
         goto ps_err_readCurrent;
     }
 
     /* Convert response to double */
-    current = atof(buffer);
-    std::cout << "Power Supply: Current is " << current << "A" << std::endl;
+    current = strtod(buffer, &end);
+    if (end == buffer)
+    {
+        std::cout << "Power Supply: Unknown current response: " << buffer << std::endl;
+        current = 0.0;
+        err = PsError::ERR_INVALID_RESPONSE;
+        goto ps_err_readCurrent;
+    }
+    if (verbose)
+        std::cout << "Power Supply: Current is " << current << "A" << std::endl;
 
 ps_err_readCurrent:
-    current = 0.0;
+    return err;
+}
+
+PowerSupply::PsError PowerSupply::readIdentity(PsIdentity& identity)
+{
+    PS_ALLOCATION_PROBE("driver.readIdentity");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[128];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    std::string fields[4];
+    size_t field = 0;
+
+    memset(buffer, '\0', sizeof(buffer));
+    identity = PsIdentity();
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* Send identification query */
+    err = sendCommand(psCommands["identify"], "", {"identify"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to query identity. Error: " << static_cast<int>(err) << std::endl;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
+        goto ps_err_readIdentity;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status != VI_SUCCESS && status != VI_SUCCESS_TERM_CHAR && status != VI_SUCCESS_MAX_CNT)
+    {
+        std::cout << "Failed to read identity. Status: " << status << std::endl;
+        err = (status == VI_ERROR_ABORT) ? PsError::ERR_CANCELLED : PsError::ERR_OPERATION_FAILED;
+        goto ps_err_readIdentity;
+    }
+
+    /* Response format: <manufacturer>,<model>,<serial>,<firmware> */
+    for (ViUInt32 i = 0; i < bufferCount && buffer[i] != '\n' && buffer[i] != '\r'; i++)
+    {
+        if (buffer[i] == ',' && field < 3)
+            field++;
+        else
+            fields[field] += buffer[i];
+    }
+    identity.manufacturer = fields[0];
+    identity.model = fields[1];
+    identity.serialNumber = fields[2];
+    identity.firmware = fields[3];
+    if (verbose)
+        std::cout << "Power Supply: Identity is " << identity.model << " S/N " << identity.serialNumber << std::endl;
+
+ps_err_readIdentity:
+    return err;
+}
+
+PowerSupply::PsError PowerSupply::readSetpoints(PsSetpoints& setpoints)
+{
+    PS_ALLOCATION_PROBE("driver.readSetpoints");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[64];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    char *field;
+    char *next;
+
+    memset(buffer, '\0', sizeof(buffer));
+    setpoints = PsSetpoints();
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    /* Compound query: one round trip for voltage, current limit and output */
+    err = sendCommand(psCommands["readSetpoints"], "", {"readSetpoints"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to query setpoints. Error: " << static_cast<int>(err) << std::endl;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
+        goto ps_err_readSetpoints;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status != VI_SUCCESS && status != VI_SUCCESS_TERM_CHAR)
+    {
+        std::cout << "Failed to read setpoints. Status: " << status << std::endl;
+        err = (status == VI_ERROR_ABORT) ? PsError::ERR_CANCELLED : PsError::ERR_OPERATION_FAILED;
+        goto ps_err_readSetpoints;
+    }
+
+    /* Response format: <voltage>;<current limit>;<0|1> */
+    field = buffer;
+    setpoints.voltage = strtod(field, &next);
+    if (next == field || *next != ';')
+        goto ps_err_parse;
+    field = next + 1;
+    setpoints.currentLimit = strtod(field, &next);
+    if (next == field || *next != ';')
+        goto ps_err_parse;
+    field = next + 1;
+    if (*field != '0' && *field != '1')
+        goto ps_err_parse;
+    setpoints.output = (*field == '1');
+    if (verbose)
+        std::cout << "Power Supply: Setpoints are " << setpoints.voltage << "V, " << setpoints.currentLimit
+                  << "A, output " << (setpoints.output ? "ON" : "OFF") << std::endl;
+    return PsError::ERR_SUCCESS;
+
+ps_err_parse:
+    std::cout << "Power Supply: Unknown setpoints response: " << buffer << std::endl;
+    setpoints = PsSetpoints();
+    err = PsError::ERR_OPERATION_FAILED;
+
+ps_err_readSetpoints:
     return err;
 }
 
 PowerSupply::PsError PowerSupply::turnOn(void)
 {
+    PS_ALLOCATION_PROBE("driver.turnOn");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     PsError err = PsError::ERR_SUCCESS;
 
     /* Check if the instrument is open */
@@ -302,16 +763,22 @@ PowerSupply::PsError PowerSupply::turnOn(void)
         goto err_turnOn;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send turn on command */
-    err = sendCommand(psCommands["turnOn"], "");
+    err = sendCommand(psCommands["turnOn"], "", {"turnOn"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to turn on power supply. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
     }
     else
     {
-        std::cout << "Power Supply: Turned on" << std::endl;
+        if (verbose)
+            std::cout << "Power Supply: Turned on" << std::endl;
     }
 
 err_turnOn:
@@ -320,6 +787,8 @@ err_turnOn:
 
 PowerSupply::PsError PowerSupply::turnOff(void)
 {
+    PS_ALLOCATION_PROBE("driver.turnOff");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
     PsError err = PsError::ERR_SUCCESS;
 
     /* Check if the instrument is open */
@@ -329,33 +798,912 @@ PowerSupply::PsError PowerSupply::turnOff(void)
         goto err_turnOff;
     }
 
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
     /* Send turn off command */
-    err = sendCommand(psCommands["turnOff"], "");
+    err = sendCommand(psCommands["turnOff"], "", {"turnOff"});
     if (err != PsError::ERR_SUCCESS)
     {
         std::cout << "Failed to turn off power supply. Error: " << static_cast<int>(err) << std::endl;
-        err = PsError::ERR_OPERATION_FAILED;
+        err = (err == PsError::ERR_CANCELLED) ? err : PsError::ERR_OPERATION_FAILED;
     }
     else
     {
-        std::cout << "Power Supply: Turned off" << std::endl;
+        if (verbose)
+            std::cout << "Power Supply: Turned off" << std::endl;
     }
 
 err_turnOff:
     return err;
 }
 
-void PowerSupply::close(void)
+/**
+ * @brief Sets the number of outputs. readChannels() reads all of them in one
+ * message, so the count is limited by the longest message the instrument
+ * accepts and by the reply buffer.
+ * @param count Outputs of the supply, from 1.
+ * @return ERR_OPERATION_FAILED, with the count unchanged, when the outputs do not fit in one query.
+ */
+PowerSupply::PsError PowerSupply::setChannels(int count)
+{
+    if (count < 1)
+        return PsError::ERR_OPERATION_FAILED;
+
+    /* The terminator is not part of the program */
+    if (channelQueryBytes(count, true) - 1 > maxProgramBytes ||
+        static_cast<size_t>(count) * 2 * maxReadingBytes > channelReplyBytes)
+    {
+        std::cout << "Power Supply: " << count << " outputs do not fit in one query" << std::endl;
+        return PsError::ERR_OPERATION_FAILED;
+    }
+    channels = count;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Selects the output the next commands apply to. Skipped when already selected.
+ * @param channel Output number, from 1.
+ */
+PowerSupply::PsError PowerSupply::selectChannel(int channel)
+{
+    PS_ALLOCATION_PROBE("driver.selectChannel");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    PsError err;
+
+    if (channel < 1 || channel > channels)
+        return PsError::ERR_OPERATION_FAILED;
+    if (channels == 1 || channel == selectedChannel)
+        return PsError::ERR_SUCCESS;
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+
+    err = sendCommand(psCommands["selectChannel"], std::to_string(channel), {"selectChannel"});
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+    selectedChannel = channel;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Writes settings to several outputs with as few selects and writes as possible.
+ * Commands are grouped by channel, the selected channel first and the
+ * others in ascending order, keeping their order within a channel. Each
+ * group is preceded by one INST:NSEL, except a group for the channel
+ * already selected. Groups are joined into program messages of up to
+ * maxProgramBytes.
+ * @param commands Writes to send; queries are not accepted.
+ */
+PowerSupply::PsError PowerSupply::writeChannels(const std::vector<PsChannelCommand>& commands)
+{
+    PS_ALLOCATION_PROBE("driver.writeChannels");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    std::vector<PsChannelCommand> ordered(commands);
+    std::string program;
+    std::string unit;
+    std::vector<std::string> names;
+    std::vector<std::string> unitNames;
+    int programChannel = selectedChannel;
+    int current = selectedChannel;
+    PsError err = PsError::ERR_SUCCESS;
+
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    for (const PsChannelCommand& command : commands)
+    {
+        auto entry = psCommands.find(command.name);
+        if (command.channel < 1 || command.channel > channels || entry == psCommands.end() || entry->second.back() == '?')
+            return PsError::ERR_OPERATION_FAILED;
+    }
+
+    /* The selected channel sorts first */
+    std::stable_sort(ordered.begin(), ordered.end(), [current](const PsChannelCommand& a, const PsChannelCommand& b) {
+        return (a.channel == current ? 0 : a.channel) < (b.channel == current ? 0 : b.channel);
+    });
+
+    for (const PsChannelCommand& command : ordered)
+    {
+        unit.clear();
+        unitNames.clear();
+        if (channels > 1 && command.channel != current)
+        {
+            unit = psCommands["selectChannel"] + " " + std::to_string(command.channel) + ";:";
+            unitNames.push_back("selectChannel");
+            current = command.channel;
+        }
+        unit += psCommands[command.name];
+        unitNames.push_back(command.name);
+        if (!command.value.empty())
+            unit += " " + command.value;
+
+        /* Flush before the message gets too long for the instrument input buffer */
+        if (!program.empty() && program.size() + 2 + unit.size() > maxProgramBytes)
+        {
+            err = sendCommand(program, "", names);
+            if (err != PsError::ERR_SUCCESS)
+                goto err_writeChannels;
+            selectedChannel = programChannel;
+            program.clear();
+            names.clear();
+        }
+        if (!program.empty())
+            program += ";:";
+        program += unit;
+        names.insert(names.end(), unitNames.begin(), unitNames.end());
+        programChannel = current;
+    }
+
+    if (!program.empty())
+    {
+        err = sendCommand(program, "", names);
+        if (err != PsError::ERR_SUCCESS)
+            goto err_writeChannels;
+        selectedChannel = programChannel;
+    }
+    return PsError::ERR_SUCCESS;
+
+err_writeChannels:
+    /* Part of the message may have run: the selection is unknown */
+    selectedChannel = 0;
+    std::cout << "Failed to write channels. Error: " << static_cast<int>(err) << std::endl;
+    return err;
+}
+
+/**
+ * @brief Sets the voltage of one output.
+ * @param channel Output number, from 1.
+ * @param voltage Voltage in volts.
+ */
+PowerSupply::PsError PowerSupply::writeVoltage(int channel, double voltage)
+{
+    PsChannelCommand command;
+
+    command.channel = channel;
+    command.name = "writeVoltage";
+    command.value = std::to_string(voltage);
+    return writeChannels({command});
+}
+
+/**
+ * @brief Reads every output in one compound query.
+ * The query starts with the selected output so that its INST:NSEL is
+ * skipped, then walks the others in order; on a single output supply it
+ * has no select at all.
+ * @param readings Resized to the channel count; index 0 is channel 1.
+ * @param withVoltage Also read the voltages; otherwise they are left at 0.
+ */
+PowerSupply::PsError PowerSupply::readChannels(std::vector<PsChannelReading>& readings, bool withVoltage)
+{
+    PS_ALLOCATION_PROBE("driver.readChannels");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[channelReplyBytes];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    std::string program;
+    std::vector<std::string> names;
+    int count = std::max(1, channels);
+    int first = (selectedChannel >= 1 && selectedChannel <= count) ? selectedChannel : 1;
+    char *field;
+    char *next;
+
+    memset(buffer, '\0', sizeof(buffer));
+    readings.assign(count, PsChannelReading());
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* INST:NSEL n;:MEAS:VOLT?;:MEAS:CURR?;:INST:NSEL m;... */
+    for (int i = 0; i < count; i++)
+    {
+        int channel = (first - 1 + i) % count + 1;
+
+        if (count > 1 && channel != selectedChannel)
+        {
+            if (!program.empty())
+                program += ";:";
+            program += psCommands["selectChannel"] + " " + std::to_string(channel);
+            names.push_back("selectChannel");
+        }
+        if (withVoltage)
+        {
+            if (!program.empty())
+                program += ";:";
+            program += psCommands["readVoltage"];
+            names.push_back("readVoltage");
+        }
+        if (!program.empty())
+            program += ";:";
+        program += psCommands["readCurrent"];
+        names.push_back("readCurrent");
+    }
+
+    err = sendCommand(program, "", names);
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to query channels. Error: " << static_cast<int>(err) << std::endl;
+        goto ps_err_readChannels;
+    }
+    if (count > 1)
+        selectedChannel = (first + count - 2) % count + 1;
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+    {
+        std::cout << "Failed to read channels. Status: " << status << std::endl;
+        err = failureFor(status);
+        goto ps_err_readChannels;
+    }
+
+    /* Response format: [<voltage>;]<current>[;...] in query order */
+    field = buffer;
+    for (int i = 0; i < count; i++)
+    {
+        PsChannelReading& reading = readings[(first - 1 + i) % count];
+
+        if (withVoltage)
+        {
+            reading.voltage = strtod(field, &next);
+            if (next == field || *next != ';')
+                goto ps_err_parse;
+            field = next + 1;
+        }
+        reading.current = strtod(field, &next);
+        if (next == field || (i < count - 1 && *next != ';'))
+            goto ps_err_parse;
+        field = next + 1;
+    }
+    return PsError::ERR_SUCCESS;
+
+ps_err_parse:
+    std::cout << "Power Supply: Unknown channels response: " << buffer << std::endl;
+    err = PsError::ERR_INVALID_RESPONSE;
+
+ps_err_readChannels:
+    readings.assign(count, PsChannelReading());
+    return err;
+}
+
+/**
+ * @brief Programs the status enables so that one *STB? poll shows every change
+ * worth a full read: the operation and questionable events of the masks, in
+ * both directions, and the error bits of the standard event register.
+ * Models without the status subsystem reject the enables; polls then read
+ * the full state every time.
+ */
+PowerSupply::PsError PowerSupply::enableStatusReporting(void)
+{
+    PS_ALLOCATION_PROBE("driver.enableStatusReporting");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[32];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    std::string program;
+    unsigned eventStatus = 0;
+
+    memset(buffer, '\0', sizeof(buffer));
+    statusReporting = false;
+    statusKnown = false;
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* *CLS;...;:STAT:OPER:ENAB m;:STAT:QUES:ENAB n;*ESR?, the errors of the message tell whether it was accepted */
+    program = psCommands["enableStatus"] + ";:" + psCommands["operationEnable"] + " " + std::to_string(operationMask) +
+              ";:" + psCommands["questionableEnable"] + " " + std::to_string(questionableMask) + ";" + psCommands["eventStatus"];
+    err = sendCommand(program, "", {"enableStatus", "operationEnable", "questionableEnable", "eventStatus"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to enable status reporting. Error: " << static_cast<int>(err) << std::endl;
+        goto ps_err_enableStatusReporting;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+    {
+        std::cout << "Failed to read event status. Status: " << status << std::endl;
+        err = failureFor(status);
+        goto ps_err_enableStatusReporting;
+    }
+    if (sscanf(buffer, "%u", &eventStatus) != 1)
+    {
+        std::cout << "Power Supply: Unknown event status response: " << buffer << std::endl;
+        err = PsError::ERR_INVALID_RESPONSE;
+        goto ps_err_enableStatusReporting;
+    }
+
+    /* Query, device, execution or command error: no status subsystem */
+    if (eventStatus & 0x3C)
+    {
+        std::cout << "Power Supply: Status reporting not supported, polling the full state" << std::endl;
+        err = PsError::ERR_OPERATION_FAILED;
+        goto ps_err_enableStatusReporting;
+    }
+
+    statusReporting = true;
+    if (verbose)
+        std::cout << "Power Supply: Status reporting enabled" << std::endl;
+    return PsError::ERR_SUCCESS;
+
+ps_err_enableStatusReporting:
+    return err;
+}
+
+/**
+ * @brief Reads the IEEE 488.2 status byte.
+ * Serial links have no service request line, so the byte is read with *STB?.
+ * @param statusByte Receives the status byte.
+ */
+PowerSupply::PsError PowerSupply::readStatusByte(uint8_t& statusByte)
+{
+    PS_ALLOCATION_PROBE("driver.readStatusByte");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[16];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    unsigned value = 0;
+
+    memset(buffer, '\0', sizeof(buffer));
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    err = sendCommand(psCommands["statusByte"], "", {"statusByte"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to query status byte. Error: " << static_cast<int>(err) << std::endl;
+        return err;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+    {
+        std::cout << "Failed to read status byte. Status: " << status << std::endl;
+        return failureFor(status);
+    }
+    if (sscanf(buffer, "%u", &value) != 1 || value > 0xFF)
+    {
+        std::cout << "Power Supply: Unknown status byte response: " << buffer << std::endl;
+        return PsError::ERR_INVALID_RESPONSE;
+    }
+
+    statusByte = static_cast<uint8_t>(value);
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Reads the output state and the latched events with one compound
+ * query, then drains the error queue. Reading the event registers clears
+ * them, and with them the summary bits of the status byte.
+ * @param status Receives the state; the status byte is left unchanged.
+ */
+PowerSupply::PsError PowerSupply::readStatus(PsStatus& status)
 {
-    if (instrument != VI_NULL)
+    PS_ALLOCATION_PROBE("driver.readStatus");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    const int maxDrainedErrors = 8;
+    char buffer[160];
+    ViUInt32 bufferCount = 0;
+    ViStatus visaStatus = VI_SUCCESS;
+    PsError err = PsError::ERR_SUCCESS;
+    int output = 0;
+    unsigned operation = 0;
+    unsigned questionable = 0;
+    unsigned eventStatus = 0;
+    int error = 0;
+
+    memset(buffer, '\0', sizeof(buffer));
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
     {
-        viClose(instrument);
-        instrument = VI_NULL;
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
     }
-    if (defaultRM != VI_NULL)
+
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    err = sendCommand(psCommands["readStatus"], "", {"readStatus"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to query status. Error: " << static_cast<int>(err) << std::endl;
+        return err;
+    }
+
+    /* Read response from power supply */
+    visaStatus = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (visaStatus < VI_SUCCESS)
+    {
+        std::cout << "Failed to read status. Status: " << visaStatus << std::endl;
+        return failureFor(visaStatus);
+    }
+
+    /* Response format: <output>;<operation>;<questionable>;<event status>;<code>,"<message>" */
+    if (sscanf(buffer, "%d;%u;%u;%u;%d", &output, &operation, &questionable, &eventStatus, &error) != 5)
+    {
+        std::cout << "Power Supply: Unknown status response: " << buffer << std::endl;
+        return PsError::ERR_INVALID_RESPONSE;
+    }
+    status.output = (output != 0);
+    status.operation = static_cast<uint16_t>(operation);
+    status.questionable = static_cast<uint16_t>(questionable);
+    status.eventStatus = static_cast<uint8_t>(eventStatus);
+    status.error = error;
+    if (error != 0)
+        std::cout << "Power Supply: Instrument error: " << buffer << std::endl;
+
+    /* Empty the rest of the queue so its summary bit clears */
+    for (int i = 0; error != 0 && i < maxDrainedErrors; i++)
+    {
+        err = sendCommand(psCommands["readError"], "", {"readError"});
+        if (err != PsError::ERR_SUCCESS)
+            return err;
+        memset(buffer, '\0', sizeof(buffer));
+        visaStatus = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+        if (visaStatus < VI_SUCCESS)
+            return failureFor(visaStatus);
+        if (sscanf(buffer, "%d", &error) != 1)
+            return PsError::ERR_INVALID_RESPONSE;
+        if (error != 0)
+            std::cout << "Power Supply: Instrument error: " << buffer << std::endl;
+    }
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Checks the instrument for state changes at the cost of one *STB?.
+ * The full state is read only when a summary bit is set, on the first poll
+ * and after a failed exchange, which could have lost cleared events. Without
+ * status reporting every poll reads the full state.
+ * @param status State of the previous poll; updated with the new one.
+ * @param changed Set when the output switched or events or errors were latched.
+ */
+PowerSupply::PsError PowerSupply::pollStatus(PsStatus& status, bool& changed)
+{
+    PS_ALLOCATION_PROBE("driver.pollStatus");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    bool output = status.output;
+    PsError err;
+
+    changed = false;
+    if (statusReporting && statusKnown)
+    {
+        err = readStatusByte(status.statusByte);
+        if (err != PsError::ERR_SUCCESS)
+            return err;
+        if ((status.statusByte & stbChanges) == 0)
+            return PsError::ERR_SUCCESS;
+    }
+
+    err = readStatus(status);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+    changed = !statusKnown || status.output != output || status.questionable != 0 ||
+              (status.eventStatus & 0x3C) != 0 || status.error != 0;
+    statusKnown = true;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Writes voltage, current limit and output state in one program message.
+ * An output being turned off goes off first; one being turned on goes on last,
+ * after its new limits.
+ * @param setpoints Settings to write.
+ */
+PowerSupply::PsError PowerSupply::writeSetpoints(const PsSetpoints& setpoints)
+{
+    PS_ALLOCATION_PROBE("driver.writeSetpoints");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    std::string program;
+    PsError err;
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* Unaddressed commands apply to the first output */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    /* OUTP OFF;:VOLT v;:CURR c or VOLT v;:CURR c;:OUTP ON */
+    if (!setpoints.output)
+        program = psCommands["turnOff"] + ";:";
+    program += psCommands["writeVoltage"] + " " + std::to_string(setpoints.voltage) + ";:" +
+               psCommands["setCurrent"] + " " + std::to_string(setpoints.currentLimit);
+    if (setpoints.output)
+        program += ";:" + psCommands["turnOn"];
+
+    err = sendCommand(program, "", {setpoints.output ? "turnOn" : "turnOff", "writeVoltage", "setCurrent"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to write setpoints. Error: " << static_cast<int>(err) << std::endl;
+        return err;
+    }
+    if (verbose)
+        std::cout << "Power Supply: Setpoints written" << std::endl;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Saves the instrument settings to a memory slot with *SAV.
+ * The message ends with *ESR?, which waits for the save and tells whether
+ * the model accepted it.
+ * @param slot Instrument memory slot.
+ * @return ERR_OPERATION_FAILED when the model rejects the slot or has no saved states.
+ */
+PowerSupply::PsError PowerSupply::saveState(int slot)
+{
+    PS_ALLOCATION_PROBE("driver.saveState");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[32];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err;
+    unsigned eventStatus = 0;
+
+    memset(buffer, '\0', sizeof(buffer));
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    err = sendCommand(psCommands["saveState"] + " " + std::to_string(slot) + ";" + psCommands["eventStatus"], "",
+                      {"saveState", "eventStatus"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to save state. Error: " << static_cast<int>(err) << std::endl;
+        return err;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+    {
+        std::cout << "Failed to read event status. Status: " << status << std::endl;
+        return failureFor(status);
+    }
+    if (sscanf(buffer, "%u", &eventStatus) != 1)
+    {
+        std::cout << "Power Supply: Unknown event status response: " << buffer << std::endl;
+        return PsError::ERR_INVALID_RESPONSE;
+    }
+    if (eventStatus & 0x3C)
+    {
+        std::cout << "Power Supply: State not saved to slot " << slot << std::endl;
+        return PsError::ERR_OPERATION_FAILED;
+    }
+    if (verbose)
+        std::cout << "Power Supply: State saved to slot " << slot << std::endl;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Recalls a memory slot with *RCL and checks it against the expected settings.
+ * The recall, an output off and the voltage and current read back travel
+ * in one message, so the output is off whatever state the slot restored,
+ * with no exchange in between. It is switched on only when the read back
+ * matches and the output is expected on, so a slot overwritten at the
+ * front panel never powers the load with the wrong settings.
+ * @param slot Instrument memory slot.
+ * @param expected Settings the slot is believed to hold.
+ * @param tolerance Largest difference of voltage and current accepted as a match.
+ * @param matched Set when the recalled settings are the expected ones.
+ */
+PowerSupply::PsError PowerSupply::recallState(int slot, const PsSetpoints& expected, double tolerance, bool& matched)
+{
+    PS_ALLOCATION_PROBE("driver.recallState");
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    char buffer[64];
+    ViUInt32 bufferCount = 0;
+    ViStatus status = VI_SUCCESS;
+    PsError err;
+    std::string program;
+    double voltage = 0.0;
+    double currentLimit = 0.0;
+
+    matched = false;
+    memset(buffer, '\0', sizeof(buffer));
+
+    /* Check if the instrument is open */
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Device not connected" << std::endl;
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+    }
+
+    /* A recall sets every output; the read back applies to the first one */
+    err = selectChannel(1);
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+
+    /* *RCL n;:OUTP OFF;:VOLT?;:CURR? */
+    program = psCommands["recallState"] + " " + std::to_string(slot) + ";:" + psCommands["turnOff"];
+    program += ";:" + psCommands["writeVoltage"] + "?;:" + psCommands["setCurrent"] + "?";
+    err = sendCommand(program, "", {"recallState", "turnOff", "readSetpoints"});
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to recall state. Error: " << static_cast<int>(err) << std::endl;
+        return err;
+    }
+
+    /* Read response from power supply */
+    status = readResponse(buffer, sizeof(buffer) - 1, bufferCount);
+    if (status < VI_SUCCESS)
+    {
+        std::cout << "Failed to read recalled state. Status: " << status << std::endl;
+        return failureFor(status);
+    }
+
+    /* Response format: <voltage>;<current limit> */
+    if (sscanf(buffer, "%lf;%lf", &voltage, &currentLimit) != 2)
+    {
+        std::cout << "Power Supply: Unknown recalled state response: " << buffer << std::endl;
+        return PsError::ERR_INVALID_RESPONSE;
+    }
+    if (std::fabs(voltage - expected.voltage) > tolerance || std::fabs(currentLimit - expected.currentLimit) > tolerance)
+    {
+        std::cout << "Power Supply: Slot " << slot << " holds " << voltage << "V, " << currentLimit << "A" << std::endl;
+        return PsError::ERR_SUCCESS;
+    }
+    matched = true;
+
+    if (expected.output)
+    {
+        err = sendCommand(psCommands["turnOn"], "", {"turnOn"});
+        if (err != PsError::ERR_SUCCESS)
+        {
+            std::cout << "Failed to turn on power supply. Error: " << static_cast<int>(err) << std::endl;
+            return err;
+        }
+    }
+    if (verbose)
+        std::cout << "Power Supply: Recalled slot " << slot << std::endl;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Sends one program message and, for queries, reads the reply.
+ * @param program Program message without terminator.
+ * @param reply Buffer receiving the reply.
+ * @param size Size of the reply buffer.
+ * @param replyCount Reply bytes received.
+ * @param roundTripMs Time from the write to the end of the reply.
+ */
+PowerSupply::PsError PowerSupply::timeExchange(const std::string& program, char *reply, size_t size,
+                                               ViUInt32& replyCount, double& roundTripMs)
+{
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    ViStatus status;
+    PsError err;
+
+    replyCount = 0;
+    err = sendCommand(program, "", {});
+    if (err != PsError::ERR_SUCCESS)
+        return err;
+    if (program.back() == '?')
+    {
+        status = readResponse(reply, size - 1, replyCount);
+        if (status != VI_SUCCESS && status != VI_SUCCESS_TERM_CHAR)
+            return failureFor(status);
+        reply[replyCount] = '\0';
+    }
+    roundTripMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - transactionStart).count();
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Measures every command of psCommands and builds the timing profile of the model.
+ * Queries are timed as they are. Commands without a reply are sent with
+ * *OPC? appended and the round trip of *OPC? alone is subtracted. Settings
+ * are rewritten with their present values and only the output command
+ * matching the present output state is sent, so the instrument state does
+ * not change; the other output command is marked as estimated.
+ * The new profile is applied on success.
+ * @param profile Filled with the model and one timing per command.
+ * @param repeats Exchanges per command.
+ */
+PowerSupply::PsError PowerSupply::characterize(TimingProfile& profile, unsigned repeats)
+{
+    /* Nothing else goes out while the commands are timed */
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    const std::string& opc = psCommands["operationComplete"];
+    PsIdentity identity;
+    PsSetpoints setpoints;
+    std::map<std::string, std::string> values;
+    std::vector<double> samples;
+    char reply[64];
+    ViUInt32 replyCount = 0;
+    double roundTripMs = 0.0;
+    double opcMs = 0.0;
+    PsError err;
+
+    if (this->isOpen() != PsError::ERR_SUCCESS)
+        return PsError::ERR_DEVICE_NOT_CONNECTED;
+
+    /* Measure with the default timeout, whatever profile was applied */
+    applyTimingProfile(TimingProfile());
+    err = readIdentity(identity);
+    if (err == PsError::ERR_SUCCESS)
+        err = readSetpoints(setpoints);
+    if (err == PsError::ERR_SUCCESS)
+        err = timeExchange(psCommands["getMaxCurrent"], reply, sizeof(reply), replyCount, roundTripMs);
+    if (err != PsError::ERR_SUCCESS)
+    {
+        std::cout << "Power Supply: Cannot read the state to characterize" << std::endl;
+        return err;
+    }
+    values["writeVoltage"] = std::to_string(setpoints.voltage);
+    values["setCurrent"] = std::to_string(setpoints.currentLimit);
+    values["writeMaxCurrent"] = std::to_string(strtod(reply, nullptr));
+    values["selectChannel"] = "1";
+    values["operationEnable"] = std::to_string(operationMask);
+    values["questionableEnable"] = std::to_string(questionableMask);
+
+    profile = TimingProfile();
+    profile.model = identity.model;
+    profile.baudrate = baudrate;
+
+    /* Baseline of the write-only commands */
+    for (unsigned i = 0; i < repeats; i++)
+    {
+        if (timeExchange(opc, reply, sizeof(reply), replyCount, roundTripMs) != PsError::ERR_SUCCESS)
+            return PsError::ERR_OPERATION_FAILED;
+        samples.push_back(roundTripMs);
+    }
+    std::sort(samples.begin(), samples.end());
+    opcMs = samples[samples.size() / 2];
+
+    for (const auto& entry : psCommands)
+    {
+        const std::string& name = entry.first;
+        bool query = entry.second.back() == '?';
+        std::string program = entry.second;
+        double wireMs = 0.0;
+
+        if ((name == "turnOn" && !setpoints.output) || (name == "turnOff" && setpoints.output))
+            continue;
+
+        /* Saving would overwrite a stored state and recalling would replace the settings */
+        if (name == "saveState" || name == "recallState")
+            continue;
+
+        /* The enables would reprogram status reporting, and the event and
+           error reads clear what change detection has not reported yet */
+        if (name == "enableStatus" || name == "operationEnable" || name == "questionableEnable" ||
+            name == "readStatus" || name == "eventStatus" || name == "readError")
+            continue;
+        if (values.count(name))
+            program += " " + values[name];
+        if (!query)
+            program += ";" + opc;
+
+        samples.clear();
+        for (unsigned i = 0; i < repeats; i++)
+        {
+            err = timeExchange(program, reply, sizeof(reply), replyCount, roundTripMs);
+            if (err != PsError::ERR_SUCCESS)
+                break;
+
+            /* Bytes of the program, its terminator and the reply, minus what *OPC? accounts for */
+            wireMs = query ? TimingProfile::wireMs(program.size() + 1 + replyCount, baudrate)
+                           : TimingProfile::wireMs(program.size() - opc.size(), baudrate);
+            samples.push_back(std::max(0.0, roundTripMs - wireMs - (query ? 0.0 : opcMs)));
+        }
+        if (err != PsError::ERR_SUCCESS)
+        {
+            std::cout << "Power Supply: " << entry.second << " not profiled. Error: " << static_cast<int>(err) << std::endl;
+            continue;
+        }
+        profile.commands[name] = TimingProfile::summarize(samples, wireMs);
+        profile.commands[name].replyBytes = query ? replyCount : 0;
+    }
+
+    /* The output command not sent behaves like its counterpart */
+    if (profile.find(setpoints.output ? "turnOn" : "turnOff"))
+    {
+        CommandTiming timing = profile.commands[setpoints.output ? "turnOn" : "turnOff"];
+        timing.estimated = true;
+        profile.commands[setpoints.output ? "turnOff" : "turnOn"] = timing;
+    }
+
+    applyTimingProfile(profile);
+    if (verbose)
+        std::cout << "Power Supply: Characterized " << profile.model << " (" << profile.commands.size() << " commands)" << std::endl;
+    return PsError::ERR_SUCCESS;
+}
+
+/**
+ * @brief Length of a command on the wire.
+ * @param name Driver command name.
+ * @return Bytes including the terminator, without parameters; 0 for unknown commands.
+ */
+size_t PowerSupply::commandBytes(const std::string& name) const
+{
+    auto entry = psCommands.find(name);
+    return entry == psCommands.end() ? 0 : entry->second.size() + 1;
+}
+
+/**
+ * @brief Length of the readChannels() query on the wire, with every output selected.
+ * @param count Outputs read.
+ * @param withVoltage True when the voltages are read too.
+ * @return Bytes including the terminator.
+ */
+size_t PowerSupply::channelQueryBytes(int count, bool withVoltage) const
+{
+    size_t bytes = 0;
+
+    /* commandBytes() counts a terminator per command; one more byte makes it the ";:" between them */
+    for (int channel = 1; channel <= count; channel++)
+    {
+        if (count > 1)
+            bytes += commandBytes("selectChannel") + 1 + std::to_string(channel).size() + 1;  /* " n" */
+        if (withVoltage)
+            bytes += commandBytes("readVoltage") + 1;
+        bytes += commandBytes("readCurrent") + 1;
+    }
+    return bytes > 0 ? bytes - 1 : 0;
+}
+
+/**
+ * @brief Uses the per-command timeouts of a timing profile.
+ * @param profile Profile of the connected model; an empty one restores the default timeout.
+ */
+void PowerSupply::applyTimingProfile(const TimingProfile& profile)
+{
+    std::map<std::string, uint32_t> timeouts;
+
+    for (const auto& entry : psCommands)
+    {
+        if (profile.find(entry.first))
+            timeouts[entry.first] = profile.timeoutMs(entry.first);
+    }
+
+    /* The worker reads the timeouts with every command */
+    std::lock_guard<std::recursive_mutex> exchange(ioMutex);
+    commandTimeoutsMs.swap(timeouts);
+}
+
+/**
+ * @brief Closes the link. A write or read blocked in another thread is
+ * aborted first, so the session is never freed under it.
+ */
+void PowerSupply::close(void)
+{
+    transport->abort();
     {
-        viClose(defaultRM);
-        defaultRM = VI_NULL;
+        std::lock_guard<std::recursive_mutex> lock(ioMutex);
+        reconnectWanted = false;
+        transport->close();
+        port = "";
     }
-    port = "";
 }
@@ -1,9 +1,84 @@
+#ifndef DRV_POWER_SUPPLY_H
+#define DRV_POWER_SUPPLY_H
+
 #include <iostream>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include "visa.h"
+#include "transport.h"
+#include "cancel_token.h"
+#include "timing_profile.h"
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
+
+/* Fields reported by the IEEE 488.2 *IDN? query */
+struct PsIdentity
+{
+    std::string manufacturer;
+    std::string model;
+    std::string serialNumber;
+    std::string firmware;
+};
+
+/* Programmed state read back in one transaction */
+struct PsSetpoints
+{
+    double voltage = 0.0;
+    double currentLimit = 0.0;
+    bool output = false;
+};
+
+/* Reading of one output of a multi-channel supply */
+struct PsChannelReading
+{
+    double voltage = 0.0;
+    double current = 0.0;
+};
+
+/* Write addressed to one output. Channels are numbered from 1 as in INST:NSEL */
+struct PsChannelCommand
+{
+    int channel = 1;
+    std::string name;   /* Key of the driver command table */
+    std::string value;  /* Parameter, empty for none */
+};
+
+/* Instrument state behind the IEEE 488.2 status byte. The event fields
+   hold what latched since the previous full read */
+struct PsStatus
+{
+    uint8_t statusByte = 0;      /* Last *STB? */
+    bool output = false;         /* Output 1 */
+    uint16_t operation = 0;      /* STAT:OPER:EVEN? */
+    uint16_t questionable = 0;   /* STAT:QUES:EVEN?: protection trips */
+    uint8_t eventStatus = 0;     /* *ESR?: command, execution, device and query errors */
+    int error = 0;               /* Oldest SYST:ERR? code, 0 when the queue was empty */
+};
+
+/* Link health counters. Updated by the driver on every transaction and read
+   lock-free by monitoring, so observing them never touches the instrument */
+struct PsHealth
+{
+    static constexpr int latencyBuckets = 12;
+    static constexpr double latencyBoundsMs[latencyBuckets - 1] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000};
+
+    std::atomic<uint64_t> commands{0};      /* Commands sent */
+    std::atomic<uint64_t> errors{0};        /* Failed writes or reads */
+    std::atomic<uint64_t> timeouts{0};      /* Failures caused by a VISA timeout */
+    std::atomic<uint64_t> cancellations{0}; /* Exchanges aborted by a cancellation or close */
+    std::atomic<uint64_t> reconnects{0};    /* Successful opens after the first one */
+    std::atomic<uint64_t> bytesSent{0};     /* Program messages including terminators */
+    std::atomic<uint64_t> bytesReceived{0}; /* Replies including terminators */
+    std::atomic<uint64_t> latencyCount[latencyBuckets] = {};  /* Per bucket, last one is +Inf */
+    std::atomic<uint64_t> latencySumUs{0};
+
+    void recordLatency(uint64_t latencyUs);
+};
 
 class PowerSupply
 {
@@ -14,13 +89,17 @@ class PowerSupply
             ERR_INVALID_VOLTAGE,
             ERR_INVALID_CURRENT,
             ERR_DEVICE_NOT_CONNECTED,
-            ERR_OPERATION_FAILED
+            ERR_OPERATION_FAILED,
+            ERR_TIMEOUT,
+            ERR_INVALID_RESPONSE,
+            ERR_CANCELLED
         };
 
-        PowerSupply(std::string port);
+        PowerSupply(std::string port, std::unique_ptr<Transport> transport = nullptr);
         ~PowerSupply();
 
         PsError open(std::string port);
+        PsError reconnect(void);
         PsError writeVoltage(double voltage);
         PsError writeMaxCurrent(double current);
         PsError isOpen(void);
@@ -29,14 +108,72 @@ class PowerSupply
         PsError turnOff(void);
         PsError readVoltage(double& voltage);
         PsError readCurrent(double& current);
+        PsError readIdentity(PsIdentity& identity);
+        PsError readSetpoints(PsSetpoints& setpoints);
+        PsError setChannels(int count);
+        PsError selectChannel(int channel);
+        PsError writeChannels(const std::vector<PsChannelCommand>& commands);
+        PsError writeVoltage(int channel, double voltage);
+        PsError trackVoltage(double voltage, PsChannelReading& reading, bool withVoltage);
+        PsError readChannels(std::vector<PsChannelReading>& readings, bool withVoltage);
+        PsError enableStatusReporting(void);
+        PsError readStatusByte(uint8_t& statusByte);
+        PsError readStatus(PsStatus& status);
+        PsError pollStatus(PsStatus& status, bool& changed);
+        PsError writeSetpoints(const PsSetpoints& setpoints);
+        PsError saveState(int slot);
+        PsError recallState(int slot, const PsSetpoints& expected, double tolerance, bool& matched);
+        bool statusReportingEnabled(void) const { return statusReporting; }
+        void forgetSelection(void) { selectedChannel = 0; }  /* Another client of the link may have selected an output */
+        void setCancelToken(CancelToken *token) { cancelToken = token; }  /* Checked before every exchange, nullptr for none */
+        void setVerbose(bool on) { verbose = on; }  /* Progress and per-command messages; errors are always printed */
+        PsError characterize(TimingProfile& profile, unsigned repeats);
+        void applyTimingProfile(const TimingProfile& profile);
+        size_t commandBytes(const std::string& name) const;
+        size_t channelQueryBytes(int count, bool withVoltage) const;
         void close(void);
         std::string port;
         int baudrate;
+        int channels = 1;  /* Outputs; more than one are addressed with INST:NSEL, unaddressed commands go to output 1. Set with setChannels() */
+        PsHealth health;
+
+        /* IEEE 488.2 status byte bits */
+        static constexpr uint8_t stbErrorQueue = 0x04;    /* SYST:ERR? queue not empty */
+        static constexpr uint8_t stbQuestionable = 0x08;  /* Enabled STAT:QUES events */
+        static constexpr uint8_t stbEventStatus = 0x20;   /* Enabled *ESR events */
+        static constexpr uint8_t stbOperation = 0x80;     /* Enabled STAT:OPER events */
+        static constexpr uint8_t stbChanges = stbErrorQueue | stbQuestionable | stbEventStatus | stbOperation;
+
+        /* Events summarized in the status byte. SCPI leaves the operation bits
+           to the model; the defaults are the constant-voltage (8) and
+           constant-current (10) bits of common bench supplies, one of which
+           changes whenever the output is switched. The questionable defaults
+           are the over-voltage (0), over-current (1) and over-temperature (4) trips */
+        uint16_t operationMask = 0x0500;
+        uint16_t questionableMask = 0x0013;
 
     private:
         int defaultBaudrate = 9600;
-        ViSession defaultRM;
-        ViSession instrument;
+        std::unique_ptr<Transport> transport;
+        bool openedBefore = false;
+        std::chrono::steady_clock::time_point transactionStart;
+        std::map<std::string, uint32_t> commandTimeoutsMs;  /* From the timing profile, keyed by command name; under ioMutex */
+        uint32_t timeoutMs = TimingProfile::defaultTimeoutMs;
+        int selectedChannel = 0;  /* Output selected on the instrument, 0 when unknown */
+        static constexpr size_t maxProgramBytes = 200;  /* Longest message written at once */
+        static constexpr size_t channelReplyBytes = 256;  /* Reply buffer of readChannels() */
+        static constexpr size_t maxReadingBytes = 16;     /* One NR3 reading and its separator, e.g. +1.23456789E+00; */
+        bool statusReporting = false;  /* Status enables programmed; polls read *STB? only */
+        bool statusKnown = false;      /* A full status read since the link came up or last failed */
+        CancelToken *cancelToken = nullptr;
+        bool verbose = true;
+        /* Held by each operation from its first write to its last read, so two
+           threads never read each other's replies and close() never frees a
+           session in use. Recursive: operations are built from other ones */
+        std::recursive_mutex ioMutex;
+        std::atomic<bool> reconnectWanted{false};  /* Opened and not closed by the user; set under ioMutex */
+        bool outOfStep = false;        /* An exchange was aborted; resynchronize before the next one */
+        unsigned resyncMarker = 0;     /* Varies the marker of each resynchronization */
         std::map<std::string, std::string> psCommands =
         {
             {"writeVoltage",      "VOLT"},
@@ -47,7 +184,28 @@ class PowerSupply
             {"getMaxCurrent",   "IMAX?"},
             {"isOn",            "OUTP?"},
             {"turnOn",          "OUTP ON"},
-            {"turnOff",         "OUTP OFF"}
+            {"turnOff",         "OUTP OFF"},
+            {"identify",        "*IDN?"},
+            {"readSetpoints",   "VOLT?;:CURR?;:OUTP?"},
+            {"operationComplete", "*OPC?"},
+            {"selectChannel",   "INST:NSEL"},
+            {"enableStatus",    "*CLS;*ESE 60;:STAT:OPER:PTR 32767;:STAT:OPER:NTR 32767"},
+            {"operationEnable", "STAT:OPER:ENAB"},
+            {"questionableEnable", "STAT:QUES:ENAB"},
+            {"eventStatus",     "*ESR?"},
+            {"statusByte",      "*STB?"},
+            {"readStatus",      "OUTP?;:STAT:OPER:EVEN?;:STAT:QUES:EVEN?;*ESR?;:SYST:ERR?"},
+            {"readError",       "SYST:ERR?"},
+            {"saveState",       "*SAV"},
+            {"recallState",     "*RCL"}
         };
-        PsError sendCommand(const std::string& command, const std::string& value);
+        PsError sendCommand(const std::string& command, const std::string& value, const std::vector<std::string>& names);
+        ViStatus readResponse(char *buffer, size_t size, ViUInt32& count);
+        PsError timeExchange(const std::string& program, char *reply, size_t size, ViUInt32& replyCount, double& roundTripMs);
+        void recordFailure(ViStatus status);
+        void recordAbort(void);
+        PsError resynchronize(void);
+        static PsError failureFor(ViStatus status);
 };
+
+#endif /* DRV_POWER_SUPPLY_H */
@@ -0,0 +1,242 @@
+
+#include "endurance_runner.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    /* Sleeping alone wakes up to a scheduler tick late: sleep to this much
+       before an edge, then spin. Windows ticks every 15.6 ms by default */
+#if defined(_WIN32)
+    const std::chrono::milliseconds spinMargin(16);
+#else
+    const std::chrono::milliseconds spinMargin(2);
+#endif
+
+    void waitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        if (deadline - std::chrono::steady_clock::now() > spinMargin)
+            std::this_thread::sleep_until(deadline - spinMargin);
+        while (std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+    double millisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    std::chrono::steady_clock::duration fromMilliseconds(double milliseconds)
+    {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                   std::chrono::duration<double, std::milli>(milliseconds));
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param powerSupply Open driver; its channels must cover the outputs.
+ * @param options Outputs, timing and pass window.
+ */
+EnduranceRunner::EnduranceRunner(PowerSupply& powerSupply, const EnduranceOptions& options)
+    : powerSupply(powerSupply), options(options)
+{
+    if (this->options.outputs.empty())
+        this->options.outputs.push_back(1);
+    for (int output : this->options.outputs)
+    {
+        switchOn.push_back({output, "turnOn", ""});
+        switchOff.push_back({output, "turnOff", ""});
+    }
+    readings.assign(std::max(1, powerSupply.channels), PsChannelReading());
+}
+
+/**
+ * @brief Reads the current back to back until the next read would end after end.
+ */
+void EnduranceRunner::capture(std::chrono::steady_clock::time_point end, EnduranceCycle& cycle)
+{
+    std::vector<double> last(options.outputs.size(), 0.0);
+    PowerSupply::PsError err;
+
+    while (std::chrono::steady_clock::now() + fromMilliseconds(readEstimateMs) < end)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        /* One compound query reads every output of a multi-output supply */
+        if (powerSupply.channels > 1)
+            err = powerSupply.readChannels(readings, false);
+        else
+            err = powerSupply.readCurrent(readings[0].current);
+        if (err != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            cycle.failure = "current read failed";
+            return;
+        }
+        readEstimateMs += (millisecondsBetween(start, std::chrono::steady_clock::now()) - readEstimateMs) / 8.0;
+
+        for (size_t i = 0; i < options.outputs.size(); i++)
+        {
+            last[i] = readings[options.outputs[i] - 1].current;
+            cycle.peakCurrent = std::max(cycle.peakCurrent, last[i]);
+        }
+        cycle.samples++;
+    }
+
+    if (cycle.samples == 0)
+    {
+        cycle.failure = "no current captured";
+        return;
+    }
+    cycle.settledCurrent = *std::min_element(last.begin(), last.end());
+    for (size_t i = 0; i < options.outputs.size(); i++)
+    {
+        if (last[i] < options.minCurrent || last[i] > options.maxCurrent)
+        {
+            char reason[96];
+
+            snprintf(reason, sizeof(reason), "output %d settled at %.4f A", options.outputs[i], last[i]);
+            cycle.failure = reason;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Runs the cycles. Every output is switched off first.
+ * @param cycleDone Called after every cycle, nullptr for none.
+ */
+EnduranceReport EnduranceRunner::run(const std::function<void(const EnduranceCycle&)>& cycleDone)
+{
+    EnduranceReport report;
+    std::vector<double> onLate;
+    std::vector<double> offLate;
+    uint64_t samples = 0;
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point next;
+
+    for (int output : options.outputs)
+    {
+        if (output < 1 || output > powerSupply.channels)
+        {
+            EnduranceCycle cycle;
+            cycle.failure = "output " + std::to_string(output) + " does not exist";
+            report.failures.push_back(cycle);
+            return report;
+        }
+    }
+    powerSupply.writeChannels(switchOff);
+
+    begin = std::chrono::steady_clock::now();
+    next = begin + std::chrono::milliseconds(10);
+    for (unsigned number = 1; number <= options.cycles; number++)
+    {
+        EnduranceCycle cycle;
+        std::chrono::steady_clock::time_point offAt = next + fromMilliseconds(options.onMs);
+        std::chrono::steady_clock::time_point captureEnd = std::min(next + fromMilliseconds(options.captureMs), offAt);
+        PowerSupply::PsError err;
+
+        cycle.cycle = number;
+        waitUntil(next);
+        err = powerSupply.writeChannels(switchOn);
+        cycle.onLateMs = millisecondsBetween(next, std::chrono::steady_clock::now());
+        if (err != PowerSupply::PsError::ERR_SUCCESS)
+            cycle.failure = "switch-on failed";
+        else
+            capture(captureEnd, cycle);
+
+        waitUntil(offAt);
+        err = powerSupply.writeChannels(switchOff);
+        cycle.offLateMs = millisecondsBetween(offAt, std::chrono::steady_clock::now());
+        if (err != PowerSupply::PsError::ERR_SUCCESS && cycle.failure.empty())
+            cycle.failure = "switch-off failed";
+
+        /* A lost link fails the cycle; the next one runs on the reopened link */
+        if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+            powerSupply.reconnect();
+
+        cycle.passed = cycle.failure.empty();
+        report.cycles++;
+        if (cycle.passed)
+            report.passed++;
+        else
+        {
+            report.failed++;
+            if (report.failures.size() < maxFailuresKept)
+                report.failures.push_back(cycle);
+        }
+        onLate.push_back(cycle.onLateMs);
+        offLate.push_back(cycle.offLateMs);
+        samples += cycle.samples;
+        report.peakCurrent = std::max(report.peakCurrent, cycle.peakCurrent);
+        if (cycleDone)
+            cycleDone(cycle);
+        if (!cycle.passed && options.stopOnFailure)
+            break;
+
+        /* Late cycles do not catch up in a burst: the off time is kept */
+        next = offAt + fromMilliseconds(options.offMs);
+        if (std::chrono::steady_clock::now() > next)
+        {
+            report.overruns++;
+            next = std::chrono::steady_clock::now() + fromMilliseconds(options.offMs);
+        }
+    }
+
+    report.seconds = millisecondsBetween(begin, std::chrono::steady_clock::now()) / 1000.0;
+    report.onLate = spread(onLate);
+    report.offLate = spread(offLate);
+    report.samplesPerCycle = report.cycles ? static_cast<double>(samples) / report.cycles : 0.0;
+    return report;
+}
+
+/**
+ * @brief Mean, standard deviation, 99th percentile and maximum. Sorts the values.
+ */
+EnduranceSpread EnduranceRunner::spread(std::vector<double>& latenessMs)
+{
+    EnduranceSpread result;
+    double squares = 0.0;
+
+    if (latenessMs.empty())
+        return result;
+    std::sort(latenessMs.begin(), latenessMs.end());
+    for (double value : latenessMs)
+        result.meanMs += value;
+    result.meanMs /= latenessMs.size();
+    for (double value : latenessMs)
+        squares += (value - result.meanMs) * (value - result.meanMs);
+    result.stdDevMs = std::sqrt(squares / latenessMs.size());
+    result.p99Ms = latenessMs[std::min(latenessMs.size() - 1, latenessMs.size() * 99 / 100)];
+    result.maxMs = latenessMs.back();
+    return result;
+}
+
+void EnduranceRunner::render(const EnduranceReport& report, std::string& out)
+{
+    char line[192];
+
+    snprintf(line, sizeof(line), "cycles      %u passed, %u failed, %u overran, %.1f s\n",
+             report.passed, report.failed, report.overruns, report.seconds);
+    out += line;
+    snprintf(line, sizeof(line), "rate        %.0f cycles/hour\n", report.cyclesPerHour());
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %8s %8s %8s %8s\n", "lateness", "mean ms", "sd ms", "p99 ms", "max ms");
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %8.3f %8.3f %8.3f %8.3f\n", "switch-on",
+             report.onLate.meanMs, report.onLate.stdDevMs, report.onLate.p99Ms, report.onLate.maxMs);
+    out += line;
+    snprintf(line, sizeof(line), "%-11s %8.3f %8.3f %8.3f %8.3f\n", "switch-off",
+             report.offLate.meanMs, report.offLate.stdDevMs, report.offLate.p99Ms, report.offLate.maxMs);
+    out += line;
+    snprintf(line, sizeof(line), "capture     %.1f reads/cycle, peak %.4f A\n", report.samplesPerCycle, report.peakCurrent);
+    out += line;
+    for (const EnduranceCycle& cycle : report.failures)
+    {
+        snprintf(line, sizeof(line), "failed      cycle %u: %s\n", cycle.cycle, cycle.failure.c_str());
+        out += line;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef ENDURANCE_RUNNER_H
+#define ENDURANCE_RUNNER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "drv_power_supply.h"
+
+struct EnduranceOptions
+{
+    std::vector<int> outputs = {1};  /* Outputs switched together, numbered from 1 */
+    unsigned cycles = 1000;
+    double onMs = 1000.0;
+    double offMs = 1000.0;
+    double captureMs = 200.0;        /* Current is read back to back this long after each switch-on */
+    double minCurrent = 0.0;         /* Pass window of the last current captured, per output */
+    double maxCurrent = 1e9;
+    bool stopOnFailure = false;
+};
+
+/* One power cycle. Lateness runs from the scheduled edge to the end of the write */
+struct EnduranceCycle
+{
+    unsigned cycle = 0;
+    double onLateMs = 0.0;
+    double offLateMs = 0.0;
+    double peakCurrent = 0.0;     /* Highest current captured, over the outputs */
+    double settledCurrent = 0.0;  /* Lowest last current captured, over the outputs */
+    unsigned samples = 0;         /* Current reads of the capture */
+    bool passed = false;
+    std::string failure;          /* Why the cycle failed, empty when passed */
+};
+
+struct EnduranceSpread
+{
+    double meanMs = 0.0;
+    double stdDevMs = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+struct EnduranceReport
+{
+    unsigned cycles = 0;
+    unsigned passed = 0;
+    unsigned failed = 0;
+    unsigned overruns = 0;        /* Cycles that ended after the next one should have started */
+    double seconds = 0.0;
+    EnduranceSpread onLate;
+    EnduranceSpread offLate;
+    double samplesPerCycle = 0.0;
+    double peakCurrent = 0.0;
+    std::vector<EnduranceCycle> failures;  /* The first ones, in order */
+
+    double cyclesPerHour(void) const { return seconds > 0.0 ? cycles * 3600.0 / seconds : 0.0; }
+};
+
+/* Power-cycle endurance run of a device under test. Edges are scheduled on
+   an absolute time line, so a late edge never shifts the following ones,
+   and each is one program message switching every output at once: no
+   output query, no read back. Between the switch-on and the end of the
+   capture window the current is read back to back; a cycle passes when
+   both switches went through and the last current of every output is
+   within the pass window. */
+class EnduranceRunner
+{
+    public:
+        static constexpr size_t maxFailuresKept = 20;
+
+        EnduranceRunner(PowerSupply& powerSupply, const EnduranceOptions& options);
+
+        EnduranceReport run(const std::function<void(const EnduranceCycle&)>& cycleDone = nullptr);
+        static void render(const EnduranceReport& report, std::string& out);
+
+    private:
+        PowerSupply& powerSupply;
+        EnduranceOptions options;
+        std::vector<PsChannelCommand> switchOn;
+        std::vector<PsChannelCommand> switchOff;
+        std::vector<PsChannelReading> readings;
+        double readEstimateMs = 0.0;  /* Moving average of a current read */
+
+        void capture(std::chrono::steady_clock::time_point end, EnduranceCycle& cycle);
+        static EnduranceSpread spread(std::vector<double>& latenessMs);
+};
+
+#endif /* ENDURANCE_RUNNER_H */
@@ -0,0 +1,188 @@
+
+#include "engine_transport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    int64_t wallClockMs(void)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief Constructor. Takes over the command queue of the region.
+ * @param region Mapped region of a running engine.
+ */
+EngineTransport::EngineTransport(EngineRegion *region)
+    : region(region), token(region->attachClient())
+{
+}
+
+/**
+ * @brief Points the engine at a port. The engine keeps its session when it
+ * already has that port open, so a restarted GUI attaches without a reopen.
+ * @param port Port name, as for VisaTransport.
+ * @param baudrate Unused; the engine owns the serial settings.
+ */
+ViStatus EngineTransport::open(const std::string& port, int baudrate)
+{
+    EngineCommand command;
+    EngineReply answer;
+    ViStatus status;
+
+    (void)baudrate;
+    replySize = 0;
+    aborted = false;
+    if (port.size() >= sizeof(command.data))
+        return VI_ERROR_RSRC_NFOUND;
+    command.op = EngineOp::OPEN;
+    command.size = static_cast<uint32_t>(port.size());
+    memcpy(command.data, port.data(), port.size());
+    status = execute(command, answer);
+    opened = (status == VI_SUCCESS);
+    return status;
+}
+
+void EngineTransport::close(void)
+{
+    opened = false;
+    replySize = 0;
+}
+
+/**
+ * @brief Tells whether the engine is alive and its instrument link is up.
+ */
+bool EngineTransport::isOpen(void) const
+{
+    EngineState state;
+
+    if (!opened || !region->engineAlive(wallClockMs()))
+        return false;
+    return region->state.load(state) && state.linkUp;
+}
+
+/**
+ * @brief Sends a program message through the engine.
+ * A message holding a query is answered in the same command; the answer is
+ * returned by the next read.
+ */
+ViStatus EngineTransport::write(const char *data, size_t size)
+{
+    EngineCommand command;
+    EngineReply answer;
+    ViStatus status;
+
+    if (!opened)
+        return VI_ERROR_CONN_LOST;
+    if (aborted)
+        return VI_ERROR_ABORT;
+    if (size > sizeof(command.data))
+        return VI_ERROR_INV_PARAMETER;
+
+    command.op = EngineOp::WRITE;
+    command.size = static_cast<uint32_t>(size);
+    command.expectReply = memchr(data, '?', size) != nullptr;
+    memcpy(command.data, data, size);
+
+    /* A new query discards an unread answer, like the instrument's output queue */
+    replySize = 0;
+    status = execute(command, answer);
+    if (status == VI_SUCCESS && command.expectReply)
+    {
+        replySize = std::min<size_t>(answer.size, sizeof(reply));
+        memcpy(reply, answer.data, replySize);
+    }
+    return status;
+}
+
+ViStatus EngineTransport::read(char *buffer, size_t size, ViUInt32& count)
+{
+    count = 0;
+    if (!opened)
+        return VI_ERROR_CONN_LOST;
+    if (aborted)
+        return VI_ERROR_ABORT;
+    if (replySize == 0)
+        return VI_ERROR_TMO;
+
+    count = static_cast<ViUInt32>(std::min(size, replySize));
+    memcpy(buffer, reply, count);
+    replySize = 0;
+    return count == size && reply[count - 1] != '\n' ? VI_SUCCESS_MAX_CNT : VI_SUCCESS;
+}
+
+ViStatus EngineTransport::clear(void)
+{
+    EngineCommand command;
+    EngineReply answer;
+
+    replySize = 0;
+    aborted = false;
+    command.op = EngineOp::CLEAR;
+    return execute(command, answer);
+}
+
+/**
+ * @brief Sets how long a command waits for the engine.
+ * The engine reads the instrument with its own timeouts; this one bounds
+ * the wait here, doubled because a command may queue behind a sample.
+ */
+ViStatus EngineTransport::setTimeout(uint32_t milliseconds)
+{
+    timeoutMs = milliseconds;
+    return VI_SUCCESS;
+}
+
+/**
+ * @brief Stops waiting for the engine. The engine still finishes the
+ * command; its late answer is dropped by its id.
+ */
+ViStatus EngineTransport::abort(void)
+{
+    aborted = true;
+    return VI_SUCCESS;
+}
+
+/**
+ * @brief Changes a setting of the engine: sample time, status watch or protection.
+ * @param op Setting, one of the configuration operations.
+ * @param value New value.
+ */
+ViStatus EngineTransport::configure(EngineOp op, double value)
+{
+    EngineCommand command;
+    EngineReply answer;
+
+    command.op = op;
+    command.value = value;
+    return execute(command, answer);
+}
+
+/**
+ * @brief Queues a command and waits for its answer.
+ * Fails at once when the engine is gone or another client took the queue
+ * over; a command answered after the deadline is dropped by its id.
+ */
+ViStatus EngineTransport::execute(EngineCommand& command, EngineReply& answer)
+{
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(2 * timeoutMs + 500);
+
+    if (!region->engineAlive(wallClockMs()) || !region->submit(token, command))
+        return VI_ERROR_CONN_LOST;
+
+    while (!region->replyFor(command.id, answer))
+    {
+        if (aborted)
+            return VI_ERROR_ABORT;
+        if (std::chrono::steady_clock::now() > deadline)
+            return VI_ERROR_TMO;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return static_cast<ViStatus>(answer.status);
+}
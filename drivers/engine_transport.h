@@ -0,0 +1,44 @@
+#ifndef ENGINE_TRANSPORT_H
+#define ENGINE_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "transport.h"
+#include "engine_region.h"
+
+/* Transport to the instrument of an engine process, through the command
+   queue of its shared region. Every write is one command; the engine writes
+   it to the instrument and, when it holds a query, reads the reply in the
+   same turn, so the engine's own sampling never lands between a query and
+   its answer. The answer waits here until it is read, as on the instrument.
+   Closing only detaches: the engine keeps the port and keeps sampling. */
+class EngineTransport : public Transport
+{
+    public:
+        explicit EngineTransport(EngineRegion *region);
+
+        ViStatus open(const std::string& port, int baudrate) override;
+        void close(void) override;
+        bool isOpen(void) const override;
+        ViStatus write(const char *data, size_t size) override;
+        ViStatus read(char *buffer, size_t size, ViUInt32& count) override;
+        ViStatus clear(void) override;
+        ViStatus setTimeout(uint32_t milliseconds) override;
+        ViStatus abort(void) override;
+        ViStatus configure(EngineOp op, double value);
+
+    private:
+        EngineRegion *region;
+        uint64_t token;           /* Ownership of the command queue */
+        bool opened = false;
+        std::atomic<bool> aborted{false};
+        uint32_t timeoutMs = 2000;
+        size_t replySize = 0;
+        char reply[engineMessageBytes];
+
+        ViStatus execute(EngineCommand& command, EngineReply& answer);
+};
+
+#endif /* ENGINE_TRANSPORT_H */
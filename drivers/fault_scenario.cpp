@@ -0,0 +1,132 @@
+
+#include "fault_scenario.h"
+#include "drv_power_supply.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Constructor.
+ * @param port Port of the instrument under test.
+ * @param factory Creates the inner transport of each run.
+ */
+FaultScenario::FaultScenario(const std::string& port, const TransportFactory& factory)
+    : port(port), factory(factory)
+{
+}
+
+/**
+ * @brief Reads the current back to back through one fault profile.
+ * @param profile Faults to inject.
+ * @param seconds Duration of the run.
+ * @param seed Seed of the fault sequence.
+ * @return Goodput and recovery figures of the run.
+ */
+FaultScenarioResult FaultScenario::run(const FaultProfile& profile, double seconds, uint64_t seed)
+{
+    using Clock = std::chrono::steady_clock;
+    FaultScenarioResult result;
+    FaultInjectingTransport *faulty = new FaultInjectingTransport(factory(), profile, seed);
+    PowerSupply powerSupply(port, std::unique_ptr<Transport>(faulty));
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::microseconds(static_cast<int64_t>(seconds * 1e6));
+    Clock::time_point outageStart;
+    bool inOutage = false;
+    double current = 0.0;
+
+    result.profile = profile.name;
+    while (Clock::now() < end)
+    {
+        Clock::time_point exchangeStart = Clock::now();
+        PowerSupply::PsError err = PowerSupply::PsError::ERR_DEVICE_NOT_CONNECTED;
+
+        if (powerSupply.isOpen() == PowerSupply::PsError::ERR_SUCCESS)
+            err = powerSupply.readCurrent(current);
+        result.exchanges++;
+
+        if (err == PowerSupply::PsError::ERR_SUCCESS)
+        {
+            result.good++;
+            if (inOutage)
+            {
+                double recoveryMs = std::chrono::duration<double, std::milli>(Clock::now() - outageStart).count();
+                result.outages++;
+                result.totalRecoveryMs += recoveryMs;
+                result.maxRecoveryMs = std::max(result.maxRecoveryMs, recoveryMs);
+                inOutage = false;
+            }
+            continue;
+        }
+
+        result.failed++;
+        if (!inOutage)
+        {
+            outageStart = exchangeStart;
+            inOutage = true;
+        }
+
+        /* Same recovery as the sampler: reopen a lost link, back off while it stays down */
+        if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            if (powerSupply.reconnect() == PowerSupply::PsError::ERR_SUCCESS)
+                result.reconnects++;
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.unrecovered = inOutage ? 1 : 0;
+    result.faults = faulty->counters();
+    return result;
+}
+
+/**
+ * @brief Runs every profile in turn with the same seed.
+ * @param profiles Profiles to run.
+ * @param seconds Duration of each run.
+ * @param seed Seed of the fault sequences.
+ * @return One result per profile.
+ */
+std::vector<FaultScenarioResult> FaultScenario::runAll(const std::vector<FaultProfile>& profiles, double seconds, uint64_t seed)
+{
+    std::vector<FaultScenarioResult> results;
+
+    for (const FaultProfile& profile : profiles)
+    {
+        std::cout << "Power Supply: Fault scenario " << profile.name << std::endl;
+        results.push_back(run(profile, seconds, seed));
+    }
+    return results;
+}
+
+/**
+ * @brief Formats the results as a table, the clean profile being the baseline.
+ * @param results Results of runAll.
+ * @param out Appended with the table.
+ */
+void FaultScenario::render(const std::vector<FaultScenarioResult>& results, std::string& out)
+{
+    char line[256];
+    double baseline = results.empty() ? 0.0 : results.front().goodput();
+
+    snprintf(line, sizeof(line), "%-20s %9s %9s %8s %8s %8s %11s %11s %10s\n",
+             "profile", "reads", "good", "goodput", "vs base", "outages", "mean rec ms", "max rec ms", "reconnects");
+    out += line;
+    for (const FaultScenarioResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-20s %9llu %9llu %8.1f %7.0f%% %8llu %11.1f %11.1f %10llu%s\n",
+                 result.profile.c_str(),
+                 static_cast<unsigned long long>(result.exchanges),
+                 static_cast<unsigned long long>(result.good),
+                 result.goodput(),
+                 baseline > 0.0 ? 100.0 * result.goodput() / baseline : 0.0,
+                 static_cast<unsigned long long>(result.outages),
+                 result.meanRecoveryMs(),
+                 result.maxRecoveryMs,
+                 static_cast<unsigned long long>(result.reconnects),
+                 result.unrecovered ? " (ended in outage)" : "");
+        out += line;
+    }
+}
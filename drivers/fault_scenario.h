@@ -0,0 +1,51 @@
+#ifndef FAULT_SCENARIO_H
+#define FAULT_SCENARIO_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "fault_transport.h"
+
+/* Outcome of driving the sampler's read loop through one fault profile */
+struct FaultScenarioResult
+{
+    std::string profile;
+    double seconds = 0.0;
+    uint64_t exchanges = 0;       /* Current reads attempted */
+    uint64_t good = 0;            /* Reads that returned a value */
+    uint64_t failed = 0;
+    uint64_t reconnects = 0;
+    uint64_t outages = 0;         /* Runs of failed reads that ended with a good one */
+    uint64_t unrecovered = 0;     /* Outage still open at the end of the run */
+    double totalRecoveryMs = 0.0; /* First failed read to the next good one, summed */
+    double maxRecoveryMs = 0.0;
+    FaultCounters faults;
+
+    double goodput(void) const { return seconds > 0.0 ? good / seconds : 0.0; }
+    double meanRecoveryMs(void) const { return outages ? totalRecoveryMs / outages : 0.0; }
+};
+
+/* Resilience benchmark. Each profile wraps a fresh inner transport in a
+   FaultInjectingTransport, then reads the current back to back for a fixed
+   time the way the sampler does, reconnecting when the link is lost.
+   Goodput is successful reads per second; recovery time runs from the
+   first failed read of an outage to the next successful one. */
+class FaultScenario
+{
+    public:
+        using TransportFactory = std::function<std::unique_ptr<Transport>(void)>;
+
+        FaultScenario(const std::string& port, const TransportFactory& factory);
+
+        FaultScenarioResult run(const FaultProfile& profile, double seconds, uint64_t seed);
+        std::vector<FaultScenarioResult> runAll(const std::vector<FaultProfile>& profiles, double seconds, uint64_t seed);
+        static void render(const std::vector<FaultScenarioResult>& results, std::string& out);
+
+    private:
+        std::string port;
+        TransportFactory factory;
+};
+
+#endif /* FAULT_SCENARIO_H */
@@ -0,0 +1,279 @@
+
+#include "fault_transport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+/**
+ * @brief Fault profiles of the link problems seen in the lab.
+ */
+const std::vector<FaultProfile>& FaultProfile::standardProfiles(void)
+{
+    static const std::vector<FaultProfile> profiles = [] {
+        std::vector<FaultProfile> list;
+        FaultProfile profile;
+
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "jitter";
+        profile.latencyModel = LatencyModel::LOGNORMAL;
+        profile.latencyMs = 15.0;
+        profile.jitterMs = 30.0;
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "garbled";
+        profile.corruptByteRate = 0.01;
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "dropped-terminator";
+        profile.dropTerminatorRate = 0.05;
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "partial-reply";
+        profile.truncateRate = 0.05;
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "stall";
+        profile.stallRate = 0.02;
+        profile.stallMs = 3000.0;
+        list.push_back(profile);
+
+        profile = FaultProfile();
+        profile.name = "unplug";
+        profile.disconnectRate = 0.005;
+        profile.disconnectMs = 3000.0;
+        list.push_back(profile);
+        return list;
+    }();
+    return profiles;
+}
+
+/**
+ * @brief Constructor.
+ * @param inner Transport carrying the real exchanges.
+ * @param profile Faults to inject.
+ * @param seed Seed of the fault sequence.
+ */
+FaultInjectingTransport::FaultInjectingTransport(std::unique_ptr<Transport> inner, const FaultProfile& profile, uint64_t seed)
+    : inner(std::move(inner)), faults(profile), random(seed)
+{
+}
+
+bool FaultInjectingTransport::chance(double probability)
+{
+    if (probability <= 0.0)
+        return false;
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random) < probability;
+}
+
+/**
+ * @brief Sleeps in slices of at most 1 ms, so that abort() ends the wait.
+ * @return False when aborted.
+ */
+bool FaultInjectingTransport::delay(double milliseconds)
+{
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() +
+        std::chrono::microseconds(static_cast<int64_t>(std::max(0.0, milliseconds) * 1000.0));
+    std::chrono::steady_clock::time_point now;
+
+    while (!aborted && (now = std::chrono::steady_clock::now()) < end)
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(end - now, std::chrono::milliseconds(1)));
+    return !aborted;
+}
+
+/**
+ * @brief Sleeps for one draw of the latency distribution.
+ * @return False when aborted.
+ */
+bool FaultInjectingTransport::injectLatency(void)
+{
+    double latency = faults.latencyMs;
+
+    switch (faults.latencyModel)
+    {
+        case LatencyModel::FIXED:
+            break;
+        case LatencyModel::UNIFORM:
+            latency = std::uniform_real_distribution<double>(faults.latencyMs - faults.jitterMs,
+                                                             faults.latencyMs + faults.jitterMs)(random);
+            break;
+        case LatencyModel::NORMAL:
+            if (faults.jitterMs > 0.0)
+                latency = std::normal_distribution<double>(faults.latencyMs, faults.jitterMs)(random);
+            break;
+        case LatencyModel::LOGNORMAL:
+            if (faults.latencyMs > 0.0)
+                latency = std::lognormal_distribution<double>(std::log(faults.latencyMs),
+                                                              std::log1p(faults.jitterMs / faults.latencyMs))(random);
+            break;
+    }
+    return delay(std::max(0.0, latency));
+}
+
+/**
+ * @brief Brings the link back once an injected unplug is over.
+ * @return False while the link is down.
+ */
+bool FaultInjectingTransport::checkLink(void)
+{
+    if (linkDown && std::chrono::steady_clock::now() >= linkDownUntil)
+        linkDown = false;
+    return !linkDown;
+}
+
+ViStatus FaultInjectingTransport::open(const std::string& port, int baudrate)
+{
+    if (!checkLink())
+        return VI_ERROR_RSRC_NFOUND;
+    carry.clear();
+    aborted = false;
+    return inner->open(port, baudrate);
+}
+
+void FaultInjectingTransport::close(void)
+{
+    carry.clear();
+    inner->close();
+}
+
+bool FaultInjectingTransport::isOpen(void) const
+{
+    return inner->isOpen();
+}
+
+ViStatus FaultInjectingTransport::write(const char *data, size_t size)
+{
+    injected.writes++;
+    if (!checkLink())
+        return VI_ERROR_CONN_LOST;
+
+    /* Unplug: the session dies with the link and must be reopened */
+    if (chance(faults.disconnectRate))
+    {
+        injected.disconnects++;
+        linkDown = true;
+        linkDownUntil = std::chrono::steady_clock::now() +
+                        std::chrono::microseconds(static_cast<int64_t>(faults.disconnectMs * 1000.0));
+        inner->close();
+        carry.clear();
+        return VI_ERROR_CONN_LOST;
+    }
+
+    if (!injectLatency())
+        return VI_ERROR_ABORT;
+    return inner->write(data, size);
+}
+
+ViStatus FaultInjectingTransport::read(char *buffer, size_t size, ViUInt32& count)
+{
+    std::vector<char> reply(size);
+    ViUInt32 replyCount = 0;
+    ViStatus status;
+    std::string line;
+    size_t end;
+
+    count = 0;
+    injected.reads++;
+    if (!checkLink())
+        return VI_ERROR_CONN_LOST;
+    if (!injectLatency())
+        return VI_ERROR_ABORT;
+
+    /* Queue the inner reply behind anything held back from earlier reads */
+    status = inner->read(reply.data(), size, replyCount);
+    if (status < VI_SUCCESS)
+        return status;
+    carry.append(reply.data(), replyCount);
+    if (replyCount == 0 || reply[replyCount - 1] != '\n')
+        carry.push_back('\n');
+
+    /* Late reply: the read gives up, the bytes stay for the next one */
+    if (chance(faults.stallRate))
+    {
+        injected.stalls++;
+        if (faults.stallMs >= faults.readTimeoutMs)
+            return delay(faults.readTimeoutMs) ? VI_ERROR_TMO : VI_ERROR_ABORT;
+        if (!delay(faults.stallMs))
+            return VI_ERROR_ABORT;
+    }
+
+    end = carry.find('\n');
+    line = carry.substr(0, end + 1);
+    carry.erase(0, end + 1);
+
+    if (line.size() > 1 && chance(faults.truncateRate))
+    {
+        /* Partial reply: the tail arrives in front of the next reply */
+        size_t cut = std::uniform_int_distribution<size_t>(1, line.size() - 1)(random);
+        injected.truncatedReplies++;
+        carry.insert(0, line.substr(cut));
+        line.resize(cut);
+        status = VI_ERROR_TMO;
+    }
+    else if (chance(faults.dropTerminatorRate))
+    {
+        injected.droppedTerminators++;
+        line.pop_back();
+        status = VI_ERROR_TMO;
+    }
+
+    for (char& byte : line)
+    {
+        if (chance(faults.corruptByteRate))
+        {
+            injected.corruptedBytes++;
+            byte ^= static_cast<char>(1u << std::uniform_int_distribution<int>(0, 7)(random));
+        }
+    }
+
+    /* A read without terminator only ends with the timeout */
+    if (status >= VI_SUCCESS && (line.empty() || line.back() != '\n'))
+        status = VI_ERROR_TMO;
+    if (status == VI_ERROR_TMO && !delay(faults.readTimeoutMs))
+        status = VI_ERROR_ABORT;
+
+    count = static_cast<ViUInt32>(std::min(line.size(), size));
+    memcpy(buffer, line.data(), count);
+    return status;
+}
+
+ViStatus FaultInjectingTransport::clear(void)
+{
+    carry.clear();
+    aborted = false;
+    if (!checkLink())
+        return VI_ERROR_CONN_LOST;
+    return inner->isOpen() ? inner->clear() : VI_SUCCESS;
+}
+
+ViStatus FaultInjectingTransport::setTimeout(uint32_t milliseconds)
+{
+    /* Missing terminators and stalls now give up after the new timeout */
+    faults.readTimeoutMs = milliseconds;
+    return inner->setTimeout(milliseconds);
+}
+
+/**
+ * @brief Ends an injected wait at once; the read returns VI_ERROR_ABORT and
+ * a late reply stays held back, as a real one would arrive after the abort.
+ */
+ViStatus FaultInjectingTransport::abort(void)
+{
+    aborted = true;
+    return inner->abort();
+}
+
+ViStatus FaultInjectingTransport::deviceClear(void)
+{
+    carry.clear();
+    aborted = false;
+    if (!checkLink())
+        return VI_ERROR_CONN_LOST;
+    return inner->isOpen() ? inner->deviceClear() : VI_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#ifndef FAULT_TRANSPORT_H
+#define FAULT_TRANSPORT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "transport.h"
+
+enum class LatencyModel
+{
+    FIXED = 0,   /* Always latencyMs */
+    UNIFORM,     /* latencyMs +/- jitterMs */
+    NORMAL,      /* Mean latencyMs, standard deviation jitterMs, clamped at 0 */
+    LOGNORMAL    /* Median latencyMs, long tail scaled by jitterMs */
+};
+
+/* Faults injected around an inner transport. Rates are probabilities per
+   reply (terminator, truncation), per read (stall), per byte (corruption)
+   or per exchange (disconnect) */
+struct FaultProfile
+{
+    std::string name = "clean";
+    LatencyModel latencyModel = LatencyModel::FIXED;
+    double latencyMs = 0.0;           /* Added to every write and read */
+    double jitterMs = 0.0;
+    double corruptByteRate = 0.0;     /* One random bit flipped in the byte */
+    double dropTerminatorRate = 0.0;  /* The reply loses its line feed and the read times out */
+    double truncateRate = 0.0;        /* The reply is split; the rest arrives with the next read */
+    double stallRate = 0.0;           /* The reply is late by stallMs */
+    double stallMs = 0.0;
+    double disconnectRate = 0.0;      /* The link drops for disconnectMs */
+    double disconnectMs = 0.0;
+    double readTimeoutMs = 2000.0;    /* Time a read waits for a missing terminator */
+
+    static const std::vector<FaultProfile>& standardProfiles(void);
+};
+
+struct FaultCounters
+{
+    uint64_t writes = 0;
+    uint64_t reads = 0;
+    uint64_t corruptedBytes = 0;
+    uint64_t droppedTerminators = 0;
+    uint64_t truncatedReplies = 0;
+    uint64_t stalls = 0;
+    uint64_t disconnects = 0;
+};
+
+/* Transport decorator injecting link faults with a reproducible seed.
+   Every random decision draws from one generator seeded at construction,
+   so a profile and a seed replay the same fault sequence against the same
+   exchange sequence. */
+class FaultInjectingTransport : public Transport
+{
+    public:
+        FaultInjectingTransport(std::unique_ptr<Transport> inner, const FaultProfile& profile, uint64_t seed);
+
+        ViStatus open(const std::string& port, int baudrate) override;
+        void close(void) override;
+        bool isOpen(void) const override;
+        ViStatus write(const char *data, size_t size) override;
+        ViStatus read(char *buffer, size_t size, ViUInt32& count) override;
+        ViStatus clear(void) override;
+        ViStatus setTimeout(uint32_t milliseconds) override;
+        ViStatus abort(void) override;
+        ViStatus deviceClear(void) override;
+
+        const FaultProfile& profile(void) const { return faults; }
+        const FaultCounters& counters(void) const { return injected; }
+
+    private:
+        std::unique_ptr<Transport> inner;
+        FaultProfile faults;
+        FaultCounters injected;
+        std::mt19937_64 random;
+        std::string carry;  /* Reply bytes held back for the next read */
+        std::chrono::steady_clock::time_point linkDownUntil;
+        bool linkDown = false;
+        std::atomic<bool> aborted{false};
+
+        bool chance(double probability);
+        bool delay(double milliseconds);
+        bool injectLatency(void);
+        bool checkLink(void);
+};
+
+#endif /* FAULT_TRANSPORT_H */
@@ -0,0 +1,191 @@
+
+#include "link_budget.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+    const char* trafficName(LinkTraffic traffic)
+    {
+        switch (traffic)
+        {
+            case LinkTraffic::TELEMETRY: return "telemetry";
+            case LinkTraffic::STATUS:    return "status";
+            case LinkTraffic::CONTROL:   return "control";
+        }
+        return "";
+    }
+}
+
+/**
+ * @brief Highest rate of a scheduled command that keeps its traffic class in budget,
+ * the other commands of the class keeping their planned rates.
+ * @param name Driver command name.
+ * @return Rate per second, 0 for unknown or control commands.
+ */
+double LinkPlan::maxRate(const std::string& name) const
+{
+    const PlannedCommand *own = nullptr;
+    double budget;
+    double others = 0.0;
+
+    for (const PlannedCommand& planned : commands)
+    {
+        if (planned.command.name == name && planned.command.traffic != LinkTraffic::CONTROL)
+            own = &planned;
+    }
+    if (own == nullptr || own->costMs() <= 0.0)
+        return 0.0;
+
+    budget = own->command.traffic == LinkTraffic::TELEMETRY ? telemetryBudget : statusBudget;
+    for (const PlannedCommand& planned : commands)
+    {
+        if (&planned != own && planned.command.traffic == own->command.traffic)
+            others += planned.load();
+    }
+    return std::max(0.0, budget - others) * 1000.0 / own->costMs();
+}
+
+/**
+ * @brief Formats the plan as a table.
+ * @param out Appended with the table.
+ */
+void LinkPlan::render(std::string& out) const
+{
+    char line[192];
+
+    snprintf(line, sizeof(line), "%-16s %-9s %7s %7s %9s %9s %9s %6s\n",
+             "command", "traffic", "wire ms", "proc ms", "requested", "planned", "max safe", "load");
+    out += line;
+    for (const PlannedCommand& planned : commands)
+    {
+        snprintf(line, sizeof(line), "%-16s %-9s %7.2f %7.2f %9.2f %9.2f %9.2f %5.1f%%\n",
+                 planned.command.name.c_str(), trafficName(planned.command.traffic), planned.wireMs,
+                 planned.processingMs, planned.command.ratePerSecond, planned.plannedRate,
+                 maxRate(planned.command.name), 100.0 * planned.load());
+        out += line;
+    }
+    snprintf(line, sizeof(line), "telemetry %.1f%%, status %.1f%%, control reserve %.1f%%, worst control delay %.1f ms%s%s\n",
+             100.0 * telemetryLoad, 100.0 * statusLoad, 100.0 * controlReserve, worstControlDelayMs,
+             reason.empty() ? "" : ": ", reason.c_str());
+    out += line;
+}
+
+/**
+ * @brief Constructor.
+ * @param framing Serial framing of the link.
+ * @param profile Timing profile of the model; empty when unknown.
+ * @param policy Shares of the link time.
+ */
+LinkBudgetPlanner::LinkBudgetPlanner(const LinkFraming& framing, const TimingProfile& profile, const LinkBudgetPolicy& policy)
+    : framing(framing), profile(profile), policy(policy)
+{
+}
+
+/**
+ * @brief Time the bytes take on the line.
+ * @param bytes Characters sent or received.
+ */
+double LinkBudgetPlanner::wireMs(size_t bytes) const
+{
+    return framing.baudrate > 0 ? bytes * framing.bitsPerByte() * 1000.0 / framing.baudrate : 0.0;
+}
+
+/**
+ * @brief Instrument time of a command: the 99th percentile of its profile, or
+ * the policy default for commands the profile does not know.
+ * @param name Driver command name.
+ */
+double LinkBudgetPlanner::processingMs(const std::string& name) const
+{
+    const CommandTiming *timing = profile.find(name);
+
+    if (timing == nullptr || timing->samples == 0)
+        return policy.defaultProcessingMs;
+    return timing->processingP99Ms;
+}
+
+/**
+ * @brief Checks a schedule against the budget.
+ * Status polls may use up to statusShare of the link, telemetry what is
+ * left of maxUtilization after the control reserve and the status polls.
+ * A class over its budget has all its rates scaled by the same factor, or
+ * rejects the plan when the policy does not allow scaling back.
+ * @param schedule Commands with their requested rates.
+ * @return The plan; when rejected the planned rates are the requested ones.
+ */
+LinkPlan LinkBudgetPlanner::plan(const std::vector<ScheduledCommand>& schedule) const
+{
+    LinkPlan plan;
+    double requestedTelemetry = 0.0;
+    double requestedStatus = 0.0;
+    double longestScheduledMs = 0.0;
+    double longestControlMs = 0.0;
+    double usable = std::max(0.0, policy.maxUtilization - policy.controlReserve);
+    char reason[128];
+
+    for (const ScheduledCommand& command : schedule)
+    {
+        PlannedCommand planned;
+
+        planned.command = command;
+        planned.wireMs = wireMs(command.commandBytes + command.replyBytes);
+        if (command.parts.empty())
+            planned.processingMs = processingMs(command.name);
+        for (const std::string& part : command.parts)
+            planned.processingMs += processingMs(part);
+        planned.plannedRate = command.traffic == LinkTraffic::CONTROL ? 0.0 : std::max(0.0, command.ratePerSecond);
+        if (command.traffic == LinkTraffic::TELEMETRY)
+            requestedTelemetry += planned.load();
+        else if (command.traffic == LinkTraffic::STATUS)
+            requestedStatus += planned.load();
+
+        if (command.traffic == LinkTraffic::CONTROL)
+            longestControlMs = std::max(longestControlMs, planned.costMs());
+        else if (planned.plannedRate > 0.0)
+            longestScheduledMs = std::max(longestScheduledMs, planned.costMs());
+        plan.commands.push_back(planned);
+    }
+
+    plan.controlReserve = policy.controlReserve;
+    plan.statusBudget = std::min(policy.statusShare, usable);
+    if (requestedStatus > plan.statusBudget)
+    {
+        snprintf(reason, sizeof(reason), "status polls need %.1f%% of the link, budget %.1f%%",
+                 100.0 * requestedStatus, 100.0 * plan.statusBudget);
+        plan.reason = reason;
+        plan.accepted = policy.scaleBack;
+        plan.statusScale = plan.statusBudget / requestedStatus;
+    }
+
+    plan.telemetryBudget = std::max(0.0, usable - requestedStatus * plan.statusScale);
+    if (requestedTelemetry > plan.telemetryBudget)
+    {
+        snprintf(reason, sizeof(reason), "%stelemetry needs %.1f%% of the link, budget %.1f%%",
+                 plan.reason.empty() ? "" : "; ", 100.0 * requestedTelemetry, 100.0 * plan.telemetryBudget);
+        plan.reason += reason;
+        plan.accepted = plan.accepted && policy.scaleBack;
+        plan.telemetryScale = plan.telemetryBudget / requestedTelemetry;
+    }
+
+    if (plan.accepted)
+    {
+        for (PlannedCommand& planned : plan.commands)
+        {
+            if (planned.command.traffic == LinkTraffic::TELEMETRY)
+                planned.plannedRate *= plan.telemetryScale;
+            else if (planned.command.traffic == LinkTraffic::STATUS)
+                planned.plannedRate *= plan.statusScale;
+        }
+    }
+
+    for (const PlannedCommand& planned : plan.commands)
+    {
+        if (planned.command.traffic == LinkTraffic::TELEMETRY)
+            plan.telemetryLoad += planned.load();
+        else if (planned.command.traffic == LinkTraffic::STATUS)
+            plan.statusLoad += planned.load();
+    }
+    plan.worstControlDelayMs = longestScheduledMs + longestControlMs;
+    return plan;
+}
@@ -0,0 +1,96 @@
+#ifndef LINK_BUDGET_H
+#define LINK_BUDGET_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "timing_profile.h"
+
+enum class LinkTraffic
+{
+    TELEMETRY = 0,  /* Periodic readings */
+    STATUS,         /* Periodic state and error polls */
+    CONTROL         /* User writes; not scheduled, served from the reserve */
+};
+
+/* Serial character framing: start bit, data bits, parity bit, stop bits */
+struct LinkFraming
+{
+    int baudrate = 9600;
+    int dataBits = 8;
+    int parityBits = 0;
+    int stopBits = 1;
+
+    double bitsPerByte(void) const { return 1.0 + dataBits + parityBits + stopBits; }
+};
+
+struct ScheduledCommand
+{
+    std::string name;            /* Driver command name, looked up in the timing profile */
+    std::vector<std::string> parts;  /* Commands of a compound program, timed as their sum; empty for one command */
+    LinkTraffic traffic = LinkTraffic::TELEMETRY;
+    size_t commandBytes = 0;     /* Including the terminator */
+    size_t replyBytes = 0;       /* Including the terminator, 0 for writes */
+    double ratePerSecond = 0.0;  /* Requested rate; ignored for control traffic */
+};
+
+/* Shares of the link time. Telemetry gets what is left of maxUtilization
+   after the control reserve and the status polls */
+struct LinkBudgetPolicy
+{
+    double maxUtilization = 0.8;      /* Slack for retries and timing jitter */
+    double controlReserve = 0.2;      /* Kept free for user writes */
+    double statusShare = 0.1;         /* Ceiling of the status polls */
+    double defaultProcessingMs = 10.0;  /* Instrument time of commands without a profile */
+    bool scaleBack = true;            /* Lower the rates of an over-budget class instead of rejecting */
+};
+
+struct PlannedCommand
+{
+    ScheduledCommand command;
+    double wireMs = 0.0;
+    double processingMs = 0.0;
+    double plannedRate = 0.0;
+
+    double costMs(void) const { return wireMs + processingMs; }
+    double load(void) const { return costMs() * plannedRate / 1000.0; }
+};
+
+struct LinkPlan
+{
+    bool accepted = true;
+    std::string reason;                  /* Why rates were scaled back or rejected */
+    double telemetryScale = 1.0;         /* Planned over requested rate */
+    double statusScale = 1.0;
+    double telemetryLoad = 0.0;          /* Fractions of the link time */
+    double statusLoad = 0.0;
+    double controlReserve = 0.0;
+    double telemetryBudget = 0.0;
+    double statusBudget = 0.0;
+    double worstControlDelayMs = 0.0;    /* A write queued behind the longest scheduled exchange */
+    std::vector<PlannedCommand> commands;
+
+    double utilization(void) const { return telemetryLoad + statusLoad; }
+    double maxRate(const std::string& name) const;
+    void render(std::string& out) const;
+};
+
+/* Link budget of one instrument: the wire cost of every scheduled command
+   and reply from the framing and byte counts, plus the instrument time from
+   the model's timing profile, checked against the shares of the policy */
+class LinkBudgetPlanner
+{
+    public:
+        LinkBudgetPlanner(const LinkFraming& framing, const TimingProfile& profile, const LinkBudgetPolicy& policy);
+
+        double wireMs(size_t bytes) const;
+        double processingMs(const std::string& name) const;
+        LinkPlan plan(const std::vector<ScheduledCommand>& schedule) const;
+
+    private:
+        LinkFraming framing;
+        TimingProfile profile;
+        LinkBudgetPolicy policy;
+};
+
+#endif /* LINK_BUDGET_H */
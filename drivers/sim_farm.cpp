@@ -0,0 +1,254 @@
+
+#include "sim_farm.h"
+#include "drv_power_supply.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int latencyBuckets = 128;  /* Quarter octaves of microseconds */
+
+    int latencyBucket(double latencyUs)
+    {
+        return std::min(latencyBuckets - 1, static_cast<int>(4.0 * std::log2(latencyUs + 1.0)));
+    }
+
+    double bucketUpperUs(int bucket)
+    {
+        return std::exp2((bucket + 1) / 4.0) - 1.0;
+    }
+
+    /* Swallows the driver's per-command log while keeping its formatting cost,
+       which is what a GUI build without a console pays */
+    class NullBuffer : public std::streambuf
+    {
+        protected:
+            int overflow(int c) override { return c == EOF ? 0 : c; }
+    };
+
+    struct PollerStats
+    {
+        uint64_t reads = 0;
+        uint64_t failures = 0;
+        double latencySumUs = 0.0;
+        double maxSweepMs = 0.0;
+        uint64_t latency[latencyBuckets] = {};
+    };
+}
+
+/**
+ * @brief Constructor. Spreads the load models over the instruments.
+ * @param devices Number of instruments.
+ * @param seed Seed of the loads and of the reading noise.
+ */
+SimFarm::SimFarm(size_t devices, uint64_t seed)
+{
+    std::mt19937_64 random(seed);
+
+    instruments.reserve(devices);
+    for (size_t i = 0; i < devices; i++)
+    {
+        SimLoad load;
+
+        switch (i % 4)
+        {
+            case 0:
+                load.model = SimLoadModel::RESISTIVE;
+                load.ohms = std::uniform_real_distribution<double>(2.0, 50.0)(random);
+                break;
+            case 1:
+                load.model = SimLoadModel::CONSTANT_CURRENT;
+                load.amps = std::uniform_real_distribution<double>(0.05, 0.9)(random);
+                break;
+            case 2:
+                load.model = SimLoadModel::PULSED;
+                load.amps = std::uniform_real_distribution<double>(0.1, 0.9)(random);
+                load.periodMs = std::uniform_real_distribution<double>(100.0, 5000.0)(random);
+                load.duty = std::uniform_real_distribution<double>(0.1, 0.9)(random);
+                break;
+            default:
+                load.model = SimLoadModel::OPEN;
+                break;
+        }
+        instruments.push_back(std::make_shared<SimInstrument>(load, random(), static_cast<uint32_t>(i + 1)));
+    }
+}
+
+/**
+ * @brief Creates a transport to one instrument.
+ * @param index Instrument index.
+ * @return Transport to hand to a PowerSupply.
+ */
+std::unique_ptr<Transport> SimFarm::connect(size_t index)
+{
+    return std::unique_ptr<Transport>(new SimulatedTransport(instruments[index]));
+}
+
+/**
+ * @brief Constructor.
+ * @param pollers Poller threads; each reads a fixed share of the devices.
+ * @param seed Seed of the farm.
+ */
+FarmBenchmark::FarmBenchmark(unsigned pollers, uint64_t seed)
+    : pollers(std::max(1u, pollers)), seed(seed)
+{
+}
+
+/**
+ * @brief Resident memory of the process in bytes, 0 where it cannot be read.
+ */
+size_t FarmBenchmark::residentBytes(void)
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#elif defined(__linux__)
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+
+    if (statm == nullptr)
+        return 0;
+    if (fscanf(statm, "%lu %lu", &pages, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Reads every device's current for a fixed time.
+ * @param devices Number of simulated instruments.
+ * @param seconds Duration of the polling phase.
+ * @return Throughput, latency and memory figures.
+ */
+FarmResult FarmBenchmark::run(size_t devices, double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+    FarmResult result;
+    NullBuffer nullBuffer;
+    std::streambuf *console = std::cout.rdbuf(&nullBuffer);
+    size_t residentBefore = residentBytes();
+    SimFarm farm(devices, seed);
+    std::vector<std::unique_ptr<PowerSupply>> supplies;
+    std::vector<PollerStats> stats(pollers);
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+    uint64_t latency[latencyBuckets] = {};
+    uint64_t rank = 0;
+    double latencySumUs = 0.0;
+    Clock::time_point start;
+
+    supplies.reserve(devices);
+    for (size_t i = 0; i < devices; i++)
+    {
+        supplies.emplace_back(new PowerSupply("SIM" + std::to_string(i), farm.connect(i)));
+        supplies.back()->writeVoltage(5.0);
+        supplies.back()->turnOn();
+    }
+    if (residentBefore > 0 && devices > 0)
+        result.bytesPerDevice = (static_cast<double>(residentBytes()) - residentBefore) / devices;
+
+    start = Clock::now();
+    for (unsigned t = 0; t < pollers; t++)
+    {
+        threads.emplace_back([&, t] {
+            PollerStats& own = stats[t];
+            double current;
+
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                Clock::time_point sweepStart = Clock::now();
+
+                for (size_t i = t; i < supplies.size(); i += pollers)
+                {
+                    Clock::time_point readStart = Clock::now();
+                    PowerSupply::PsError err = supplies[i]->readCurrent(current);
+                    double latencyUs = std::chrono::duration<double, std::micro>(Clock::now() - readStart).count();
+
+                    own.reads++;
+                    own.latencySumUs += latencyUs;
+                    own.latency[latencyBucket(latencyUs)]++;
+                    if (err != PowerSupply::PsError::ERR_SUCCESS)
+                        own.failures++;
+                    else if (sampleHook)
+                        sampleHook(i, current);
+                }
+                own.maxSweepMs = std::max(own.maxSweepMs,
+                                          std::chrono::duration<double, std::milli>(Clock::now() - sweepStart).count());
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(seconds * 1e6)));
+    stop = true;
+    for (std::thread& thread : threads)
+        thread.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout.rdbuf(console);
+
+    result.devices = devices;
+    result.pollers = pollers;
+    for (const PollerStats& own : stats)
+    {
+        result.reads += own.reads;
+        result.failures += own.failures;
+        result.maxSweepMs = std::max(result.maxSweepMs, own.maxSweepMs);
+        latencySumUs += own.latencySumUs;
+        for (int b = 0; b < latencyBuckets; b++)
+            latency[b] += own.latency[b];
+    }
+    if (result.reads > 0)
+    {
+        result.meanLatencyUs = latencySumUs / result.reads;
+        for (int b = 0; b < latencyBuckets; b++)
+        {
+            rank += latency[b];
+            if (rank * 100 >= result.reads * 99)
+            {
+                result.p99LatencyUs = bucketUpperUs(b);
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Formats the results as a table.
+ * @param results One result per farm size.
+ * @param out Appended with the table.
+ */
+void FarmBenchmark::render(const std::vector<FarmResult>& results, std::string& out)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "%8s %7s %12s %9s %10s %10s %12s %10s\n",
+             "devices", "pollers", "reads/s", "failures", "mean us", "p99 us", "max sweep ms", "bytes/dev");
+    out += line;
+    for (const FarmResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%8zu %7u %12.0f %9llu %10.1f %10.1f %12.2f %10.0f\n",
+                 result.devices, result.pollers, result.readsPerSecond(),
+                 static_cast<unsigned long long>(result.failures),
+                 result.meanLatencyUs, result.p99LatencyUs, result.maxSweepMs, result.bytesPerDevice);
+        out += line;
+    }
+}
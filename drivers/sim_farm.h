@@ -0,0 +1,63 @@
+#ifndef SIM_FARM_H
+#define SIM_FARM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "sim_instrument.h"
+
+/* Simulated instruments of one process, each with its own load */
+class SimFarm
+{
+    public:
+        SimFarm(size_t devices, uint64_t seed);
+
+        size_t size(void) const { return instruments.size(); }
+        std::unique_ptr<Transport> connect(size_t index);
+        SimInstrument& instrument(size_t index) { return *instruments[index]; }
+
+    private:
+        std::vector<std::shared_ptr<SimInstrument>> instruments;
+};
+
+struct FarmResult
+{
+    size_t devices = 0;
+    unsigned pollers = 0;
+    double seconds = 0.0;
+    uint64_t reads = 0;
+    uint64_t failures = 0;
+    double meanLatencyUs = 0.0;   /* readCurrent() through driver and simulator */
+    double p99LatencyUs = 0.0;
+    double maxSweepMs = 0.0;      /* Longest pass of one poller over its devices */
+    double bytesPerDevice = 0.0;  /* Resident memory of driver, transport and instrument */
+
+    double readsPerSecond(void) const { return seconds > 0.0 ? reads / seconds : 0.0; }
+};
+
+/* Control-plane load test. Opens one PowerSupply per simulated instrument
+   and has a fixed pool of poller threads read every device's current back
+   to back. The sample hook sees every good reading from the poller threads,
+   which lets the caller forward them the way the GUI would. */
+class FarmBenchmark
+{
+    public:
+        using SampleHook = std::function<void(size_t device, double current)>;
+
+        FarmBenchmark(unsigned pollers, uint64_t seed);
+
+        void setSampleHook(const SampleHook& hook) { sampleHook = hook; }
+        FarmResult run(size_t devices, double seconds);
+        static void render(const std::vector<FarmResult>& results, std::string& out);
+        static size_t residentBytes(void);
+
+    private:
+        unsigned pollers;
+        uint64_t seed;
+        SampleHook sampleHook;
+};
+
+#endif /* SIM_FARM_H */
@@ -0,0 +1,652 @@
+
+#include "sim_instrument.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    enum Mnemonic
+    {
+        M_UNKNOWN = 0,
+        M_SOUR,
+        M_MEAS,
+        M_VOLT,
+        M_CURR,
+        M_OUTP,
+        M_STAT,
+        M_IMAX,
+        M_SYST,
+        M_ERR,
+        M_DC,
+        M_INST,
+        M_NSEL,
+        M_OPER,
+        M_QUES,
+        M_EVEN,
+        M_COND,
+        M_ENAB,
+        M_PTR,
+        M_NTR
+    };
+
+    struct MnemonicName
+    {
+        Mnemonic id;
+        const char *shortForm;
+        const char *longForm;
+    };
+
+    const MnemonicName mnemonics[] =
+    {
+        {M_SOUR, "SOUR", "SOURCE"},
+        {M_MEAS, "MEAS", "MEASURE"},
+        {M_VOLT, "VOLT", "VOLTAGE"},
+        {M_CURR, "CURR", "CURRENT"},
+        {M_OUTP, "OUTP", "OUTPUT"},
+        {M_STAT, "STAT", "STATE"},
+        {M_IMAX, "IMAX", "IMAX"},
+        {M_SYST, "SYST", "SYSTEM"},
+        {M_ERR,  "ERR",  "ERROR"},
+        {M_DC,   "DC",   "DC"},
+        {M_INST, "INST", "INSTRUMENT"},
+        {M_NSEL, "NSEL", "NSELECT"},
+        {M_STAT, "STAT", "STATUS"},
+        {M_OPER, "OPER", "OPERATION"},
+        {M_QUES, "QUES", "QUESTIONABLE"},
+        {M_EVEN, "EVEN", "EVENT"},
+        {M_COND, "COND", "CONDITION"},
+        {M_ENAB, "ENAB", "ENABLE"},
+        {M_PTR,  "PTR",  "PTRANSITION"},
+        {M_NTR,  "NTR",  "NTRANSITION"}
+    };
+
+    const int maxDepth = 4;
+    const double maxVoltage = 30.0;
+
+    bool sameUpper(const char *text, size_t size, const char *upper)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            char c = text[i];
+            if (c >= 'a' && c <= 'z')
+                c = static_cast<char>(c - 'a' + 'A');
+            if (upper[i] != c)
+                return false;
+        }
+        return upper[size] == '\0';
+    }
+
+    Mnemonic lookup(const char *text, size_t size)
+    {
+        for (const MnemonicName& name : mnemonics)
+        {
+            if (sameUpper(text, size, name.shortForm) || sameUpper(text, size, name.longForm))
+                return name.id;
+        }
+        return M_UNKNOWN;
+    }
+
+    bool parseNumber(const char *text, size_t size, double& value)
+    {
+        char number[32];
+        char *end;
+
+        if (size == 0 || size >= sizeof(number))
+            return false;
+        memcpy(number, text, size);
+        number[size] = '\0';
+        value = strtod(number, &end);
+        return end != number && *end == '\0' && std::isfinite(value);
+    }
+
+    bool parseBoolean(const char *text, size_t size, bool& value)
+    {
+        if ((size == 1 && text[0] == '1') || sameUpper(text, size, "ON"))
+            value = true;
+        else if ((size == 1 && text[0] == '0') || sameUpper(text, size, "OFF"))
+            value = false;
+        else
+            return false;
+        return true;
+    }
+
+    /* Register value parameter: SCPI error code, 0 when valid */
+    int parseRegister(const char *text, size_t size, unsigned limit, uint16_t& value)
+    {
+        double number;
+
+        if (size == 0)
+            return -109;
+        if (!parseNumber(text, size, number) || number != std::floor(number))
+            return -224;
+        if (number < 0.0 || number > limit)
+            return -222;
+        value = static_cast<uint16_t>(number);
+        return 0;
+    }
+
+    const char* errorText(int code)
+    {
+        switch (code)
+        {
+            case 0:    return "No error";
+            case -109: return "Missing parameter";
+            case -113: return "Undefined header";
+            case -222: return "Data out of range";
+            case -224: return "Illegal parameter value";
+            default:   return "Unknown error";
+        }
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param load Load connected to the output.
+ * @param seed Seed of the reading noise.
+ * @param serial Serial number reported by *IDN?.
+ * @param outputs Number of outputs, up to maxOutputs.
+ */
+SimInstrument::SimInstrument(const SimLoad& load, uint64_t seed, uint32_t serial, int outputs)
+    : load(load), outputCount(std::min(std::max(outputs, 1), maxOutputs)), serial(serial),
+      noiseState(seed ? seed : 0x9E3779B97F4A7C15ull)
+{
+}
+
+/**
+ * @brief Current drawn by the load at the set voltage, before the current limit.
+ */
+double SimInstrument::loadCurrent(const SimOutput& output, double nowMs) const
+{
+    double phase;
+
+    switch (load.model)
+    {
+        case SimLoadModel::OPEN:
+            return 0.0;
+        case SimLoadModel::RESISTIVE:
+            return load.ohms > 0.0 ? output.voltage / load.ohms : output.currentLimit;
+        case SimLoadModel::CONSTANT_CURRENT:
+            return output.voltage > 0.0 ? load.amps : 0.0;
+        case SimLoadModel::PULSED:
+            if (output.voltage <= 0.0 || load.periodMs <= 0.0)
+                return 0.0;
+            phase = std::fmod(nowMs, load.periodMs) / load.periodMs;
+            return phase < load.duty ? load.amps : load.amps * 0.1;
+    }
+    return 0.0;
+}
+
+/**
+ * @brief Uniform noise in [-noiseA, noiseA] from a xorshift generator.
+ */
+double SimInstrument::noise(void)
+{
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 7;
+    noiseState ^= noiseState << 17;
+    return load.noiseA * ((noiseState >> 11) * (2.0 / 9007199254740992.0) - 1.0);
+}
+
+/**
+ * @brief Current of the selected output: the load current, limited by CURR, plus reading noise.
+ */
+double SimInstrument::measureCurrent(double nowMs)
+{
+    const SimOutput& output = outputs[selected];
+
+    if (!output.on)
+        return 0.0;
+    return std::max(0.0, std::min(loadCurrent(output, nowMs), output.currentLimit) + noise());
+}
+
+/**
+ * @brief Voltage of the selected output, folded back while a resistive load hits the current limit.
+ */
+double SimInstrument::measureVoltage(double nowMs)
+{
+    const SimOutput& output = outputs[selected];
+
+    if (!output.on)
+        return 0.0;
+    if (load.model == SimLoadModel::RESISTIVE && loadCurrent(output, nowMs) > output.currentLimit)
+        return output.currentLimit * load.ohms;
+    return output.voltage;
+}
+
+/**
+ * @brief Switches an output from the front panel.
+ * @param output Output number, from 1.
+ * @param on New output state.
+ * @param nowMs Simulation time in milliseconds.
+ */
+void SimInstrument::setOutput(int output, bool on, double nowMs)
+{
+    if (output < 1 || output > outputCount)
+        return;
+    outputs[output - 1].on = on;
+    updateStatus(nowMs);
+}
+
+/**
+ * @brief Trips a protection: the output turns off and the event is latched.
+ * @param output Output number, from 1.
+ * @param questionable Questionable bit of the protection, questionableOV or questionableOC.
+ * @param nowMs Simulation time in milliseconds.
+ */
+void SimInstrument::tripProtection(int output, uint16_t questionable, double nowMs)
+{
+    if (output < 1 || output > outputCount)
+        return;
+    outputs[output - 1].on = false;
+    questionableEvent |= questionable;
+    updateStatus(nowMs);
+}
+
+/**
+ * @brief Latches the operation events of the condition changes since the last update.
+ */
+void SimInstrument::updateStatus(double nowMs)
+{
+    uint16_t condition = 0;
+
+    for (int i = 0; i < outputCount; i++)
+    {
+        const SimOutput& output = outputs[i];
+        if (output.on)
+            condition |= loadCurrent(output, nowMs) >= output.currentLimit ? operationCC : operationCV;
+    }
+    operationEvent |= (condition & ~operationCondition & operationPositive) |
+                      (operationCondition & ~condition & operationNegative);
+    operationCondition = condition;
+}
+
+/**
+ * @brief Status byte from the summaries of the event registers and the error queue.
+ */
+uint8_t SimInstrument::statusByte(void) const
+{
+    uint8_t status = 0;
+
+    if (lastError != 0)
+        status |= 0x04;
+    if (questionableEvent & questionableEnable)
+        status |= 0x08;
+    if (eventStatus & eventStatusEnable)
+        status |= 0x20;
+    if (operationEvent & operationEnable)
+        status |= 0x80;
+    if (status & serviceRequestEnable)
+        status |= 0x40;
+    return status;
+}
+
+void SimInstrument::fail(int code)
+{
+    lastError = code;
+    errors++;
+
+    /* Standard event bits: command, execution, device dependent and query errors */
+    if (code <= -100 && code > -200)
+        eventStatus |= 0x20;
+    else if (code <= -200 && code > -300)
+        eventStatus |= 0x10;
+    else if (code <= -300 && code > -400)
+        eventStatus |= 0x08;
+    else if (code <= -400)
+        eventStatus |= 0x04;
+}
+
+/**
+ * @brief Executes one program message and formats the replies of its queries.
+ * @param program Program message, optionally terminated by a line feed.
+ * @param size Size of the program message.
+ * @param reply Buffer receiving the replies, separated by ';' and terminated by a line feed.
+ * @param capacity Size of the reply buffer.
+ * @param nowMs Simulation time in milliseconds.
+ * @return Size of the reply, 0 when the message holds no query.
+ */
+size_t SimInstrument::execute(const char *program, size_t size, char *reply, size_t capacity, double nowMs)
+{
+    const char *p = program;
+    const char *end = program + size;
+    Mnemonic prefix[maxDepth];
+    int prefixDepth = 0;
+    size_t out = 0;
+
+    while (p < end && *p != '\n' && *p != '\r')
+    {
+        Mnemonic header[maxDepth];
+        int depth = 0;
+        bool query = false;
+        bool known = true;
+        const char *common = nullptr;
+        size_t commonSize = 0;
+        const char *parameter;
+        size_t parameterSize;
+        char value[48];
+        int written = -1;
+        uint16_t registerValue = 0;
+        int code = 0;
+
+        while (p < end && *p == ' ')
+            p++;
+
+        if (p < end && *p == '*')
+        {
+            /* Common command: *IDN?, *RST, *CLS, *OPC?, *STB?, *ESR?, *ESE, *SRE, *SAV, *RCL */
+            common = ++p;
+            while (p < end && isalpha(static_cast<unsigned char>(*p)))
+                p++;
+            commonSize = p - common;
+        }
+        else
+        {
+            /* Without a leading colon a header continues the path of the previous one */
+            if (p < end && *p == ':')
+                p++;
+            else
+                for (; depth < prefixDepth; depth++)
+                    header[depth] = prefix[depth];
+
+            while (p < end)
+            {
+                const char *name = p;
+                while (p < end && isalpha(static_cast<unsigned char>(*p)))
+                    p++;
+                if (depth < maxDepth)
+                    header[depth++] = lookup(name, p - name);
+                else
+                    known = false;
+                if (p < end && *p == ':')
+                    p++;
+                else
+                    break;
+            }
+        }
+        if (p < end && *p == '?')
+        {
+            query = true;
+            p++;
+        }
+
+        while (p < end && *p == ' ')
+            p++;
+        parameter = p;
+        while (p < end && *p != ';' && *p != '\n' && *p != '\r')
+            p++;
+        parameterSize = p - parameter;
+        while (parameterSize > 0 && parameter[parameterSize - 1] == ' ')
+            parameterSize--;
+        if (p < end && *p == ';')
+            p++;
+
+        commands++;
+        updateStatus(nowMs);
+        if (common)
+        {
+            if (query && sameUpper(common, commonSize, "IDN"))
+                written = snprintf(value, sizeof(value), "SIMULATED,PS-SIM,SN%06u,1.0", serial);
+            else if (query && sameUpper(common, commonSize, "OPC"))
+                written = snprintf(value, sizeof(value), "1");
+            else if (!query && sameUpper(common, commonSize, "RST"))
+            {
+                for (SimOutput& output : outputs)
+                    output = SimOutput();
+                selected = 0;
+            }
+            else if (!query && sameUpper(common, commonSize, "CLS"))
+            {
+                lastError = 0;
+                eventStatus = 0;
+                operationEvent = 0;
+                questionableEvent = 0;
+            }
+            else if (query && sameUpper(common, commonSize, "STB"))
+                written = snprintf(value, sizeof(value), "%u", statusByte());
+            else if (query && sameUpper(common, commonSize, "ESR"))
+            {
+                written = snprintf(value, sizeof(value), "%u", eventStatus);
+                eventStatus = 0;
+            }
+            else if (sameUpper(common, commonSize, "ESE") || sameUpper(common, commonSize, "SRE"))
+            {
+                uint8_t *setting = sameUpper(common, commonSize, "ESE") ? &eventStatusEnable : &serviceRequestEnable;
+
+                if (query)
+                    written = snprintf(value, sizeof(value), "%u", *setting);
+                else if ((code = parseRegister(parameter, parameterSize, 255, registerValue)) != 0)
+                    fail(code);
+                else
+                    *setting = static_cast<uint8_t>(registerValue);
+            }
+            else if (!query && (sameUpper(common, commonSize, "SAV") || sameUpper(common, commonSize, "RCL")))
+            {
+                /* Saved states hold every output, the output switches included */
+                if ((code = parseRegister(parameter, parameterSize, stateSlots, registerValue)) != 0)
+                    fail(code);
+                else if (registerValue < 1)
+                    fail(-222);
+                else if (sameUpper(common, commonSize, "SAV"))
+                {
+                    if (!savedStates)
+                        savedStates.reset(new SimOutput[stateSlots * maxOutputs]);
+                    std::copy(outputs, outputs + maxOutputs, &savedStates[(registerValue - 1) * maxOutputs]);
+                }
+                else if (savedStates)
+                    std::copy(&savedStates[(registerValue - 1) * maxOutputs], &savedStates[registerValue * maxOutputs], outputs);
+                else
+                    for (SimOutput& output : outputs)
+                        output = SimOutput();
+            }
+            else
+                fail(-113);
+            prefixDepth = 0;
+        }
+        else
+        {
+            Mnemonic *node = header;
+            int nodes = depth;
+            SimOutput& output = outputs[selected];
+            double number = 0.0;
+            bool state = false;
+
+            /* SOURce is an optional node */
+            if (nodes > 0 && node[0] == M_SOUR)
+            {
+                node++;
+                nodes--;
+            }
+            for (int i = 0; i < nodes; i++)
+                known = known && node[i] != M_UNKNOWN;
+            prefixDepth = depth > 0 ? depth - 1 : 0;
+            for (int i = 0; i < prefixDepth; i++)
+                prefix[i] = header[i];
+
+            if (!known || nodes == 0)
+                fail(-113);
+            else if (nodes == 1 && (node[0] == M_VOLT || node[0] == M_CURR || node[0] == M_IMAX))
+            {
+                double *setting = node[0] == M_VOLT ? &output.voltage : node[0] == M_CURR ? &output.currentLimit : &output.maxCurrent;
+                double limit = node[0] == M_VOLT ? maxVoltage : node[0] == M_CURR ? output.maxCurrent : 10.0;
+
+                if (query)
+                    written = snprintf(value, sizeof(value), "%.3f", *setting);
+                else if (parameterSize == 0)
+                    fail(-109);
+                else if (!parseNumber(parameter, parameterSize, number))
+                    fail(-224);
+                else if (number < 0.0 || number > limit)
+                    fail(-222);
+                else
+                {
+                    *setting = number;
+                    if (node[0] == M_IMAX)
+                        output.currentLimit = std::min(output.currentLimit, output.maxCurrent);
+                }
+            }
+            else if (query && node[0] == M_MEAS && (nodes == 2 || (nodes == 3 && node[2] == M_DC)) &&
+                     (node[1] == M_VOLT || node[1] == M_CURR))
+            {
+                written = snprintf(value, sizeof(value), "%.4f",
+                                   node[1] == M_VOLT ? measureVoltage(nowMs) : measureCurrent(nowMs));
+            }
+            else if (node[0] == M_OUTP && (nodes == 1 || (nodes == 2 && node[1] == M_STAT)))
+            {
+                if (query)
+                    written = snprintf(value, sizeof(value), "%d", output.on ? 1 : 0);
+                else if (parameterSize == 0)
+                    fail(-109);
+                else if (!parseBoolean(parameter, parameterSize, state))
+                    fail(-224);
+                else
+                    output.on = state;
+            }
+            else if (nodes == 2 && node[0] == M_INST && node[1] == M_NSEL)
+            {
+                if (query)
+                    written = snprintf(value, sizeof(value), "%d", selected + 1);
+                else if (parameterSize == 0)
+                    fail(-109);
+                else if (!parseNumber(parameter, parameterSize, number) || number != std::floor(number))
+                    fail(-224);
+                else if (number < 1 || number > outputCount)
+                    fail(-222);
+                else
+                    selected = static_cast<int>(number) - 1;
+            }
+            else if ((nodes == 2 || nodes == 3) && node[0] == M_STAT && (node[1] == M_OPER || node[1] == M_QUES))
+            {
+                bool operation = node[1] == M_OPER;
+                Mnemonic item = nodes == 2 ? M_EVEN : node[2];
+                uint16_t *event = operation ? &operationEvent : &questionableEvent;
+                uint16_t *setting = item == M_ENAB ? (operation ? &operationEnable : &questionableEnable) :
+                                    (item == M_PTR && operation) ? &operationPositive :
+                                    (item == M_NTR && operation) ? &operationNegative : nullptr;
+
+                /* Reading an event register clears it */
+                if (query && item == M_EVEN)
+                {
+                    written = snprintf(value, sizeof(value), "%u", *event);
+                    *event = 0;
+                }
+                else if (query && item == M_COND)
+                    written = snprintf(value, sizeof(value), "%u", operation ? operationCondition : 0u);
+                else if (setting == nullptr)
+                    fail(-113);
+                else if (query)
+                    written = snprintf(value, sizeof(value), "%u", *setting);
+                else if ((code = parseRegister(parameter, parameterSize, 32767, registerValue)) != 0)
+                    fail(code);
+                else
+                    *setting = registerValue;
+            }
+            else if (query && nodes == 2 && node[0] == M_SYST && node[1] == M_ERR)
+            {
+                written = snprintf(value, sizeof(value), "%d,\"%s\"", lastError, errorText(lastError));
+                lastError = 0;
+            }
+            else
+                fail(-113);
+        }
+
+        /* Replies of one message share a line, the last one gets the terminator */
+        if (written > 0 && out + written + 2 <= capacity)
+        {
+            if (out > 0)
+                reply[out++] = ';';
+            memcpy(reply + out, value, written);
+            out += written;
+        }
+    }
+
+    if (out > 0)
+        reply[out++] = '\n';
+    return out;
+}
+
+/**
+ * @brief Constructor.
+ * @param instrument Instrument at the other end of the link.
+ */
+SimulatedTransport::SimulatedTransport(std::shared_ptr<SimInstrument> instrument)
+    : instrument(std::move(instrument))
+{
+}
+
+ViStatus SimulatedTransport::open(const std::string& port, int baudrate)
+{
+    (void)port;
+    (void)baudrate;
+    opened = true;
+    aborted = false;
+    replySize = 0;
+    return VI_SUCCESS;
+}
+
+void SimulatedTransport::close(void)
+{
+    opened = false;
+    replySize = 0;
+}
+
+ViStatus SimulatedTransport::write(const char *data, size_t size)
+{
+    double nowMs = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+    size_t written;
+
+    if (!opened)
+        return VI_ERROR_CONN_LOST;
+    if (aborted)
+        return VI_ERROR_ABORT;
+
+    /* A new query discards an unread reply, like the instrument's output queue */
+    written = instrument->execute(data, size, reply, sizeof(reply), nowMs);
+    if (written > 0)
+        replySize = written;
+    return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::read(char *buffer, size_t size, ViUInt32& count)
+{
+    count = 0;
+    if (!opened)
+        return VI_ERROR_CONN_LOST;
+    if (aborted)
+        return VI_ERROR_ABORT;
+    if (replySize == 0)
+        return VI_ERROR_TMO;
+
+    count = static_cast<ViUInt32>(std::min(size, replySize));
+    memcpy(buffer, reply, count);
+    replySize = 0;
+    return count == size && reply[count - 1] != '\n' ? VI_SUCCESS_MAX_CNT : VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::clear(void)
+{
+    replySize = 0;
+    aborted = false;
+    return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::setTimeout(uint32_t milliseconds)
+{
+    /* Replies are immediate, a missing one fails at once */
+    (void)milliseconds;
+    return VI_SUCCESS;
+}
+
+/**
+ * @brief Exchanges never block here; the flag only fails the next one until clear().
+ */
+ViStatus SimulatedTransport::abort(void)
+{
+    aborted = true;
+    return VI_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#ifndef SIM_INSTRUMENT_H
+#define SIM_INSTRUMENT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "transport.h"
+
+enum class SimLoadModel
+{
+    OPEN = 0,          /* Nothing connected */
+    RESISTIVE,         /* I = V / ohms, the voltage folds back at the current limit */
+    CONSTANT_CURRENT,  /* Electronic load sinking amps while the output is on */
+    PULSED             /* amps for duty of every periodMs, a tenth of it otherwise */
+};
+
+struct SimLoad
+{
+    SimLoadModel model = SimLoadModel::RESISTIVE;
+    double ohms = 10.0;
+    double amps = 0.5;
+    double periodMs = 1000.0;
+    double duty = 0.5;
+    double noiseA = 0.0005;   /* Peak of the uniform noise on current readings */
+};
+
+/* Programmed state of one output */
+struct SimOutput
+{
+    double voltage = 0.0;
+    double currentLimit = 1.0;
+    double maxCurrent = 5.0;
+    bool on = false;
+};
+
+/* One simulated SCPI power supply. The state is a few numbers so that a farm
+   of thousands stays small, and execute() handles a whole program message
+   (units separated by ';', short or long mnemonics, relative headers) without
+   allocating, so the simulator is never what a load test measures.
+   Multi-output models select the output of the next commands with
+   INST:NSEL; every output drives a copy of the same load. The IEEE 488.2
+   status model is kept: constant-voltage and constant-current conditions
+   in the operation register, protection trips in the questionable one. */
+class SimInstrument
+{
+    public:
+        static constexpr int maxOutputs = 4;
+        static constexpr int stateSlots = 5;  /* *SAV and *RCL slots 1 to 5 */
+        static constexpr uint16_t operationCV = 1 << 8;
+        static constexpr uint16_t operationCC = 1 << 10;
+        static constexpr uint16_t questionableOV = 1 << 0;
+        static constexpr uint16_t questionableOC = 1 << 1;
+
+        SimInstrument(const SimLoad& load, uint64_t seed, uint32_t serial, int outputs = 1);
+
+        size_t execute(const char *program, size_t size, char *reply, size_t capacity, double nowMs);
+        double measureCurrent(double nowMs);
+        double measureVoltage(double nowMs);
+        void setOutput(int output, bool on, double nowMs);
+        void tripProtection(int output, uint16_t questionable, double nowMs);
+
+        SimLoad load;
+        uint64_t commands = 0;  /* Program units executed */
+        uint64_t errors = 0;    /* Program units rejected */
+
+    private:
+        SimOutput outputs[maxOutputs];
+        int outputCount;
+        int selected = 0;       /* Index of the output selected with INST:NSEL */
+        int lastError = 0;      /* SCPI error code reported by SYST:ERR? */
+        uint16_t operationCondition = 0;
+        uint16_t operationEvent = 0;
+        uint16_t operationEnable = 0;
+        uint16_t operationPositive = 0x7FFF;  /* Transition filters of the operation events */
+        uint16_t operationNegative = 0;
+        uint16_t questionableEvent = 0;
+        uint16_t questionableEnable = 0;
+        uint8_t eventStatus = 0;              /* *ESR? */
+        uint8_t eventStatusEnable = 0;        /* *ESE */
+        uint8_t serviceRequestEnable = 0;     /* *SRE */
+        std::unique_ptr<SimOutput[]> savedStates;  /* stateSlots x maxOutputs, allocated by the first *SAV */
+        uint32_t serial;
+        uint64_t noiseState;
+
+        double loadCurrent(const SimOutput& output, double nowMs) const;
+        double noise(void);
+        void fail(int code);
+        void updateStatus(double nowMs);
+        uint8_t statusByte(void) const;
+};
+
+/* Transport to a SimInstrument of the same process. The reply to the last
+   query waits in an output buffer until it is read, as on the instrument. */
+class SimulatedTransport : public Transport
+{
+    public:
+        explicit SimulatedTransport(std::shared_ptr<SimInstrument> instrument);
+
+        ViStatus open(const std::string& port, int baudrate) override;
+        void close(void) override;
+        bool isOpen(void) const override { return opened; }
+        ViStatus write(const char *data, size_t size) override;
+        ViStatus read(char *buffer, size_t size, ViUInt32& count) override;
+        ViStatus clear(void) override;
+        ViStatus setTimeout(uint32_t milliseconds) override;
+        ViStatus abort(void) override;
+
+    private:
+        std::shared_ptr<SimInstrument> instrument;
+        bool opened = false;
+        std::atomic<bool> aborted{false};
+        size_t replySize = 0;
+        char reply[128];
+};
+
+#endif /* SIM_INSTRUMENT_H */
@@ -0,0 +1,131 @@
+
+#include "status_poll.h"
+#include "drv_power_supply.h"
+#include "sim_instrument.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    /* Swallows the driver's per-command log */
+    class NullBuffer : public std::streambuf
+    {
+        protected:
+            int overflow(int c) override { return c == EOF ? 0 : c; }
+    };
+
+    double simulationMs(void)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+/**
+ * @brief Constructor.
+ * @param pollsPerSecond Poll rate the byte rates are reported for.
+ * @param seed Seed of the simulated reading noise.
+ */
+StatusPollBenchmark::StatusPollBenchmark(double pollsPerSecond, uint64_t seed)
+    : pollsPerSecond(pollsPerSecond), seed(seed)
+{
+}
+
+/**
+ * @brief Polls a simulated supply, injecting one event every eventEvery polls.
+ * The events cycle through an over-current trip, the output switched on
+ * from the front panel, a command error and the output switched off.
+ * @param statusReporting True to program the status enables and poll *STB?.
+ * @param polls Polls counted, after one that primes the state.
+ * @param eventEvery Polls between events.
+ */
+StatusPollResult StatusPollBenchmark::run(bool statusReporting, unsigned polls, unsigned eventEvery)
+{
+    NullBuffer nullBuffer;
+    std::streambuf *console = std::cout.rdbuf(&nullBuffer);
+    auto instrument = std::make_shared<SimInstrument>(SimLoad(), seed, 1);
+    PowerSupply powerSupply("SIM1", std::unique_ptr<Transport>(new SimulatedTransport(instrument)));
+    StatusPollResult result;
+    PsStatus status;
+    bool changed = false;
+    bool pending = false;
+    uint64_t commandsBefore;
+    uint64_t bytesBefore;
+    char reply[64];
+
+    result.statusReporting = statusReporting;
+    result.pollsPerSecond = pollsPerSecond;
+    powerSupply.writeVoltage(5.0);
+    powerSupply.turnOn();
+    if (statusReporting)
+        powerSupply.enableStatusReporting();
+    powerSupply.pollStatus(status, changed);
+
+    commandsBefore = powerSupply.health.commands;
+    bytesBefore = powerSupply.health.bytesSent + powerSupply.health.bytesReceived;
+    for (unsigned i = 1; i <= polls; i++)
+    {
+        if (eventEvery > 0 && i % eventEvery == 0)
+        {
+            switch (result.events++ % 4)
+            {
+                case 0:
+                    instrument->tripProtection(1, SimInstrument::questionableOC, simulationMs());
+                    break;
+                case 1:
+                    instrument->setOutput(1, true, simulationMs());
+                    break;
+                case 2:
+                    /* A bad command from another interface */
+                    instrument->execute("VOLT 99", 7, reply, sizeof(reply), simulationMs());
+                    break;
+                default:
+                    instrument->setOutput(1, false, simulationMs());
+                    break;
+            }
+            pending = true;
+        }
+
+        if (powerSupply.pollStatus(status, changed) != PowerSupply::PsError::ERR_SUCCESS)
+            continue;
+        result.polls++;
+        if (changed && pending)
+            result.detected++;
+        else if (changed)
+            result.spurious++;
+        pending = false;
+    }
+    result.commands = powerSupply.health.commands - commandsBefore;
+    result.bytes = powerSupply.health.bytesSent + powerSupply.health.bytesReceived - bytesBefore;
+
+    std::cout.rdbuf(console);
+    return result;
+}
+
+/**
+ * @brief Formats results as a table.
+ * @param results Results of run(), the first one being the baseline.
+ * @param out Appended with the table.
+ */
+void StatusPollBenchmark::render(const std::vector<StatusPollResult>& results, std::string& out)
+{
+    char line[192];
+    double baseline = results.empty() ? 0.0 : results.front().bytesPerSecond();
+
+    snprintf(line, sizeof(line), "%-12s %8s %7s %8s %8s %9s %9s %8s\n",
+             "polling", "polls", "events", "detected", "spurious", "bytes/poll", "bytes/s", "vs base");
+    out += line;
+    for (const StatusPollResult& result : results)
+    {
+        snprintf(line, sizeof(line), "%-12s %8llu %7llu %8llu %8llu %9.1f %9.1f %7.0f%%\n",
+                 result.statusReporting ? "status byte" : "full state",
+                 static_cast<unsigned long long>(result.polls),
+                 static_cast<unsigned long long>(result.events),
+                 static_cast<unsigned long long>(result.detected),
+                 static_cast<unsigned long long>(result.spurious),
+                 result.bytesPerPoll(), result.bytesPerSecond(),
+                 baseline > 0.0 ? 100.0 * result.bytesPerSecond() / baseline : 0.0);
+        out += line;
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef STATUS_POLL_H
+#define STATUS_POLL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct StatusPollResult
+{
+    bool statusReporting = false;  /* Polls read *STB? only, instead of the full state */
+    uint64_t polls = 0;
+    uint64_t events = 0;           /* Front-panel switches, protection trips and errors injected */
+    uint64_t detected = 0;         /* Events reported as a change by the next poll */
+    uint64_t spurious = 0;         /* Changes reported without an event */
+    uint64_t commands = 0;
+    uint64_t bytes = 0;            /* Sent and received, terminators included */
+    double pollsPerSecond = 0.0;   /* Poll rate the byte rate is given for */
+
+    double bytesPerPoll(void) const { return polls ? static_cast<double>(bytes) / polls : 0.0; }
+    double bytesPerSecond(void) const { return bytesPerPoll() * pollsPerSecond; }
+};
+
+/* Link cost of watching a simulated supply for state changes, polling the
+   full state every time or the status byte only. Events are injected on
+   the instrument side every few polls, as a user at the front panel would,
+   and each must show up as a change on the very next poll. */
+class StatusPollBenchmark
+{
+    public:
+        StatusPollBenchmark(double pollsPerSecond, uint64_t seed);
+
+        StatusPollResult run(bool statusReporting, unsigned polls, unsigned eventEvery);
+        static void render(const std::vector<StatusPollResult>& results, std::string& out);
+
+    private:
+        double pollsPerSecond;
+        uint64_t seed;
+};
+
+#endif /* STATUS_POLL_H */
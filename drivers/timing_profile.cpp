@@ -0,0 +1,194 @@
+
+#include "timing_profile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+/**
+ * @brief Timing of one command.
+ * @param name Driver command name.
+ * @return The timing, nullptr when the command was not profiled.
+ */
+const CommandTiming* TimingProfile::find(const std::string& name) const
+{
+    auto entry = commands.find(name);
+    return entry == commands.end() ? nullptr : &entry->second;
+}
+
+/**
+ * @brief Read timeout for a command: twice its worst round trip plus 50 ms.
+ * @param name Driver command name.
+ * @return Timeout in milliseconds, the default one for commands not profiled.
+ */
+uint32_t TimingProfile::timeoutMs(const std::string& name) const
+{
+    const CommandTiming *timing = find(name);
+    double timeout;
+
+    if (timing == nullptr || timing->samples == 0)
+        return defaultTimeoutMs;
+    timeout = 2.0 * (timing->wireMs + timing->processingMaxMs) + 50.0;
+    return static_cast<uint32_t>(std::min<double>(defaultTimeoutMs, std::max<double>(minimumTimeoutMs, std::ceil(timeout))));
+}
+
+/**
+ * @brief Queries of one command worth keeping in flight: enough to cover the
+ * instrument's processing time with the wire time of the next ones.
+ * @param name Driver command name.
+ * @return Depth, 1 when pipelining gains nothing or the command is unknown.
+ */
+unsigned TimingProfile::pipelineDepth(const std::string& name) const
+{
+    const CommandTiming *timing = find(name);
+
+    if (timing == nullptr || timing->wireMs <= 0.0)
+        return 1;
+    return std::min(8u, 1u + static_cast<unsigned>(timing->processingMedianMs / timing->wireMs));
+}
+
+/**
+ * @brief Shortest sample period able to run the given commands each sample.
+ * @param names Driver commands issued per sample.
+ * @return Period in milliseconds, from the 99th percentile round trips.
+ */
+double TimingProfile::samplePeriodMs(const std::vector<std::string>& names) const
+{
+    double period = 0.0;
+
+    for (const std::string& name : names)
+    {
+        const CommandTiming *timing = find(name);
+        period += timing ? timing->wireMs + timing->processingP99Ms : 0.0;
+    }
+    return period;
+}
+
+/**
+ * @brief Time the bytes take on a serial line with 8N1 framing.
+ * @param bytes Bytes sent and received.
+ * @param baudrate Line speed.
+ */
+double TimingProfile::wireMs(size_t bytes, int baudrate)
+{
+    return baudrate > 0 ? bytes * 10.0 * 1000.0 / baudrate : 0.0;
+}
+
+/**
+ * @brief Builds a timing from processing time samples.
+ * @param processingMs Samples in milliseconds; sorted in place.
+ * @param wireMs Wire time of the command.
+ */
+CommandTiming TimingProfile::summarize(std::vector<double>& processingMs, double wireMs)
+{
+    CommandTiming timing;
+
+    timing.wireMs = wireMs;
+    if (processingMs.empty())
+        return timing;
+    std::sort(processingMs.begin(), processingMs.end());
+    timing.samples = static_cast<uint32_t>(processingMs.size());
+    timing.processingMedianMs = processingMs[processingMs.size() / 2];
+    timing.processingP99Ms = processingMs[std::min(processingMs.size() - 1, processingMs.size() * 99 / 100)];
+    timing.processingMaxMs = processingMs.back();
+    return timing;
+}
+
+/**
+ * @brief Serializes the profile as text, one command per line.
+ * @return Text accepted by deserialize().
+ */
+std::string TimingProfile::serialize(void) const
+{
+    std::ostringstream out;
+    out.precision(9);
+
+    out << "model " << model << '\n';
+    out << "baud " << baudrate << '\n';
+    for (const auto& entry : commands)
+    {
+        const CommandTiming& timing = entry.second;
+        out << "cmd " << entry.first << ' ' << timing.samples << ' ' << timing.wireMs << ' '
+            << timing.processingMedianMs << ' ' << timing.processingP99Ms << ' ' << timing.processingMaxMs << ' '
+            << (timing.estimated ? 1 : 0) << ' ' << timing.replyBytes << '\n';
+    }
+    return out.str();
+}
+
+/**
+ * @brief Replaces the profile with the one parsed from text.
+ * @param text Text produced by serialize().
+ * @return True on success. On failure the profile is left unchanged.
+ */
+bool TimingProfile::deserialize(const std::string& text)
+{
+    TimingProfile parsed;
+    std::istringstream in(text);
+    std::string line;
+
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        std::string name;
+        CommandTiming timing;
+        int estimated = 0;
+
+        if (line.empty())
+            continue;
+        fields >> key;
+        if (key == "model")
+        {
+            std::getline(fields >> std::ws, parsed.model);
+        }
+        else if (key == "baud")
+        {
+            if (!(fields >> parsed.baudrate) || parsed.baudrate <= 0)
+                return false;
+        }
+        else if (key == "cmd")
+        {
+            if (!(fields >> name >> timing.samples >> timing.wireMs >> timing.processingMedianMs
+                         >> timing.processingP99Ms >> timing.processingMaxMs >> estimated))
+                return false;
+            if (timing.wireMs < 0.0 || timing.processingMedianMs < 0.0 ||
+                timing.processingP99Ms < timing.processingMedianMs || timing.processingMaxMs < timing.processingP99Ms)
+                return false;
+            timing.estimated = (estimated != 0);
+            if (!(fields >> timing.replyBytes))
+                timing.replyBytes = 0;  /* Profiles saved before reply lengths were recorded */
+            parsed.commands[name] = timing;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    *this = parsed;
+    return true;
+}
+
+/**
+ * @brief Formats the profile as a table.
+ * @param out Appended with the table.
+ */
+void TimingProfile::render(std::string& out) const
+{
+    char line[192];
+
+    snprintf(line, sizeof(line), "Timing profile of %s at %d baud\n", model.c_str(), baudrate);
+    out += line;
+    snprintf(line, sizeof(line), "%-18s %7s %8s %9s %9s %9s %10s %5s\n",
+             "command", "samples", "wire ms", "proc p50", "proc p99", "proc max", "timeout ms", "depth");
+    out += line;
+    for (const auto& entry : commands)
+    {
+        const CommandTiming& timing = entry.second;
+        snprintf(line, sizeof(line), "%-18s %7u %8.2f %9.2f %9.2f %9.2f %10u %5u%s\n",
+                 entry.first.c_str(), timing.samples, timing.wireMs, timing.processingMedianMs,
+                 timing.processingP99Ms, timing.processingMaxMs, timeoutMs(entry.first),
+                 pipelineDepth(entry.first), timing.estimated ? " (estimated)" : "");
+        out += line;
+    }
+}
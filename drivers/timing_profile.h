@@ -0,0 +1,52 @@
+#ifndef TIMING_PROFILE_H
+#define TIMING_PROFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Measured timing of one driver command. Wire time is what the bytes of the
+   command and of its reply take on the line at the profile baud rate;
+   processing time is the rest of the round trip, spent in the instrument */
+struct CommandTiming
+{
+    uint32_t samples = 0;
+    double wireMs = 0.0;
+    double processingMedianMs = 0.0;
+    double processingP99Ms = 0.0;
+    double processingMaxMs = 0.0;
+    uint32_t replyBytes = 0;  /* Reply length including the terminator, 0 for writes */
+    bool estimated = false;  /* Copied from a related command instead of measured */
+
+    double roundTripMs(void) const { return wireMs + processingMedianMs; }
+};
+
+/* Timing profile of one instrument model, keyed by the driver's command
+   names (psCommands). Built by PowerSupply::characterize() and stored per
+   model, it replaces the fixed 2 s timeout and feeds sample-rate planning */
+class TimingProfile
+{
+    public:
+        static constexpr uint32_t defaultTimeoutMs = 2000;
+        static constexpr uint32_t minimumTimeoutMs = 100;
+
+        std::string model;
+        int baudrate = 9600;
+        std::map<std::string, CommandTiming> commands;
+
+        bool empty(void) const { return commands.empty(); }
+        const CommandTiming* find(const std::string& name) const;
+        uint32_t timeoutMs(const std::string& name) const;
+        unsigned pipelineDepth(const std::string& name) const;
+        double samplePeriodMs(const std::vector<std::string>& names) const;
+        std::string serialize(void) const;
+        bool deserialize(const std::string& text);
+        void render(std::string& out) const;
+
+        static double wireMs(size_t bytes, int baudrate);
+        static CommandTiming summarize(std::vector<double>& processingMs, double wireMs);
+};
+
+#endif /* TIMING_PROFILE_H */
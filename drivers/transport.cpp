@@ -0,0 +1,130 @@
+
+#include "transport.h"
+#include <iostream>
+
+VisaTransport::~VisaTransport()
+{
+    close();
+}
+
+ViStatus VisaTransport::open(const std::string& port, int baudrate)
+{
+    std::string resourceName;
+    ViStatus status = VI_SUCCESS;
+    ViSession session = VI_NULL;
+
+    close();
+    aborted = false;
+
+    /* Open resource manager */
+    status = viOpenDefaultRM(&this->defaultRM);
+    if (status != VI_SUCCESS)
+    {
+        std::cout << "Power Supply: Failed to open default resource manager" << std::endl;
+        goto err_open;
+    }
+
+    /* Open resource */
+    resourceName = "ASRL" + port.substr(3) + "::INSTR";
+    std::cout << "Power Supply: Opening " << resourceName << std::endl;
+    status = viOpen(defaultRM, (ViRsrc)resourceName.c_str(), VI_NULL, VI_NULL, &session);
+    if (status != VI_SUCCESS)
+    {
+        std::cout << "Power Supply: Failed to open instrument" << std::endl;
+        goto err_open;
+    }
+
+    /* Set instrument configuration:
+         - Baud rate given by the driver
+         - 8 data bits
+         - No parity
+         - 1 stop bit
+         - No flow control
+         - Termination character: LF (0x0A)
+         - Termination character enabled
+         - Timeout: 2000 ms
+    */
+    viSetAttribute(session, VI_ATTR_ASRL_BAUD, baudrate);
+    viSetAttribute(session, VI_ATTR_ASRL_DATA_BITS, 8);                  /* 8 data bits */
+    viSetAttribute(session, VI_ATTR_ASRL_PARITY, VI_ASRL_PAR_NONE);      /* No parity */
+    viSetAttribute(session, VI_ATTR_ASRL_STOP_BITS, VI_ASRL_STOP_ONE);   /* 1 stop bit */
+    viSetAttribute(session, VI_ATTR_ASRL_FLOW_CNTRL, VI_ASRL_FLOW_NONE); /* No flow control */
+    viSetAttribute(session, VI_ATTR_TERMCHAR, '\n');
+    viSetAttribute(session, VI_ATTR_TERMCHAR_EN, VI_TRUE);
+    viSetAttribute(session, VI_ATTR_TMO_VALUE, 2000);                    /* in milliseconds */
+    {
+        std::lock_guard<std::mutex> lock(sessionMutex);
+        instrument = session;
+    }
+    std::cout << "Power Supply: opened resource: \n" << resourceName << std::endl;
+    return VI_SUCCESS;
+
+err_open:
+    close();
+    return status;
+}
+
+void VisaTransport::close(void)
+{
+    std::lock_guard<std::mutex> lock(sessionMutex);
+
+    if (instrument != VI_NULL)
+    {
+        viClose(instrument);
+        instrument = VI_NULL;
+    }
+    if (defaultRM != VI_NULL)
+    {
+        viClose(defaultRM);
+        defaultRM = VI_NULL;
+    }
+}
+
+ViStatus VisaTransport::write(const char *data, size_t size)
+{
+    if (aborted)
+        return VI_ERROR_ABORT;
+    return viWrite(instrument, (ViBuf)data, static_cast<ViUInt32>(size), VI_NULL);
+}
+
+ViStatus VisaTransport::read(char *buffer, size_t size, ViUInt32& count)
+{
+    count = 0;
+    if (aborted)
+        return VI_ERROR_ABORT;
+    return viRead(instrument, (ViBuf)buffer, static_cast<ViUInt32>(size), &count);
+}
+
+ViStatus VisaTransport::clear(void)
+{
+    aborted = false;
+    return viFlush(instrument, VI_READ_BUF_DISCARD | VI_ASRL_IN_BUF_DISCARD);
+}
+
+ViStatus VisaTransport::setTimeout(uint32_t milliseconds)
+{
+    return viSetAttribute(instrument, VI_ATTR_TMO_VALUE, milliseconds);
+}
+
+/**
+ * @brief Cuts off a blocked viWrite or viRead of another thread.
+ * viTerminate with no job id aborts every call in progress on the session;
+ * the flag also stops a call that had not entered VISA yet.
+ */
+ViStatus VisaTransport::abort(void)
+{
+    std::lock_guard<std::mutex> lock(sessionMutex);
+
+    aborted = true;
+    return instrument != VI_NULL ? viTerminate(instrument, VI_NULL, VI_NULL) : VI_SUCCESS;
+}
+
+/**
+ * @brief Device clear: VISA flushes the session buffers and resets the
+ * instrument's input and output queues.
+ */
+ViStatus VisaTransport::deviceClear(void)
+{
+    aborted = false;
+    return viClear(instrument);
+}
@@ -0,0 +1,60 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "visa.h"
+
+/* Byte link to one instrument. Status codes are VISA's so that drivers keep
+   a single error vocabulary whatever carries the bytes. Implementations
+   deliver one terminated reply per read, like a VISA session with the
+   termination character enabled.
+   abort() is the only call allowed from another thread while a write or
+   read is in progress: that call and any later one return VI_ERROR_ABORT
+   until clear(). */
+class Transport
+{
+    public:
+        virtual ~Transport() = default;
+
+        virtual ViStatus open(const std::string& port, int baudrate) = 0;
+        virtual void close(void) = 0;
+        virtual bool isOpen(void) const = 0;
+        virtual ViStatus write(const char *data, size_t size) = 0;
+        virtual ViStatus read(char *buffer, size_t size, ViUInt32& count) = 0;
+        virtual ViStatus clear(void) = 0;  /* Discards unread input after a failed exchange */
+        virtual ViStatus setTimeout(uint32_t milliseconds) = 0;  /* Longest wait of a read */
+        virtual ViStatus abort(void) { return VI_ERROR_NSUP_OPER; }  /* Cuts off the write or read in progress */
+        virtual ViStatus deviceClear(void) { return clear(); }  /* Also resets the instrument's queues and parser */
+};
+
+/* Serial instrument through the VISA resource manager (COMx -> ASRLx::INSTR) */
+class VisaTransport : public Transport
+{
+    public:
+        ~VisaTransport() override;
+
+        ViStatus open(const std::string& port, int baudrate) override;
+        void close(void) override;
+        bool isOpen(void) const override { return instrument.load() != VI_NULL; }
+        ViStatus write(const char *data, size_t size) override;
+        ViStatus read(char *buffer, size_t size, ViUInt32& count) override;
+        ViStatus clear(void) override;
+        ViStatus setTimeout(uint32_t milliseconds) override;
+        ViStatus abort(void) override;
+        ViStatus deviceClear(void) override;
+
+    private:
+        ViSession defaultRM = VI_NULL;
+        /* abort() and isOpen() run on other threads than open() and close();
+           the session is published and withdrawn under sessionMutex, so
+           viTerminate never gets a session that is being closed */
+        std::atomic<ViSession> instrument{VI_NULL};
+        std::mutex sessionMutex;
+        std::atomic<bool> aborted{false};
+};
+
+#endif /* TRANSPORT_H */
@@ -1,10 +1,522 @@
 #include "GUI_MAIN_POWER_SUPPLY.h"
+#include "fault_scenario.h"
+#include "sim_farm.h"
+#include "status_poll.h"
+#include "cancel_benchmark.h"
+#include "endurance_runner.h"
+#include "battery_emulator.h"
+#include "bus_stress.h"
+#include "delivery_benchmark.h"
+#include "dashboard_benchmark.h"
+#include "store_benchmark.h"
+#include "history_benchmark.h"
+#include "log_benchmark.h"
+#include "metrics_benchmark.h"
+#include "protocol_benchmark.h"
+#include "capture_log.h"
+#include "sim_instrument.h"
+#include "instrument_engine.h"
+#include "engine_transport.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QSharedMemory>
+#include <QStandardPaths>
+#include <QTimer>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief Load test against 10, 100 and 1000 simulated instruments.
+ *
+ * Good readings are forwarded to the GUI thread as queued calls, at most one
+ * per device per 16 ms frame, the way the worker signals the window. A frame
+ * timer on the GUI thread measures how late the event loop runs meanwhile.
+ */
+static int run_farm_benchmark(QApplication& app, unsigned pollers, double seconds)
+{
+    const size_t farmSizes[] = {10, 100, 1000};
+    FarmBenchmark benchmark(pollers, 1);
+    std::vector<FarmResult> results;
+    std::string report;
+    char line[160];
+
+    for (size_t devices : farmSizes)
+    {
+        std::vector<qint64> lastPostedNs(devices, -16000000);
+        QElapsedTimer clock;
+        QElapsedTimer sinceFrame;
+        QTimer frame;
+        double maxFrameLateMs = 0.0;
+        qint64 maxDeliveryNs = 0;
+
+        clock.start();
+        benchmark.setSampleHook([&](size_t device, double current) {
+            qint64 now = clock.nsecsElapsed();
+
+            /* Each device belongs to a single poller thread */
+            if (now - lastPostedNs[device] < 16000000)
+                return;
+            lastPostedNs[device] = now;
+            QMetaObject::invokeMethod(&app, [&maxDeliveryNs, &clock, now, current] {
+                (void)current;
+                maxDeliveryNs = std::max(maxDeliveryNs, clock.nsecsElapsed() - now);
+            }, Qt::QueuedConnection);
+        });
+
+        frame.setTimerType(Qt::PreciseTimer);
+        frame.setInterval(16);
+        QObject::connect(&frame, &QTimer::timeout, [&] {
+            maxFrameLateMs = std::max(maxFrameLateMs, sinceFrame.nsecsElapsed() / 1e6 - 16.0);
+            sinceFrame.restart();
+        });
+        sinceFrame.start();
+        frame.start();
+
+        std::thread runner([&] {
+            results.push_back(benchmark.run(devices, seconds));
+            QMetaObject::invokeMethod(&app, [&app] { app.quit(); }, Qt::QueuedConnection);
+        });
+        app.exec();
+        runner.join();
+        frame.stop();
+        QCoreApplication::sendPostedEvents();
+
+        snprintf(line, sizeof(line), "%zu devices: GUI frame late by up to %.1f ms, samples delivered within %.1f ms\n",
+                 devices, maxFrameLateMs, maxDeliveryNs / 1e6);
+        report += line;
+    }
+
+    FarmBenchmark::render(results, report);
+    std::cout << report;
+    return 0;
+}
+
+/**
+ * @brief Power-cycle endurance run. Outputs, capture window and pass window
+ * come from the settings; the model's timing profile sets the timeouts.
+ * Every cycle is logged to a CSV file under the application data directory,
+ * and progress is printed every 100 cycles. Port SIM runs against a
+ * simulated supply.
+ */
+static int run_endurance(const std::string& port, unsigned cycles, double onMs, double offMs)
+{
+    QSettings settings("powerSupply", "settings");
+    QString logDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/endurance";
+    QFile log(logDir + "/" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".csv");
+    std::unique_ptr<Transport> transport;
+    EnduranceOptions options;
+    EnduranceReport report;
+    PsIdentity identity;
+    TimingProfile profile;
+    std::string text;
+    int channels = std::max(1, settings.value("channels", 1).toInt());
+
+    if (port == "SIM")
+        transport.reset(new SimulatedTransport(std::make_shared<SimInstrument>(SimLoad(), 1, 1, channels)));
+    PowerSupply powerSupply(port == "SIM" ? "SIM1" : port, std::move(transport));
+    if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to open " << port << std::endl;
+        return 1;
+    }
+    if (powerSupply.setChannels(channels) != PowerSupply::PsError::ERR_SUCCESS)
+        return 1;
+    if (port == "SIM")
+        powerSupply.writeVoltage(5.0);
+    if (powerSupply.readIdentity(identity) == PowerSupply::PsError::ERR_SUCCESS && !identity.model.empty() &&
+        profile.deserialize(settings.value("timing/" + QString::fromStdString(identity.model).replace('/', '_'), "")
+                                .toString().toStdString()))
+        powerSupply.applyTimingProfile(profile);
+
+    options.outputs.clear();
+    for (const QString& output : settings.value("enduranceOutputs", "1").toString().split(',', Qt::SkipEmptyParts))
+        options.outputs.push_back(output.trimmed().toInt());
+    options.cycles = cycles;
+    options.onMs = onMs;
+    options.offMs = offMs;
+    options.captureMs = std::min(onMs, settings.value("enduranceCaptureMs", 200.0).toDouble());
+    options.minCurrent = settings.value("enduranceMinCurrentA", 0.0).toDouble();
+    options.maxCurrent = settings.value("enduranceMaxCurrentA", 1e9).toDouble();
+    options.stopOnFailure = settings.value("enduranceStopOnFailure", false).toBool();
+
+    if (!QDir().mkpath(logDir) || !log.open(QIODevice::WriteOnly | QIODevice::Text))
+        std::cout << "No cycle log: " << logDir.toStdString() << " is not writable" << std::endl;
+    else
+        log.write("cycle,on_late_ms,off_late_ms,reads,peak_a,settled_a,result\n");
+
+    powerSupply.setVerbose(false);
+    report = EnduranceRunner(powerSupply, options).run([&](const EnduranceCycle& cycle) {
+        if (log.isOpen())
+            log.write(QString("%1,%2,%3,%4,%5,%6,%7\n").arg(cycle.cycle).arg(cycle.onLateMs, 0, 'f', 3)
+                          .arg(cycle.offLateMs, 0, 'f', 3).arg(cycle.samples).arg(cycle.peakCurrent, 0, 'f', 4)
+                          .arg(cycle.settledCurrent, 0, 'f', 4)
+                          .arg(cycle.passed ? QString("pass") : QString::fromStdString(cycle.failure)).toUtf8());
+        if (cycle.cycle % 100 == 0)
+            std::cout << "Cycle " << cycle.cycle << " of " << options.cycles << std::endl;
+    });
+
+    EnduranceRunner::render(report, text);
+    std::cout << text;
+    if (log.isOpen())
+        std::cout << "Cycle log: " << log.fileName().toStdString() << std::endl;
+    return report.failed ? 2 : 0;
+}
+
+/**
+ * @brief Battery emulation on output 1. The battery is the batteryModel
+ * setting, in the text form of BatteryParameters, or a lithium-ion cell.
+ * Port SIM runs against a simulated supply with a 10 ohm load.
+ */
+static int run_battery(const std::string& port, double seconds, double rateHz)
+{
+    QSettings settings("powerSupply", "settings");
+    BatteryParameters parameters = BatteryParameters::lithiumIon();
+    QString modelText = settings.value("batteryModel", "").toString();
+    std::unique_ptr<Transport> transport;
+    EmulatorOptions options;
+    EmulatorReport report;
+    std::string text;
+
+    if (!modelText.isEmpty() && !parameters.deserialize(modelText.toStdString()))
+    {
+        std::cout << "Invalid batteryModel setting" << std::endl;
+        return 1;
+    }
+    if (port == "SIM")
+        transport.reset(new SimulatedTransport(std::make_shared<SimInstrument>(SimLoad(), 1, 1)));
+    PowerSupply powerSupply(port == "SIM" ? "SIM1" : port, std::move(transport));
+    if (powerSupply.isOpen() != PowerSupply::PsError::ERR_SUCCESS)
+    {
+        std::cout << "Failed to open " << port << std::endl;
+        return 1;
+    }
+
+    options.rateHz = rateHz;
+    options.seconds = seconds;
+    options.checkEvery = static_cast<unsigned>(std::max(0, settings.value("batteryCheckEvery", 10).toInt()));
+    powerSupply.setVerbose(false);
+    report = BatteryEmulator(powerSupply, parameters, options).run();
+
+    BatteryEmulator::render(report, text);
+    std::cout << text;
+    return 0;
+}
+
+/**
+ * @brief Instrument engine: owns the port, samples, protects and logs every
+ * output, and serves the window through shared memory until a client asks
+ * it to shut down. Settings are the window's, read once at start.
+ *
+ * A region left by an engine that died is taken over; one whose engine is
+ * still running is not.
+ */
+static int run_engine(const std::string& port)
+{
+    QSettings settings("powerSupply", "settings");
+    QSharedMemory memory(QSharedMemory::platformSafeKey(EngineRegion::sharedMemoryKey));
+    QString logDir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/engine";
+    EngineOptions options;
+    EngineRegion *region;
+    VisaTransport *link = new VisaTransport();
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    if (!memory.create(sizeof(EngineRegion)))
+    {
+        if (memory.error() != QSharedMemory::AlreadyExists || !memory.attach() ||
+            static_cast<size_t>(memory.size()) < sizeof(EngineRegion))
+        {
+            std::cout << "Engine: Shared memory unavailable: " << memory.errorString().toStdString() << std::endl;
+            return 1;
+        }
+        if (static_cast<EngineRegion*>(memory.data())->engineAlive(now))
+        {
+            std::cout << "Engine: Already running" << std::endl;
+            return 1;
+        }
+    }
+
+    options.channels = std::max(1, settings.value("channels", 1).toInt());
+    options.sampleTimeMs = std::max(1, settings.value("sampleTimeMs", 1000).toInt());
+    options.statusWatch = settings.value("statusWatch", true).toBool();
+    options.protectionLimit = settings.value("protectionCurrentA", 0.0).toDouble();
+    if (QDir().mkpath(logDir))
+        options.logDirectory = logDir.toStdString();
+
+    PowerSupply powerSupply(port, std::unique_ptr<Transport>(link));
+    if (powerSupply.setChannels(options.channels) != PowerSupply::PsError::ERR_SUCCESS)
+        return 1;
+    region = EngineRegion::initialize(memory.data(), static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch()),
+                                      QCoreApplication::applicationPid(), QDateTime::currentMSecsSinceEpoch());
+    InstrumentEngine engine(*region, powerSupply, *link, options);
+
+    std::cout << "Engine: Serving " << (port.empty() ? "no port" : port) << std::endl;
+    engine.run();
+    std::cout << "Engine: Shut down" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Asks a running instrument engine to shut down.
+ */
+static int stop_engine(void)
+{
+    QSharedMemory memory(QSharedMemory::platformSafeKey(EngineRegion::sharedMemoryKey));
+    EngineRegion *region;
+
+    if (!memory.attach() || static_cast<size_t>(memory.size()) < sizeof(EngineRegion) ||
+        !static_cast<EngineRegion*>(memory.data())->engineAlive(QDateTime::currentMSecsSinceEpoch()))
+    {
+        std::cout << "No engine running" << std::endl;
+        return 1;
+    }
+    region = static_cast<EngineRegion*>(memory.data());
+    return EngineTransport(region).configure(EngineOp::SHUTDOWN, 0.0) == VI_SUCCESS ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
+    /* --fault-benchmark COMx [seconds]: resilience report, no window */
+    if (argc >= 3 && strcmp(argv[1], "--fault-benchmark") == 0)
+    {
+        FaultScenario scenario(argv[2], [] { return std::unique_ptr<Transport>(new VisaTransport()); });
+        double seconds = argc >= 4 ? atof(argv[3]) : 30.0;
+        std::string report;
+
+        FaultScenario::render(scenario.runAll(FaultProfile::standardProfiles(), seconds, 1), report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --profile-instrument COMx [repeats]: timing profile of the model, saved for the GUI */
+    if (argc >= 3 && strcmp(argv[1], "--profile-instrument") == 0)
+    {
+        PowerSupply powerSupply(argv[2]);
+        TimingProfile profile;
+        unsigned repeats = argc >= 4 ? static_cast<unsigned>(atoi(argv[3])) : 50;
+        std::string report;
+
+        if (powerSupply.characterize(profile, std::max(1u, repeats)) != PowerSupply::PsError::ERR_SUCCESS)
+        {
+            std::cout << "Characterization failed" << std::endl;
+            return 1;
+        }
+        QSettings("powerSupply", "settings").setValue("timing/" + QString::fromStdString(profile.model).replace('/', '_'),
+                                                      QString::fromStdString(profile.serialize()));
+        profile.render(report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --status-benchmark [polls per second]: link cost of change detection, full state against status byte */
+    if (argc >= 2 && strcmp(argv[1], "--status-benchmark") == 0)
+    {
+        StatusPollBenchmark benchmark(argc >= 3 ? atof(argv[2]) : 1.0, 1);
+        std::vector<StatusPollResult> results;
+        std::string report;
+
+        results.push_back(benchmark.run(false, 10000, 50));
+        results.push_back(benchmark.run(true, 10000, 50));
+        StatusPollBenchmark::render(results, report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --store-benchmark [samples] [channels]: capture layouts, memory per sample and scan throughput */
+    if (argc >= 2 && strcmp(argv[1], "--store-benchmark") == 0)
+    {
+        StoreBenchmark benchmark(argc >= 3 ? static_cast<size_t>(std::max(2LL, atoll(argv[2]))) : 1000000,
+                                 argc >= 4 ? static_cast<size_t>(std::max(1, atoi(argv[3]))) : 8);
+        std::string report;
+
+        StoreBenchmark::render(benchmark.run(), report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --history-benchmark [hours] [channels] [MiB]: compressed history memory cap and scroll-back query time */
+    if (argc >= 2 && strcmp(argv[1], "--history-benchmark") == 0)
+    {
+        HistoryBenchmark benchmark(argc >= 3 ? std::max(0.01, atof(argv[2])) : 24.0,
+                                   argc >= 4 ? static_cast<size_t>(std::max(1, atoi(argv[3]))) : 4,
+                                   (argc >= 5 ? static_cast<size_t>(std::max(1, atoi(argv[4]))) : 64) * 1024 * 1024);
+        std::string report;
+
+        HistoryBenchmark::render(benchmark.run(), report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --log-benchmark [seconds] [directory]: sustained log ingest rate against the durability interval */
+    if (argc >= 2 && strcmp(argv[1], "--log-benchmark") == 0)
+    {
+        std::string directory = argc >= 4 ? argv[3] : QDir::tempPath().toStdString() + "/ps_log_benchmark";
+        LogBenchmark benchmark(directory, argc >= 3 ? std::max(0.1, atof(argv[2])) : 5.0);
+        std::string report;
+
+        LogBenchmark::render(benchmark.run(), report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --capture-export DIR: durable samples of a capture log as CSV */
+    if (argc >= 3 && strcmp(argv[1], "--capture-export") == 0)
+    {
+        std::cout << "channel,sequence,timestamp_ms,voltage,current,quality\n";
+        CaptureLog::replay(argv[2], [](int channel, const Sample& sample) {
+            char line[160];
+
+            snprintf(line, sizeof(line), "%d,%llu,%lld,%.6f,%.6f,%u\n", channel,
+                     static_cast<unsigned long long>(sample.sequence), static_cast<long long>(sample.timestampMs),
+                     sample.voltage, sample.current, static_cast<unsigned>(sample.quality));
+            std::cout << line;
+        });
+        return 0;
+    }
+
+    /* --metrics-benchmark [channels] [scrapes]: OpenMetrics scrape render time, at rest and while sampling */
+    if (argc >= 2 && strcmp(argv[1], "--metrics-benchmark") == 0)
+    {
+        MetricsBenchmark benchmark(argc >= 3 ? static_cast<size_t>(std::max(1, atoi(argv[2]))) : 500,
+                                   argc >= 4 ? static_cast<unsigned>(std::max(10, atoi(argv[3]))) : 200);
+        std::string report;
+
+        MetricsBenchmark::render(benchmark.run(), report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --protocol-benchmark [channels] [frames]: binary telemetry frames against text lines */
+    if (argc >= 2 && strcmp(argv[1], "--protocol-benchmark") == 0)
+    {
+        ProtocolBenchmark benchmark(argc >= 3 ? static_cast<size_t>(std::max(1, atoi(argv[2]))) : 64,
+                                    argc >= 4 ? static_cast<size_t>(std::max(2, atoi(argv[3]))) : 100000);
+        std::vector<ProtocolResult> results;
+        std::string report;
+
+        for (double changed : {0.1, 1.0})
+        {
+            std::vector<ProtocolResult> run = benchmark.run(changed);
+            results.insert(results.end(), run.begin(), run.end());
+        }
+        ProtocolBenchmark::render(results, report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --cancel-benchmark [seconds]: random cancellations under load from one and two threads, cancel latency and mismatched replies */
+    if (argc >= 2 && strcmp(argv[1], "--cancel-benchmark") == 0)
+    {
+        CancelBenchmark benchmark(CancelBenchmark::defaultProfile(), 1);
+        double seconds = argc >= 3 ? std::max(1.0, atof(argv[2])) : 10.0;
+        std::vector<CancelResult> results;
+        std::string report;
+
+        results.push_back(benchmark.run(seconds, 0.0));
+        results.push_back(benchmark.run(seconds, 50.0));
+        results.push_back(benchmark.run(seconds, 10.0));
+        results.push_back(benchmark.run(seconds, 0.0, 2));   /* Sampler and window on one driver */
+        results.push_back(benchmark.run(seconds, 10.0, 2));
+        CancelBenchmark::render(results, report);
+        std::cout << report;
+        return CancelBenchmark::passed(results) ? 0 : 1;
+    }
+
+    /* --endurance COMx|SIM [cycles] [on ms] [off ms]: power-cycle endurance run, no window */
+    if (argc >= 3 && strcmp(argv[1], "--endurance") == 0)
+    {
+        QCoreApplication app(argc, argv);  /* Same settings and application paths as the window */
+
+        return run_endurance(argv[2], argc >= 4 ? static_cast<unsigned>(std::max(1, atoi(argv[3]))) : 1000,
+                             argc >= 5 ? std::max(1.0, atof(argv[4])) : 1000.0,
+                             argc >= 6 ? std::max(1.0, atof(argv[5])) : 1000.0);
+    }
+
+    /* --battery COMx|SIM [seconds] [rate Hz]: battery emulation on output 1, no window */
+    if (argc >= 3 && strcmp(argv[1], "--battery") == 0)
+    {
+        QCoreApplication app(argc, argv);  /* Same settings as the window */
+
+        return run_battery(argv[2], argc >= 4 ? std::max(0.1, atof(argv[3])) : 60.0,
+                           argc >= 5 ? std::max(1.0, atof(argv[4])) : 1000.0);
+    }
+
+    /* --bus-stress [seconds] [rate Hz]: telemetry bus with deliberately slow consumers, sampler rate and memory per second */
+    if (argc >= 2 && strcmp(argv[1], "--bus-stress") == 0)
+    {
+        BusStressOptions options;
+        BusStressReport result;
+        std::string report;
+
+        options.seconds = argc >= 3 ? std::max(2.0, atof(argv[2])) : 10.0;
+        options.rateHz = argc >= 4 ? std::max(1.0, atof(argv[3])) : 1000.0;
+        result = BusStress(options).run();
+        BusStress::render(result, report);
+        std::cout << report;
+        return BusStress::passed(result) ? 0 : 1;
+    }
+
+    /* --delivery-benchmark [samples] [rate Hz]: allocations and CPU per 1k samples delivered to the GUI thread */
+    if (argc >= 2 && strcmp(argv[1], "--delivery-benchmark") == 0)
+    {
+        QCoreApplication app(argc, argv);  /* Event loop of the receiving thread */
+        DeliveryBenchmark benchmark(argc >= 3 ? std::max(1000LL, atoll(argv[2])) : 20000,
+                                    argc >= 4 ? std::max(1.0, atof(argv[3])) : 5000.0);
+        std::vector<DeliveryResult> results;
+        std::string report;
+
+        results.push_back(benchmark.runSignals());
+        results.push_back(benchmark.runFrames());
+        DeliveryBenchmark::render(results, report);
+        std::cout << report;
+        return 0;
+    }
+
+    /* --dashboard-load [clients] [channels] [seconds]: event streams of many browsers on one dashboard */
+    if (argc >= 2 && strcmp(argv[1], "--dashboard-load") == 0)
+    {
+        QCoreApplication app(argc, argv);  /* Event loop shared by the server and the clients */
+        DashboardBenchmark benchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 100,
+                                     argc >= 4 ? std::max(1, atoi(argv[3])) : 4,
+                                     argc >= 5 ? std::max(1.0, atof(argv[4])) : 10.0);
+        DashboardLoadResult result = benchmark.run();
+        std::string report;
+
+        DashboardBenchmark::render(result, report);
+        std::cout << report;
+        return DashboardBenchmark::passed(result) ? 0 : 1;
+    }
+
+    /* --engine [COMx]: instrument engine for windows in engine mode, no window.
+       --engine-stop: shuts it down */
+    if (argc >= 2 && (strcmp(argv[1], "--engine") == 0 || strcmp(argv[1], "--engine-stop") == 0))
+    {
+        QCoreApplication app(argc, argv);  /* Same application paths as the window */
+
+        if (strcmp(argv[1], "--engine-stop") == 0)
+            return stop_engine();
+        return run_engine(argc >= 3 ? argv[2] : "");
+    }
+
     QApplication a(argc, argv);
+
+    /* --farm-benchmark [pollers] [seconds]: control plane against simulated instruments */
+    if (argc >= 2 && strcmp(argv[1], "--farm-benchmark") == 0)
+    {
+        unsigned pollers = argc >= 3 ? static_cast<unsigned>(atoi(argv[2])) : std::thread::hardware_concurrency();
+        double seconds = argc >= 4 ? atof(argv[3]) : 5.0;
+        return run_farm_benchmark(a, pollers, seconds);
+    }
+
     MainWindow w;
     w.show();
     return a.exec();
@@ -0,0 +1,30 @@
+/**
+ * @file allocation_test.cpp
+ * @brief Fails if any zero-allocation path allocated.
+ *
+ * Built with PS_TRACK_ALLOCATIONS whatever the window's build uses, so the
+ * probes count. Usage: allocation_test [iterations]
+ */
+
+#include "allocation_check.h"
+#include "alloc_tracker.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    AllocationCheck check(argc >= 2 ? static_cast<uint64_t>(std::max(1LL, atoll(argv[1]))) : 100000);
+    std::vector<AllocationCheckResult> results;
+    std::string report;
+
+    if (!AllocationTracker::enabled())
+    {
+        std::cout << "Allocation test: Built without PS_TRACK_ALLOCATIONS" << std::endl;
+        return 1;
+    }
+    results = check.run();
+    AllocationCheck::render(results, report);
+    std::cout << report;
+    return AllocationCheck::passed(results) ? 0 : 1;
+}
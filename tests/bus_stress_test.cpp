@@ -0,0 +1,26 @@
+/**
+ * @file bus_stress_test.cpp
+ * @brief Fails if slow consumers of the telemetry bus slowed the sampler
+ * down or made the process grow.
+ *
+ * Usage: bus_stress_test [seconds] [rate Hz]
+ */
+
+#include "bus_stress.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    BusStressOptions options;
+    BusStressReport result;
+    std::string report;
+
+    options.seconds = argc >= 2 ? std::max(2.0, atof(argv[1])) : 5.0;
+    options.rateHz = argc >= 3 ? std::max(1.0, atof(argv[2])) : 1000.0;
+    result = BusStress(options).run();
+    BusStress::render(result, report);
+    std::cout << report;
+    return BusStress::passed(result) ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file cancel_test.cpp
+ * @brief Fails if a cancelled exchange left a reply for another query, or a
+ * cancellation took longer than CancelBenchmark::maxCancelMs.
+ *
+ * Usage: cancel_test [seconds per run]
+ */
+
+#include "cancel_benchmark.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    CancelBenchmark benchmark(CancelBenchmark::defaultProfile(), 1);
+    double seconds = argc >= 2 ? std::max(1.0, atof(argv[1])) : 3.0;
+    std::vector<CancelResult> results;
+    std::string report;
+
+    results.push_back(benchmark.run(seconds, 50.0));
+    results.push_back(benchmark.run(seconds, 10.0));
+    results.push_back(benchmark.run(seconds, 10.0, 2));  /* Sampler and window on one driver */
+    CancelBenchmark::render(results, report);
+    std::cout << report;
+    return CancelBenchmark::passed(results) ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file dashboard_load_test.cpp
+ * @brief Fails if the web dashboard dropped a client, starved a rate tier or
+ * held up the event loop it shares with the window.
+ *
+ * Usage: dashboard_load_test [clients] [channels] [seconds]
+ */
+
+#include "dashboard_benchmark.h"
+#include <QCoreApplication>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);  /* Event loop shared by the server and the clients */
+    DashboardBenchmark benchmark(argc >= 2 ? std::max(1, atoi(argv[1])) : 100,
+                                 argc >= 3 ? std::max(1, atoi(argv[2])) : 4,
+                                 argc >= 4 ? std::max(1.0, atof(argv[3])) : 5.0);
+    DashboardLoadResult result = benchmark.run();
+    std::string report;
+
+    DashboardBenchmark::render(result, report);
+    std::cout << report;
+    return DashboardBenchmark::passed(result) ? 0 : 1;
+}